@@ -0,0 +1,101 @@
+/****************************************************************************
+ * benchtime.c
+ *
+ * Runs a command and appends one CSV record with its wall and CPU
+ * seconds and peak resident size, in the layout used by the other
+ * benchmark programs:
+ *
+ *   tool,case,stage,wall_s,cpu_s,maxrss_kb,count
+ *
+ * The stage is always "total" and the count is the exit status of the
+ * command.  It is used to time whole runs of the installed executables,
+ * e.g. allocator.exe or preProcessNLCD.exe.
+ *
+ * Usage:
+ *   benchtime.exe tool case results.csv command [args ...]
+ *
+ * Use "-" as the results file to write to stdout.  The output of the
+ * command itself is not redirected.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+
+/* ============================================================= */
+static double wallClock(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+
+/* ============================================================= */
+int main(int argc, char *argv[])
+{
+    struct rusage ru;
+    FILE *out;
+    pid_t pid;
+    double start, wall, cpu;
+    int status, code;
+
+    if(argc < 5)
+    {
+        fprintf(stderr,
+                "Usage: %s tool case results.csv command [args ...]\n",
+                argv[0]);
+        return 2;
+    }
+
+    start = wallClock();
+    pid = fork();
+    if(pid < 0)
+    {
+        perror("fork");
+        return 2;
+    }
+    if(pid == 0)
+    {
+        execvp(argv[4], &argv[4]);
+        perror(argv[4]);
+        _exit(127);
+    }
+    if(wait4(pid, &status, 0, &ru) < 0)
+    {
+        perror("wait4");
+        return 2;
+    }
+    wall = wallClock() - start;
+    cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1.0e-6 +
+          ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1.0e-6;
+    code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+    if(!strcmp(argv[3], "-"))
+    {
+        out = stdout;
+    }
+    else if((out = fopen(argv[3], "a")) == NULL)
+    {
+        perror(argv[3]);
+        return 2;
+    }
+    if(out == stdout || ftell(out) == 0)
+    {
+        fprintf(out, "tool,case,stage,wall_s,cpu_s,maxrss_kb,count\n");
+    }
+    fprintf(out, "%s,%s,total,%.4f,%.4f,%ld,%d\n", argv[1], argv[2],
+            wall, cpu, ru.ru_maxrss, code);
+    if(out != stdout)
+    {
+        fclose(out);
+    }
+    return code;
+}
@@ -0,0 +1,945 @@
+/****************************************************************************
+ * gensynth.c
+ *
+ * Writes a deterministic synthetic data set for the benchmarks in this
+ * directory, so that srgcreate, allocator and the raster tools can be
+ * timed without the external data tarball.  Everything is generated
+ * from hashes of the seed and the feature indices, so the same command
+ * line always writes the same files.  The vector data are in the
+ * LAM_40N_97W projection used by the scripts:
+ *
+ *   counties.shp   county-like polygon mosaic (FIPS, NAME, AREA_KM2)
+ *   tracts.shp     finer polygon mosaic (TRACT, FIPS, POP2000, HOUSING)
+ *   roads.shp      road-like polylines (ROAD_ID, LANES)
+ *   points.shp     point cloud with clusters (SITE_ID, BERTHS)
+ *   points.csv     the same points as a PointFile in lat-lon
+ *   GRIDDESC.txt   SYNGRID and SYNFINE regular grids and SYNEGRID
+ *   egrid.txt      ArcGIS polygon text file for the SYNEGRID EGrid
+ *   nlcd_*.bil     overlapping NLCD-like tiles, EHdr format, Albers
+ *   nlcd_files.txt list of the NLCD tiles, for preProcessNLCD
+ *   swath_*.bil    swath latitude, longitude and a variable (float32)
+ *   synth.env      the sizes written, as csh setenv lines
+ *
+ * Usage:
+ *   gensynth.exe output_dir [-scale s] [-seed n] [-counties n]
+ *        [-tract_factor n] [-edge_points n] [-roads n] [-points n]
+ *        [-grid_cell m] [-nlcd_tiles n] [-nlcd_pixels n]
+ *        [-swath_lines n] [-swath_pixels n]
+ *
+ * The scale multiplies the number of counties, roads and points, and
+ * the domain grows with it so the features keep their size.  The swath
+ * has 1 km pixels at nadir and its track crosses the whole domain.
+ *
+ * File contains:
+ * main
+ * writeMosaic
+ * writeRoads
+ * writePoints
+ * writeGrids
+ * writeNLCD
+ * writeSwath
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "shapefil.h"
+#include "proj_api.h"
+
+#define PI 3.14159265358979323846
+
+#define LCC_PROJ "+proj=lcc +a=6370000.0 +b=6370000.0 +lat_1=33 +lat_2=45 +lat_0=40 +lon_0=-97"
+#define LATLON_PROJ "+proj=latlong +a=6370000.0 +b=6370000.0"
+#define ALBERS_PROJ "+proj=aea +lat_1=29.5 +lat_2=45.5 +lat_0=23 +lon_0=-96 +x_0=0 +y_0=0 +ellps=GRS80 +datum=NAD83"
+#define ALBERS_PRJ "PROJCS[\"USA_Contiguous_Albers_Equal_Area_Conic_USGS_version\",GEOGCS[\"GCS_North_American_1983\",DATUM[\"D_North_American_1983\",SPHEROID[\"GRS_1980\",6378137.0,298.257222101]],PRIMEM[\"Greenwich\",0.0],UNIT[\"Degree\",0.0174532925199433]],PROJECTION[\"Albers\"],PARAMETER[\"False_Easting\",0.0],PARAMETER[\"False_Northing\",0.0],PARAMETER[\"Central_Meridian\",-96.0],PARAMETER[\"Standard_Parallel_1\",29.5],PARAMETER[\"Standard_Parallel_2\",45.5],PARAMETER[\"Latitude_Of_Origin\",23.0],UNIT[\"Meter\",1.0]]"
+
+/* size of a county cell, and of the domain at scale 1, in meters */
+#define COUNTY_SIZE 60000.0
+#define SWATH_MISSING -999.0
+
+#define MIN(x,y) ((x)<(y) ? (x):(y))
+#define MAX(x,y) ((x)>(y) ? (x):(y))
+
+typedef struct _SynthParms {
+    char dir[256];
+    unsigned long seed;
+    int counties;           /* counties along each side of the domain */
+    int tractFactor;        /* tracts along each side of a county */
+    int edgePoints;         /* vertices between the corners of an edge */
+    int roads;
+    int points;
+    double gridCell;        /* SYNGRID cell size */
+    int nlcdTiles;          /* tiles along each side */
+    int nlcdPixels;         /* pixels along each side of a tile */
+    int swathLines;
+    int swathPixels;
+    double xmin, ymin, xmax, ymax;  /* domain, LCC meters */
+} SynthParms;
+
+/* the NLCD classes, with how often each is drawn */
+static int nlcdClass[] = { 11, 21, 22, 23, 24, 31, 41, 42, 43, 52, 71,
+                           81, 82, 90, 95 };
+static int nlcdWeight[] = { 6, 6, 4, 2, 1, 1, 14, 12, 5, 12, 8,
+                            8, 14, 5, 2 };
+#define NLCD_CLASSES 15
+
+static projPJ lccProj, latlonProj, albersProj;
+
+
+/* ============================================================= */
+/* A hash of the seed and three indices, uniform in [0, 1) */
+static double unitHash(unsigned long seed, unsigned long a, unsigned long b,
+                       unsigned long c)
+{
+    unsigned long h = (seed * 0x9E3779B1UL) & 0xFFFFFFFFUL;
+
+    h = ((h ^ a) * 0x85EBCA6BUL) & 0xFFFFFFFFUL;
+    h ^= h >> 13;
+    h = ((h ^ b) * 0xC2B2AE35UL) & 0xFFFFFFFFUL;
+    h ^= h >> 16;
+    h = ((h ^ c) * 0x27D4EB2FUL) & 0xFFFFFFFFUL;
+    h ^= h >> 15;
+    h = (h * 0x85EBCA6BUL) & 0xFFFFFFFFUL;
+    h ^= h >> 13;
+    return (double) h / 4294967296.0;
+}
+
+
+/* ============================================================= */
+/* Sequential draws for the roads and points */
+static unsigned long rngState;
+
+static double rnd(void)
+{
+    rngState = (rngState * 1664525UL + 1013904223UL) & 0xFFFFFFFFUL;
+    return unitHash(rngState, 17, 0, 0);
+}
+
+static double rndNormal(void)
+{
+    double u1 = rnd(), u2 = rnd();
+
+    if(u1 < 1e-12)
+    {
+        u1 = 1e-12;
+    }
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * PI * u2);
+}
+
+
+/* ============================================================= */
+static void fail(char *mesg, char *what)
+{
+    fprintf(stderr, "gensynth: %s %s\n", mesg, what ? what : "");
+    exit(2);
+}
+
+
+/* ============================================================= */
+static projPJ initProj(char *def)
+{
+    projPJ p = pj_init_plus(def);
+
+    if(p == NULL)
+    {
+        fail("Unable to initialize projection", def);
+    }
+    return p;
+}
+
+
+/* ============================================================= */
+/* Transform n points in place between two projections */
+static void transform(projPJ from, projPJ to, int n, double *x, double *y)
+{
+    int i;
+
+    if(pj_is_latlong(from))
+    {
+        for(i = 0; i < n; i++)
+        {
+            x[i] *= DEG_TO_RAD;
+            y[i] *= DEG_TO_RAD;
+        }
+    }
+    if(pj_transform(from, to, n, 1, x, y, NULL) != 0)
+    {
+        fail("Projection error", NULL);
+    }
+    if(pj_is_latlong(to))
+    {
+        for(i = 0; i < n; i++)
+        {
+            x[i] *= RAD_TO_DEG;
+            y[i] *= RAD_TO_DEG;
+        }
+    }
+}
+
+
+/* ============================================================= */
+static char *fileName(SynthParms *sp, char *name)
+{
+    static char path[4][512];
+    static int next = 0;
+
+    next = (next + 1) % 4;
+    sprintf(path[next], "%s/%s", sp->dir, name);
+    return path[next];
+}
+
+
+/* ============================================================= */
+/* Corner (i, j) of an n x m lattice over the box.  Corners on the
+ * boundary stay on it so the mosaic covers the box exactly. */
+static void latticeNode(unsigned long seed, int i, int j, int n, int m,
+                        double x0, double y0, double dx, double dy,
+                        double *x, double *y)
+{
+    *x = x0 + i * dx;
+    *y = y0 + j * dy;
+    if(i > 0 && i < n)
+    {
+        *x += (unitHash(seed, 1, i, j) - 0.5) * 0.4 * dx;
+    }
+    if(j > 0 && j < m)
+    {
+        *y += (unitHash(seed, 2, i, j) - 0.5) * 0.4 * dy;
+    }
+}
+
+
+/* ============================================================= */
+/* Point k (1 to np) between corners (x1,y1) and (x2,y2) of lattice edge
+ * (kind, i, j).  The offset only depends on the edge, so the two
+ * polygons that share it get the same vertices. */
+static void edgePoint(unsigned long seed, int kind, int i, int j, int k,
+                      int np, int boundary, double x1, double y1,
+                      double x2, double y2, double *x, double *y)
+{
+    double t = (double) k / (np + 1);
+    double dx = x2 - x1, dy = y2 - y1;
+    double off = 0.0;
+
+    if(!boundary)
+    {
+        off = (unitHash(seed, 3 + kind, i * 4096 + j, k) - 0.5) * 0.16 *
+              sin(PI * t);
+    }
+    *x = x1 + dx * t - dy * off;
+    *y = y1 + dy * t + dx * off;
+}
+
+
+/* ============================================================= */
+/* Outline of cell (i, j) of the mosaic, clockwise and closed.  Returns
+ * the number of vertices. */
+static int mosaicCell(unsigned long seed, int i, int j, int n, int m,
+                      int np, double x0, double y0, double dx, double dy,
+                      double *x, double *y)
+{
+    double cx[4], cy[4];
+    int k, nv = 0;
+
+    latticeNode(seed, i, j, n, m, x0, y0, dx, dy, &cx[0], &cy[0]);
+    latticeNode(seed, i, j + 1, n, m, x0, y0, dx, dy, &cx[1], &cy[1]);
+    latticeNode(seed, i + 1, j + 1, n, m, x0, y0, dx, dy, &cx[2], &cy[2]);
+    latticeNode(seed, i + 1, j, n, m, x0, y0, dx, dy, &cx[3], &cy[3]);
+
+    /* up the left edge, which is vertical edge (i, j) */
+    x[nv] = cx[0]; y[nv] = cy[0]; nv++;
+    for(k = 1; k <= np; k++, nv++)
+    {
+        edgePoint(seed, 1, i, j, k, np, i == 0, cx[0], cy[0], cx[1], cy[1],
+                  &x[nv], &y[nv]);
+    }
+    /* along the top, horizontal edge (i, j + 1) */
+    x[nv] = cx[1]; y[nv] = cy[1]; nv++;
+    for(k = 1; k <= np; k++, nv++)
+    {
+        edgePoint(seed, 0, i, j + 1, k, np, j + 1 == m, cx[1], cy[1],
+                  cx[2], cy[2], &x[nv], &y[nv]);
+    }
+    /* down the right, vertical edge (i + 1, j), walked backwards */
+    x[nv] = cx[2]; y[nv] = cy[2]; nv++;
+    for(k = np; k >= 1; k--, nv++)
+    {
+        edgePoint(seed, 1, i + 1, j, k, np, i + 1 == n, cx[3], cy[3],
+                  cx[2], cy[2], &x[nv], &y[nv]);
+    }
+    /* back along the bottom, horizontal edge (i, j), backwards */
+    x[nv] = cx[3]; y[nv] = cy[3]; nv++;
+    for(k = np; k >= 1; k--, nv++)
+    {
+        edgePoint(seed, 0, i, j, k, np, j == 0, cx[0], cy[0], cx[3], cy[3],
+                  &x[nv], &y[nv]);
+    }
+    x[nv] = cx[0]; y[nv] = cy[0]; nv++;
+    return nv;
+}
+
+
+/* ============================================================= */
+static double ringArea(int nv, double *x, double *y)
+{
+    double a = 0.0;
+    int k;
+
+    for(k = 0; k < nv - 1; k++)
+    {
+        a += x[k] * y[k + 1] - x[k + 1] * y[k];
+    }
+    return fabs(a) / 2.0;
+}
+
+
+/* ============================================================= */
+/* County FIPS code for county (i, j) */
+static void countyFIPS(SynthParms *sp, int i, int j, char *fips)
+{
+    int idx = j * sp->counties + i;
+
+    sprintf(fips, "%02d%03d", (idx / 999 + 1) % 100, idx % 999 + 1);
+}
+
+
+/* ============================================================= */
+/* Write the counties (tracts == 0) or the tracts (tracts == 1) */
+static void writeMosaic(SynthParms *sp, int tracts)
+{
+    SHPHandle shp;
+    DBFHandle dbf;
+    SHPObject *obj;
+    double *x, *y, dx, dy, a;
+    char name[64], fips[16], *base;
+    int n, i, j, nv, rec, ci, cj;
+    unsigned long seed;
+
+    n = sp->counties * (tracts ? sp->tractFactor : 1);
+    seed = sp->seed * 31 + (tracts ? 2 : 1);
+    dx = (sp->xmax - sp->xmin) / n;
+    dy = (sp->ymax - sp->ymin) / n;
+    base = tracts ? "tracts" : "counties";
+
+    shp = SHPCreate(fileName(sp, base), SHPT_POLYGON);
+    dbf = DBFCreate(fileName(sp, base));
+    if(shp == NULL || dbf == NULL)
+    {
+        fail("Unable to create", fileName(sp, base));
+    }
+    if(tracts)
+    {
+        DBFAddField(dbf, "TRACT", FTString, 11, 0);
+        DBFAddField(dbf, "FIPS", FTString, 5, 0);
+        DBFAddField(dbf, "POP2000", FTDouble, 12, 1);
+        DBFAddField(dbf, "HOUSING", FTInteger, 10, 0);
+    }
+    else
+    {
+        DBFAddField(dbf, "FIPS", FTString, 5, 0);
+        DBFAddField(dbf, "NAME", FTString, 24, 0);
+        DBFAddField(dbf, "AREA_KM2", FTDouble, 12, 3);
+    }
+
+    x = (double *) malloc((4 * sp->edgePoints + 5) * sizeof(double));
+    y = (double *) malloc((4 * sp->edgePoints + 5) * sizeof(double));
+    if(x == NULL || y == NULL)
+    {
+        fail("Allocation error for", base);
+    }
+
+    rec = 0;
+    for(j = 0; j < n; j++)
+    {
+        for(i = 0; i < n; i++)
+        {
+            nv = mosaicCell(seed, i, j, n, n, sp->edgePoints, sp->xmin,
+                            sp->ymin, dx, dy, x, y);
+            obj = SHPCreateSimpleObject(SHPT_POLYGON, nv, x, y, NULL);
+            SHPWriteObject(shp, -1, obj);
+            SHPDestroyObject(obj);
+            a = ringArea(nv, x, y);
+
+            if(tracts)
+            {
+                ci = i / sp->tractFactor;
+                cj = j / sp->tractFactor;
+                countyFIPS(sp, ci, cj, fips);
+                sprintf(name, "%s%06d", fips, rec % 1000000);
+                DBFWriteStringAttribute(dbf, rec, 0, name);
+                DBFWriteStringAttribute(dbf, rec, 1, fips);
+                /* a few dense places in a sparse background */
+                DBFWriteDoubleAttribute(dbf, rec, 2, floor(50.0 +
+                    8000.0 * pow(unitHash(seed, 7, i, j), 3.0)));
+                DBFWriteIntegerAttribute(dbf, rec, 3,
+                    (int) (20 + 3000 * pow(unitHash(seed, 8, i, j), 3.0)));
+            }
+            else
+            {
+                countyFIPS(sp, i, j, fips);
+                sprintf(name, "County %d-%d", i, j);
+                DBFWriteStringAttribute(dbf, rec, 0, fips);
+                DBFWriteStringAttribute(dbf, rec, 1, name);
+                DBFWriteDoubleAttribute(dbf, rec, 2, a / 1.0e6);
+            }
+            rec++;
+        }
+    }
+
+    SHPClose(shp);
+    DBFClose(dbf);
+    free(x);
+    free(y);
+    printf("%s: %d polygons of %d vertices\n", base, rec,
+           4 * sp->edgePoints + 5);
+}
+
+
+/* ============================================================= */
+/* Random walks that stop at the edge of the domain */
+static void writeRoads(SynthParms *sp)
+{
+    SHPHandle shp;
+    DBFHandle dbf;
+    SHPObject *obj;
+    double *x, *y, heading, step;
+    int r, k, nv, maxv = 400, totv = 0;
+
+    rngState = sp->seed * 7 + 3;
+    step = COUNTY_SIZE / 8.0;
+
+    shp = SHPCreate(fileName(sp, "roads"), SHPT_ARC);
+    dbf = DBFCreate(fileName(sp, "roads"));
+    if(shp == NULL || dbf == NULL)
+    {
+        fail("Unable to create", fileName(sp, "roads"));
+    }
+    DBFAddField(dbf, "ROAD_ID", FTInteger, 9, 0);
+    DBFAddField(dbf, "LANES", FTInteger, 2, 0);
+
+    x = (double *) malloc(maxv * sizeof(double));
+    y = (double *) malloc(maxv * sizeof(double));
+    if(x == NULL || y == NULL)
+    {
+        fail("Allocation error for", "roads");
+    }
+
+    for(r = 0; r < sp->roads; r++)
+    {
+        x[0] = sp->xmin + rnd() * (sp->xmax - sp->xmin);
+        y[0] = sp->ymin + rnd() * (sp->ymax - sp->ymin);
+        heading = rnd() * 2.0 * PI;
+        nv = 20 + (int) (rnd() * (maxv - 20));
+        for(k = 1; k < nv; k++)
+        {
+            heading += 0.15 * rndNormal();
+            x[k] = x[k - 1] + step * (0.5 + rnd()) * cos(heading);
+            y[k] = y[k - 1] + step * (0.5 + rnd()) * sin(heading);
+            if(x[k] <= sp->xmin || x[k] >= sp->xmax ||
+               y[k] <= sp->ymin || y[k] >= sp->ymax)
+            {
+                break;
+            }
+        }
+        if(k < 2)
+        {
+            /* keep at least one segment inside the domain */
+            x[1] = x[0] + (x[0] < (sp->xmin + sp->xmax) / 2 ? step : -step);
+            y[1] = y[0];
+            k = 2;
+        }
+        totv += k;
+        obj = SHPCreateSimpleObject(SHPT_ARC, k, x, y, NULL);
+        SHPWriteObject(shp, -1, obj);
+        SHPDestroyObject(obj);
+        DBFWriteIntegerAttribute(dbf, r, 0, r + 1);
+        DBFWriteIntegerAttribute(dbf, r, 1, 1 + (int) (rnd() * 6));
+    }
+
+    SHPClose(shp);
+    DBFClose(dbf);
+    free(x);
+    free(y);
+    printf("roads: %d polylines, %d vertices\n", sp->roads, totv);
+}
+
+
+/* ============================================================= */
+/* Points, most of them in clusters, as a shapefile and as a PointFile
+ * with quoted names */
+static void writePoints(SynthParms *sp)
+{
+    SHPHandle shp;
+    DBFHandle dbf;
+    SHPObject *obj;
+    FILE *csv;
+    double *x, *y, *lon, *lat, cx = 0.0, cy = 0.0;
+    int p, nclust = 0;
+    char id[16];
+
+    rngState = sp->seed * 11 + 5;
+
+    x = (double *) malloc(sp->points * sizeof(double));
+    y = (double *) malloc(sp->points * sizeof(double));
+    lon = (double *) malloc(sp->points * sizeof(double));
+    lat = (double *) malloc(sp->points * sizeof(double));
+    if(x == NULL || y == NULL || lon == NULL || lat == NULL)
+    {
+        fail("Allocation error for", "points");
+    }
+    for(p = 0; p < sp->points; p++)
+    {
+        if(nclust == 0 && rnd() < 0.7)
+        {
+            /* start a new cluster */
+            cx = sp->xmin + rnd() * (sp->xmax - sp->xmin);
+            cy = sp->ymin + rnd() * (sp->ymax - sp->ymin);
+            nclust = 5 + (int) (rnd() * 50);
+        }
+        if(nclust > 0)
+        {
+            x[p] = cx + rndNormal() * COUNTY_SIZE / 10.0;
+            y[p] = cy + rndNormal() * COUNTY_SIZE / 10.0;
+            nclust--;
+        }
+        else
+        {
+            x[p] = sp->xmin + rnd() * (sp->xmax - sp->xmin);
+            y[p] = sp->ymin + rnd() * (sp->ymax - sp->ymin);
+        }
+        x[p] = MAX(sp->xmin + 1.0, MIN(sp->xmax - 1.0, x[p]));
+        y[p] = MAX(sp->ymin + 1.0, MIN(sp->ymax - 1.0, y[p]));
+        lon[p] = x[p];
+        lat[p] = y[p];
+    }
+    transform(lccProj, latlonProj, sp->points, lon, lat);
+
+    shp = SHPCreate(fileName(sp, "points"), SHPT_POINT);
+    dbf = DBFCreate(fileName(sp, "points"));
+    if((csv = fopen(fileName(sp, "points.csv"), "w")) == NULL ||
+       shp == NULL || dbf == NULL)
+    {
+        fail("Unable to create", fileName(sp, "points"));
+    }
+    DBFAddField(dbf, "SITE_ID", FTString, 10, 0);
+    DBFAddField(dbf, "BERTHS", FTInteger, 4, 0);
+    fprintf(csv, "SITE_ID,NAME,LONGITUDE,LATITUDE,BERTHS\n");
+
+    rngState = sp->seed * 13 + 1;
+    for(p = 0; p < sp->points; p++)
+    {
+        int berths = 1 + (int) (40 * pow(rnd(), 2.0));
+
+        sprintf(id, "S%08d", p + 1);
+        obj = SHPCreateSimpleObject(SHPT_POINT, 1, &x[p], &y[p], NULL);
+        SHPWriteObject(shp, -1, obj);
+        SHPDestroyObject(obj);
+        DBFWriteStringAttribute(dbf, p, 0, id);
+        DBFWriteIntegerAttribute(dbf, p, 1, berths);
+        fprintf(csv, "%s,\"Site %d, Unit %d\",%.6f,%.6f,%d\n", id, p + 1,
+                p % 7 + 1, lon[p], lat[p], berths);
+    }
+
+    SHPClose(shp);
+    DBFClose(dbf);
+    fclose(csv);
+    free(x);
+    free(y);
+    free(lon);
+    free(lat);
+    printf("points: %d\n", sp->points);
+}
+
+
+/* ============================================================= */
+/* GRIDDESC with the regular grids and an EGrid over the domain, and
+ * the ArcGIS text file of the EGrid cells */
+static void writeGrids(SynthParms *sp, int *ncols, int *nrows)
+{
+    FILE *fp;
+    double x[5], y[5], cell = sp->gridCell;
+    int i, j, n, m;
+
+    *ncols = (int) ((sp->xmax - sp->xmin) / cell);
+    *nrows = (int) ((sp->ymax - sp->ymin) / cell);
+
+    if((fp = fopen(fileName(sp, "GRIDDESC.txt"), "w")) == NULL)
+    {
+        fail("Unable to create", fileName(sp, "GRIDDESC.txt"));
+    }
+    fprintf(fp, "! coords\n'LAM_40N_97W'\n2, 33, 45, -97, -97, 40\n' '\n");
+    fprintf(fp, "'SYNGRID'\n'LAM_40N_97W', %.1f, %.1f, %.1f, %.1f, %d, %d, 1\n",
+            sp->xmin, sp->ymin, cell, cell, *ncols, *nrows);
+    fprintf(fp, "'SYNFINE'\n'LAM_40N_97W', %.1f, %.1f, %.1f, %.1f, %d, %d, 1\n",
+            sp->xmin, sp->ymin, cell / 3.0, cell / 3.0, *ncols * 3, *nrows * 3);
+    fprintf(fp, "'SYNEGRID'\n'LAM_40N_97W', %.1f, %.1f, %.1f, %.1f, %d, %d, 1\n",
+            sp->xmin, sp->ymin, cell, cell, *ncols, *nrows);
+    fprintf(fp, "' '\n");
+    fclose(fp);
+
+    /* the EGrid cells are the regular cells with jittered corners */
+    if((fp = fopen(fileName(sp, "egrid.txt"), "w")) == NULL)
+    {
+        fail("Unable to create", fileName(sp, "egrid.txt"));
+    }
+    n = *ncols;
+    m = *nrows;
+    for(j = 0; j < m; j++)
+    {
+        for(i = 0; i < n; i++)
+        {
+            mosaicCell(sp->seed * 31 + 3, i, j, n, m, 0, sp->xmin, sp->ymin,
+                       cell, cell, x, y);
+            fprintf(fp, "%d,%.3f,%.3f\n", j * n + i + 1,
+                    (x[0] + x[2]) / 2.0, (y[0] + y[2]) / 2.0);
+            fprintf(fp, "%.3f,%.3f\n%.3f,%.3f\n%.3f,%.3f\n%.3f,%.3f\n"
+                    "%.3f,%.3f\nEND\n", x[0], y[0], x[1], y[1], x[2], y[2],
+                    x[3], y[3], x[4], y[4]);
+        }
+    }
+    fprintf(fp, "END\n");
+    fclose(fp);
+    printf("grids: SYNGRID %d x %d, SYNFINE %d x %d, SYNEGRID %d x %d\n",
+           n, m, 3 * n, 3 * m, n, m);
+}
+
+
+/* ============================================================= */
+static void writeEHdr(char *hdrName, int nrows, int ncols, int nbits,
+                      double ulx, double uly, double dim, char *nodata)
+{
+    FILE *fp;
+
+    if((fp = fopen(hdrName, "w")) == NULL)
+    {
+        fail("Unable to create", hdrName);
+    }
+    fprintf(fp, "BYTEORDER      I\nLAYOUT         BIL\n");
+    fprintf(fp, "NROWS          %d\nNCOLS          %d\n", nrows, ncols);
+    fprintf(fp, "NBANDS         1\nNBITS          %d\n", nbits);
+    if(nbits == 32)
+    {
+        fprintf(fp, "PIXELTYPE      FLOAT\n");
+    }
+    fprintf(fp, "BANDROWBYTES   %d\nTOTALROWBYTES  %d\n", ncols * nbits / 8,
+            ncols * nbits / 8);
+    fprintf(fp, "ULXMAP         %.6f\nULYMAP         %.6f\n", ulx, uly);
+    fprintf(fp, "XDIM           %.6f\nYDIM           %.6f\n", dim, dim);
+    fprintf(fp, "NODATA         %s\n", nodata);
+    fclose(fp);
+}
+
+
+/* ============================================================= */
+/* NLCD-like tiles of 30 m pixels in the middle of the domain.  The
+ * tiles overlap, as the NLCD zone images do, and a pixel has the same
+ * class in every tile it falls in. */
+static void writeNLCD(SynthParms *sp)
+{
+    FILE *fp, *list, *prj;
+    unsigned char *row;
+    double cx, cy, x0, y0, u;
+    int tx, ty, i, j, k, c, overlap = 64, patch = 33, tot, gx, gy;
+    long pi, pj;
+    char name[64];
+
+    if(sp->nlcdTiles <= 0)
+    {
+        return;
+    }
+
+    /* the domain center in Albers, snapped to the 30 m pixels */
+    cx = (sp->xmin + sp->xmax) / 2.0;
+    cy = (sp->ymin + sp->ymax) / 2.0;
+    transform(lccProj, albersProj, 1, &cx, &cy);
+    cx = floor(cx / 30.0) * 30.0;
+    cy = floor(cy / 30.0) * 30.0;
+    x0 = cx - sp->nlcdTiles * (sp->nlcdPixels - overlap) * 15.0;
+    y0 = cy + sp->nlcdTiles * (sp->nlcdPixels - overlap) * 15.0;
+
+    for(tot = 0, k = 0; k < NLCD_CLASSES; k++)
+    {
+        tot += nlcdWeight[k];
+    }
+
+    row = (unsigned char *) malloc(sp->nlcdPixels);
+    if(row == NULL || (list = fopen(fileName(sp, "nlcd_files.txt"), "w")) == NULL)
+    {
+        fail("Unable to create", fileName(sp, "nlcd_files.txt"));
+    }
+    for(ty = 0; ty < sp->nlcdTiles; ty++)
+    {
+        for(tx = 0; tx < sp->nlcdTiles; tx++)
+        {
+            sprintf(name, "nlcd_%02d_%02d.bil", tx, ty);
+            if((fp = fopen(fileName(sp, name), "wb")) == NULL)
+            {
+                fail("Unable to create", fileName(sp, name));
+            }
+            for(i = 0; i < sp->nlcdPixels; i++)
+            {
+                pj = (long) ty * (sp->nlcdPixels - overlap) + i;
+                for(j = 0; j < sp->nlcdPixels; j++)
+                {
+                    pi = (long) tx * (sp->nlcdPixels - overlap) + j;
+                    /* the patch this pixel is in, with ragged borders */
+                    gx = (int) ((pi + (long) (8 * unitHash(sp->seed, 9, pj, 0)))
+                                / patch);
+                    gy = (int) ((pj + (long) (8 * unitHash(sp->seed, 10, pi, 0)))
+                                / patch);
+                    u = unitHash(sp->seed, 11, gx, gy);
+                    if(unitHash(sp->seed, 12, pi, pj) < 0.08)
+                    {
+                        /* speckle */
+                        u = unitHash(sp->seed, 13, pi, pj);
+                    }
+                    c = (int) (u * tot);
+                    for(k = 0; k < NLCD_CLASSES - 1 && c >= nlcdWeight[k]; k++)
+                    {
+                        c -= nlcdWeight[k];
+                    }
+                    row[j] = (unsigned char) nlcdClass[k];
+                }
+                fwrite(row, 1, sp->nlcdPixels, fp);
+            }
+            fclose(fp);
+
+            sprintf(name, "nlcd_%02d_%02d.hdr", tx, ty);
+            writeEHdr(fileName(sp, name), sp->nlcdPixels, sp->nlcdPixels, 8,
+                      x0 + tx * (sp->nlcdPixels - overlap) * 30.0 + 15.0,
+                      y0 - ty * (sp->nlcdPixels - overlap) * 30.0 - 15.0,
+                      30.0, "0");
+            sprintf(name, "nlcd_%02d_%02d.prj", tx, ty);
+            if((prj = fopen(fileName(sp, name), "w")) == NULL)
+            {
+                fail("Unable to create", fileName(sp, name));
+            }
+            fprintf(prj, "%s\n", ALBERS_PRJ);
+            fclose(prj);
+
+            sprintf(name, "nlcd_%02d_%02d.bil", tx, ty);
+            fprintf(list, "%s\n", fileName(sp, name));
+        }
+    }
+    fclose(list);
+    free(row);
+    printf("nlcd: %d tiles of %d x %d pixels\n", sp->nlcdTiles * sp->nlcdTiles,
+           sp->nlcdPixels, sp->nlcdPixels);
+}
+
+
+/* ============================================================= */
+/* One swath across the domain, lines along the track and pixels across
+ * it that grow toward the edges of the scan, with a smooth variable
+ * that is missing in a few places */
+static void writeSwath(SynthParms *sp)
+{
+    FILE *fp[3];
+    char *names[3] = { "swath_lat", "swath_lon", "swath_val" };
+    double *x, *y, heading = 0.35, along, across, s, u, cx, cy, len;
+    float *val;
+    char name[64];
+    int i, j, k, nl = sp->swathLines, np = sp->swathPixels;
+
+    if(nl <= 0 || np <= 0)
+    {
+        return;
+    }
+
+    x = (double *) malloc(np * sizeof(double));
+    y = (double *) malloc(np * sizeof(double));
+    val = (float *) malloc(np * sizeof(float));
+    if(x == NULL || y == NULL || val == NULL)
+    {
+        fail("Allocation error for", "swath");
+    }
+    for(k = 0; k < 3; k++)
+    {
+        sprintf(name, "%s.bil", names[k]);
+        if((fp[k] = fopen(fileName(sp, name), "wb")) == NULL)
+        {
+            fail("Unable to create", fileName(sp, name));
+        }
+    }
+
+    /* 1 km pixels at nadir, 2.5 km at the scan edges */
+    cx = (sp->xmin + sp->xmax) / 2.0;
+    cy = (sp->ymin + sp->ymax) / 2.0;
+    len = 1000.0 * nl;
+    for(i = 0; i < nl; i++)
+    {
+        along = -len / 2.0 + 1000.0 * i;
+        for(j = 0; j < np; j++)
+        {
+            u = (2.0 * j + 1.0 - np) / np;
+            across = 500.0 * np * (u + 0.5 * u * u * u);
+            x[j] = cx + along * sin(heading) + across * cos(heading);
+            y[j] = cy + along * cos(heading) - across * sin(heading);
+            s = 1.0 + 0.5 * sin(x[j] / 200000.0) * cos(y[j] / 300000.0);
+            val[j] = (float) (s * 2.0e15);
+            if(unitHash(sp->seed, 14, i / 4, j / 4) < 0.05)
+            {
+                val[j] = (float) SWATH_MISSING;
+            }
+        }
+        transform(lccProj, latlonProj, np, x, y);
+        for(j = 0; j < np; j++)
+        {
+            float lat = (float) y[j], lon = (float) x[j];
+
+            fwrite(&lat, sizeof(float), 1, fp[0]);
+            fwrite(&lon, sizeof(float), 1, fp[1]);
+        }
+        fwrite(val, sizeof(float), np, fp[2]);
+    }
+    for(k = 0; k < 3; k++)
+    {
+        fclose(fp[k]);
+        sprintf(name, "%s.hdr", names[k]);
+        writeEHdr(fileName(sp, name), nl, np, 32, 0.5, nl - 0.5, 1.0, "-999");
+    }
+    free(x);
+    free(y);
+    free(val);
+    printf("swath: %d lines of %d pixels\n", nl, np);
+}
+
+
+/* ============================================================= */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: gensynth.exe output_dir [-scale s] [-seed n] "
+            "[-counties n]\n\t[-tract_factor n] [-edge_points n] [-roads n] "
+            "[-points n]\n\t[-grid_cell m] [-nlcd_tiles n] [-nlcd_pixels n]\n"
+            "\t[-swath_lines n] [-swath_pixels n]\n");
+    exit(2);
+}
+
+
+/* ============================================================= */
+int main(int argc, char *argv[])
+{
+    SynthParms sp;
+    FILE *fp;
+    double scale = 1.0, half;
+    int a, ncols, nrows;
+
+    if(argc < 2 || argv[1][0] == '-')
+    {
+        usage();
+    }
+    strncpy(sp.dir, argv[1], sizeof(sp.dir) - 1);
+    sp.dir[sizeof(sp.dir) - 1] = '\0';
+
+    /* the scale is applied first, the other options override it */
+    for(a = 2; a < argc - 1; a += 2)
+    {
+        if(!strcmp(argv[a], "-scale"))
+        {
+            scale = atof(argv[a + 1]);
+        }
+    }
+    if(scale <= 0.0)
+    {
+        usage();
+    }
+    sp.seed = 1;
+    sp.counties = MAX(2, (int) floor(20.0 * sqrt(scale) + 0.5));
+    sp.tractFactor = 4;
+    sp.edgePoints = 8;
+    sp.roads = (int) (2000 * scale);
+    sp.points = (int) (20000 * scale);
+    sp.gridCell = 12000.0;
+    sp.nlcdTiles = 2;
+    sp.nlcdPixels = (int) (2000 * sqrt(scale));
+    sp.swathLines = -1;
+    sp.swathPixels = (int) (1000 * sqrt(scale));
+
+    for(a = 2; a < argc; a += 2)
+    {
+        if(a + 1 >= argc)
+        {
+            usage();
+        }
+        if(!strcmp(argv[a], "-scale"))
+            ;
+        else if(!strcmp(argv[a], "-seed"))
+            sp.seed = (unsigned long) atol(argv[a + 1]);
+        else if(!strcmp(argv[a], "-counties"))
+            sp.counties = atoi(argv[a + 1]);
+        else if(!strcmp(argv[a], "-tract_factor"))
+            sp.tractFactor = atoi(argv[a + 1]);
+        else if(!strcmp(argv[a], "-edge_points"))
+            sp.edgePoints = atoi(argv[a + 1]);
+        else if(!strcmp(argv[a], "-roads"))
+            sp.roads = atoi(argv[a + 1]);
+        else if(!strcmp(argv[a], "-points"))
+            sp.points = atoi(argv[a + 1]);
+        else if(!strcmp(argv[a], "-grid_cell"))
+            sp.gridCell = atof(argv[a + 1]);
+        else if(!strcmp(argv[a], "-nlcd_tiles"))
+            sp.nlcdTiles = atoi(argv[a + 1]);
+        else if(!strcmp(argv[a], "-nlcd_pixels"))
+            sp.nlcdPixels = atoi(argv[a + 1]);
+        else if(!strcmp(argv[a], "-swath_lines"))
+            sp.swathLines = atoi(argv[a + 1]);
+        else if(!strcmp(argv[a], "-swath_pixels"))
+            sp.swathPixels = atoi(argv[a + 1]);
+        else
+            usage();
+    }
+    if(sp.counties < 1 || sp.tractFactor < 1 || sp.edgePoints < 0 ||
+       sp.roads < 0 || sp.points < 0 || sp.gridCell <= 0.0 ||
+       sp.nlcdPixels <= 64)
+    {
+        usage();
+    }
+
+    /* the domain is centered on the projection origin */
+    half = sp.counties * COUNTY_SIZE / 2.0;
+    sp.xmin = -half;
+    sp.ymin = -half;
+    sp.xmax = half;
+    sp.ymax = half;
+    if(sp.swathLines < 0)
+    {
+        /* the track runs past both edges of the domain */
+        sp.swathLines = (int) (2.4 * half / 1000.0);
+    }
+
+    lccProj = initProj(LCC_PROJ);
+    latlonProj = initProj(LATLON_PROJ);
+    albersProj = initProj(ALBERS_PROJ);
+
+    writeMosaic(&sp, 0);
+    writeMosaic(&sp, 1);
+    writeRoads(&sp);
+    writePoints(&sp);
+    writeGrids(&sp, &ncols, &nrows);
+    writeNLCD(&sp);
+    writeSwath(&sp);
+
+    if((fp = fopen(fileName(&sp, "synth.env"), "w")) == NULL)
+    {
+        fail("Unable to create", fileName(&sp, "synth.env"));
+    }
+    fprintf(fp, "setenv SYNTH_XMIN %.1f\nsetenv SYNTH_YMIN %.1f\n", sp.xmin,
+            sp.ymin);
+    fprintf(fp, "setenv SYNTH_CELL %.1f\nsetenv SYNTH_COLS %d\n"
+            "setenv SYNTH_ROWS %d\n", sp.gridCell, ncols, nrows);
+    fprintf(fp, "setenv SYNTH_SWATH_LINES %d\nsetenv SYNTH_SWATH_PIXELS %d\n",
+            sp.swathLines, sp.swathPixels);
+    fprintf(fp, "setenv SYNTH_COUNTIES %d\nsetenv SYNTH_TRACTS %d\n",
+            sp.counties * sp.counties,
+            sp.counties * sp.counties * sp.tractFactor * sp.tractFactor);
+    fprintf(fp, "setenv SYNTH_ROADS %d\nsetenv SYNTH_POINTS %d\n", sp.roads,
+            sp.points);
+    fclose(fp);
+
+    pj_free(lccProj);
+    pj_free(latlonProj);
+    pj_free(albersProj);
+    return 0;
+}
@@ -0,0 +1,600 @@
+/***************************************************************************
+ * This program is used:
+ *  1. to time the satellite regridding functions of the raster tools on
+ *     the synthetic swath written by gensynth.exe.
+ *  2. to write one CSV record per stage, in the same layout as
+ *     srgbench.exe: tool,case,stage,wall_s,cpu_s,maxrss_kb,count
+ *
+ * The stages are:
+ *     read_swath     reading the swath latitude, longitude and variable
+ *     rasterize      the domain grid cell ID of each fine raster pixel,
+ *                    as the tools get by rasterizing the grid shapefile
+ *     grid_index     computeDomainGridImageIndex: projecting the swath
+ *                    and finding the nearest swath pixel of each raster
+ *                    pixel with ANN
+ *     grid_values    computeGridSatValues: averaging the variable in
+ *                    each domain grid cell
+ *     omi_center     computeGridOMI.exe with PIXEL_WEIGHTING=CENTER on a
+ *                    regular lat-long image of OMI_PIXEL_SIZE degrees:
+ *                    rasterizing the grid at computeRasterResolution and
+ *                    averaging the image pixel under each raster pixel center
+ *     omi_coverage   computeGridOMI.exe with PIXEL_WEIGHTING=COVERAGE on the
+ *                    same image: computePixelCoverageWeights and the
+ *                    coverage weighted average
+ *     omi_diff       cells whose CENTER and COVERAGE values differ by more
+ *                    than 1%, or that have a value in one mode only.  The
+ *                    mean and maximum differences of the covered fraction
+ *                    of a cell and of the values go to stderr.
+ *
+ * The two OMI stages follow the loops of computeSatVariable in
+ * computeGridOMI.cpp, which reads its image from HDF files.
+ *
+ * Usage:  rasterbench.exe swath_dir [-case name] [-out results.csv]
+ *
+ * Environment Variables needed:
+ *         GRID_ROWS  -- grid domain rows
+ *         GRID_COLUMNS -- grid domain columns
+ *         GRID_XMIN -- grid domain xmin
+ *         GRID_YMIN -- grid domain ymin
+ *         GRID_XCELLSIZE -- grid domain x grid size
+ *         GRID_YCELLSIZE -- grid domain y grid size
+ *         GRID_PROJ -- grid domain proj4 projection definition
+ *         GRID_RASTER_PIXELS -- optional raster pixels along each side of
+ *                               a grid cell, default 4
+ *         OMI_PIXEL_SIZE -- optional OMI image pixel size in degrees,
+ *                           default 0.25
+ ***********************************************************************************/
+#include <iostream>
+#include <fstream>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "sa_raster.h"
+#include "commontools.h"
+#include "geotools.h"
+
+static FILE   *outFile = NULL;
+static string caseName = string ( "default" );
+static double stageWall, stageCPU;
+
+static double searchRadius = 5000.0;   //maximum distance to the nearest swath pixel
+static double omiPixelSize = 0.25;     //OMI L3 pixel size in degrees
+static double omiMissing = -999.0;
+
+static double   cpuClock ( long *maxrss );
+static double   wallClock ( );
+static void     startStage ( );
+static void     endStage ( const char *stage, long count );
+static float   *readSwathVar ( string swathDir, const char *name, int *rows, int *cols );
+static double  *makeOMIImage ( gridInfo grid, gridInfo *imageInfo );
+static long     omiCenterValues ( gridInfo grid, gridInfo imageInfo, double *poImage,
+                                  float *satV, double *covered );
+static long     omiCoverageValues ( gridInfo grid, gridInfo imageInfo, double *poImage,
+                                    float *satV, double *covered );
+
+
+/******************************************************
+************************* MAIN  ***********************
+*******************************************************/
+int main(int nArgc, char *papszArgv[])
+{
+    gridInfo     grid;            //modeling domain grid
+    gridInfo     newRasterInfo;   //rasterized domain grid
+    gridInfo     imageInfo;       //swath variable and its geolocation
+    string       swathDir, outName;
+    int          i, j, sub, rows, cols, lrows, lcols;
+
+    if ( nArgc < 2 )
+    {
+       printf( "Usage: rasterbench.exe swath_dir [-case name] [-out results.csv]\n" );
+       exit ( 1 );
+    }
+    swathDir = string ( papszArgv[1] );
+    processDirName ( swathDir );
+    for ( i=2; i<nArgc; i++ )
+    {
+       if ( strcmp ( papszArgv[i], "-case" ) == 0 && i+1 < nArgc )
+       {
+          caseName = string ( papszArgv[++i] );
+       }
+       else if ( strcmp ( papszArgv[i], "-out" ) == 0 && i+1 < nArgc )
+       {
+          outName = string ( papszArgv[++i] );
+       }
+       else
+       {
+          printf( "Usage: rasterbench.exe swath_dir [-case name] [-out results.csv]\n" );
+          exit ( 1 );
+       }
+    }
+
+    outFile = stdout;
+    if ( outName.size() > 0 && ( outFile = fopen ( outName.c_str(), "a" ) ) == NULL )
+    {
+       printf( "Error: unable to open %s\n", outName.c_str() );
+       exit ( 1 );
+    }
+    if ( outFile == stdout || ftell ( outFile ) == 0 )
+    {
+       fprintf ( outFile, "tool,case,stage,wall_s,cpu_s,maxrss_kb,count\n" );
+    }
+
+    /*******************************************
+    *   domain grid from the environment      *
+    *******************************************/
+    grid.rows = atoi ( getEnviVariable("GRID_ROWS") );
+    grid.cols = atoi ( getEnviVariable("GRID_COLUMNS") );
+    grid.xmin = atof ( getEnviVariable("GRID_XMIN") );
+    grid.ymin = atof ( getEnviVariable("GRID_YMIN") );
+    grid.xCellSize = atof ( getEnviVariable("GRID_XCELLSIZE") );
+    grid.yCellSize = atof ( getEnviVariable("GRID_YCELLSIZE") );
+    grid.strProj4 = getEnviVariable("GRID_PROJ");
+    grid.xmax = grid.xmin + grid.cols * grid.xCellSize;
+    grid.ymax = grid.ymin + grid.rows * grid.yCellSize;
+
+    if ( getenv("OMI_PIXEL_SIZE") != NULL )
+    {
+       omiPixelSize = atof ( getenv("OMI_PIXEL_SIZE") );
+       if ( omiPixelSize <= 0.0 )
+       {
+          printf( "Error: OMI_PIXEL_SIZE has to be a positive number of degrees\n" );
+          exit ( 1 );
+       }
+    }
+
+    sub = 4;
+    if ( getenv("GRID_RASTER_PIXELS") != NULL )
+    {
+       sub = atoi ( getenv("GRID_RASTER_PIXELS") );
+       if ( sub < 1 )
+       {
+          printf( "Error: GRID_RASTER_PIXELS has to be a positive integer\n" );
+          exit ( 1 );
+       }
+    }
+
+    /*******************************************
+    *   read the swath                        *
+    *******************************************/
+    startStage ( );
+    float *latF = readSwathVar ( swathDir, "swath_lat", &lrows, &lcols );
+    float *lonF = readSwathVar ( swathDir, "swath_lon", &rows, &cols );
+    float *valF = readSwathVar ( swathDir, "swath_val", &rows, &cols );
+    if ( rows != lrows || cols != lcols )
+    {
+       printf( "Error: swath latitude and longitude sizes differ\n" );
+       exit ( 1 );
+    }
+
+    double *latP = (double *) CPLCalloc(sizeof(double),rows*cols);
+    double *longP = (double *) CPLCalloc(sizeof(double),rows*cols);
+    double *poImage = (double *) CPLCalloc(sizeof(double),rows*cols);
+    for ( i=0; i<rows*cols; i++ )
+    {
+       latP[i] = latF[i];
+       longP[i] = lonF[i];
+       poImage[i] = valF[i];
+    }
+    CPLFree ( latF );
+    CPLFree ( lonF );
+    CPLFree ( valF );
+    endStage ( "read_swath", (long) rows * cols );
+
+    imageInfo.rows = rows;
+    imageInfo.cols = cols;
+    imageInfo.dims.push_back ( rows );
+    imageInfo.dims.push_back ( cols );
+    imageInfo.strProj4 = (char *) "+proj=latlong +a=6370000.0 +b=6370000.0";
+    imageInfo.attsStr.push_back ( string ( "synthetic swath" ) );   //title
+    imageInfo.attsStr.push_back ( string ( "" ) );                  //units
+    imageInfo.attsStr.push_back ( string ( "1.0" ) );               //scale factor
+    imageInfo.attsStr.push_back ( string ( "0.0" ) );               //offset
+    imageInfo.attsStr.push_back ( string ( "-999.0" ) );            //missing value
+    imageInfo.attsStr.push_back ( string ( "float" ) );             //data type
+
+    /*******************************************
+    *   rasterize the domain grid             *
+    *******************************************/
+    startStage ( );
+    newRasterInfo = grid;
+    newRasterInfo.cols = grid.cols * sub;
+    newRasterInfo.rows = grid.rows * sub;
+    newRasterInfo.xCellSize = grid.xCellSize / sub;
+    newRasterInfo.yCellSize = grid.yCellSize / sub;
+
+    int totalSize = newRasterInfo.rows * newRasterInfo.cols;
+    GUInt32 *poImage_grd = (GUInt32 *) CPLCalloc(sizeof(GUInt32),totalSize);
+    //rows from the top of the raster, grid IDs from the LL corner
+    for ( i=0; i<newRasterInfo.rows; i++ )
+    {
+       int gridRow = ( newRasterInfo.rows - 1 - i ) / sub;
+       for ( j=0; j<newRasterInfo.cols; j++ )
+       {
+          poImage_grd[i * newRasterInfo.cols + j] = gridRow * grid.cols + j / sub + 1;
+       }
+    }
+    endStage ( "rasterize", (long) totalSize );
+
+    /*******************************************
+    *   regrid                                *
+    *******************************************/
+    startStage ( );
+    int *grdIndex = (int *) CPLCalloc(sizeof(int),totalSize);
+    if ( ! computeDomainGridImageIndex ( grdIndex, longP, latP, imageInfo, newRasterInfo, searchRadius ) )
+    {
+       printf( "Error: the swath does not cover the domain grid\n" );
+       exit ( 1 );
+    }
+    long found = 0;
+    for ( i=0; i<totalSize; i++ )
+    {
+       if ( grdIndex[i] != -999 )
+       {
+          found++;
+       }
+    }
+    endStage ( "grid_index", found );
+
+    startStage ( );
+    float *satV = (float *) CPLCalloc(sizeof(float),grid.rows*grid.cols);
+    computeGridSatValues ( poImage_grd, grdIndex, satV, poImage, imageInfo, newRasterInfo, grid );
+    long filled = 0;
+    for ( i=0; i<grid.rows*grid.cols; i++ )
+    {
+       if ( satV[i] != MISSIING_VALUE )
+       {
+          filled++;
+       }
+    }
+    endStage ( "grid_values", filled );
+
+    /*******************************************
+    *   OMI-like image: CENTER and COVERAGE   *
+    *******************************************/
+    gridInfo  omiInfo;
+    double   *omiImage = makeOMIImage ( grid, &omiInfo );
+    float    *centerV = (float *) CPLCalloc(sizeof(float),grid.rows*grid.cols);
+    float    *coverV = (float *) CPLCalloc(sizeof(float),grid.rows*grid.cols);
+    double   *centerF = (double *) CPLCalloc(sizeof(double),grid.rows*grid.cols);
+    double   *coverF = (double *) CPLCalloc(sizeof(double),grid.rows*grid.cols);
+
+    startStage ( );
+    filled = omiCenterValues ( grid, omiInfo, omiImage, centerV, centerF );
+    endStage ( "omi_center", filled );
+
+    startStage ( );
+    filled = omiCoverageValues ( grid, omiInfo, omiImage, coverV, coverF );
+    endStage ( "omi_coverage", filled );
+
+    //cells whose value differs by more than 1% or is missing in one mode only
+    long    differ = 0, both = 0;
+    double  fracSum = 0.0, fracMax = 0.0, valueSum = 0.0, valueMax = 0.0;
+    for ( i=0; i<grid.rows*grid.cols; i++ )
+    {
+       double d = fabs ( centerF[i] - coverF[i] );
+       fracSum += d;
+       fracMax = MAX ( fracMax, d );
+       if ( ( centerV[i] == MISSIING_VALUE ) != ( coverV[i] == MISSIING_VALUE ) )
+       {
+          differ++;
+       }
+       else if ( centerV[i] != MISSIING_VALUE )
+       {
+          d = fabs ( centerV[i] - coverV[i] ) / MAX ( fabs ( coverV[i] ), 1.0e-30 );
+          valueSum += d;
+          valueMax = MAX ( valueMax, d );
+          both++;
+          if ( d > 0.01 )
+          {
+             differ++;
+          }
+       }
+    }
+    startStage ( );
+    endStage ( "omi_diff", differ );
+    fprintf ( stderr, "%s: CENTER - COVERAGE covered fraction of a cell: mean %.4f  max %.4f\n",
+              caseName.c_str(), fracSum / (grid.rows*grid.cols), fracMax );
+    fprintf ( stderr, "%s: CENTER - COVERAGE relative value difference: mean %.4f  max %.4f over %ld cells\n",
+              caseName.c_str(), both > 0 ? valueSum / both : 0.0, valueMax, both );
+
+    CPLFree ( coverF );
+    CPLFree ( centerF );
+    CPLFree ( coverV );
+    CPLFree ( centerV );
+    CPLFree ( omiImage );
+    CPLFree ( satV );
+    CPLFree ( grdIndex );
+    CPLFree ( poImage_grd );
+    CPLFree ( latP );
+    CPLFree ( longP );
+    CPLFree ( poImage );
+
+    if ( outFile != stdout )
+    {
+       fclose ( outFile );
+    }
+    return 0;
+}
+
+
+/***********************************************
+*  wall clock seconds                          *
+***********************************************/
+static double wallClock ( )
+{
+    struct timeval tv;
+
+    gettimeofday ( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+
+/***********************************************
+*  CPU seconds and peak resident size         *
+***********************************************/
+static double cpuClock ( long *maxrss )
+{
+    struct rusage ru;
+
+    getrusage ( RUSAGE_SELF, &ru );
+    if ( maxrss != NULL )
+    {
+       *maxrss = ru.ru_maxrss;
+    }
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1.0e-6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1.0e-6;
+}
+
+
+static void startStage ( )
+{
+    stageWall = wallClock ( );
+    stageCPU = cpuClock ( NULL );
+}
+
+
+static void endStage ( const char *stage, long count )
+{
+    double wall = wallClock ( ) - stageWall;
+    long   maxrss;
+    double cpu = cpuClock ( &maxrss ) - stageCPU;
+
+    fprintf ( outFile, "raster,%s,%s,%.4f,%.4f,%ld,%ld\n", caseName.c_str(), stage,
+              wall, cpu, maxrss, count );
+    fflush ( outFile );
+}
+
+
+/***********************************************
+*  read a float32 EHdr swath array            *
+***********************************************/
+static float *readSwathVar ( string swathDir, const char *name, int *rows, int *cols )
+{
+    string   hdrName = swathDir + string ( name ) + string ( ".hdr" );
+    string   bilName = swathDir + string ( name ) + string ( ".bil" );
+    string   key;
+    ifstream hdr;
+
+    *rows = *cols = 0;
+    hdr.open ( hdrName.c_str() );
+    if ( ! hdr.good() )
+    {
+       printf( "Error: unable to open %s\n", hdrName.c_str() );
+       exit ( 1 );
+    }
+    while ( hdr >> key )
+    {
+       if ( key.compare ( "NROWS" ) == 0 )
+       {
+          hdr >> *rows;
+       }
+       else if ( key.compare ( "NCOLS" ) == 0 )
+       {
+          hdr >> *cols;
+       }
+    }
+    hdr.close ( );
+
+    float *data = (float *) CPLCalloc(sizeof(float),(*rows) * (*cols));
+    FILE  *fp = fopen ( bilName.c_str(), "rb" );
+    if ( fp == NULL || fread ( data, sizeof(float), (*rows) * (*cols), fp ) != (size_t) ((*rows) * (*cols)) )
+    {
+       printf( "Error: unable to read %s\n", bilName.c_str() );
+       exit ( 1 );
+    }
+    fclose ( fp );
+    return data;
+}
+
+
+/***********************************************
+*  regular lat-long image over the domain,    *
+*  rows from the south edge like OMI L3 data  *
+***********************************************/
+static double *makeOMIImage ( gridInfo grid, gridInfo *imageInfo )
+{
+    const int  SIDE_POINTS = 16;
+    projPJ     proj4From, proj4To;
+    projUV     xyP;
+    double     bxmin = HUGE_VAL, bxmax = -HUGE_VAL, bymin = HUGE_VAL, bymax = -HUGE_VAL;
+    int        i, k, row, col;
+
+    imageInfo->strProj4 = (char *) "+proj=latlong +a=6370000.0 +b=6370000.0";
+    proj4From = pj_init_plus ( grid.strProj4 );
+    proj4To = pj_init_plus ( imageInfo->strProj4 );
+    if ( proj4From == NULL || proj4To == NULL )
+    {
+       printf( "Error: Initializing grid or image PROJ4 projection failed.\n" );
+       exit ( 1 );
+    }
+
+    //extent of the domain outline in degrees
+    double cx[4] = { grid.xmin, grid.xmax, grid.xmax, grid.xmin };
+    double cy[4] = { grid.ymin, grid.ymin, grid.ymax, grid.ymax };
+    for ( k=0; k<4; k++ )
+    {
+       for ( i=0; i<SIDE_POINTS; i++ )
+       {
+          double t = (double) i / SIDE_POINTS;
+          xyP = projectPoint ( proj4From, proj4To, cx[k] + t * (cx[(k+1)%4] - cx[k]),
+                               cy[k] + t * (cy[(k+1)%4] - cy[k]) );
+          bxmin = MIN ( bxmin, xyP.u );
+          bxmax = MAX ( bxmax, xyP.u );
+          bymin = MIN ( bymin, xyP.v );
+          bymax = MAX ( bymax, xyP.v );
+       }
+    }
+    pj_free ( proj4From );
+    pj_free ( proj4To );
+
+    imageInfo->xCellSize = omiPixelSize;
+    imageInfo->yCellSize = omiPixelSize;
+    imageInfo->xmin = ( floor ( bxmin / omiPixelSize ) - 1 ) * omiPixelSize;
+    imageInfo->ymin = ( floor ( bymin / omiPixelSize ) - 1 ) * omiPixelSize;
+    imageInfo->cols = (int) ceil ( (bxmax - imageInfo->xmin) / omiPixelSize ) + 1;
+    imageInfo->rows = (int) ceil ( (bymax - imageInfo->ymin) / omiPixelSize ) + 1;
+    imageInfo->xmax = imageInfo->xmin + imageInfo->cols * omiPixelSize;
+    imageInfo->ymax = imageInfo->ymin + imageInfo->rows * omiPixelSize;
+
+    //smooth field with a few missing pixels, as the swath
+    double *poImage = (double *) CPLCalloc(sizeof(double),imageInfo->rows*imageInfo->cols);
+    for ( row=0; row<imageInfo->rows; row++ )
+    {
+       double lat = imageInfo->ymin + (row + 0.5) * omiPixelSize;
+       for ( col=0; col<imageInfo->cols; col++ )
+       {
+          double lon = imageInfo->xmin + (col + 0.5) * omiPixelSize;
+          if ( (row * 7 + col * 13) % 29 == 0 )
+          {
+             poImage[row * imageInfo->cols + col] = omiMissing;
+          }
+          else
+          {
+             poImage[row * imageInfo->cols + col] = 1.0e15 * (1.0 + 0.5 * sin ( lon / 2.0 ) * cos ( lat / 3.0 ));
+          }
+       }
+    }
+    return poImage;
+}
+
+
+/***********************************************
+*  PIXEL_WEIGHTING=CENTER: the image pixel    *
+*  under each raster pixel center             *
+***********************************************/
+static long omiCenterValues ( gridInfo grid, gridInfo imageInfo, double *poImage,
+                              float *satV, double *covered )
+{
+    projPJ   proj4From, proj4To;
+    projUV   xyP;
+    int      i, j, row, col, sub;
+    long     filled = 0;
+
+    //the tools rasterize the domain grid at this resolution
+    double rasterResolution = computeRasterResolution ( imageInfo, grid );
+    sub = MAX ( 1, (int) floor ( grid.xCellSize / rasterResolution + 0.5 ) );
+    int    xCells_grd = grid.cols * sub;
+    int    yCells_grd = grid.rows * sub;
+    double xCellSize_grd = grid.xCellSize / sub;
+    double yCellSize_grd = grid.yCellSize / sub;
+    double halfGridCellArea = grid.xCellSize * grid.yCellSize / 2.0;
+
+    proj4From = pj_init_plus ( grid.strProj4 );
+    proj4To = pj_init_plus ( imageInfo.strProj4 );
+    if ( proj4From == NULL || proj4To == NULL )
+    {
+       printf( "Error: Initializing grid or image PROJ4 projection failed.\n" );
+       exit ( 1 );
+    }
+
+    int    *gridIDs = (int *) CPLCalloc(sizeof(int),grid.rows*grid.cols);
+    double *gridValues = (double *) CPLCalloc(sizeof(double),grid.rows*grid.cols);
+
+    //raster rows from the top, grid IDs from the LL corner
+    for ( i=0; i<yCells_grd; i++ )
+    {
+       int    gridRow = ( yCells_grd - 1 - i ) / sub;
+       double y = grid.ymax - i * yCellSize_grd - yCellSize_grd / 2.0;
+       for ( j=0; j<xCells_grd; j++ )
+       {
+          int    gridID = gridRow * grid.cols + j / sub;
+          double x = grid.xmin + j * xCellSize_grd + xCellSize_grd / 2.0;
+
+          xyP = projectPoint ( proj4From, proj4To, x, y );
+          col = (int) ( floor ( (xyP.u - imageInfo.xmin) / imageInfo.xCellSize ) );
+          row = (int) ( floor ( (xyP.v - imageInfo.ymin) / imageInfo.yCellSize ) );
+          if ( (col >= 0 && col < imageInfo.cols) && (row >= 0 && row < imageInfo.rows) )
+          {
+             double value = poImage[imageInfo.cols * row + col];
+             if ( value != omiMissing )
+             {
+                gridIDs[gridID] += 1;
+                gridValues[gridID] += value;
+             }
+          }
+       }
+    }
+
+    for ( i=0; i<grid.rows*grid.cols; i++ )
+    {
+       covered[i] = gridIDs[i] * xCellSize_grd * yCellSize_grd / ( halfGridCellArea * 2.0 );
+       if ( gridIDs[i] * xCellSize_grd * yCellSize_grd >= halfGridCellArea )
+       {
+          satV[i] = gridValues[i] / gridIDs[i];
+          filled++;
+       }
+       else
+       {
+          satV[i] = MISSIING_VALUE;
+       }
+    }
+
+    CPLFree ( gridIDs );
+    CPLFree ( gridValues );
+    pj_free ( proj4From );
+    pj_free ( proj4To );
+    return filled;
+}
+
+
+/***********************************************
+*  PIXEL_WEIGHTING=COVERAGE: image pixels     *
+*  weighted by the part of the cell they cover *
+***********************************************/
+static long omiCoverageValues ( gridInfo grid, gridInfo imageInfo, double *poImage,
+                                float *satV, double *covered )
+{
+    pixelCoverageWeights  pixelWeights;
+    int                   gridID, idIndex;
+    long                  filled = 0;
+
+    pixelWeights = computePixelCoverageWeights ( grid, imageInfo );
+    for ( gridID = 0; gridID < pixelWeights.cells; gridID++ )
+    {
+       double weightSum = 0.0;
+       double valueSum = 0.0;
+       for ( idIndex = pixelWeights.start[gridID]; idIndex < pixelWeights.start[gridID+1]; idIndex++ )
+       {
+          double value = poImage[pixelWeights.pixel[idIndex]];
+          if ( value != omiMissing )
+          {
+             weightSum += pixelWeights.weight[idIndex];
+             valueSum += pixelWeights.weight[idIndex] * value;
+          }
+       }
+
+       covered[gridID] = weightSum;
+       if ( weightSum >= 0.5 )
+       {
+          satV[gridID] = valueSum / weightSum;
+          filled++;
+       }
+       else
+       {
+          satV[gridID] = MISSIING_VALUE;
+       }
+    }
+
+    freePixelCoverageWeights ( &pixelWeights );
+    return filled;
+}
@@ -0,0 +1,346 @@
+/****************************************************************************
+ * srgbench.c
+ *
+ * Runs the srgcreate pipeline on the inputs named by the usual srgcreate
+ * environment variables and times each stage.  The stages are the calls
+ * made by srg_main.c, in the same order:
+ *
+ *   read_grid       PolyReader for the output grid or polygons
+ *   read_data       PolyReader for the data polygons, with projection
+ *   attach_data     attachAttribute and PolyMShapeInOne on the data
+ *   read_weight     PolyReader for the weight shapes, with projection
+ *   attach_weight   attachAttribute on the weight shapes
+ *   project         the weight vertices projected back to their file
+ *                   projection, i.e. the projection share of read_weight
+ *   intersect_wd    polyIsect of the weight and data shapes
+ *   intersect_grid  polyIsect of those pieces and the grid
+ *   sum             sum2Poly and sum1Poly for each weight attribute
+ *   report          reportSurrogate, which sums again and writes
+ *
+ * For each stage one CSV record is written with the wall and CPU
+ * seconds, the peak resident size of the process so far and a count of
+ * what the stage produced:
+ *
+ *   tool,case,stage,wall_s,cpu_s,maxrss_kb,count
+ *
+ * Usage:
+ *   srgbench.exe [-case name] [-out results.csv]
+ *
+ * The records are appended to the results file, which gets a header
+ * line when it is new; without -out they go to stdout.  Weight filters
+ * and the USE_DW_FILE shortcut of srgcreate are not supported.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "shapefil.h"
+#include "mims_spatl.h"
+#include "mims_evs.h"
+#include "parms3.h"
+#include "io.h"
+
+char *prog_name;
+int maxShapes = 0;
+int fileCompleted;
+
+static FILE *out = NULL;
+static char *caseName = "default";
+static double stageWall, stageCPU;
+
+
+/* ============================================================= */
+static double wallClock(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+
+/* ============================================================= */
+static double cpuClock(long *maxrss)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    if(maxrss != NULL)
+    {
+        *maxrss = ru.ru_maxrss;
+    }
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1.0e-6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1.0e-6;
+}
+
+
+/* ============================================================= */
+static void startStage(void)
+{
+    stageWall = wallClock();
+    stageCPU = cpuClock(NULL);
+}
+
+
+/* ============================================================= */
+static void endStage(char *stage, long count)
+{
+    double wall = wallClock() - stageWall;
+    long maxrss;
+    double cpu = cpuClock(&maxrss) - stageCPU;
+
+    fprintf(out, "srgcreate,%s,%s,%.4f,%.4f,%ld,%ld\n", caseName, stage,
+            wall, cpu, maxrss, count);
+    fflush(out);
+}
+
+
+/* ============================================================= */
+/* Project all of the vertices of poly from the map of to to the map of
+ * from, on a copy, and return the number of vertices */
+static long projectVertices(PolyObject *poly, MapProjInfo *from,
+                            MapProjInfo *to)
+{
+    PolyShapeList *plist;
+    PolyShape *ps;
+    double *x, *y;
+    long n = 0, k = 0;
+    int c, v;
+
+    for(plist = poly->plist; plist; plist = plist->next)
+    {
+        ps = plist->ps;
+        for(c = 0; c < ps->num_contours; c++)
+        {
+            n += ps->contour[c].num_vertices;
+        }
+    }
+    x = (double *) malloc(MAX(1, n) * sizeof(double));
+    y = (double *) malloc(MAX(1, n) * sizeof(double));
+    if(x == NULL || y == NULL)
+    {
+        ERROR(prog_name, "Allocation error in projectVertices", 2);
+    }
+    for(plist = poly->plist; plist; plist = plist->next)
+    {
+        ps = plist->ps;
+        for(c = 0; c < ps->num_contours; c++)
+        {
+            for(v = 0; v < ps->contour[c].num_vertices; v++, k++)
+            {
+                x[k] = ps->contour[c].vertex[v].x;
+                y[k] = ps->contour[c].vertex[v].y;
+            }
+        }
+    }
+    storeProjection(from, to);
+    projectPoints((int) n, x, y);
+    free(x);
+    free(y);
+    return n;
+}
+
+
+/* ============================================================= */
+/* Time the sums that reportSurrogate makes, without writing them */
+static long sumSurrogates(PolyObject *wdg_poly, int use_weight_val)
+{
+    PolyObject *w_poly, *wd_poly;
+    PolyIntStruct *polyIntInfo;
+    double **num, *denom;
+    int n1, n2, d1, i, attr_id;
+    long count = 0;
+
+    wd_poly = wdg_poly->parent_poly1;
+    w_poly = wd_poly->parent_poly1;
+    for(attr_id = 0; attr_id < w_poly->attr_hdr->num_attr; attr_id++)
+    {
+        if(sum2Poly(wdg_poly, &num, &n1, &n2, attr_id, &polyIntInfo,
+                    use_weight_val) != 0 ||
+           sum1Poly(wd_poly, &denom, &d1, attr_id, use_weight_val) != 0)
+        {
+            ERROR(prog_name, "Error computing the surrogate sums", 2);
+        }
+        for(i = 0; i < n1; i++)
+        {
+            count += polyIntInfo[i].numIntersections;
+            free(polyIntInfo[i].intIndices);
+            free(polyIntInfo[i].intValues);
+        }
+        free(polyIntInfo);
+        free(denom);
+    }
+    return count;
+}
+
+
+/* ============================================================= */
+int main(int argc, char *argv[])
+{
+    PolyObject *p_data, *p_weight, *p_grid = NULL;
+    PolyObject *p_wd, *p_wdg;
+    MapProjInfo *outMapProj, *dataMapProj, *weightMapProj;
+    Arena *geomArena;
+    char tempString[256], outfile[256], mesg[300];
+    char *outName = NULL;
+    int a, no_weight_attr = 0;
+    long count;
+    extern int debug_output;
+
+    prog_name = argv[0];
+    for(a = 1; a < argc; a++)
+    {
+        if(!strcmp(argv[a], "-case") && a + 1 < argc)
+        {
+            caseName = argv[++a];
+        }
+        else if(!strcmp(argv[a], "-out") && a + 1 < argc)
+        {
+            outName = argv[++a];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-case name] [-out results.csv]\n",
+                    prog_name);
+            return 2;
+        }
+    }
+    out = stdout;
+    if(outName != NULL)
+    {
+        if((out = fopen(outName, "a")) == NULL)
+        {
+            sprintf(mesg, "Unable to open %.200s", outName);
+            ERROR(prog_name, mesg, 2);
+        }
+    }
+    if(out == stdout || ftell(out) == 0)
+    {
+        fprintf(out, "tool,case,stage,wall_s,cpu_s,maxrss_kb,count\n");
+    }
+
+    debug_output = 0;
+    geomArena = newArena(0);
+    if(geomArena == NULL)
+    {
+        ERROR(prog_name, "Allocation error for the geometry arena", 2);
+    }
+    setCurrentArena(geomArena);
+
+    startStage();
+    getEnvtValue(ENVT_OUTPUT_FILE_TYPE, tempString);
+    if(!strcmp(tempString, "RegularGrid") || !strcmp(tempString, "EGrid"))
+    {
+        p_grid = PolyReader(ENVT_OUTPUT_GRID_NAME, ENVT_OUTPUT_FILE_TYPE,
+                            NULL, NULL, NULL);
+    }
+    else if(!strcmp(tempString, "Polygon"))
+    {
+        outMapProj = getFullMapProjection(ENVT_OUTPUT_ELLIPSOID,
+                                          ENVT_OUTPUT_MAP_PROJ);
+        p_grid = PolyReader(ENVT_OUTPUT_POLY_FILE, ENVT_OUTPUT_FILE_TYPE,
+                            outMapProj, NULL, NULL);
+        if(p_grid && !attachAttribute(p_grid, ENVT_OUTPUT_POLY_ATTR, NULL))
+        {
+            ERROR(prog_name, "Attaching output polygon attribute error", 2);
+        }
+    }
+    if(!p_grid)
+    {
+        ERROR(prog_name, "Error reading output grid/polygon data", 2);
+    }
+    endStage("read_grid", p_grid->nObjects);
+
+    if(getEnvtValue(ENVT_WEIGHT_ATTR_LIST, tempString) &&
+       !strcmp(tempString, "NONE"))
+    {
+        no_weight_attr = 1;
+    }
+
+    startStage();
+    dataMapProj = getFullMapProjection(ENVT_DATA_ELLIPSOID, ENVT_DATA_MAP_PROJ);
+    p_data = PolyReader(ENVT_DATA_FILE_NAME, ENVT_DATA_FILE_NAME_TYPE,
+                        dataMapProj, p_grid->bb, p_grid->map);
+    if(!p_data)
+    {
+        ERROR(prog_name, "Error reading poly-data file", 2);
+    }
+    endStage("read_data", p_data->nObjects);
+
+    startStage();
+    if(!attachAttribute(p_data, ENVT_DATA_ID_ATTR, NULL) ||
+       PolyMShapeInOne(p_data) != 0)
+    {
+        ERROR(prog_name, "Attaching base data polygon attribute error", 2);
+    }
+    endStage("attach_data", p_data->nObjects);
+
+    startStage();
+    weightMapProj = getFullMapProjection(ENVT_WEIGHT_FILE_ELLIPSOID,
+                                         ENVT_WEIGHT_FILE_MAP_PROJ);
+    p_weight = PolyReader(ENVT_WEIGHT_FILE_NAME, ENVT_WEIGHT_FILE_TYPE,
+                          weightMapProj, p_data->bb, p_grid->map);
+    if(!p_weight || p_weight->nObjects == 0)
+    {
+        ERROR(prog_name, "Error reading weight file, or no weight shapes", 2);
+    }
+    endStage("read_weight", p_weight->nObjects);
+
+    startStage();
+    if(!attachAttribute(p_weight, ENVT_WEIGHT_ATTR_LIST, ENVT_SURROGATE_ID))
+    {
+        ERROR(prog_name, "Attaching weight polygon attribute error", 2);
+    }
+    endStage("attach_weight", p_weight->nObjects);
+
+    startStage();
+    count = projectVertices(p_weight, p_grid->map, weightMapProj);
+    endStage("project", count);
+
+    p_wd = getNewPoly(0);
+    p_wdg = getNewPoly(0);
+    if(!p_wd || !p_wdg)
+    {
+        ERROR(prog_name, "Allocation error in getNewPoly", 2);
+    }
+
+    startStage();
+    if(polyIsect(p_weight, p_data, p_wd, FALSE) <= 0)
+    {
+        ERROR(prog_name, "Weight and data polygons do not intersect", 2);
+    }
+    endStage("intersect_wd", p_wd->nObjects);
+
+    startStage();
+    if(polyIsect(p_wd, p_grid, p_wdg, FALSE) <= 0)
+    {
+        ERROR(prog_name, "Weight+data polygons do not overlap the grid", 2);
+    }
+    endStage("intersect_grid", p_wdg->nObjects);
+
+    startStage();
+    count = sumSurrogates(p_wdg, !no_weight_attr);
+    endStage("sum", count);
+
+    startStage();
+    if(!getEnvtValue(ENVT_OUTPUT_FILE_NAME, outfile) ||
+       !strcmp(outfile, "NONE"))
+    {
+        strcpy(outfile, "");
+    }
+    if(!reportSurrogate(p_wdg, ENVT_SURROGATE_FILE, !no_weight_attr, outfile))
+    {
+        ERROR(prog_name, "Error generating surrogates", 2);
+    }
+    endStage("report", p_wdg->nObjects);
+
+    if(out != stdout)
+    {
+        fclose(out);
+    }
+    return 0;
+}
@@ -93,6 +93,14 @@ public class SurrogateTool {
 	boolean run_create = false, run_merge = false, run_gapfill = false; // indicator to create, merge, and gapfill
 																		// surrogates
     boolean hasSrgMerge = true;
+
+	public static final int NUM_OPTIONAL_CONTROLS = 4; // optional variables at the end of the control variable lists
+
+	public static final long SRGCREATE_MEMORY_FACTOR = 8; // estimated srgcreate peak memory per byte of input shapefiles
+
+	int srgcreateJobs = 1; // number of srgcreate runs allowed at the same time
+
+	long srgcreateMemBudget = 0; // memory budget in MB for concurrent srgcreate runs, 0 = no limit
 	
 	// method launch log file and to set system related variables
 	public void getSystemInfo() {
@@ -312,22 +320,20 @@ public class SurrogateTool {
 				"SURROGATE CODE FILE", "SRGCREATE EXECUTABLE", "DEBUG_OUTPUT", "OUTPUT_FORMAT", "OUTPUT_FILE_TYPE",
 				"OUTPUT_GRID_NAME", "GRIDDESC", "OUTPUT_FILE_ELLIPSOID", "OUTPUT DIRECTORY", "OUTPUT SURROGATE FILE",
 				"OUTPUT SRGDESC FILE", "OVERWRITE OUTPUT FILES", "LOG FILE NAME", "COMPUTE SURROGATES FROM SHAPEFILES",
-				"MERGE SURROGATES", "GAPFILL SURROGATES", "SHAPEFILE DIRECTORY", "DENOMINATOR_THRESHOLD" }; // last two
-																											// are
-																											// optional
+				"MERGE SURROGATES", "GAPFILL SURROGATES", "SHAPEFILE DIRECTORY", "DENOMINATOR_THRESHOLD",
+				"SRGCREATE PARALLEL JOBS", "SRGCREATE MEMORY BUDGET" }; // last four are optional
 		String[] polyVars = { "GENERATION CONTROL FILE", "SURROGATE SPECIFICATION FILE", "SHAPEFILE CATALOG",
 				"SURROGATE CODE FILE", "SRGCREATE EXECUTABLE", "DEBUG_OUTPUT", "OUTPUT_FORMAT", "OUTPUT_FILE_TYPE",
 				"OUTPUT_POLY_FILE", "OUTPUT_POLY_ATTR", "OUTPUT DIRECTORY", "OUTPUT SURROGATE FILE",
 				"OUTPUT SRGDESC FILE", "OVERWRITE OUTPUT FILES", "LOG FILE NAME", "COMPUTE SURROGATES FROM SHAPEFILES",
-				"MERGE SURROGATES", "GAPFILL SURROGATES", "SHAPEFILE DIRECTORY", "DENOMINATOR_THRESHOLD" }; // last two
-																											// are
-																											// optional
+				"MERGE SURROGATES", "GAPFILL SURROGATES", "SHAPEFILE DIRECTORY", "DENOMINATOR_THRESHOLD",
+				"SRGCREATE PARALLEL JOBS", "SRGCREATE MEMORY BUDGET" }; // last four are optional
 		String[] egridVars = { "GENERATION CONTROL FILE", "SURROGATE SPECIFICATION FILE", "SHAPEFILE CATALOG",
 				"SURROGATE CODE FILE", "SRGCREATE EXECUTABLE", "DEBUG_OUTPUT", "OUTPUT_FORMAT", "OUTPUT_FILE_TYPE",
 				"OUTPUT_GRID_NAME", "GRIDDESC", "OUTPUT_FILE_ELLIPSOID", "OUTPUT_POLY_FILE", "OUTPUT DIRECTORY",
 				"OUTPUT SURROGATE FILE", "OUTPUT SRGDESC FILE", "OVERWRITE OUTPUT FILES", "LOG FILE NAME",
 				"COMPUTE SURROGATES FROM SHAPEFILES", "MERGE SURROGATES", "GAPFILL SURROGATES", "SHAPEFILE DIRECTORY",
-				"DENOMINATOR_THRESHOLD" }; // last two are optional
+				"DENOMINATOR_THRESHOLD", "SRGCREATE PARALLEL JOBS", "SRGCREATE MEMORY BUDGET" }; // last four are optional
 
 		int keyItems = 1; // 1 = first item is the key item
 		ArrayList list = new ArrayList();
@@ -401,14 +407,14 @@ public class SurrogateTool {
 		// check all needed variables exist
 		String outputFType = getControls("OUTPUT_FILE_TYPE");
 		if (outputFType.equals("RegularGrid")) {
-			for (j = 0; j < gridVars.length - 2; j++) {
+			for (j = 0; j < gridVars.length - NUM_OPTIONAL_CONTROLS; j++) {
 				if (!controls.containsKey(gridVars[j])) {
 					writeLogFile("Error: " + gridVars[j] + " does not exist in " + CONTROL_VARIABLE_FILE + "." + LS,
 							runStop);
 				}
 			}
 		} else if (outputFType.equals("Polygon")) {
-			for (j = 0; j < polyVars.length - 2; j++) {
+			for (j = 0; j < polyVars.length - NUM_OPTIONAL_CONTROLS; j++) {
 				if (!controls.containsKey(polyVars[j])) {
 					writeLogFile("Error: " + polyVars[j] + " does not exist in " + CONTROL_VARIABLE_FILE + "." + LS,
 							runStop);
@@ -419,7 +425,7 @@ public class SurrogateTool {
 					  runStop);
             */
 		} else if (outputFType.equals("EGrid")) {
-			for (j = 0; j < egridVars.length - 2; j++) {
+			for (j = 0; j < egridVars.length - NUM_OPTIONAL_CONTROLS; j++) {
 				if (!controls.containsKey(egridVars[j])) {
 					writeLogFile("Error: " + egridVars[j] + " does not exist in " + CONTROL_VARIABLE_FILE + "." + LS,
 							runStop);
@@ -523,6 +529,28 @@ public class SurrogateTool {
 		if (OW.equals("YES")) {
 			run_gapfill = true;
 		}
+
+		// optional concurrent srgcreate runs, limited by the memory budget
+		if (controls.containsKey("SRGCREATE PARALLEL JOBS")) {
+			try {
+				srgcreateJobs = Integer.parseInt(getControls("SRGCREATE PARALLEL JOBS").trim());
+			} catch (NumberFormatException e) {
+				srgcreateJobs = 0;
+			}
+			if (srgcreateJobs < 1) {
+				writeLogFile("Error: SRGCREATE PARALLEL JOBS has to be a positive integer" + LS, runStop);
+			}
+		}
+		if (controls.containsKey("SRGCREATE MEMORY BUDGET")) {
+			try {
+				srgcreateMemBudget = Long.parseLong(getControls("SRGCREATE MEMORY BUDGET").trim());
+			} catch (NumberFormatException e) {
+				srgcreateMemBudget = -1;
+			}
+			if (srgcreateMemBudget < 0) {
+				writeLogFile("Error: SRGCREATE MEMORY BUDGET has to be a non-negative integer in MB" + LS, runStop);
+			}
+		}
 	}
 
 	// method to get control value for an item in control table
@@ -1543,7 +1571,9 @@ public class SurrogateTool {
 		String header;
 		String outDir;
 		String srgFile;
+		String dataFile, weightFile;
 		String[] shape = new String[3];
+		ArrayList jobs = new ArrayList(); // srgcreate runs waiting for the scheduler
 
 		// put variable in a list or vector first
 		if (!checkDir(outDir = getControls("OUTPUT DIRECTORY"), runError)) {
@@ -1601,8 +1631,8 @@ public class SurrogateTool {
 					continue;
 				}
 				;
-				allVar.add("DATA_FILE_NAME=" + shape[DIRECTORY_INDEX] + FS + dshape); // put datafile with dir into
-																						// array
+				dataFile = shape[DIRECTORY_INDEX] + FS + dshape;
+				allVar.add("DATA_FILE_NAME=" + dataFile); // put datafile with dir into array
 				allVar.add("DATA_FILE_ELLIPSOID=" + shape[ELLIPSOID_INDEX]); // put ellipsoid of data file in array
 				allVar.add("DATA_FILE_MAP_PRJN=" + "+" + shape[PROJECTION_INDEX]); // put projection of data file in
 																					// array
@@ -1634,7 +1664,8 @@ public class SurrogateTool {
 					continue;
 				}
 				;
-				allVar.add("WEIGHT_FILE_NAME=" + shape[DIRECTORY_INDEX] + FS + wshape);
+				weightFile = shape[DIRECTORY_INDEX] + FS + wshape;
+				allVar.add("WEIGHT_FILE_NAME=" + weightFile);
 				allVar.add("WEIGHT_FILE_ELLIPSOID=" + shape[ELLIPSOID_INDEX]); // put ellipsoid of data file in array
 				allVar.add("WEIGHT_FILE_MAP_PRJN=" + "+" + shape[PROJECTION_INDEX]); // put projection of data file
 																						// in array
@@ -1690,27 +1721,67 @@ public class SurrogateTool {
 
 				COMMAND[2] = getControls("SRGCREATE EXECUTABLE");
 				RunScripts rs = new RunScripts("SRGCREATE", COMMAND, env);
+				if (srgcreateJobs > 1) {
+					// srgcreate runs are independent of each other, so queue it for the scheduler
+					long mem = estimateSrgCreateMemory(dataFile, weightFile);
+					jobs.add(new SrgCreateJob(key, (String) list.get(SURROGATE_INDEX), srgFile, logList, rs, mem));
+					continue;
+				}
 				String runMessage = rs.run();
 				rs = null; // free all memory used by rs
-				if (checkRunMessage(runMessage)) {
-					putSrgRunLog(key, logList, "SRGCREATE Failed");
-					System.out.println(key + "   SRGCREATE Failed");
-				} else {
-					putSrgRunLog(key, logList, "SRGCREATE Success");
-					System.out.println(LS + key + "   SRGCREATE Success" + LS);
+				finishSrgCreate(key, (String) list.get(SURROGATE_INDEX), srgFile, logList, runMessage);
+			}
+		}
 
-					if (!addSrgHeaders(key, srgFile, CREATE_STATUS_INDEX)) {
-						putSrgRunLog(key, logList, "SRGCREATE Headers Failed");
-						System.out.println(LS + key + "   SRGCREATE Headers Failed" + LS);
-					} else {
-						addSrgDesc(key, (String) list.get(SURROGATE_INDEX), srgFile);
-						writeSrgDesc();
-					}
-				}
+		if (jobs.isEmpty()) {
+			return;
+		}
+
+		writeLogFile(LS + "Running " + jobs.size() + " srgcreate jobs with up to " + srgcreateJobs
+				+ " at a time, memory budget " + (srgcreateMemBudget > 0 ? srgcreateMemBudget + " MB" : "unlimited")
+				+ LS, runContinue);
+		SrgCreateScheduler scheduler = new SrgCreateScheduler(srgcreateJobs, srgcreateMemBudget);
+		scheduler.runAll(jobs);
+
+		// report the runs in the generation file order so the run log matches a serial run
+		for (int j = 0; j < jobs.size(); j++) {
+			SrgCreateJob job = (SrgCreateJob) jobs.get(j);
+			finishSrgCreate(job.key, job.srgName, job.srgFile, job.logList, job.runMessage);
+		}
+	}
+
+	// check the srgcreate run message, then add headers and the description for a created surrogate
+	private void finishSrgCreate(String key, String srgName, String srgFile, ArrayList logList, String runMessage) {
+		if (checkRunMessage(runMessage)) {
+			putSrgRunLog(key, logList, "SRGCREATE Failed");
+			System.out.println(key + "   SRGCREATE Failed");
+		} else {
+			putSrgRunLog(key, logList, "SRGCREATE Success");
+			System.out.println(LS + key + "   SRGCREATE Success" + LS);
+
+			if (!addSrgHeaders(key, srgFile, CREATE_STATUS_INDEX)) {
+				putSrgRunLog(key, logList, "SRGCREATE Headers Failed");
+				System.out.println(LS + key + "   SRGCREATE Headers Failed" + LS);
+			} else {
+				addSrgDesc(key, srgName, srgFile);
+				writeSrgDesc();
 			}
 		}
 	}
 
+	// estimate srgcreate peak memory in MB from the size of its data and weight shapefiles
+	private long estimateSrgCreateMemory(String dataFile, String weightFile) {
+		String[] ext = { ".shp", ".dbf" };
+		long bytes = 0;
+
+		for (int i = 0; i < ext.length; i++) {
+			bytes += new File(dataFile + ext[i]).length();
+			bytes += new File(weightFile + ext[i]).length();
+		}
+		long mem = bytes * SRGCREATE_MEMORY_FACTOR / (1024 * 1024);
+		return (mem < 1) ? 1 : mem;
+	}
+
 	/**
 	 * Loop through the surrogates to use srgmerge.exe or Java merging tool for merging Set environmental variables for
 	 * the run and create temp file txt for merge Run srgmerge.exe or merge tool.
@@ -2307,6 +2378,93 @@ class StreamGobbler extends Thread {
 	}
 }
 
+/*----------------class to hold one srgcreate run for the scheduler----------------------*/
+class SrgCreateJob {
+	String key, srgName, srgFile;
+
+	ArrayList logList; // run log list for the surrogate
+
+	RunScripts rs;
+
+	long memMB; // estimated peak memory of the run
+
+	String runMessage; // message from the run, set by the scheduler
+
+	SrgCreateJob(String key, String srgName, String srgFile, ArrayList logList, RunScripts rs, long memMB) {
+		this.key = key;
+		this.srgName = srgName;
+		this.srgFile = srgFile;
+		this.logList = logList;
+		this.rs = rs;
+		this.memMB = memMB;
+	}
+}
+
+/*----------------class to run srgcreate jobs at the same time within a memory budget----------------------*/
+class SrgCreateScheduler {
+	protected int maxJobs;
+
+	protected long memBudget; // MB, 0 = no limit
+
+	protected int running = 0;
+
+	protected long memInUse = 0;
+
+	SrgCreateScheduler(int maxJobs, long memBudget) {
+		this.maxJobs = maxJobs;
+		this.memBudget = memBudget;
+	}
+
+	// start the jobs in list order as slots and memory free up, and wait for all of them
+	public void runAll(ArrayList jobs) {
+		Thread[] threads = new Thread[jobs.size()];
+
+		for (int i = 0; i < jobs.size(); i++) {
+			final SrgCreateJob job = (SrgCreateJob) jobs.get(i);
+			acquire(job.memMB);
+			System.out.println("Starting srgcreate for " + job.key + " (estimated " + job.memMB + " MB)");
+			threads[i] = new Thread() {
+				public void run() {
+					try {
+						job.runMessage = job.rs.run();
+					} finally {
+						job.rs = null; // free all memory used by rs
+						release(job.memMB);
+					}
+				}
+			};
+			threads[i].start();
+		}
+
+		for (int i = 0; i < threads.length; i++) {
+			try {
+				threads[i].join();
+			} catch (InterruptedException e) {
+				i--; // keep waiting for the run
+			}
+		}
+	}
+
+	// wait for a free slot; a job larger than the whole budget runs on its own
+	protected synchronized void acquire(long mem) {
+		while (running > 0 && (running >= maxJobs || (memBudget > 0 && memInUse + mem > memBudget))) {
+			try {
+				wait();
+			} catch (InterruptedException e) {
+				// check the slots again
+			}
+		}
+		running++;
+		memInUse += mem;
+	}
+
+	protected synchronized void release(long mem) {
+		running--;
+		memInUse -= mem;
+		notifyAll();
+	}
+}
+
 /*----------------class to run a script file----------------------*/
 class RunScripts {
 	protected String[] cmd, env;
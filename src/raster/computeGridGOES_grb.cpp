@@ -452,7 +452,7 @@ int main(int nArgc, char *argv[])
 	******************************/
         int ncid;
         
-	anyErrors( nc_create(outNetcdfFile.c_str(), NC_CLOBBER, &ncid) );   //open output file
+	anyErrors( nc_create(outNetcdfFile.c_str(), netCDFCreateMode ( NC_CLOBBER ), &ncid) );   //open output file
  
         /********************
         * Dimension lengths *
@@ -643,7 +643,8 @@ int main(int nArgc, char *argv[])
            dimIndex[0] = time_dim;   
            dimIndex[1] = south_north_dim;
            dimIndex[2] = west_east_dim;
-           anyErrors( nc_def_var(ncid, inGOESVars[i].c_str(), NC_FLOAT, 3, dimIndex, &goesV_id) );           
+           anyErrors( nc_def_var(ncid, inGOESVars[i].c_str(), NC_FLOAT, 3, dimIndex, &goesV_id) );
+           setNetCDFVarStorage ( ncid, goesV_id );
            anyErrors( nc_put_att_int(ncid, goesV_id, "FieldType", NC_INT, 1, fieldtype) ); 
            anyErrors( nc_put_att_text(ncid, goesV_id, "MemoryOrder", 3, "XY ") );
            anyErrors( nc_put_att_text(ncid, goesV_id, "description", strlen(inGOESVarDesc[i].c_str()), inGOESVarDesc[i].c_str()) );
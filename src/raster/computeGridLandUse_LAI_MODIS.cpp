@@ -1152,7 +1152,7 @@ int main( int nArgc,  char* papszArgv[] )
    * Write WRF landuse data file in netCDF format *
    ***********************************************/
    int ncid;
-   anyErrors( nc_create(outNetcdfFile.c_str(), NC_CLOBBER, &ncid) );
+   anyErrors( nc_create(outNetcdfFile.c_str(), netCDFCreateMode ( NC_CLOBBER ), &ncid) );
 
    /********************
    * Dimension lengths *
@@ -1256,11 +1256,13 @@ int main( int nArgc,  char* papszArgv[] )
    if ( inUSGSImpe.compare("YES") == 0 )
    {
       anyErrors( nc_def_var(ncid, "IMPERV", NC_FLOAT, 2, dimIndex, &imperv_id) );
+      setNetCDFVarStorage ( ncid, imperv_id );
    }
 
    if ( inUSGSCano.compare("YES") == 0 )
    {
       anyErrors( nc_def_var(ncid, "CANOPY", NC_FLOAT, 2, dimIndex, &canopy_id) );
+      setNetCDFVarStorage ( ncid, canopy_id );
    }
 
    if (land_cat_len > 0 ) 
@@ -1277,16 +1279,20 @@ int main( int nArgc,  char* papszArgv[] )
       dimIndex[2] = south_north_dim;
       dimIndex[3] = west_east_dim;
       anyErrors( nc_def_var(ncid, "LANDUSEF", NC_FLOAT, 4, dimIndex, &luf_id) );
+      setNetCDFVarStorage ( ncid, luf_id );
    */
       dimIndex[0] = land_cat_dim;
       dimIndex[1] = south_north_dim;
       dimIndex[2] = west_east_dim;
       anyErrors( nc_def_var(ncid, "LANDUSEF", NC_FLOAT, 3, dimIndex, &luf_id) );
+      setNetCDFVarStorage ( ncid, luf_id );
 
       dimIndex[0] = south_north_dim;
       dimIndex[1] = west_east_dim;
       anyErrors( nc_def_var(ncid, "LANDMASK", NC_FLOAT, 2, dimIndex, &lum_id) );
+      setNetCDFVarStorage ( ncid, lum_id );
       anyErrors( nc_def_var(ncid, "LU_INDEX", NC_FLOAT, 2, dimIndex, &lud_id) );
+      setNetCDFVarStorage ( ncid, lud_id );
    }
 
    /********************
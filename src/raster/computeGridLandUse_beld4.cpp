@@ -153,12 +153,138 @@ int                           PASTURE_CLASSES = 6;
 int                           CROP_CLASSES = 36;       //for 2006 US NASS has 36 and CAN has 36
                                                        //for 2001 US NASS has 32 and CAN has 42
 
-std::map<string, int >        gridCntyCrop;             //grid, county, NLCD crop 81 or 82 area
+//grid, county, crop cell counts for NLCD 81/82 and MODIS 12/14 crops: an open addressing hash table
+//keyed by gridID (upper 32 bits), county FIPS (24 bits) and crop class (8 bits) packed into 64 bits
+typedef struct _cropCountTable {
+   long long   *keys;       //0 marks an empty slot; gridID starts from 1
+   int         *counts;
+   size_t       size;       //power of 2
+   size_t       used;
+} cropCountTable;
+
+cropCountTable                gridCntyCrop = { NULL, NULL, 0, 0 };  //grid, county, NLCD crop 81 or 82 area
 
 std::map<int, vector<int> >   grid81CNTYs, grid82CNTYs; //grid crop contains intersected counties
 std::map<int, vector<int> >   grid12CNTYs, grid14CNTYs; //grid crop contains intersected CAN counties
 
 
+/************************************************************************/
+/*    packGridCntyCrop ()                                               */
+/************************************************************************/
+static long long packGridCntyCrop( int gridID, int cntyFIPS, int classID )
+{
+   if ( cntyFIPS >= (1 << 24) || classID >= (1 << 8) )
+   {
+      printf( "\tError: county code %d or crop class %d is too large for the grid county crop table.\n", cntyFIPS, classID );
+      exit ( 1 );
+   }
+
+   return ( (long long) gridID << 32 ) | ( (long long) cntyFIPS << 8 ) | classID;
+}
+
+
+/************************************************************************/
+/*    findGridCntyCropSlot ()                                           */
+/************************************************************************/
+static size_t findGridCntyCropSlot( cropCountTable *table, long long key )
+{
+   //multiplicative hash on the packed key, then linear probing
+   size_t  mask = table->size - 1;
+   size_t  i = (size_t) ( ( (unsigned long long) key * 0x9E3779B97F4A7C15ULL ) >> 32 ) & mask;
+
+   while ( table->keys[i] != 0 && table->keys[i] != key )
+   {
+      i = ( i + 1 ) & mask;
+   }
+
+   return i;
+}
+
+
+/************************************************************************/
+/*    growGridCntyCrop ()                                               */
+/************************************************************************/
+static void growGridCntyCrop( cropCountTable *table )
+{
+   long long    *oldKeys = table->keys;
+   int          *oldCounts = table->counts;
+   size_t        oldSize = table->size;
+
+   table->size = oldSize ? oldSize * 2 : 4096;
+   table->keys = (long long *) CPLCalloc ( table->size, sizeof(long long) );
+   table->counts = (int *) CPLCalloc ( table->size, sizeof(int) );
+
+   for ( size_t i = 0; i < oldSize; i++ )
+   {
+      if ( oldKeys[i] != 0 )
+      {
+         size_t j = findGridCntyCropSlot ( table, oldKeys[i] );
+         table->keys[j] = oldKeys[i];
+         table->counts[j] = oldCounts[i];
+      }
+   }
+
+   CPLFree ( oldKeys );
+   CPLFree ( oldCounts );
+}
+
+
+/************************************************************************/
+/*    addGridCntyCrop ()                                                */
+/*    add one cell and return the count, 1 for a new element            */
+/************************************************************************/
+static int addGridCntyCrop( int gridID, int cntyFIPS, int classID )
+{
+   long long  key = packGridCntyCrop ( gridID, cntyFIPS, classID );
+
+   //keep the load factor under 1/2
+   if ( 2 * ( gridCntyCrop.used + 1 ) > gridCntyCrop.size )
+   {
+      growGridCntyCrop ( &gridCntyCrop );
+   }
+
+   size_t i = findGridCntyCropSlot ( &gridCntyCrop, key );
+   if ( gridCntyCrop.keys[i] == 0 )
+   {
+      gridCntyCrop.keys[i] = key;
+      gridCntyCrop.used++;
+   }
+
+   return ++gridCntyCrop.counts[i];
+}
+
+
+/************************************************************************/
+/*    getGridCntyCrop ()                                                */
+/*    return the cell count, 0 if the element does not exist            */
+/************************************************************************/
+static int getGridCntyCrop( int gridID, int cntyFIPS, int classID )
+{
+   if ( gridCntyCrop.used == 0 )
+   {
+      return 0;
+   }
+
+   size_t i = findGridCntyCropSlot ( &gridCntyCrop, packGridCntyCrop ( gridID, cntyFIPS, classID ) );
+
+   return gridCntyCrop.counts[i];
+}
+
+
+/************************************************************************/
+/*    clearGridCntyCrop ()                                              */
+/************************************************************************/
+static void clearGridCntyCrop( )
+{
+   CPLFree ( gridCntyCrop.keys );
+   CPLFree ( gridCntyCrop.counts );
+   gridCntyCrop.keys = NULL;
+   gridCntyCrop.counts = NULL;
+   gridCntyCrop.size = 0;
+   gridCntyCrop.used = 0;
+}
+
+
 /************************************************************************/
 /*    fillLandClassHashTables ()                                        */
 /************************************************************************/
@@ -1234,14 +1360,12 @@ int main( int nArgc,  char* papszArgv[] )
             {
                //printf ( "\tgridID:%d   county# %d FIPS: %d  Crop: %d\n", gridID, m, vecFIPS[m], j);
 
-               sprintf( temp_char,"%d.%d.%d\0",gridID, vecFIPS[m], j+1 );   //12 or 14 crops
-               tmp_str = string ( temp_char );
+               int cropArea = getGridCntyCrop ( gridID, vecFIPS[m], j+1 );   //12 or 14 crops
  
-               if ( gridCntyCrop.find ( tmp_str ) != gridCntyCrop.end() )
+               if ( cropArea > 0 )
                {
                   //get crop area with a grid and county
-                  int cropArea = gridCntyCrop[tmp_str];
-                  qaArea1 += gridCntyCrop[tmp_str];
+                  qaArea1 += cropArea;
 
                   //printf ( "\tCounty grid crop area:%d\n", cropArea );
 
@@ -1372,14 +1496,12 @@ int main( int nArgc,  char* papszArgv[] )
             {
                //printf ( "\tgridID:%d   county# %d FIPS: %d  Crop: %d\n", gridID, m, vecFIPS[m], j+65);
 
-               sprintf( temp_char,"%d.%d.%d\0",gridID, vecFIPS[m], j+65 );   // j+65 = 81 or 82 crops
-               tmp_str = string ( temp_char );
+               int cropArea = getGridCntyCrop ( gridID, vecFIPS[m], j+65 );   // j+65 = 81 or 82 crops
 
-               if ( gridCntyCrop.find ( tmp_str )  != gridCntyCrop.end() )
+               if ( cropArea > 0 )
                {
                   //get crop area with a grid and county
-                  int cropArea = gridCntyCrop[tmp_str];
-                  qaArea1 += gridCntyCrop[tmp_str];
+                  qaArea1 += cropArea;
 
                   //printf ( "\tCounty grid crop area:%d\n", cropArea );
 
@@ -1480,7 +1602,7 @@ int main( int nArgc,  char* papszArgv[] )
       
       grid81CNTYs.clear();
       grid82CNTYs.clear();
-      gridCntyCrop.clear();
+      clearGridCntyCrop();
    }
 
    if ( inNASALand.compare("YES") == 0 )
@@ -1488,7 +1610,7 @@ int main( int nArgc,  char* papszArgv[] )
         CPLFree (gridMODIS);
         grid12CNTYs.clear();
         grid14CNTYs.clear();
-        gridCntyCrop.clear();
+        clearGridCntyCrop();
    }
 
    CPLFree (gridIDS);
@@ -1543,7 +1665,7 @@ int main( int nArgc,  char* papszArgv[] )
    * Write WRF landuse data file in netCDF format *
    ***********************************************/
    int ncid;
-   anyErrors( nc_create(outNetcdfFile.c_str(), NC_CLOBBER, &ncid) );
+   anyErrors( nc_create(outNetcdfFile.c_str(), netCDFCreateMode ( NC_CLOBBER ), &ncid) );
 
 
    /********************
@@ -1663,7 +1785,9 @@ int main( int nArgc,  char* papszArgv[] )
    if ( inUSGSLand.compare("YES") == 0 )
    {
       anyErrors( nc_def_var(ncid, "IMPERV", NC_FLOAT, 3, dimIndex, &imperv_id) );
+      setNetCDFVarStorage ( ncid, imperv_id );
       anyErrors( nc_def_var(ncid, "CANOPY", NC_FLOAT, 3, dimIndex, &canopy_id) );
+      setNetCDFVarStorage ( ncid, canopy_id );
 
       dimIndex[0] = time_dim;
       dimIndex[1] = tree_cat_dim;
@@ -1675,6 +1799,7 @@ int main( int nArgc,  char* papszArgv[] )
       dimIndex[2] = south_north_dim;
       dimIndex[3] = west_east_dim;
       anyErrors( nc_def_var(ncid, "TREEF", NC_FLOAT, 4, dimIndex, &tree_id) );
+      setNetCDFVarStorage ( ncid, tree_id );
    }
 
    dimIndex[0] = time_dim;
@@ -1691,6 +1816,7 @@ int main( int nArgc,  char* papszArgv[] )
    dimIndex[2] = south_north_dim;
    dimIndex[3] = west_east_dim;
    anyErrors( nc_def_var(ncid, "LANDUSEF", NC_FLOAT, 4, dimIndex, &luf_id) );
+   setNetCDFVarStorage ( ncid, luf_id );
 
    dimIndex[0] = time_dim;
    dimIndex[1] = crop_cat_dim;
@@ -1701,13 +1827,16 @@ int main( int nArgc,  char* papszArgv[] )
    dimIndex[1] = crop_cat_dim;
    dimIndex[2] = south_north_dim;
    dimIndex[3] = west_east_dim;
-   anyErrors( nc_def_var(ncid, "CROPF", NC_FLOAT, 4, dimIndex, &crop_id) ); 
+   anyErrors( nc_def_var(ncid, "CROPF", NC_FLOAT, 4, dimIndex, &crop_id) );
+   setNetCDFVarStorage ( ncid, crop_id );
 
    dimIndex[0] = time_dim;
    dimIndex[1] = south_north_dim;
    dimIndex[2] = west_east_dim;
    anyErrors( nc_def_var(ncid, "LANDMASK", NC_FLOAT, 3, dimIndex, &lum_id) );
+   setNetCDFVarStorage ( ncid, lum_id );
    anyErrors( nc_def_var(ncid, "LU_INDEX", NC_FLOAT, 3, dimIndex, &lud_id) );
+   setNetCDFVarStorage ( ncid, lud_id );
 
 
    /********************
@@ -2695,43 +2824,17 @@ void   computeLandUse( std::vector<string> imageFiles, string fileType )
                       int cntyFIPS = poImage_cnty[colCnty];
                       if ( cntyFIPS > 0 )
                       {
-                          //county FIPS and GRIDID
-                          char   tmp_char[30];
-
-                          sprintf( tmp_char,"%d.%d.%d\0",gridID,cntyFIPS, classID);
-                          string tmp_str = string ( tmp_char );
-
-                          if ( gridCntyCrop.find ( tmp_str )  != gridCntyCrop.end() )
-                          {
-                             //grid, county, crop element is already existing
-                             gridCntyCrop[tmp_str] += 1;   //add one cell
-                          }
-                          else
+                          //count the cell for county FIPS, GRIDID and crop
+                          if ( addGridCntyCrop ( gridID, cntyFIPS, classID ) == 1 )
                           {
-                             //grid, county, crop element is new
-                             gridCntyCrop[tmp_str] = 1;
-
-                             //add county element to the grid
-                             std::vector<int>  vecFIPS;
+                             //grid, county, crop element is new: add county element to the grid
                              if ( classID == 81 )
                              {
-                                if ( grid81CNTYs.find ( gridID ) != grid81CNTYs.end() )
-                                {
-                                   //existing grid element and get county fips vector
-                                   vecFIPS = grid81CNTYs[gridID];
-                                }
-                                vecFIPS.push_back ( cntyFIPS );
-                                grid81CNTYs[gridID] = vecFIPS;
+                                grid81CNTYs[gridID].push_back ( cntyFIPS );
                              }
                              else
                              {
-                                if ( grid82CNTYs.find ( gridID ) != grid82CNTYs.end() )
-                                {
-                                   //existing grid element and get county fips vector
-                                   vecFIPS = grid82CNTYs[gridID];
-                                }
-                                vecFIPS.push_back ( cntyFIPS );
-                                grid82CNTYs[gridID] = vecFIPS;
+                                grid82CNTYs[gridID].push_back ( cntyFIPS );
                              }
 
                              //printf ( "\tgridID=%d   FIPS=%d\n", gridID, cntyFIPS );
@@ -2999,42 +3102,17 @@ void   computeMODIS( string modisFile )
                            int cntyFIPS = poImage_cnty[colCnty];
                            if ( cntyFIPS > 0 )
                            {
-                              //county FIPS and GRIDID
-                              char   tmp_char[30];
-
-                              sprintf( tmp_char,"%d.%d.%d\0",gridID,cntyFIPS,classID);
-                              string tmp_str = string ( tmp_char );
-                              if ( gridCntyCrop.find ( tmp_str )  != gridCntyCrop.end() )
+                              //count the cell for county FIPS, GRIDID and crop
+                              if ( addGridCntyCrop ( gridID, cntyFIPS, classID ) == 1 )
                               {
-                                 //grid, county, crop element is already existing
-                                 gridCntyCrop[tmp_str] += 1;   //add one cell
-                              }
-                              else
-                              {
-                                 //grid, county, crop element is new
-                                 gridCntyCrop[tmp_str] = 1;
-
-                                 //add county element to the grid
-                                 std::vector<int>  vecFIPS;
+                                 //grid, county, crop element is new: add county element to the grid
                                  if ( classID == 12 )
                                  {
-                                    if ( grid12CNTYs.find ( gridID ) != grid12CNTYs.end() )
-                                    {
-                                       //existing grid element and get county fips vector
-                                       vecFIPS = grid12CNTYs[gridID];
-                                    }
-                                    vecFIPS.push_back ( cntyFIPS );
-                                    grid12CNTYs[gridID] = vecFIPS;
+                                    grid12CNTYs[gridID].push_back ( cntyFIPS );
                                  }
                                  else
                                  {
-                                    if ( grid14CNTYs.find ( gridID ) != grid14CNTYs.end() )
-                                    {
-                                       //existing grid element and get county fips vector
-                                       vecFIPS = grid14CNTYs[gridID];
-                                    }
-                                    vecFIPS.push_back ( cntyFIPS );
-                                    grid14CNTYs[gridID] = vecFIPS;
+                                    grid14CNTYs[gridID].push_back ( cntyFIPS );
                                  }
                                  //printf ( "\tgridID=%d   FIPS=%d\n", gridID, cntyFIPS );
 
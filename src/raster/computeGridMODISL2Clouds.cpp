@@ -223,10 +223,6 @@ int main(int nArgc, char *argv[])
         FileExists(outNetcdfFile.c_str(), 3 );  //the file has to be new.
 
 
-       /*********************************/
-       /*    Create grid raster file    */
-       /*********************************/
-       string createdGridImage  = createGridImage ( grid );
 
        /*********************************/
        /*  Set grid info from Satellite */
@@ -251,12 +247,9 @@ int main(int nArgc, char *argv[])
        gridInfo newRasterInfo = computeNewRasterInfo ( no_shape, rasterResolution, grid);
 
        /*********************************/
-       /*    resample grid raster       */
+       /*    domain grid raster         */
        /*********************************/
-       string gridRasterFile = resampleRaster (createdGridImage, newRasterInfo);
-
-       //delete created raster file
-       deleteRasterFile ( createdGridImage );
+       string gridRasterFile = getDomainGridRaster (grid, newRasterInfo);
 
 
        /*****************************************
@@ -291,7 +284,7 @@ int main(int nArgc, char *argv[])
        ******************************/
        int ncid;
         
-       anyErrors( nc_create(outNetcdfFile.c_str(), NC_CLOBBER, &ncid) );   //open output file
+       anyErrors( nc_create(outNetcdfFile.c_str(), netCDFCreateMode ( NC_CLOBBER ), &ncid) );   //open output file
  
        /********************
        * Dimension lengths *
@@ -585,7 +578,7 @@ int main(int nArgc, char *argv[])
        /*******************************************************/
        /*  Close and delete rasterized grid domain image file */
        /*******************************************************/
-       deleteRasterFile ( gridRasterFile ); 
+       releaseDomainGridRaster ( gridRasterFile ); 
 
        /**************************
        * Store global attributes *
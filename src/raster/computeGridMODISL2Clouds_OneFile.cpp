@@ -221,10 +221,6 @@ int main(int nArgc, char *argv[])
         printf( "\tOutput NetCDF file is: %s\n", outNetcdfFile.c_str() );
         FileExists(outNetcdfFile.c_str(), 3 );  //the file has to be new.
 
-       /*********************************/
-       /*    Create grid raster file    */
-       /*********************************/
-       string createdGridImage  = createGridImage ( grid );
 
        /*********************************/
        /*  Set grid info from Satellite */
@@ -247,12 +243,9 @@ int main(int nArgc, char *argv[])
         gridInfo newRasterInfo = computeNewRasterInfo ( no_shape, rasterResolution, grid);
 
        /*********************************/
-       /*    resample grid raster       */
+       /*    domain grid raster         */
        /*********************************/
-       string gridRasterFile = resampleRaster (createdGridImage, newRasterInfo);
-
-      //delete created raster file
-       deleteRasterFile ( createdGridImage );
+       string gridRasterFile = getDomainGridRaster (grid, newRasterInfo);
 
        /**********************************
        * Compute times and timesStr data *
@@ -305,7 +298,7 @@ int main(int nArgc, char *argv[])
 	******************************/
         int ncid;
         
-	anyErrors( nc_create(outNetcdfFile.c_str(), NC_CLOBBER, &ncid) );   //open output file
+	anyErrors( nc_create(outNetcdfFile.c_str(), netCDFCreateMode ( NC_CLOBBER ), &ncid) );   //open output file
  
         /********************
         * Dimension lengths *
@@ -504,7 +497,8 @@ int main(int nArgc, char *argv[])
            dimIndex[0] = time_dim;   
            dimIndex[1] = south_north_dim;
            dimIndex[2] = west_east_dim;
-           anyErrors( nc_def_var(ncid, inSatVars[i].c_str(), NC_FLOAT, 3, dimIndex, &satV_id) );           
+           anyErrors( nc_def_var(ncid, inSatVars[i].c_str(), NC_FLOAT, 3, dimIndex, &satV_id) );
+           setNetCDFVarStorage ( ncid, satV_id );
 
            anyErrors( nc_put_att_int(ncid, satV_id, "FieldType", NC_INT, 1, fieldtype) ); 
            anyErrors( nc_put_att_text(ncid, satV_id, "MemoryOrder", 3, "XY ") );
@@ -539,7 +533,7 @@ int main(int nArgc, char *argv[])
         /*******************************************************/
         /*  Close and delete rasterized grid domain image file */
         /*******************************************************/
-        deleteRasterFile ( gridRasterFile ); 
+        releaseDomainGridRaster ( gridRasterFile ); 
 
 
 	/**************************
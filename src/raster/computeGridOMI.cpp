@@ -57,6 +57,8 @@ double                halfGridCellArea;                     //domain grid area
 double                xMin_grd,xMax_grd,yMin_grd,yMax_grd;  //modeling domain extent
 OGRSpatialReference   oSRS_grd;
 char                  *pszProj4_grd = NULL;
+bool                  coverageWeighting = false;   //weight image pixels by cell coverage
+pixelCoverageWeights  pixelWeights;                //pixel coverage of each grid cell
 
 /***************************
 *********** MAIN  **********
@@ -230,10 +232,25 @@ int main(int nArgc, char *argv[])
         printf( "\tOutput NetCDF file is: %s\n", outNetcdfFile.c_str() );
         FileExists(outNetcdfFile.c_str(), 3 );  //the file has to be new.
 
-       /*********************************/
-       /*    Create grid raster file    */
-       /*********************************/
-       string createdGridImage  = createGridImage ( grid );
+        //optional pixel weighting: CENTER counts re-sampled domain pixels in the cell holding
+        //their centers, COVERAGE weights the image pixels by the fraction of each cell they cover
+        if ( getenv ( "PIXEL_WEIGHTING" ) != NULL )
+        {
+           tmp_str = string ( getEnviVariable("PIXEL_WEIGHTING") );
+           tmp_str = trim ( tmp_str );
+           tmp_str = stringToUpper ( tmp_str );
+           if ( tmp_str.compare ( "COVERAGE" ) == 0 )
+           {
+              coverageWeighting = true;
+           }
+           else if ( tmp_str.compare ( "CENTER" ) != 0 )
+           {
+              printf ( "\tError: PIXEL_WEIGHTING has to be CENTER or COVERAGE: %s\n", tmp_str.c_str() );
+              exit ( 1 );
+           }
+           printf ( "\tPixel weighting: %s\n", tmp_str.c_str() );
+        }
+
 
        /*********************************/
        /*  Get grid info from Satellite */
@@ -252,24 +269,32 @@ int main(int nArgc, char *argv[])
           imageInfo = getImageInfo ( tmp_str );  //hdf (4) file and other GDAL image file
        }
 
-       /*********************************/
-       /*    Compute raster resolution  */
-       /*********************************/
-       double  rasterResolution =  computeRasterResolution ( imageInfo, grid );
+       string    gridRasterFile;
+       gridInfo  newRasterInfo;
 
-       /*********************************/
-       /*  Compute new raster info      */
-       /*********************************/
-        string no_shape;
-        gridInfo newRasterInfo = computeNewRasterInfo ( no_shape, rasterResolution, grid);
-
-       /*********************************/
-       /*    resample grid raster       */
-       /*********************************/
-       string gridRasterFile = resampleRaster (createdGridImage, newRasterInfo);
-
-       //delete created raster file
-       deleteRasterFile ( createdGridImage );
+       if ( coverageWeighting )
+       {
+          //the image is used at its own resolution
+          pixelWeights = computePixelCoverageWeights ( grid, imageInfo );
+       }
+       else
+       {
+          /*********************************/
+          /*    Compute raster resolution  */
+          /*********************************/
+          double  rasterResolution =  computeRasterResolution ( imageInfo, grid );
+
+          /*********************************/
+          /*  Compute new raster info      */
+          /*********************************/
+          string no_shape;
+          newRasterInfo = computeNewRasterInfo ( no_shape, rasterResolution, grid);
+
+          /*********************************/
+          /*    domain grid raster         */
+          /*********************************/
+          gridRasterFile = getDomainGridRaster (grid, newRasterInfo);
+       }
        
        /**********************************
        * Compute times and timesStr data *
@@ -318,7 +343,7 @@ int main(int nArgc, char *argv[])
 	******************************/
         int ncid;
         
-	anyErrors( nc_create(outNetcdfFile.c_str(), NC_CLOBBER, &ncid) );   //open output file
+	anyErrors( nc_create(outNetcdfFile.c_str(), netCDFCreateMode ( NC_CLOBBER ), &ncid) );   //open output file
  
         /********************
         * Dimension lengths *
@@ -427,57 +452,65 @@ int main(int nArgc, char *argv[])
         GDALAllRegister();
 
 
-        /***********************************************/
-        /*     Open rasterized grid domain image       */
-        /***********************************************/
         const char   *pszWKT = NULL;
         char         *pszWKT_nc = NULL;
         double       xUL;
         double       yUL;
 
-        //open the grid domain image
-        poGrid = (GDALDataset *) GDALOpen( gridRasterFile.c_str(), GA_ReadOnly );
-        if( poGrid == NULL )
+        if ( coverageWeighting )
         {
-          printf( "\tError: Open rasterized domain file failed: %s.\n", gridRasterFile.c_str() );
-          exit( 1 );
+           oSRS_grd.importFromProj4( grid.strProj4 );
+           oSRS_grd.exportToProj4( &pszProj4_grd );
         }
-        poGridBand = poGrid->GetRasterBand( 1 );  // band 1
+        else
+        {
+           /***********************************************/
+           /*     Open rasterized grid domain image       */
+           /***********************************************/
+           //open the grid domain image
+           poGrid = (GDALDataset *) GDALOpen( gridRasterFile.c_str(), GA_ReadOnly );
+           if( poGrid == NULL )
+           {
+             printf( "\tError: Open rasterized domain file failed: %s.\n", gridRasterFile.c_str() );
+             exit( 1 );
+           }
+           poGridBand = poGrid->GetRasterBand( 1 );  // band 1
 
-        // get rows and columns of the image
-        xCells_grd = newRasterInfo.cols;
-        yCells_grd = newRasterInfo.rows;
-        //printf( "\tGrid domain cells are: %dx%d\n", xCells_grd, yCells_grd );
+           // get rows and columns of the image
+           xCells_grd = newRasterInfo.cols;
+           yCells_grd = newRasterInfo.rows;
+           //printf( "\tGrid domain cells are: %dx%d\n", xCells_grd, yCells_grd );
 
 
-        //get UL corner coordinates and grid size for the domain grid
-        xUL = newRasterInfo.xmin;
-        yUL = newRasterInfo.ymax;
-        //printf( "\tDoamin UL Origin = (%.6lf,%.6lf)\n", xUL,yUL );
+           //get UL corner coordinates and grid size for the domain grid
+           xUL = newRasterInfo.xmin;
+           yUL = newRasterInfo.ymax;
+           //printf( "\tDoamin UL Origin = (%.6lf,%.6lf)\n", xUL,yUL );
 
-        xCellSize_grd =  newRasterInfo.xCellSize;
-        yCellSize_grd =  newRasterInfo.yCellSize;  
-        //printf( "\tGrid domain re-sampled pixel size = (%.3lf,%.3lf)\n", xCellSize_grd, yCellSize_grd );
+           xCellSize_grd =  newRasterInfo.xCellSize;
+           yCellSize_grd =  newRasterInfo.yCellSize;  
+           //printf( "\tGrid domain re-sampled pixel size = (%.3lf,%.3lf)\n", xCellSize_grd, yCellSize_grd );
 
-        //compute extent of band 1 domain grid image (only one band for all images)
-        xMin_grd = xUL;
-        xMax_grd = newRasterInfo.xmax;
+           //compute extent of band 1 domain grid image (only one band for all images)
+           xMin_grd = xUL;
+           xMax_grd = newRasterInfo.xmax;
 
-        yMax_grd = yUL;
-        yMin_grd = newRasterInfo.ymin;;
-        //printf( "\tDomain grid raster extent:  minXY(%.3lf,%.3lf)   maxXY(%.3lf,%.3lf)\n", xMin_grd,yMin_grd,xMax_grd,yMax_grd );
+           yMax_grd = yUL;
+           yMin_grd = newRasterInfo.ymin;;
+           //printf( "\tDomain grid raster extent:  minXY(%.3lf,%.3lf)   maxXY(%.3lf,%.3lf)\n", xMin_grd,yMin_grd,xMax_grd,yMax_grd );
 
-        //get projection from the domain rater image
-        if( (pszWKT = poGrid->GetProjectionRef())  == NULL )
-        {
-           printf( "\tError: Projection is not defined in the domain grid raster file: %s.\n", gridRasterFile.c_str() );
-           printf( "\tCan define it using gdal_translate utility.\n");
-           exit( 1 );
+           //get projection from the domain rater image
+           if( (pszWKT = poGrid->GetProjectionRef())  == NULL )
+           {
+              printf( "\tError: Projection is not defined in the domain grid raster file: %s.\n", gridRasterFile.c_str() );
+              printf( "\tCan define it using gdal_translate utility.\n");
+              exit( 1 );
+           }
+           pszWKT_nc =strdup ( pszWKT );   //convert it to no const char
+           oSRS_grd.importFromWkt( &pszWKT_nc );      //needed it for comparison
+           oSRS_grd.exportToProj4( &pszProj4_grd );
+           //printf ( "\tProj4 for the domain raster image is: %s\n\n", pszProj4_grd);
         }
-        pszWKT_nc =strdup ( pszWKT );   //convert it to no const char
-        oSRS_grd.importFromWkt( &pszWKT_nc );      //needed it for comparison
-        oSRS_grd.exportToProj4( &pszProj4_grd );
-        //printf ( "\tProj4 for the domain raster image is: %s\n\n", pszProj4_grd);
 
 
         /*****************************************
@@ -535,7 +568,8 @@ int main(int nArgc, char *argv[])
            dimIndex[0] = time_dim;   
            dimIndex[1] = south_north_dim;
            dimIndex[2] = west_east_dim;
-           anyErrors( nc_def_var(ncid, inSatVars[i].c_str(), NC_FLOAT, 3, dimIndex, &satV_id) );           
+           anyErrors( nc_def_var(ncid, inSatVars[i].c_str(), NC_FLOAT, 3, dimIndex, &satV_id) );
+           setNetCDFVarStorage ( ncid, satV_id );
 
            anyErrors( nc_put_att_int(ncid, satV_id, "FieldType", NC_INT, 1, fieldtype) ); 
            anyErrors( nc_put_att_text(ncid, satV_id, "MemoryOrder", 3, "XY ") );
@@ -610,12 +644,19 @@ int main(int nArgc, char *argv[])
  
         }
 
-        GDALClose( (GDALDatasetH) poGrid );
-        
-        /*******************************************************/
-        /*  Close and delete rasterized grid domain image file */
-        /*******************************************************/
-        deleteRasterFile ( gridRasterFile ); 
+        if ( coverageWeighting )
+        {
+           freePixelCoverageWeights ( &pixelWeights );
+        }
+        else
+        {
+           GDALClose( (GDALDatasetH) poGrid );
+
+           /*******************************************************/
+           /*  Close and delete rasterized grid domain image file */
+           /*******************************************************/
+           releaseDomainGridRaster ( gridRasterFile );
+        }
 
 
 	/**************************
@@ -742,6 +783,45 @@ void  computeSatVariable ( string imageFileName, string varName, float *satV, gr
         readHDF4SatVarData (imageFileName, varName, poImage);   //OMI L2G and L3 data
      }
 
+     if ( coverageWeighting )
+     {
+        int    timeIndex = 0;
+        double weightSum, valueSum;
+
+        //average of the pixels weighted by their coverage, if at least half of the cell has values
+        for ( gridID = 0; gridID < pixelWeights.cells; gridID++ )
+        {
+           weightSum = 0.0;
+           valueSum = 0.0;
+           for ( idIndex = pixelWeights.start[gridID]; idIndex < pixelWeights.start[gridID+1]; idIndex++ )
+           {
+              value = poImage[pixelWeights.pixel[idIndex]];
+              if ( value != SAT_MISSIING_VALUE )
+              {
+                 weightSum += pixelWeights.weight[idIndex];
+                 valueSum += pixelWeights.weight[idIndex] * value;
+              }
+           }
+
+           dataIndex = timeIndex * gridRows * gridCols + gridID;
+           if ( weightSum >= 0.5 )
+           {
+              satV[dataIndex] = valueSum / weightSum;
+           }
+           else
+           {
+              satV[dataIndex] = MISSIING_VALUE;
+           }
+        }
+
+        CPLFree (poImage);
+        pj_free ( proj4From );
+        pj_free ( proj4To );
+
+        printf ( "\tFinished processing satellite image file.\n\n" );
+        return;
+     }
+
      /***********************************************************************************
       *     Allocate memory store pixel number and total value in each modeling grid    *
       ***********************************************************************************/
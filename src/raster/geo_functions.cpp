@@ -70,6 +70,13 @@
  *  67. readGridCoordinates - read in grid coordinates from a csv file  
  *  68. readHDF5SatVarDataInt  - read int data from HDF5
  *  69. computeGridSatValues_hour - compute tropomi data with time
+ *  70. readHDF4SatVarWindow - read the part of a HDF4 tile variable over a domain in its own data type
+ *  71. netCDFCreateMode - output NetCDF format selected by NETCDF_OUTPUT_FORMAT
+ *  72. setNetCDFVarStorage - chunk and compress a variable in NetCDF-4 output
+ *  73. getDomainGridRaster - domain grid ID raster at a resolution, cached in DOMAIN_RASTER_CACHE_DIR
+ *  74. releaseDomainGridRaster - delete a domain grid ID raster unless it is cached
+ *  75. computePixelCoverageWeights - overlap fractions between domain grid cells and image pixels
+ *  76. freePixelCoverageWeights - free the overlap fractions
  *
  * Written by the Institute for the Environment at UNC, Chapel Hill
  * in support of the EPA CMAS Modeling and NASA Grants, 2009.
@@ -80,6 +87,7 @@
 ***********************************************************************/
 
 #include <dirent.h>
+#include <unistd.h>
 #include <ctime> 
 #include <cstdlib>
 #include <sstream>
@@ -1691,6 +1699,8 @@ void writeWRFGridCoordinates ( int ncid, int west_east_dim, int south_north_dim,
      dimIndex[1] = west_east_dim;
      anyErrors( nc_def_var(ncid, "XLONG_M", NC_FLOAT, 2, dimIndex, &lon_id) );
      anyErrors( nc_def_var(ncid, "XLAT_M", NC_FLOAT, 2, dimIndex, &lat_id) );
+     setNetCDFVarStorage ( ncid, lon_id );
+     setNetCDFVarStorage ( ncid, lat_id );
 
      anyErrors( nc_put_att_int(ncid, lon_id, "FieldType", NC_INT, 1, fieldtype) );
      anyErrors( nc_put_att_text(ncid, lon_id, "MemoryOrder", 3, "XY ") );
@@ -3779,6 +3789,7 @@ int defineWRFNetCDFSatVar ( int ncid, string satVarName, int numDims, int *dimIn
    printf ("\tDefine varName=%s numDims=%d\n",satVarName.c_str(), numDims);
 
    anyErrors( nc_def_var(ncid, satVarName.c_str(), NC_FLOAT, numDims, dimIndex, &satV_id) );
+   setNetCDFVarStorage ( ncid, satV_id );
 
    anyErrors( nc_put_att_int(ncid, satV_id, "FieldType", NC_INT, 1, fieldtype) );
 
@@ -4386,6 +4397,7 @@ int defineNCFloatVariable (int ncid, const char *varName, int numDims, int *dimI
    printf ("\tDefined variable: %s\n", varName );
 
    anyErrors( nc_def_var(ncid, varName, NC_FLOAT, numDims, dimIndex, &var_id) );
+   setNetCDFVarStorage ( ncid, var_id );
 
    anyErrors( nc_put_att_int(ncid, var_id, "FieldType", NC_INT, 1, fieldtype) );
    anyErrors( nc_put_att_text(ncid, var_id, "MemoryOrder", 2, "XY") );
@@ -4531,6 +4543,7 @@ int defineNCIntVariable (int ncid, const char *varName, int numDims, int *dimInd
    printf ("\tDefined variable: %s\n", varName );
 
    anyErrors( nc_def_var(ncid, varName, NC_INT, numDims, dimIndex, &var_id) );
+   setNetCDFVarStorage ( ncid, var_id );
 
    anyErrors( nc_put_att_int(ncid, var_id, "FieldType", NC_INT, 1, fieldtype) );
 
@@ -5026,14 +5039,12 @@ string  extractDomainMODISData ( std::vector<string> modisFiles, string varName,
       { 
           printf ("\n\tMODIS land cover file intersects with the domain: %s\n", imageFile.c_str() );
 
-          //get data from the MODIS file
-          double *poImage = (double *) CPLCalloc(sizeof(double), modisInfo.rows*modisInfo.cols);
-
-          readHDF4SatVarData (imageFile, varName, poImage);   
+          //get the part of the MODIS file over the domain in its own data type
+          satVarWindow win = readHDF4SatVarWindow (imageFile, varName, modisInfo, grid);
 
           double x,y;
           int  col,row;
-          for( i = 0; i<modisInfo.rows; i++ )
+          for( i = win.row1; i<win.row1+win.rows; i++ )
           {
             
              //get cell center point y and compute row in grid image
@@ -5042,7 +5053,7 @@ string  extractDomainMODISData ( std::vector<string> modisFiles, string varName,
 
              if ( row >= 0 && row < grid.rows )
              {
-                for (j=0; j<modisInfo.cols; j++)
+                for (j=win.col1; j<win.col1+win.cols; j++)
                 {
           
                    //get cell center point x and compute col in grid image
@@ -5052,11 +5063,11 @@ string  extractDomainMODISData ( std::vector<string> modisFiles, string varName,
                    if ( col >=0 && col < grid.cols )
                    {
                       int gridIndex = grid.cols * row + col;
-                      int imageIndex = modisInfo.cols * i + j;
+                      int imageIndex = win.cols * (i - win.row1) + j - win.col1;
 
                       //printf ( "\tcol=%d  row=%d  gridIndex=%d\n",col,row,gridIndex );
                       
-                      GByte  modisClass =  int ( poImage[imageIndex] );
+                      GByte  modisClass =  int ( getSatVarWindowValue ( &win, imageIndex ) );
 
                       if (  modisClass == 17 || modisClass == 254 )
                       { 
@@ -5072,7 +5083,7 @@ string  extractDomainMODISData ( std::vector<string> modisFiles, string varName,
           }  //i
          
           printf ( "\tFinished reading: %s\n\n", imageFile.c_str() );
-          CPLFree (poImage);
+          CPLFree (win.data);
 
       }  //intersect
 
@@ -5390,6 +5401,8 @@ void writeWRFGridCoordinates_time ( int ncid, int time_dim, int west_east_dim, i
      dimIndex[2] = west_east_dim;
      anyErrors( nc_def_var(ncid, "XLONG_M", NC_FLOAT, 3, dimIndex, &lon_id) );
      anyErrors( nc_def_var(ncid, "XLAT_M", NC_FLOAT, 3, dimIndex, &lat_id) );
+     setNetCDFVarStorage ( ncid, lon_id );
+     setNetCDFVarStorage ( ncid, lat_id );
 
      anyErrors( nc_put_att_int(ncid, lon_id, "FieldType", NC_INT, 1, fieldtype) );
      anyErrors( nc_put_att_text(ncid, lon_id, "MemoryOrder", 3, "XY ") );
@@ -6463,21 +6476,17 @@ string   extractDomainLAIData ( std::vector<string> modisFiles, std::vector<stri
       { 
           printf ("\n\tMODIS LAI-FAPR file intersects with the domain: %s\n", imageFile.c_str() );
 
-          //read satellite variables into arrays
-          double *poImage[satVars.size()];
+          //read the part of the satellite variables over the domain in their own data types
+          satVarWindow win[satVars.size()];
 
           for ( m=0; m<satVars.size(); m++ )
           {
-
-             //get data from the MODIS file
-             poImage[m] = (double *) CPLCalloc(sizeof(double), modisInfo.rows*modisInfo.cols);
-
-             readHDF4SatVarData (imageFile, satVars[m], poImage[m]);   
+             win[m] = readHDF4SatVarWindow (imageFile, satVars[m], modisInfo, grid);
           }
 
           double x,y;
           int  col,row;
-          for( i = 0; i<modisInfo.rows; i++ )
+          for( i = win[0].row1; i<win[0].row1+win[0].rows; i++ )
           {
             
              //get cell center point y and compute row in grid image
@@ -6486,7 +6495,7 @@ string   extractDomainLAIData ( std::vector<string> modisFiles, std::vector<stri
 
              if ( row >= 0 && row < grid.rows )
              {
-                for (j=0; j<modisInfo.cols; j++)
+                for (j=win[0].col1; j<win[0].col1+win[0].cols; j++)
                 {
           
                    //get cell center point x and compute col in grid image
@@ -6496,13 +6505,13 @@ string   extractDomainLAIData ( std::vector<string> modisFiles, std::vector<stri
                    if ( col >=0 && col < grid.cols )
                    {
                       int gridIndex = grid.cols * row + col;
-                      int imageIndex = modisInfo.cols * i + j;
+                      int imageIndex = win[0].cols * (i - win[0].row1) + j - win[0].col1;
 
                       //printf ( "\tcol=%d  row=%d  gridIndex=%d\n",col,row,gridIndex );
                       
                       for ( m=0; m<satVars.size(); m++ )
                       {
-                         GByte  modisClass =  int ( poImage[m][imageIndex] );
+                         GByte  modisClass =  int ( getSatVarWindowValue ( &win[m], imageIndex ) );
 
                          poGrid[m][gridIndex] = int ( modisClass );  //copy image data to grid
 
@@ -6519,7 +6528,7 @@ string   extractDomainLAIData ( std::vector<string> modisFiles, std::vector<stri
       
           for ( m=0; m<satVars.size(); m++ )
           {
-             CPLFree (poImage[m]);
+             CPLFree (win[m].data);
           }
 
       }  //intersect
@@ -6674,22 +6683,23 @@ string   extractDomainALBData ( std::vector<string> modisFiles, std::vector<stri
       { 
           printf ("\n\tMODIS file intersects with the domain: %s\n", imageFile.c_str() );
 
-          //read satellite variables into arrays
-          double *poImage[satVars.size()];
+          //read the part of the satellite variables over the domain in their own data types
+          satVarWindow win[satVars.size()];
 
           for ( m=0; m<satVars.size(); m++ )
           {
-
-             //get data from the MODIS file
-             poImage[m] = (double *) CPLCalloc(sizeof(double), modisInfo.rows*modisInfo.cols*numParams);
-
-             readHDF4SatVarData (imageFile, satVars[m], poImage[m]);   
+             win[m] = readHDF4SatVarWindow (imageFile, satVars[m], modisInfo, grid);
+             if ( win[m].numP != numParams )
+             {
+                printf ( "\tError: %s has %d parameters and %d are expected\n", satVars[m].c_str(), win[m].numP, numParams );
+                exit ( 1 );
+             }
           }
 
 
           double x,y;
           int  col,row;
-          for( i = 0; i<modisInfo.rows; i++ )
+          for( i = win[0].row1; i<win[0].row1+win[0].rows; i++ )
           {
             
              //get cell center point y and compute row in grid image
@@ -6698,7 +6708,7 @@ string   extractDomainALBData ( std::vector<string> modisFiles, std::vector<stri
 
              if ( row >= 0 && row < grid.rows )
              {
-                for (j=0; j<modisInfo.cols; j++)
+                for (j=win[0].col1; j<win[0].col1+win[0].cols; j++)
                 {
           
                    //get cell center point x and compute col in grid image
@@ -6718,11 +6728,11 @@ string   extractDomainALBData ( std::vector<string> modisFiles, std::vector<stri
                          for ( k=0; k<numParams; k++ )
                          { 
                    
-                            int imageIndex = i * modisInfo.cols * numParams + j * numParams + k;
+                            int imageIndex = ( (i - win[0].row1) * win[0].cols + j - win[0].col1 ) * numParams + k;
 
                             //printf ( "\tcol=%d  row=%d  k=%d  gridIndex=%d\n",col,row,k,gridIndex );
 
-                            GInt16  modisClass =  int ( poImage[m][imageIndex] );
+                            GInt16  modisClass =  int ( getSatVarWindowValue ( &win[m], imageIndex ) );
 
                             poGrid[numBand][gridIndex] = modisClass;  //copy image data to grid band
                           
@@ -6742,7 +6752,7 @@ string   extractDomainALBData ( std::vector<string> modisFiles, std::vector<stri
       
           for ( m=0; m<satVars.size(); m++ )
           {
-             CPLFree (poImage[m]);
+             CPLFree (win[m].data);
           }
 
       }  //intersect
@@ -7394,3 +7404,644 @@ void  computeGridSatValues_hour ( GUInt32 *poImage_grd, int *grdIndex, float *sa
    CPLFree (gridValues);
    CPLFree (gridTimes);
 }
+
+
+
+/****************************************************************/
+/*   70. readHDF4SatVarWindow                                   */
+/*       read the rows and columns of a HDF4 tile variable that */
+/*       can fall in the domain grid, in the file data type     */
+/****************************************************************/
+satVarWindow  readHDF4SatVarWindow ( string imageFile, string varName, gridInfo imageInfo, gridInfo grid )
+{
+   int32         sd_id, sds_id, index;
+   char          sds_name[64];
+   int32         rank, dim_sizes[MAX_VAR_DIMS], num_type, attributes;
+   char          *varName_nc;
+   int           typeSize;
+   satVarWindow  win;
+
+
+   /*  Tile pixel i has its center at ymax - (i+0.5)*yCellSize, and the
+    *  extract functions keep it when that center falls in a grid row.
+    *  Read from one pixel before the first such row to one after the
+    *  last so the per pixel checks still decide. */
+   double  gridYmin = grid.ymax - grid.rows * grid.yCellSize;
+   double  gridXmax = grid.xmin + grid.cols * grid.xCellSize;
+
+   int row1 = (int) floor ( (imageInfo.ymax - grid.ymax) / imageInfo.yCellSize - 0.5 ) - 1;
+   int row2 = (int) ceil ( (imageInfo.ymax - gridYmin) / imageInfo.yCellSize - 0.5 ) + 1;
+   int col1 = (int) floor ( (grid.xmin - imageInfo.xmin) / imageInfo.xCellSize - 0.5 ) - 1;
+   int col2 = (int) ceil ( (gridXmax - imageInfo.xmin) / imageInfo.xCellSize - 0.5 ) + 1;
+
+   row1 = max ( row1, 0 );
+   col1 = max ( col1, 0 );
+   row2 = min ( row2, imageInfo.rows );
+   col2 = min ( col2, imageInfo.cols );
+
+   win.row1 = row1;
+   win.col1 = col1;
+   win.rows = max ( row2 - row1, 0 );
+   win.cols = max ( col2 - col1, 0 );
+   win.numP = 1;
+   win.data = NULL;
+
+
+   sd_id = SDstart(imageFile.c_str(), DFACC_READ);
+   if (sd_id == FAIL)
+   {
+      printf ("\tOpen HDF4 file failed: %s.\n", imageFile.c_str() );
+      exit ( 1 );
+   }
+
+   varName_nc = strdup ( varName.c_str() );
+   anyHDF4Errors ( index = SDnametoindex ( sd_id, varName_nc ) );
+   anyHDF4Errors ( sds_id = SDselect (sd_id, index) );
+   anyHDF4Errors( SDgetinfo(sds_id, sds_name, &rank, dim_sizes, &num_type, &attributes) );
+   free ( varName_nc );
+
+   if ( rank != 2 && rank != 3 )
+   {
+      printf ("\tImage file variable has to have 2 or 3 dimensions: dim=%d\n", rank);
+      exit ( 1 );
+   }
+
+   //rows and columns are the first two dimensions.  MCD43A1 has 3 parameters in the third one
+   if ( dim_sizes[0] != imageInfo.rows || dim_sizes[1] != imageInfo.cols )
+   {
+      printf ("\tTile variable %s size %dx%d does not match the tile info %dx%d: %s\n", varName.c_str(),
+              dim_sizes[0], dim_sizes[1], imageInfo.rows, imageInfo.cols, imageFile.c_str() );
+      exit ( 1 );
+   }
+
+   if ( rank == 3 )
+   {
+      win.numP = dim_sizes[2];
+   }
+
+   switch ( num_type )
+   {
+      case DFNT_UINT8:
+      case DFNT_INT8:    typeSize = 1; break;
+      case DFNT_INT16:   typeSize = 2; break;
+      case DFNT_FLOAT32: typeSize = 4; break;
+      case DFNT_FLOAT64: typeSize = 8; break;
+      default:
+         printf ( "\tError: add data type - %d in readHDF4SatVarWindow.\n",num_type );
+         exit ( 1 );
+   }
+   win.numType = num_type;
+
+   printf ( "\tRead window rows %d-%d cols %d-%d of %dx%d   DataType=%d\n", 
+            win.row1, win.row1 + win.rows - 1, win.col1, win.col1 + win.cols - 1, 
+            imageInfo.rows, imageInfo.cols, num_type );
+
+   win.data = CPLCalloc ( typeSize, max ( win.rows * win.cols * win.numP, 1 ) );
+
+   if ( win.rows > 0 && win.cols > 0 )
+   {
+      int32  start[3] = { win.row1, win.col1, 0 };
+      int32  edges[3] = { win.rows, win.cols, win.numP };
+
+      anyHDF4Errors ( SDreaddata (sds_id, start, NULL, edges , (VOIDP) win.data ) );
+   }
+
+   anyHDF4Errors ( SDendaccess(sds_id) );
+   anyHDF4Errors (  SDend(sd_id) );
+
+   printf ( "\tRead data: %s  |  %s\n", imageFile.c_str(), varName.c_str() );
+
+   return win;
+}
+
+
+
+/****************************************************************/
+/*   71. netCDFCreateMode                                       */
+/*       nc_create mode for an output file: defaultMode unless  */
+/*       NETCDF_OUTPUT_FORMAT is set to CLASSIC, 64BIT or       */
+/*       NETCDF4                                                */
+/****************************************************************/
+int  netCDFCreateMode ( int defaultMode )
+{
+   char    *format_env;
+   string  format;
+
+
+   format_env = getenv ( "NETCDF_OUTPUT_FORMAT" );
+   if ( format_env == NULL )
+   {
+      return defaultMode;
+   }
+
+   format = string ( format_env );
+   format = trim ( format );
+   format = stringToUpper ( format );
+
+   if ( format.empty() || format.compare ( "CLASSIC" ) == 0 )
+   {
+      return NC_CLOBBER;
+   }
+
+   if ( format.compare ( "64BIT" ) == 0 )
+   {
+      return NC_CLOBBER | NC_64BIT_OFFSET;
+   }
+
+   if ( format.compare ( "NETCDF4" ) == 0 )
+   {
+#ifdef NC_NETCDF4
+      //classic model keeps the same dimensions, types and attributes
+      //so readers of the classic files see the same contents
+      return NC_CLOBBER | NC_NETCDF4 | NC_CLASSIC_MODEL;
+#else
+      printf ( "\tNETCDF_OUTPUT_FORMAT=NETCDF4 needs a NetCDF-4 library, writing 64-bit offset NetCDF\n" );
+      return NC_CLOBBER | NC_64BIT_OFFSET;
+#endif
+   }
+
+   printf ( "  Error: NETCDF_OUTPUT_FORMAT has to be CLASSIC, 64BIT or NETCDF4: %s\n", format_env );
+   exit ( 1 );
+}
+
+
+/****************************************************************/
+/*   72. setNetCDFVarStorage                                    */
+/*       chunk and compress a gridded variable of a NetCDF-4    */
+/*       output file.  Call it right after nc_def_var.          */
+/****************************************************************/
+void  setNetCDFVarStorage ( int ncid, int var_id )
+{
+#ifdef NC_NETCDF4
+   int      format;
+   int      i, numDims;
+   int      dimIDs[NC_MAX_VAR_DIMS];
+   size_t   chunks[NC_MAX_VAR_DIMS];
+   nc_type  varType;
+   char     *level_env;
+   int      deflateLevel = 1;
+
+
+   anyErrors( nc_inq_format (ncid, &format) );
+   if ( format != NC_FORMAT_NETCDF4 && format != NC_FORMAT_NETCDF4_CLASSIC )
+   {
+      return;
+   }
+
+   anyErrors( nc_inq_vartype (ncid, var_id, &varType) );
+   anyErrors( nc_inq_varndims (ncid, var_id, &numDims) );
+   if ( varType == NC_CHAR || numDims < 2 )
+   {
+      return;   //times, names and coordinate vectors are small
+   }
+   anyErrors( nc_inq_vardimid (ncid, var_id, dimIDs) );
+
+   //one chunk per time step and category, a whole grid slice each,
+   //split when a slice is larger than 1M cells
+   for ( i = 0; i < numDims; i++ )
+   {
+      if ( i < numDims - 2 )
+      {
+         chunks[i] = 1;
+      }
+      else
+      {
+         anyErrors( nc_inq_dimlen (ncid, dimIDs[i], &chunks[i]) );
+         if ( chunks[i] == 0 )
+         {
+            chunks[i] = 1;   //empty unlimited dimension
+         }
+      }
+   }
+   while ( chunks[numDims-2] * chunks[numDims-1] > 1048576 )
+   {
+      if ( chunks[numDims-2] > chunks[numDims-1] )
+      {
+         chunks[numDims-2] = (chunks[numDims-2] + 1) / 2;
+      }
+      else
+      {
+         chunks[numDims-1] = (chunks[numDims-1] + 1) / 2;
+      }
+   }
+   anyErrors( nc_def_var_chunking (ncid, var_id, NC_CHUNKED, chunks) );
+
+   level_env = getenv ( "NETCDF_DEFLATE_LEVEL" );
+   if ( level_env != NULL )
+   {
+      deflateLevel = atoi ( level_env );
+      if ( deflateLevel < 0 || deflateLevel > 9 )
+      {
+         printf ( "  Error: NETCDF_DEFLATE_LEVEL has to be 0 to 9: %s\n", level_env );
+         exit ( 1 );
+      }
+   }
+   if ( deflateLevel > 0 )
+   {
+      anyErrors( nc_def_var_deflate (ncid, var_id, 1, 1, deflateLevel) );
+   }
+#endif
+}
+
+
+
+/****************************************************************/
+/*   73. getDomainGridRaster                                    */
+/*       domain grid ID raster (from 1 at the LL cell) at the   */
+/*       resolution of rasterInfo, in the grid projection.  The */
+/*       ID of each pixel is computed from its center, so no    */
+/*       grid image is rasterized and re-sampled.  When         */
+/*       DOMAIN_RASTER_CACHE_DIR is set the raster is kept      */
+/*       there and reused by later runs on the same domain.     */
+/****************************************************************/
+string  getDomainGridRaster ( gridInfo grid, gridInfo rasterInfo )
+{
+   const char     *pszFormat = "EHdr";
+   GDALDriver     *poDriver;
+   GDALDataset    *poDstDS;
+   GDALRasterBand *poBand;
+   OGRSpatialReference oSRS;
+   char           *pszWKT = NULL;
+   char           *cacheDir_env;
+   char           tmp_char[512];
+   string         key, cacheName, imageName, tmp_str;
+   unsigned long long  hash;
+   int            i, j;
+   const char     *exts[4] = { ".hdr", ".prj", ".bil.aux.xml", ".bil" };
+
+
+   printf("\nGenerating domain grid raster at resolution: %lf\n", rasterInfo.xCellSize);
+
+   cacheDir_env = getenv ( "DOMAIN_RASTER_CACHE_DIR" );
+   if ( cacheDir_env != NULL && strlen ( cacheDir_env ) > 0 )
+   {
+      //the raster is defined by the grid and the raster extent and resolution
+      key = string ( grid.strProj4 );
+      sprintf ( tmp_char, "|%.6lf|%.6lf|%.6lf|%.6lf|%d|%d", grid.xmin, grid.ymax,
+                grid.xCellSize, grid.yCellSize, grid.rows, grid.cols );
+      key.append ( tmp_char );
+      sprintf ( tmp_char, "|%.6lf|%.6lf|%.6lf|%.6lf|%d|%d", rasterInfo.xmin, rasterInfo.ymax,
+                rasterInfo.xCellSize, rasterInfo.yCellSize, rasterInfo.rows, rasterInfo.cols );
+      key.append ( tmp_char );
+
+      //FNV-1a hash of the key for the file name
+      hash = 14695981039346656037ULL;
+      for ( i = 0; i < (int) key.size(); i++ )
+      {
+         hash ^= (unsigned char) key[i];
+         hash *= 1099511628211ULL;
+      }
+
+      tmp_str = string ( cacheDir_env );
+      tmp_str = processDirName ( tmp_str );
+      sprintf ( tmp_char, "domain_%016llx_grd", hash );
+      cacheName = tmp_str + string ( tmp_char );
+
+      //the .key file is written last, so a raster with a matching key is complete
+      std::ifstream keyFile ( (cacheName + string (".key")).c_str() );
+      if ( keyFile.good() )
+      {
+         string cachedKey;
+         std::getline ( keyFile, cachedKey );
+         if ( cachedKey.compare ( key ) == 0 )
+         {
+            printf ( "\tUse cached domain grid raster: %s.bil\n", cacheName.c_str() );
+            return ( cacheName + string (".bil") );
+         }
+         printf ( "\tCached domain grid raster has a different key, not used: %s\n", cacheName.c_str() );
+         cacheName.clear();
+      }
+      keyFile.close();
+
+      if ( ! cacheName.empty() )
+      {
+         //write under a name of this process and rename into place
+         sprintf ( tmp_char, "_%d", (int) getpid() );
+         imageName = cacheName + string ( tmp_char ) + string ( ".bil" );
+      }
+   }
+
+   if ( imageName.empty() )
+   {
+      imageName = getRandomFileName ( string ( "_grd.bil" ) );
+   }
+
+   GDALAllRegister();
+
+   poDriver = GetGDALDriverManager()->GetDriverByName(pszFormat);
+   if( poDriver == NULL )
+   {
+      printf ( "\tCreating a GDAL format driver failed: %s\n", pszFormat);
+      exit( 1 );
+   }
+
+   poDstDS = poDriver->Create( imageName.c_str(), rasterInfo.cols, rasterInfo.rows, 1, GDT_UInt32, NULL );
+   if( poDstDS == NULL )
+   {
+      printf ( "\tCreating the domain grid raster failed: %s\n", imageName.c_str() );
+      exit( 1 );
+   }
+   double adfGeoTransform[6] = { rasterInfo.xmin, rasterInfo.xCellSize, 0, rasterInfo.ymax, 0, -1*rasterInfo.yCellSize };
+   poDstDS->SetGeoTransform( adfGeoTransform );
+
+   oSRS.importFromProj4( grid.strProj4 );
+   oSRS.exportToWkt( &pszWKT );
+   if ( (poDstDS->SetProjection( pszWKT )) == CE_Failure )
+   {
+      printf ( "\tSetting projection failed for the grid raster file: %s\n", imageName.c_str() );
+      exit ( 1 );
+   }
+   CPLFree ( pszWKT );
+
+   poBand = poDstDS->GetRasterBand(1);
+
+   //grid ID from LL to UR corner 1 to rows*cols, 0 outside the domain
+   GUInt32 *poImage = (GUInt32 *) CPLCalloc(sizeof(GUInt32),rasterInfo.cols);
+   int *gridCols = (int *) CPLCalloc(sizeof(int),rasterInfo.cols);
+
+   for ( j=0; j<rasterInfo.cols; j++ )
+   {
+      double x = rasterInfo.xmin + j * rasterInfo.xCellSize + rasterInfo.xCellSize / 2.0;
+      double col = floor ( (x - grid.xmin) / grid.xCellSize );
+      gridCols[j] = ( col >= 0 && col < grid.cols ) ? (int) col : -1;
+   }
+
+   for ( i=0; i<rasterInfo.rows; i++ )
+   {
+      double y = rasterInfo.ymax - i * rasterInfo.yCellSize - rasterInfo.yCellSize / 2.0;
+      double row = floor ( (grid.ymax - y) / grid.yCellSize );
+
+      for ( j=0; j<rasterInfo.cols; j++ )
+      {
+         if ( row >= 0 && row < grid.rows && gridCols[j] >= 0 )
+         {
+            poImage[j] = (grid.rows - 1 - (int) row) * grid.cols + gridCols[j] + 1;
+         }
+         else
+         {
+            poImage[j] = 0;
+         }
+      }
+
+      if ( (poBand->RasterIO( GF_Write, 0, i, rasterInfo.cols, 1, poImage,
+            rasterInfo.cols, 1, GDT_UInt32, 0, 0 ) ) == CE_Failure)
+      {
+         printf( "\tError in writing data for image: %s.\n", imageName.c_str() );
+         exit( 1 );
+      }
+   }
+
+   CPLFree (poImage);
+   CPLFree (gridCols);
+   GDALClose( (GDALDatasetH) poDstDS );
+
+   if ( cacheName.empty() )
+   {
+      printf ( "\tCreated domain grid raster file: %s\n", imageName.c_str() );
+      return ( imageName );
+   }
+
+   //concurrent runs write the same raster, so the last rename wins harmlessly
+   tmp_str = imageName.substr ( 0, imageName.size() - 4 );
+   for ( i = 0; i < 4; i++ )
+   {
+      string fromName = tmp_str + string ( exts[i] );
+      if ( stat ( fromName.c_str(), &stFileInfo ) == 0 &&
+           rename ( fromName.c_str(), (cacheName + string (exts[i])).c_str() ) != 0 )
+      {
+         printf ( "\tError: moving domain grid raster into the cache failed: %s%s\n", cacheName.c_str(), exts[i] );
+         exit ( 1 );
+      }
+   }
+
+   imageName = cacheName + string ( "_" ) + string ( tmp_char + 1 ) + string ( ".key" );
+   std::ofstream outKey ( imageName.c_str() );
+   outKey << key << endl;
+   outKey.close();
+   if ( rename ( imageName.c_str(), (cacheName + string (".key")).c_str() ) != 0 )
+   {
+      printf ( "\tError: writing the cache key failed: %s.key\n", cacheName.c_str() );
+      exit ( 1 );
+   }
+
+   printf ( "\tCached domain grid raster file: %s.bil\n", cacheName.c_str() );
+   return ( cacheName + string (".bil") );
+}
+
+
+/****************************************************************/
+/*   74. releaseDomainGridRaster                                */
+/*       delete a raster from getDomainGridRaster unless it is  */
+/*       kept in the cache for other runs                       */
+/****************************************************************/
+void  releaseDomainGridRaster ( string rasterFile )
+{
+   string  keyFile = rasterFile.substr ( 0, rasterFile.size() - 4 ) + string ( ".key" );
+
+   if ( stat ( keyFile.c_str(), &stFileInfo ) == 0 )
+   {
+      return;
+   }
+   deleteRasterFile ( rasterFile );
+}
+
+
+
+/****************************************************************/
+/*   clip a polygon to a box (Sutherland-Hodgman) and return    */
+/*   the area of the part inside                                */
+/****************************************************************/
+static double clippedPolygonArea ( std::vector<double> &xs, std::vector<double> &ys,
+                                   double xmin, double ymin, double xmax, double ymax )
+{
+   std::vector<double>  inX, inY, outX, outY;
+   double               area = 0.0;
+   int                  edge, k, n;
+
+   outX = xs;
+   outY = ys;
+   for ( edge = 0; edge < 4 && outX.size() > 0; edge++ )
+   {
+      inX.swap ( outX );
+      inY.swap ( outY );
+      outX.clear();
+      outY.clear();
+      n = inX.size();
+      for ( k = 0; k < n; k++ )
+      {
+         double  x1 = inX[(k + n - 1) % n], y1 = inY[(k + n - 1) % n];
+         double  x2 = inX[k], y2 = inY[k];
+         double  d1, d2;
+
+         //signed distance inside the edge: left, right, bottom, top
+         switch ( edge )
+         {
+            case 0:  d1 = x1 - xmin;  d2 = x2 - xmin;  break;
+            case 1:  d1 = xmax - x1;  d2 = xmax - x2;  break;
+            case 2:  d1 = y1 - ymin;  d2 = y2 - ymin;  break;
+            default: d1 = ymax - y1;  d2 = ymax - y2;  break;
+         }
+
+         if ( (d1 >= 0.0) != (d2 >= 0.0) )
+         {
+            double t = d1 / (d1 - d2);
+            outX.push_back ( x1 + t * (x2 - x1) );
+            outY.push_back ( y1 + t * (y2 - y1) );
+         }
+         if ( d2 >= 0.0 )
+         {
+            outX.push_back ( x2 );
+            outY.push_back ( y2 );
+         }
+      }
+   }
+
+   n = outX.size();
+   for ( k = 0; k < n; k++ )
+   {
+      area += outX[k] * outY[(k + 1) % n] - outX[(k + 1) % n] * outY[k];
+   }
+   return fabs ( area ) / 2.0;
+}
+
+
+/****************************************************************/
+/*   75. computePixelCoverageWeights                            */
+/*       fraction of each domain grid cell covered by each      */
+/*       image pixel.  The cell outline (4 points a side) is    */
+/*       projected into the image projection and clipped to the */
+/*       pixels under it, so the weights are exact up to the    */
+/*       curvature of the cell edges between those points.      */
+/****************************************************************/
+pixelCoverageWeights  computePixelCoverageWeights ( gridInfo grid, gridInfo imageInfo )
+{
+   const int              SIDE_POINTS = 4;
+   pixelCoverageWeights   weights;
+   projPJ                 proj4From, proj4To;
+   projUV                 xyP;
+   std::vector<int>       pixels;
+   std::vector<float>     fractions;
+   std::vector<double>    xs, ys;
+   int                    i, j, k, m, row, col;
+
+
+   printf ( "\nComputing pixel coverage of the domain grid cells...\n" );
+
+   proj4From = pj_init_plus ( grid.strProj4 );
+   proj4To = pj_init_plus ( imageInfo.strProj4 );
+   if ( proj4From == NULL || proj4To == NULL )
+   {
+      printf( "\tError: Initializing grid or image PROJ4 projection failed.\n" );
+      exit( 1 );
+   }
+
+   weights.cells = grid.rows * grid.cols;
+   weights.start = (int *) CPLCalloc ( sizeof(int), weights.cells + 1 );
+
+   //cell ID - 1 = row * cols + col with rows from the south edge
+   for ( i = 0; i < grid.rows; i++ )
+   {
+      for ( j = 0; j < grid.cols; j++ )
+      {
+         double  x0 = grid.xmin + j * grid.xCellSize;
+         double  y0 = grid.ymin + i * grid.yCellSize;
+         double  cx[4] = { x0, x0 + grid.xCellSize, x0 + grid.xCellSize, x0 };
+         double  cy[4] = { y0, y0, y0 + grid.yCellSize, y0 + grid.yCellSize };
+         double  bxmin = HUGE_VAL, bxmax = -HUGE_VAL, bymin = HUGE_VAL, bymax = -HUGE_VAL;
+         double  cellArea = 0.0;
+         bool    projected = true;
+
+         weights.start[i * grid.cols + j] = pixels.size();
+
+         xs.clear();
+         ys.clear();
+         for ( k = 0; k < 4 && projected; k++ )
+         {
+            for ( m = 0; m < SIDE_POINTS; m++ )
+            {
+               double t = (double) m / SIDE_POINTS;
+               xyP = projectPoint ( proj4From, proj4To, cx[k] + t * (cx[(k+1)%4] - cx[k]),
+                                    cy[k] + t * (cy[(k+1)%4] - cy[k]) );
+               if ( xyP.u == HUGE_VAL )
+               {
+                  projected = false;
+                  break;
+               }
+               xs.push_back ( xyP.u );
+               ys.push_back ( xyP.v );
+               bxmin = MIN ( bxmin, xyP.u );
+               bxmax = MAX ( bxmax, xyP.u );
+               bymin = MIN ( bymin, xyP.v );
+               bymax = MAX ( bymax, xyP.v );
+            }
+         }
+         if ( ! projected )
+         {
+            continue;   //cell cannot be placed on the image
+         }
+
+         for ( k = 0; k < (int) xs.size(); k++ )
+         {
+            m = (k + 1) % xs.size();
+            cellArea += xs[k] * ys[m] - xs[m] * ys[k];
+         }
+         cellArea = fabs ( cellArea ) / 2.0;
+         if ( cellArea <= 0.0 )
+         {
+            continue;
+         }
+
+         int row1 = MAX ( 0, (int) floor ( (bymin - imageInfo.ymin) / imageInfo.yCellSize ) );
+         int row2 = MIN ( imageInfo.rows - 1, (int) floor ( (bymax - imageInfo.ymin) / imageInfo.yCellSize ) );
+         int col1 = MAX ( 0, (int) floor ( (bxmin - imageInfo.xmin) / imageInfo.xCellSize ) );
+         int col2 = MIN ( imageInfo.cols - 1, (int) floor ( (bxmax - imageInfo.xmin) / imageInfo.xCellSize ) );
+
+         for ( row = row1; row <= row2; row++ )
+         {
+            double pymin = imageInfo.ymin + row * imageInfo.yCellSize;
+            for ( col = col1; col <= col2; col++ )
+            {
+               double pxmin = imageInfo.xmin + col * imageInfo.xCellSize;
+               double area = clippedPolygonArea ( xs, ys, pxmin, pymin,
+                                                  pxmin + imageInfo.xCellSize, pymin + imageInfo.yCellSize );
+               if ( area > 0.0 )
+               {
+                  pixels.push_back ( row * imageInfo.cols + col );
+                  fractions.push_back ( (float) (area / cellArea) );
+               }
+            }
+         }
+      }  //j
+   }  //i
+   weights.start[weights.cells] = pixels.size();
+
+   weights.pixel = (int *) CPLCalloc ( sizeof(int), MAX ( 1, pixels.size() ) );
+   weights.weight = (float *) CPLCalloc ( sizeof(float), MAX ( 1, fractions.size() ) );
+   for ( k = 0; k < (int) pixels.size(); k++ )
+   {
+      weights.pixel[k] = pixels[k];
+      weights.weight[k] = fractions[k];
+   }
+
+   pj_free ( proj4From );
+   pj_free ( proj4To );
+
+   printf ( "\tCell and pixel overlaps: %d\n", (int) pixels.size() );
+
+   return weights;
+}
+
+
+/****************************************************************/
+/*   76. freePixelCoverageWeights                               */
+/****************************************************************/
+void  freePixelCoverageWeights ( pixelCoverageWeights *weights )
+{
+   CPLFree ( weights->start );
+   CPLFree ( weights->pixel );
+   CPLFree ( weights->weight );
+   weights->start = NULL;
+   weights->pixel = NULL;
+   weights->weight = NULL;
+   weights->cells = 0;
+}
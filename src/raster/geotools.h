@@ -69,6 +69,42 @@ typedef struct _ncVarData {
   float        *floatData;
 } ncVarData;
 
+//part of a HDF4 satellite tile variable kept in its file data type
+typedef struct _satVarWindow {
+  int32        numType;     //HDF4 data type: DFNT_UINT8, DFNT_INT16, DFNT_FLOAT32 ...
+  int          row1;        //first tile row and column in the window
+  int          col1;
+  int          rows;        //window rows and columns
+  int          cols;
+  int          numP;        //values per pixel: 3 for MCD43A1 parameters
+  void         *data;       //rows*cols*numP values
+} satVarWindow;
+
+//fraction of each domain grid cell covered by the image pixels it overlaps,
+//stored by cell (ID - 1) with the pixels of cell i in start[i] to start[i+1]-1
+typedef struct _pixelCoverageWeights {
+  int          cells;       //domain grid cells
+  int          *start;      //cells+1 offsets into pixel and weight
+  int          *pixel;      //image pixel index, rows from the image south edge
+  float        *weight;     //fraction of the cell area in the pixel
+} pixelCoverageWeights;
+
+
+/**********************************
+*  get a window value as double   *
+***********************************/
+inline double getSatVarWindowValue ( satVarWindow *win, int index )
+{
+   switch ( win->numType )
+   {
+      case DFNT_UINT8:   return ( (uint8 *) win->data )[index];
+      case DFNT_INT8:    return ( (int8 *) win->data )[index];
+      case DFNT_INT16:   return ( (int16 *) win->data )[index];
+      case DFNT_FLOAT32: return ( (float32 *) win->data )[index];
+      default:           return ( (float64 *) win->data )[index];
+   }
+}
+
 
 /**********************************
 *        Functions                *
@@ -141,3 +177,10 @@ void getPointsInRasterValues (gridInfo grid,  std::vector<int> epicSiteIDs, std:
 int getNetCDFDim ( char * dimName, string fileName );
 string   extractDomainLAIData ( std::vector<string> modisFiles, std::vector<string> satVars, gridInfo grid);
 string   extractDomainALBData ( std::vector<string> modisFiles, std::vector<string> satVars, gridInfo grid);
+satVarWindow  readHDF4SatVarWindow ( string imageFile, string varName, gridInfo imageInfo, gridInfo grid );
+int      netCDFCreateMode ( int defaultMode );
+void     setNetCDFVarStorage ( int ncid, int var_id );
+string   getDomainGridRaster ( gridInfo grid, gridInfo rasterInfo );
+void     releaseDomainGridRaster ( string rasterFile );
+pixelCoverageWeights  computePixelCoverageWeights ( gridInfo grid, gridInfo imageInfo );
+void     freePixelCoverageWeights ( pixelCoverageWeights *weights );
@@ -1690,12 +1690,14 @@ INPUTS:  const char* fileName  Name of file to create.
          int create64BitFile   Create 64-bit NetCDF file?
 RETURNS: int NetCDF file ID if successful, else -1 if failed and a message is
          printed to stderr.
+NOTES:   NETCDF_OUTPUT_FORMAT overrides the format, see netCDFCreateMode().
 ******************************************************************************/
 
 static int createNetCDFFile( const char* fileName, int create64BitFile ) {
 
   int result = -1;
-  const int mode = create64BitFile ? NC_CLOBBER | NC_64BIT_OFFSET : NC_CLOBBER;
+  const int mode =
+    netCDFCreateMode( create64BitFile ? NC_CLOBBER | NC_64BIT_OFFSET : NC_CLOBBER );
   int ncid = -1;
 
   assert( fileName ); assert( *fileName );
@@ -1815,6 +1817,7 @@ static int createVariable( int file,
 
   if ( checkStatus( nc_def_var( file, name, type, dimensionality, dimensionIds, &id ),
                    "Can't create variable" ) ) {
+    setNetCDFVarStorage( file, id );
     if ( writeTextAttribute( file, id, "units", units ) ) {
       result = id;
     }
@@ -25,6 +25,12 @@
  *        DATADIR -- directory to store preprocessed images without overlapping.
  *        OUTPUT_NLCDFILES_LIST -- File which contains all output NLCD images with directories and names.
  *                     Only needed when program is called without arguments.
+ *
+ *        Optional environment variables:
+ *        NLCD_PP_FORMAT -- EHdr (default) to write a full BIL copy of each image, or
+ *                     VRT to write a GDAL VRT that reads the original image and only
+ *                     stores the masked overlapping windows in small BIL files.
+ *        NLCD_PP_THREADS -- number of images to build at the same time (default 1).
  */
 #include <iostream>
 #include <fstream>
@@ -33,12 +39,32 @@
 #include "gdal_priv.h"
 #include <ogr_spatialref.h>
 #include <vrtdataset.h>
+#include <pthread.h>
 
 #include "sa_raster.h"
 #include "commontools.h"
 
+//window of image i overlapping a previous image j
+typedef struct
+{
+   int    j;                  //index of the previous image
+   int    c_col, c_row;       //UL cell of the window in image i, from 0
+   int    p_col, p_row;       //UL cell of the window in image j, from 0
+   int    nXSize, nYSize;     //window size
+} overlapWindow;
+
+//an image to be preprocessed
+typedef struct
+{
+   string                      fileName;      //original image
+   string                      newFileName;   //preprocessed image
+   int                         xCells, yCells;
+   std::vector<overlapWindow>  windows;       //overlapping windows with previous images
+} nlcdImage;
+
 static void Usage();
 void  cleanOverlayCells ( std::vector<string> imageFiles, string fileType );
+void  buildNoOverlapImages ( std::vector<nlcdImage> &images, GByte NoDataValue );
 
 //define global variables
 string                newDataDir;             //new directory created under the first USGS landuse image directory
@@ -49,6 +75,8 @@ string                cgapType = "NOAA CGAP NLCD Landuse Files";
 std::ofstream         n_imageFile;            //output processed image file list
 OGRSpatialReference   oSRS_std;                     //set the first NLCD landuse image projection as the standard projection   
 double                xCellSize_std, yCellSize_std; //set the cell size of the first NLCD landuse image as the standard size
+bool                  vrtOutput = false;      //write VRT images instead of BIL copies
+int                   nThreads = 1;           //images built at the same time
 
 
 /************************************************************************/
@@ -119,6 +147,34 @@ int main( int nArgc,  char* papszArgv[] )
     n_dataFileList = trim( n_dataFileList );
     printf("Preprocessed NLCD image list file:  %s\n",n_dataFileList.c_str());
     FileExists(n_dataFileList.c_str(), 1 );  //the file has to be new.
+
+    //optional output format and number of threads
+    if ( getenv("NLCD_PP_FORMAT") != NULL )
+    {
+       string  ppFormat = string ( getenv("NLCD_PP_FORMAT") );
+       ppFormat = stringToUpper ( trim ( ppFormat ) );
+       if ( ppFormat.compare("VRT") == 0 )
+       {
+          vrtOutput = true;
+       }
+       else if ( ppFormat.compare("EHDR") != 0 && ppFormat.size() != 0 )
+       {
+          printf( "Error: NLCD_PP_FORMAT has to be EHdr or VRT: %s\n", ppFormat.c_str() );
+          exit ( 1 );
+       }
+    }
+    printf( "Preprocessed NLCD image format:  %s\n", vrtOutput ? "VRT" : "EHdr" );
+
+    if ( getenv("NLCD_PP_THREADS") != NULL )
+    {
+       nThreads = atoi ( getenv("NLCD_PP_THREADS") );
+       if ( nThreads < 1 )
+       {
+          printf( "Error: NLCD_PP_THREADS has to be a positive integer: %s\n", getenv("NLCD_PP_THREADS") );
+          exit ( 1 );
+       }
+    }
+    printf( "Images built at the same time:  %d\n", nThreads );
    
 /* -------------------------------------------------------------------- */
 /*     read in each NLCD images to get image vector for each data set  */
@@ -239,23 +295,22 @@ void   cleanOverlayCells ( std::vector<string> imageFiles, string fileType )
     string                pfileName;           //previous processed file name
     string                lineStr;             //a string line to write file
     string                cmd_str;             //command string for gdal_translate
-    int                   i,j,k,nPixelCount;
+    int                   i,j,k;
    
     //GDAL related
-    GDALDataset     *poRDataset, *p_poRDataset;
+    GDALDataset     *poRDataset;
     GDALDriver      *poDrive;
     char            **papszFileList;
-    GDALRasterBand  *poBand, *p_poBand;
+    GDALRasterBand  *poBand;
     double          adfGeoTransform[6];
     double          xUL,yUL;
     int             xCells, yCells, p_xCells, p_yCells; //cells 
     double          xCellSize, yCellSize; //cell size
     std::vector<double>   extXMin,extXMax;       //x extent of images
     std::vector<double>   extYMin,extYMax;       //y extent of images
+    std::vector<nlcdImage> images;               //images with their overlapping windows
     double          xmin,xmax,ymin,ymax;         //current image extent
     double          intpart;
-    GDALDriver      *p_poDrive;
-    const char      *pszFormat = "EHdr";
      
     const char      *pszWKT = NULL;
     char            *pszWKT_nc = NULL;
@@ -421,7 +476,7 @@ void   cleanOverlayCells ( std::vector<string> imageFiles, string fileType )
 
 /* -------------------------------------------------------------------- */
 /*   Create new no-overlaypping image name from image i in new data dir */
-/*   New images will be in EHdr -- ESRI .hdr Labelled format            */
+/*   New images will be in EHdr -- ESRI .hdr Labelled format or VRT     */
 /* -------------------------------------------------------------------- */
      newFileName = fileName;
      k = newFileName.rfind(".", newFileName.length());
@@ -436,7 +491,14 @@ void   cleanOverlayCells ( std::vector<string> imageFiles, string fileType )
      }
      newFileName = newFileName.substr(k+1);
      newFileName = newDataDir + newFileName;
-     newFileName.append(".bil");   //ESRI BIL format
+     if ( vrtOutput )
+     {
+        newFileName.append(".vrt");   //GDAL virtual image over the original
+     }
+     else
+     {
+        newFileName.append(".bil");   //ESRI BIL format
+     }
      //newFileName.append("_no");
      //newFileName.append(extStr);
      printf( "No-overlapping file: %s\n",newFileName.c_str() );
@@ -475,57 +537,25 @@ void   cleanOverlayCells ( std::vector<string> imageFiles, string fileType )
          printf( "Deleted the file: %s\n", newFileName.c_str() );
      }
 
-     //open the current i image and make a EHdr copy to store no-overlapping data
-     poRDataset = (GDALDataset *) GDALOpen( fileName.c_str(), GA_ReadOnly );
-     if( poRDataset == NULL )
-     {
-         printf( "Open raster file failed: %s.\n", fileName.c_str() );
-         exit( 1 );
-     }
-     p_poDrive = GetGDALDriverManager()->GetDriverByName(pszFormat);  //drive for EHdr
-     if ( (p_poRDataset = p_poDrive->CreateCopy(newFileName.c_str(), poRDataset, 
-                                              TRUE,NULL,GDALDummyProgress,NULL) )  == NULL )
-     {
-         printf( "Making a copy of the file failed: %s to %s\n", fileName.c_str(),newFileName.c_str() );
-         exit( 1 );
-     }
-     GDALClose( (GDALDatasetH) p_poRDataset );  //close due to may readable only
-     p_poRDataset = NULL;
-     GDALClose( (GDALDatasetH) poRDataset );
-     poRDataset = NULL;
+     //keep what the workers need to build the new image
+     nlcdImage  image;
+     image.fileName = fileName;
+     image.newFileName = newFileName;
+     image.xCells = xCells;
+     image.yCells = yCells;
 
 /* -------------------------------------------------------------------- */
-/*   Open the copied EHdr image i for updating                          */
-/* -------------------------------------------------------------------- */
-     poRDataset = (GDALDataset *) GDALOpen( newFileName.c_str(), GA_Update );
-     if( poRDataset == NULL )
-     {
-         printf( "Open raster file failed: %s.\n", newFileName.c_str() );
-         exit( 1 );
-     }
-    
-/* -------------------------------------------------------------------- */
-/*   Check each previous i-1 images to get rid of overlapping in image i*/
+/*   Find the overlapping windows with each previous i-1 images         */
 /* -------------------------------------------------------------------- */
      for ( j=0; j<i; j++)
      {
         //get previous image j
-        pfileName = imageFiles.at(j);
+        pfileName = images.at(j).fileName;
         printf( "\n    Previous File Names: %s\n",pfileName.c_str() );
-/* -------------------------------------------------------------------- */
-/*   Open previous processed EHdr image j and get rows and columns      */
-/* -------------------------------------------------------------------- */        
-        //open previous j image
-        p_poRDataset = (GDALDataset *) GDALOpen( pfileName.c_str(), GA_ReadOnly );
-        if( p_poRDataset == NULL )
-        {
-           printf( "Open raster file failed: %s.\n", pfileName.c_str() );
-           exit( 1 );
-        } 
 
         // get rows and columns of the image
-        p_xCells = p_poRDataset->GetRasterXSize();
-        p_yCells = p_poRDataset->GetRasterYSize();
+        p_xCells = images.at(j).xCells;
+        p_yCells = images.at(j).yCells;
         printf( "Pixel Size = %dx%d\n", p_xCells, p_yCells ); 
         printf( "extent:  min(%.3f,%.3f)   max(%.3f,%.3f)\n", extXMin.at(j),extYMin.at(j),extXMax.at(j),extYMax.at(j) ); 
 
@@ -644,108 +674,334 @@ void   cleanOverlayCells ( std::vector<string> imageFiles, string fileType )
               exit ( 1 );
            }
  
-/* -------------------------------------------------------------------- */
-/*         get the band 1 image from current image i                */
-/* -------------------------------------------------------------------- */
-           poBand = poRDataset->GetRasterBand( 1 );  // band 1
-           GByte *poImage = (GByte *) CPLCalloc(sizeof(GByte),c_nXSize*c_nYSize);
-           if ( (poBand->RasterIO(GF_Read, c_col1-1,c_row1-1,c_nXSize,c_nYSize,
-                 poImage,c_nXSize,c_nYSize,GDT_Byte,0,0)) == CE_Failure) 
-           {
-              printf( "Error: reading band 1 data error from image i: %s.\n", newFileName.c_str() );
-              CPLFree (poImage);
-              exit( 1 );
-           }
-           
-           /*
-           printf ( "Row=%d Col=%d\n", c_row1,c_col1);
-           double x = -2185199.6;
-           double y = 2370598.66;
-           int oCol = (int) (floor ((x - c_oXmin) / xCellSize_std) + 1);
-           int oRow = (int) (floor ((c_oYmax - y) / yCellSize_std) + 1);
-           k = (oRow - 1) * c_nXSize + oCol - 1;
-           printf("col=%d   row=%d   value=%d\n",oCol,oRow,(int) poImage[k]);
-           k = k -1;
-           printf("Left   value=%d\n",(int) poImage[k]);
-           k = k + 2;
-           printf("Right   value=%d\n",(int) poImage[k]);
-           k = k - 1 - c_nXSize;
-           printf("UP   value=%d\n",(int) poImage[k]);
-           k = k + 2*c_nXSize;
-           printf("Down   value=%d\n",(int) poImage[k]);
-           */
-           
-/* -------------------------------------------------------------------- */
-/*         get the band 1 image from previous image j                   */
-/* -------------------------------------------------------------------- */
-           p_poBand = p_poRDataset->GetRasterBand( 1 );  // band 1
-           GByte *p_poImage = (GByte *) CPLCalloc(sizeof(GByte),p_nXSize*p_nYSize);
-           if ( (p_poBand->RasterIO(GF_Read, p_col1-1,p_row1-1,p_nXSize,p_nYSize,
-                 p_poImage,p_nXSize,p_nYSize,GDT_Byte,0,0)) == CE_Failure)
-           {
-              printf( "Error: reading band 1 data error from image j: %s.\n", pfileName.c_str() );
-              CPLFree (p_poImage);
-              exit( 1 );
-           }
-
-           /*
-           printf ( "Row=%d Col=%d\n", p_row1,p_col1);
-           double x = -2022780.8;
-           double y = 2266528.93;
-           int oCol = (int) (floor ((x - oXmin) / xCellSize_std) + 1);   
-           int oRow = (int) (floor ((oYmax - y) / yCellSize_std) + 1);
-           k = (oRow - 1) * p_nXSize + oCol - 1;
-           printf("col=%d   row=%d   value=%d\n",oCol,oRow,(int) p_poImage[k]); 
-           k = k -1;
-           printf("Left   value=%d\n",(int) p_poImage[k]);
-           k = k + 2;
-           printf("Right   value=%d\n",(int) p_poImage[k]);
-           k = k - 1 - p_nXSize;
-           printf("UP   value=%d\n",(int) p_poImage[k]);
-           k = k + 2*p_nXSize;
-           printf("Down   value=%d\n",(int) p_poImage[k]);
-           */
-
-/* -------------------------------------------------------------------- */
-/*         Set image i cells with values in previous image j to NODATA  */
-/* -------------------------------------------------------------------- */
-           nPixelCount = c_nXSize * c_nYSize;   //total cells in overlapping box
-           for (k=0; k<nPixelCount; k++)
-           {
-               if (p_poImage[k] != NoDataValue)
-               {
-                  poImage[k] = NoDataValue;    
-               }
-           }
-           
-/* -------------------------------------------------------------------- */
-/*         write update box array back to current image i band          */
-/* -------------------------------------------------------------------- */
-           if ( (poBand->RasterIO(GF_Write, c_col1-1,c_row1-1,c_nXSize,c_nYSize,
-                 poImage,c_nXSize,c_nYSize,GDT_Byte,0,0)) == CE_Failure)
-           {  
-              printf( "Error: Writing band 1 data error to image i: %s.\n", newFileName.c_str() );
-              CPLFree (poImage);
-              exit( 1 );
-           }
-      
-           CPLFree (poImage);
-           CPLFree (p_poImage); 
-
-        }  //end of overlapping processing
+           overlapWindow  window;
+           window.j = j;
+           window.c_col = c_col1 - 1;
+           window.c_row = c_row1 - 1;
+           window.p_col = p_col1 - 1;
+           window.p_row = p_row1 - 1;
+           window.nXSize = c_nXSize;
+           window.nYSize = c_nYSize;
+           image.windows.push_back ( window );
+
+        }  //end of overlapping box
         else
         {
            printf ("j=%d image does not intersect.\n",j);
         }
-     
-        GDALClose( (GDALDatasetH) p_poRDataset );
      } //end of j
 
-    poRDataset->FlushCache();
-    GDALClose( (GDALDatasetH) poRDataset );
+     images.push_back ( image );
 
    }  //end of i
 
+/* -------------------------------------------------------------------- */
+/*   Build the new images.  Each image is only masked by the original   */
+/*   images before it, so the images are independent of each other.    */
+/* -------------------------------------------------------------------- */
+   buildNoOverlapImages ( images, NoDataValue );
+
    printf ("Finished preprocessing images: %s\n",fileType.c_str());
 }  //end of the function
 
+/************************************************************************/
+/*    maskOverlapWindow ( image, window, buffer, NoDataValue )          */
+/*    read a window of original image i and set the cells that have    */
+/*    data in any previous original image to NODATA.  Returns the      */
+/*    number of cells set to NODATA.                                    */
+/************************************************************************/
+
+static int maskOverlapWindow ( std::vector<nlcdImage> &images, int i, overlapWindow &w, 
+                               GDALRasterBand *poBand, GByte *poImage, GByte NoDataValue )
+{
+    GDALDataset     *p_poRDataset;
+    GDALRasterBand  *p_poBand;
+    GByte           *p_poImage;
+    nlcdImage       &image = images.at(i);
+    int             k, row, col, nMasked = 0;
+
+
+    if ( (poBand->RasterIO(GF_Read, w.c_col,w.c_row,w.nXSize,w.nYSize,
+          poImage,w.nXSize,w.nYSize,GDT_Byte,0,0)) == CE_Failure) 
+    {
+       printf( "Error: reading band 1 data error from image i: %s.\n", image.fileName.c_str() );
+       exit( 1 );
+    }
+
+    //a previous image masks the window where its own window meets this one
+    for ( k=0; k<image.windows.size(); k++ )
+    {
+       overlapWindow  &v = image.windows.at(k);
+
+       int col1 = MAX ( w.c_col, v.c_col );
+       int row1 = MAX ( w.c_row, v.c_row );
+       int col2 = MIN ( w.c_col + w.nXSize, v.c_col + v.nXSize );
+       int row2 = MIN ( w.c_row + w.nYSize, v.c_row + v.nYSize );
+       if ( col1 >= col2 || row1 >= row2 )
+       {
+          continue;
+       }
+       int nXSize = col2 - col1;
+       int nYSize = row2 - row1;
+
+       p_poRDataset = (GDALDataset *) GDALOpen( images.at(v.j).fileName.c_str(), GA_ReadOnly );
+       if( p_poRDataset == NULL )
+       {
+          printf( "Open raster file failed: %s.\n", images.at(v.j).fileName.c_str() );
+          exit( 1 );
+       } 
+       p_poBand = p_poRDataset->GetRasterBand( 1 );  // band 1
+       p_poImage = (GByte *) CPLCalloc(sizeof(GByte),nXSize*nYSize);
+       if ( (p_poBand->RasterIO(GF_Read, v.p_col + col1 - v.c_col, v.p_row + row1 - v.c_row, nXSize,nYSize,
+             p_poImage,nXSize,nYSize,GDT_Byte,0,0)) == CE_Failure)
+       {
+          printf( "Error: reading band 1 data error from image j: %s.\n", images.at(v.j).fileName.c_str() );
+          CPLFree (p_poImage);
+          exit( 1 );
+       }
+
+       for ( row=0; row<nYSize; row++ )
+       {
+          GByte  *p_line = p_poImage + row * nXSize;
+          GByte  *line = poImage + (row1 - w.c_row + row) * w.nXSize + col1 - w.c_col;
+          for ( col=0; col<nXSize; col++ )
+          {
+             if ( p_line[col] != NoDataValue && line[col] != NoDataValue )
+             {
+                line[col] = NoDataValue;
+                nMasked++;
+             }
+          }
+       }
+
+       CPLFree (p_poImage);
+       GDALClose( (GDALDatasetH) p_poRDataset );
+    }
+
+    return nMasked;
+}
+
+
+/************************************************************************/
+/*    buildNoOverlapImage ( images, i, NoDataValue )                    */
+/*    write image i without the cells covered by previous images       */
+/************************************************************************/
+
+static void buildNoOverlapImage ( std::vector<nlcdImage> &images, int i, GByte NoDataValue )
+{
+    GDALDataset     *poRDataset, *n_poRDataset, *w_poRDataset;
+    GDALRasterBand  *poBand, *n_poBand, *w_poBand;
+    GDALDriver      *poDrive;
+    nlcdImage       &image = images.at(i);
+    double          adfGeoTransform[6];
+    int             k, nPatches = 0, bSuccess;
+
+
+    //a VRT refers to the original image by its full path
+    string  fileName = image.fileName;
+    if ( vrtOutput && CPLIsFilenameRelative( fileName.c_str() ) )
+    {
+       char  *pszCurrentDir = CPLGetCurrentDir();
+       fileName = string ( CPLFormFilename( pszCurrentDir, fileName.c_str(), NULL ) );
+       CPLFree (pszCurrentDir);
+    }
+
+    poRDataset = (GDALDataset *) GDALOpen( fileName.c_str(), GA_ReadOnly );
+    if( poRDataset == NULL )
+    {
+       printf( "Open raster file failed: %s.\n", fileName.c_str() );
+       exit( 1 );
+    }
+    poBand = poRDataset->GetRasterBand( 1 );  // band 1
+    poRDataset->GetGeoTransform( adfGeoTransform );
+
+/* -------------------------------------------------------------------- */
+/*   EHdr: copy image i and write the masked windows into the copy      */
+/*   VRT:  read image i through a VRT that places the masked windows    */
+/*         over it, so cells outside the windows are not copied         */
+/* -------------------------------------------------------------------- */
+    if ( ! vrtOutput )
+    {
+       poDrive = GetGDALDriverManager()->GetDriverByName("EHdr");
+       if ( (n_poRDataset = poDrive->CreateCopy(image.newFileName.c_str(), poRDataset, 
+                                                TRUE,NULL,GDALDummyProgress,NULL) )  == NULL )
+       {
+          printf( "Making a copy of the file failed: %s to %s\n", image.fileName.c_str(),image.newFileName.c_str() );
+          exit( 1 );
+       }
+       n_poBand = n_poRDataset->GetRasterBand( 1 );
+    }
+    else
+    {
+       poDrive = GetGDALDriverManager()->GetDriverByName("VRT");
+       if ( (n_poRDataset = poDrive->Create(image.newFileName.c_str(), image.xCells, image.yCells, 
+                                            0, GDT_Byte, NULL) ) == NULL )
+       {
+          printf( "Creating VRT file failed: %s\n", image.newFileName.c_str() );
+          exit( 1 );
+       }
+       n_poRDataset->SetGeoTransform( adfGeoTransform );
+       n_poRDataset->SetProjection( poRDataset->GetProjectionRef() );
+       n_poRDataset->AddBand( GDT_Byte, NULL );
+       n_poBand = n_poRDataset->GetRasterBand( 1 );
+
+       double noData = poBand->GetNoDataValue( &bSuccess );
+       if ( bSuccess )
+       {
+          n_poBand->SetNoDataValue( noData );
+       }
+       if ( poBand->GetColorTable() != NULL )
+       {
+          n_poBand->SetColorTable( poBand->GetColorTable() );
+       }
+       n_poBand->SetColorInterpretation( poBand->GetColorInterpretation() );
+
+       ((VRTSourcedRasterBand *) n_poBand)->AddSimpleSource( poBand, 0, 0, image.xCells, image.yCells,
+                                                             0, 0, image.xCells, image.yCells );
+    }
+
+    for ( k=0; k<image.windows.size(); k++ )
+    {
+       overlapWindow  &w = image.windows.at(k);
+       GByte  *poImage = (GByte *) CPLCalloc(sizeof(GByte),w.nXSize*w.nYSize);
+
+       //untouched windows are left as they are in the original image
+       if ( maskOverlapWindow ( images, i, w, poBand, poImage, NoDataValue ) == 0 )
+       {
+          CPLFree (poImage);
+          continue;
+       }
+
+       if ( ! vrtOutput )
+       {
+          w_poBand = n_poBand;
+       }
+       else
+       {
+          //store the window in a BIL file next to the VRT
+          string  windowFileName = image.newFileName;
+          char    tmp_char[30];
+          windowFileName.erase( windowFileName.rfind(".") );
+          sprintf( tmp_char, "_w%d.bil", nPatches + 1 );
+          windowFileName.append( tmp_char );
+
+          poDrive = GetGDALDriverManager()->GetDriverByName("EHdr");
+          if ( (w_poRDataset = poDrive->Create(windowFileName.c_str(), w.nXSize, w.nYSize, 
+                                               1, GDT_Byte, NULL) ) == NULL )
+          {
+             printf( "Creating window file failed: %s\n", windowFileName.c_str() );
+             exit( 1 );
+          }
+          double  w_adfGeoTransform[6];
+          memcpy ( w_adfGeoTransform, adfGeoTransform, sizeof(adfGeoTransform) );
+          w_adfGeoTransform[0] = adfGeoTransform[0] + w.c_col * adfGeoTransform[1];
+          w_adfGeoTransform[3] = adfGeoTransform[3] + w.c_row * adfGeoTransform[5];
+          w_poRDataset->SetGeoTransform( w_adfGeoTransform );
+          w_poRDataset->SetProjection( poRDataset->GetProjectionRef() );
+          w_poBand = w_poRDataset->GetRasterBand( 1 );
+       }
+
+       if ( (w_poBand->RasterIO(GF_Write, vrtOutput ? 0 : w.c_col, vrtOutput ? 0 : w.c_row, w.nXSize,w.nYSize,
+             poImage,w.nXSize,w.nYSize,GDT_Byte,0,0)) == CE_Failure)
+       {  
+          printf( "Error: Writing band 1 data error to image i: %s.\n", image.newFileName.c_str() );
+          CPLFree (poImage);
+          exit( 1 );
+       }
+       CPLFree (poImage);
+
+       if ( vrtOutput )
+       {
+          w_poRDataset->FlushCache();
+          ((VRTSourcedRasterBand *) n_poBand)->AddSimpleSource( w_poBand, 0, 0, w.nXSize, w.nYSize,
+                                                                w.c_col, w.c_row, w.nXSize, w.nYSize );
+          GDALClose( (GDALDatasetH) w_poRDataset );  //the VRT keeps its own reference
+       }
+       nPatches++;
+    }
+
+    n_poRDataset->FlushCache();
+    GDALClose( (GDALDatasetH) n_poRDataset );
+    GDALClose( (GDALDatasetH) poRDataset );
+
+    printf( "Built %s: %d overlapping windows, %d masked\n", image.newFileName.c_str(), 
+            (int) image.windows.size(), nPatches );
+}
+
+
+/************************************************************************/
+/*    threads building the images                                       */
+/************************************************************************/
+
+typedef struct
+{
+   std::vector<nlcdImage>  *images;
+   GByte                   NoDataValue;
+   int                     next;          //next image to build
+   pthread_mutex_t         lock;
+} imageQueue;
+
+static void *buildImageThread ( void *arg )
+{
+    imageQueue  *queue = (imageQueue *) arg;
+    int         i;
+
+
+    while ( true )
+    {
+       pthread_mutex_lock ( &queue->lock );
+       i = queue->next++;
+       pthread_mutex_unlock ( &queue->lock );
+
+       if ( i >= queue->images->size() )
+       {
+          break;
+       }
+       buildNoOverlapImage ( *queue->images, i, queue->NoDataValue );
+    }
+
+    return NULL;
+}
+
+
+/************************************************************************/
+/*    buildNoOverlapImages ( images, NoDataValue )                      */
+/************************************************************************/
+
+void buildNoOverlapImages ( std::vector<nlcdImage> &images, GByte NoDataValue )
+{
+    imageQueue  queue;
+    pthread_t   *threads;
+    int         i, n;
+
+
+    queue.images = &images;
+    queue.NoDataValue = NoDataValue;
+    queue.next = 0;
+    pthread_mutex_init ( &queue.lock, NULL );
+
+    n = MIN ( nThreads, (int) images.size() );
+    if ( n <= 1 )
+    {
+       buildImageThread ( &queue );
+    }
+    else
+    {
+       threads = (pthread_t *) CPLCalloc(sizeof(pthread_t), n);
+       for ( i=0; i<n; i++ )
+       {
+          if ( pthread_create ( &threads[i], NULL, buildImageThread, &queue ) != 0 )
+          {
+             printf( "Error: starting thread %d to build images\n", i+1 );
+             exit( 1 );
+          }
+       }
+       for ( i=0; i<n; i++ )
+       {
+          pthread_join ( threads[i], NULL );
+       }
+       CPLFree (threads);
+    }
+
+    pthread_mutex_destroy ( &queue.lock );
+}
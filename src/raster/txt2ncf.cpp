@@ -502,7 +502,7 @@ int main(int argc, char *argv[])
 	* Enter define mode *
 	********************/
         int ncid;
-	anyErrors( nc_create(outputFile, NC_CLOBBER, &ncid) );
+	anyErrors( nc_create(outputFile, netCDFCreateMode ( NC_CLOBBER ), &ncid) );
 
 	/********************
 	* Define dimensions *
@@ -547,25 +547,31 @@ int main(int argc, char *argv[])
         dims2_x[0] = time_dim;
         dims2_x[1] = west_east_dim;
 	anyErrors( nc_def_var(ncid, "X_M", NC_FLOAT, 2, dims2_x, &x_id) );
+	setNetCDFVarStorage ( ncid, x_id );
 
         dims2_y[0] = time_dim;
 	dims2_y[1] = south_north_dim;
 	anyErrors( nc_def_var(ncid, "Y_M", NC_FLOAT, 2, dims2_y, &y_id) );
+	setNetCDFVarStorage ( ncid, y_id );
 
         dims3[0] = time_dim;
         dims3[1] = south_north_dim;
         dims3[2] = west_east_dim;
         anyErrors( nc_def_var(ncid, "XLONG_M", NC_FLOAT, 3, dims3, &lon_id) );
+        setNetCDFVarStorage ( ncid, lon_id );
         anyErrors( nc_def_var(ncid, "XLAT_M", NC_FLOAT, 3, dims3, &lat_id) );
+        setNetCDFVarStorage ( ncid, lat_id );
      
         if ( INCLUDE_IMPERV )
         {
 	   anyErrors( nc_def_var(ncid, "IMPERV", NC_FLOAT, 3, dims3, &imperv_id) );
+	   setNetCDFVarStorage ( ncid, imperv_id );
         }
        
         if ( INCLUDE_CANOPY )
         { 
 	  anyErrors( nc_def_var(ncid, "CANOPY", NC_FLOAT, 3, dims3, &canopy_id) );
+	  setNetCDFVarStorage ( ncid, canopy_id );
         }
 
         if ( INCLUDE_LANDUSE )
@@ -579,12 +585,15 @@ int main(int argc, char *argv[])
            dims4[2] = south_north_dim;
            dims4[3] = west_east_dim;
 	   anyErrors( nc_def_var(ncid, "LANDUSEF", NC_FLOAT, 4, dims4, &luf_id) );
+	   setNetCDFVarStorage ( ncid, luf_id );
            printf( "Defined luf\n" );
 
 	   anyErrors( nc_def_var(ncid, "LANDMASK", NC_FLOAT, 3, dims3, &lum_id) );
+	   setNetCDFVarStorage ( ncid, lum_id );
            printf( "Defined lum\n" );
 
 	   anyErrors( nc_def_var(ncid, "LU_INDEX", NC_FLOAT, 3, dims3, &lud_id) );
+	   setNetCDFVarStorage ( ncid, lud_id );
            printf( "Defined lud\n" );
 
         }
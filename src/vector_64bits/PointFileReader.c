@@ -11,6 +11,15 @@
  *
  * Modified 5/3/2005 to add file "chunking"
  * Modified 5/24/2005 added ability to read csv files with quoted strings 
+ *
+ * The file is mapped into memory (read into a buffer where mmap is not
+ * available) and read in one pass: the rows of the current chunk are
+ * found first, then the coordinates and attributes of each row are
+ * parsed together, by POINT_FILE_THREADS threads when that is set, and
+ * the coordinates are projected in one batch.  The shapes are built by
+ * the calling thread since the node allocator is not thread-safe.  When
+ * MAX_INPUT_FILE_SHAPES is set each call reads the next range of rows,
+ * starting at the byte offset where the previous chunk ended.
  ****************************************************************************/
 
 #include <stdio.h>
@@ -22,49 +31,387 @@
 #else
 #include <malloc.h>
 #endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
 #include "shapefil.h"
 #include "mims_spatl.h"
 #include "mims_evs.h"
 #include "parms3.h"
 #include "io.h"
 
-fpos_t filePosition; /* global added to allow for file "chunking" */
+long filePosition; /* byte offset of the next chunk, for file "chunking" */
 int window;
 
+/* rows per thread below which the rows are parsed in one thread */
+#define POINT_ROWS_PER_THREAD 4096
+
+/* what is known about the file while its rows are being parsed */
+typedef struct _PointCSV {
+    char *buf;              /* the file contents */
+    long len;
+    char d;                 /* field delimiter */
+    int xcol, ycol;         /* columns holding the coordinates */
+    int nattr;              /* attributes kept for each row */
+    int *attrCol;           /* column of each attribute */
+    int stringItems;        /* 1 for string attributes, 0 for doubles */
+    int nrows;
+    long *rowStart;         /* offset of each row in buf */
+    int maxLine;            /* longest row, in bytes */
+    double *x, *y;          /* coordinates of each row */
+    AttributeValue **attr_val;
+} PointCSV;
+
+/* one thread's share of the rows */
+typedef struct _PointTask {
+    PointCSV *csv;
+    int first, last;        /* rows first through last - 1 */
+    int coordErr;           /* first row with a bad coordinate, or -1 */
+    int attrErr;            /* first row with a bad attribute, or -1 */
+    char coordMesg[300];
+    char attrMesg[300];
+} PointTask;
+
+
+/* ============================================================= */
+/* Return the contents of fname and its length.  *mapped is set when the
+ * contents were mapped rather than read. */
+static char *loadPointFile(char *fname, long *len, int *mapped)
+{
+    FILE *ifp;
+    char *buf;
+    long n;
+
+    *mapped = 0;
+#ifndef _WIN32
+    {
+        struct stat st;
+        int fd;
+
+        if((fd = open(fname, O_RDONLY)) >= 0)
+        {
+            if(fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                buf = (char *) mmap(NULL, (size_t) st.st_size, PROT_READ,
+                                    MAP_PRIVATE, fd, 0);
+                if(buf != (char *) MAP_FAILED)
+                {
+                    close(fd);
+                    *len = (long) st.st_size;
+                    *mapped = 1;
+                    return buf;
+                }
+            }
+            close(fd);
+        }
+    }
+#endif
+
+    if((ifp = fopen(fname, "rb")) == NULL)
+    {
+        return NULL;
+    }
+    fseek(ifp, 0L, SEEK_END);
+    n = ftell(ifp);
+    fseek(ifp, 0L, SEEK_SET);
+    buf = (char *) malloc(n > 0 ? n : 1);
+    if(buf == NULL || (n > 0 && fread(buf, 1, n, ifp) != (size_t) n))
+    {
+        free(buf);
+        fclose(ifp);
+        return NULL;
+    }
+    fclose(ifp);
+    *len = n;
+    return buf;
+}
+
+
+/* ============================================================= */
+static void unloadPointFile(char *buf, long len, int mapped)
+{
+#ifndef _WIN32
+    if(mapped)
+    {
+        munmap(buf, (size_t) len);
+        return;
+    }
+#endif
+    free(buf);
+}
+
+
+/* ============================================================= */
+/* Offset of the end of the line starting at pos, before its '\n' */
+static long lineEnd(char *buf, long len, long pos)
+{
+    char *eol = (char *) memchr(buf + pos, '\n', (size_t) (len - pos));
+
+    return eol ? (long) (eol - buf) : len;
+}
+
+
+/* ============================================================= */
+/* Trim the line [*start, *end) as trim() in io.c would */
+static void trimLine(char *buf, long *start, long *end)
+{
+    while(*start < *end && (buf[*start] == ' ' || buf[*start] == '\t'))
+    {
+        (*start)++;
+    }
+    while(*end > *start && (buf[*end - 1] == ' ' || buf[*end - 1] == '\t' ||
+                            buf[*end - 1] == '\n' || buf[*end - 1] == '\r'))
+    {
+        (*end)--;
+    }
+}
+
+
+/* ============================================================= */
+/* Copy the next field of [*pos, end) into field, dropping the quotes,
+ * and leave *pos past its delimiter.  Returns 0 once the line is done. */
+static int nextField(char *buf, long *pos, long end, char d, char *field,
+                     int *more)
+{
+    int i = 0;
+    int insideQuote = FALSE;
+    long p = *pos;
+
+    if(!*more)
+    {
+        return 0;
+    }
+    *more = 0;
+    while(p < end)
+    {
+        if(buf[p] == d && insideQuote == FALSE)
+        {
+            p++;
+            *more = 1;
+            break;
+        }
+        else if(buf[p] == '"')
+        {
+            insideQuote = !insideQuote;
+        }
+        else
+        {
+            field[i++] = buf[p];
+        }
+        p++;
+    }
+    field[i] = '\0';
+    *pos = p;
+    return 1;
+}
+
+
+/* ============================================================= */
+/* Parse the coordinates and attributes of rows first to last - 1 */
+static void parsePointRows(PointTask *task)
+{
+    PointCSV *csv = task->csv;
+    char *field;
+    long pos, end;
+    int r, s, count, more, gotx, goty;
+    AttributeValue *av;
+
+    task->coordErr = task->attrErr = -1;
+    field = (char *) malloc(csv->maxLine + 1);
+    if(field == NULL)
+    {
+        task->coordErr = task->first;
+        strcpy(task->coordMesg, "Unable to allocate memory for point file rows");
+        return;
+    }
+
+    for(r = task->first; r < task->last; r++)
+    {
+        av = (AttributeValue *) malloc(MAX(1, csv->nattr) *
+                                       sizeof(AttributeValue));
+        csv->attr_val[r] = av;
+        if(av == NULL)
+        {
+            task->coordErr = r;
+            strcpy(task->coordMesg,
+                   "Unable to allocate memory for point file attributes");
+            break;
+        }
+        for(s = 0; s < csv->nattr; s++)
+        {
+            av[s].str = NULL;
+        }
+
+        pos = csv->rowStart[r];
+        end = lineEnd(csv->buf, csv->len, pos);
+        trimLine(csv->buf, &pos, &end);
+
+        gotx = goty = 0;
+        more = 1;
+        count = 0;
+        while(nextField(csv->buf, &pos, end, csv->d, field, &more))
+        {
+            if(count == csv->xcol || count == csv->ycol)
+            {
+                if(digiCheck(field))
+                {
+                    if(task->coordErr < 0)
+                    {
+                        task->coordErr = r;
+                        sprintf(task->coordMesg, "%.200s is non-numeric "
+                                "and cannot be used to define a coordinate",
+                                field);
+                    }
+                }
+                else if(count == csv->xcol)
+                {
+                    csv->x[r] = atof(field);
+                    gotx = 1;
+                }
+                else
+                {
+                    csv->y[r] = atof(field);
+                    goty = 1;
+                }
+            }
+
+            for(s = 0; s < csv->nattr; s++)
+            {
+                if(csv->attrCol[s] != count)
+                {
+                    continue;
+                }
+                if(csv->stringItems)
+                {
+                    av[s].str = (char *) strdup(field);
+                }
+                else if(digiCheck(field))
+                {
+                    /* doubles are needed for allocation */
+                    if(task->attrErr < 0)
+                    {
+                        task->attrErr = r;
+                        sprintf(task->attrMesg, "%.200s is non-numeric and "
+                                "cannot be used for ALLOCATE mode", field);
+                    }
+                }
+                else
+                {
+                    av[s].val = atof(field);
+                }
+            }
+            count++;
+        }
+
+        if((!gotx || !goty) && task->coordErr < 0)
+        {
+            task->coordErr = r;
+            strcpy(task->coordMesg,
+                   "Point file row is missing a coordinate column");
+        }
+    }
+
+    free(field);
+}
+
+
+/* ============================================================= */
+/* parse the rows of task t; run by runTasks */
+static void parsePointTask(void *arg, int t, int thread)
+{
+    parsePointRows(&((PointTask *) arg)[t]);
+}
+
+
+/* ============================================================= */
+/* Parse all of the rows in csv, splitting them among the threads.
+ * Errors are reported for the first bad row, as a serial read would. */
+static void parsePointFile(PointCSV *csv)
+{
+    PointTask *task;
+    extern char *prog_name;
+    int i, n, err;
+
+    n = envThreads(ENVT_POINT_FILE_THREADS);
+    if(n > csv->nrows / POINT_ROWS_PER_THREAD)
+    {
+        n = MAX(1, csv->nrows / POINT_ROWS_PER_THREAD);
+    }
+
+    task = (PointTask *) malloc(n * sizeof(PointTask));
+    if(task == NULL)
+    {
+        ERROR(prog_name, "Unable to allocate memory for point file rows", 2);
+    }
+    for(i = 0; i < n; i++)
+    {
+        task[i].csv = csv;
+        task[i].first = (int) ((double) csv->nrows * i / n);
+        task[i].last = (int) ((double) csv->nrows * (i + 1) / n);
+    }
+
+    runTasks(n, n, parsePointTask, task);
+
+    /* the tasks are in row order, so the first error found is the one
+     * a serial read would have stopped at */
+    for(err = 0; err < 2; err++)
+    {
+        for(i = 0; i < n; i++)
+        {
+            if(err == 0 && task[i].coordErr >= 0)
+            {
+                ERROR(prog_name, task[i].coordMesg, 2);
+            }
+            if(err == 1 && task[i].attrErr >= 0)
+            {
+                ERROR(prog_name, task[i].attrMesg, 2);
+            }
+        }
+    }
+    free(task);
+}
+
+
+/* ============================================================= */
+/* Is the line at [pos, end) a data row: not a comment and not blank */
+static int isPointRow(char *buf, long pos, long end)
+{
+    if(pos < end && buf[pos] == '#')
+    {
+        return 0;
+    }
+    trimLine(buf, &pos, &end);
+    return end > pos;
+}
+
+
 PolyObject *PointFileReader(char *ename, MapProjInfo *file_mapproj, 
                        MapProjInfo *output_mapproj)
 {
-
-    FILE *ifp;
-    
     PolyObject *poly;
     PolyShape *ps;
-    AttributeHeader *aheader;
-    AttributeValue *tmpAV;
     Shape *shp;
+    PointCSV csv;
     extern char *prog_name;
     extern int fileCompleted;
     extern int maxShapes;
-    char pointFileName[256], mesg[256], lineBuffer[1024];
-    char trimBuffer[1024], *tBuf;
-    char overlayAttrs[256], mimsMode[100];
-    char xc[25], yc[25];
-    char **data, *tmpString, *ptr, *dbCheck;
+    char pointFileName[256], mesg[300];
+    char mimsMode[100];
+    char xc[256], yc[256];
     char **header;
     char **attribList;
-    int i, j,  count, numPoints;
-    bool insideQuote, getAllAttribs;
-    int xcol = -1;
-    int ycol = -1;
+    char *field;
+    int i, count, more, rowCap;
+    bool getAllAttribs;
     int ncnt, nmax, hc, matched;
-    int nObjects, numFields, numRecords, nShapeType;
+    int numFields, mapped;
+    long pos, end, headerEnd;
 
-    char de[24], delimiter[10], d;
-    char *running, tempString[256];
- 
-    double projx, projy;
-
-    PointFileIndex *pfIndex;
+    char de[24], d;
     int  StringItems;  // = 1 set String items and = 0 set Double items
 
     /* read in name of column not number */
@@ -96,27 +443,22 @@ PolyObject *PointFileReader(char *ename, MapProjInfo *file_mapproj,
 
     if(!strcmp(de, "COMMA"))
     {
-          strcpy(delimiter, ",");
           d = ',';
     }
     else if(!strcmp(de, "SEMICOLON"))
     {
-          strcpy(delimiter, ";");
           d = ';';
     }
     else if(!strcmp(de, "PIPE"))
     {
-          strcpy(delimiter, "|");
           d = '|';
     }
     /* add other delimiters here */
     else
     {
           /* no delimiter specified so use a space */
-          strcpy(delimiter, " ");
           d = ' ';
     }
-    /*printf("Delimiter is:%s or [%s]\n", de, delimiter);*/
 
 
     if(!getEnvtValue(ENVT_INPUT_FILE_NAME, pointFileName))
@@ -154,236 +496,103 @@ PolyObject *PointFileReader(char *ename, MapProjInfo *file_mapproj,
     }
 
 
-    if((ifp = fopen(pointFileName, "r")) == NULL)
+    if((csv.buf = loadPointFile(pointFileName, &csv.len, &mapped)) == NULL)
     {
         sprintf(mesg,"Unable to read %s\n", pointFileName);
         ERROR(prog_name, mesg, 2);
     }
+    csv.d = d;
 
-    /* do a quick reconnoiter of the file */
-    /* ignore comments in files */
-    numFields = 0;
-
-    do
+    /* the header is the first line that is not a comment */
+    pos = 0;
+    end = lineEnd(csv.buf, csv.len, pos);
+    while(pos < csv.len && csv.buf[pos] == '#')
     {
-        fgets(lineBuffer, sizeof(lineBuffer), ifp);
+        pos = end + 1;
+        end = pos < csv.len ? lineEnd(csv.buf, csv.len, pos) : csv.len;
     }
-    while(lineBuffer[0] == '#');
-
-       
-    trim(lineBuffer, trimBuffer);
-    ptr = trimBuffer;
-    insideQuote = FALSE;
- 
-    while(ptr[0] != '\0')
-    {
-        if(ptr[0] == d && insideQuote == FALSE)
-        {
-            numFields++;
-        }
-        else if(ptr[0] == '"' && insideQuote)
-        {
-            insideQuote = FALSE;
-        }
-        else if(ptr[0] == '"' && !insideQuote)
-        {
-            insideQuote = TRUE;
-        }
-        ptr++;
-    } 
-    numFields++;
-    /*printf("numFields=%d\n", numFields);*/
-   
-    if(numFields == 0)
+    if(pos >= csv.len)
     {
         sprintf(mesg, "Formatting error encountered in %s", 
                              pointFileName);
         ERROR(prog_name, mesg, 2);
     }
+    headerEnd = end + 1;
+    trimLine(csv.buf, &pos, &end);
 
-
-    /* this if block is here and not above only because
-       numFields was unknown before this point */
-    if(!strcmp(attribList[0], "ALL") )
+    field = (char *) malloc(end - pos + 1);
+    header = (char **) malloc((end - pos + 1) * sizeof(char *));
+    if(field == NULL || header == NULL)
     {
-        getAllAttribs = TRUE;
-        /* change ncnt to total # of fields in point file */
-        ncnt = numFields;
+        ERROR(prog_name, "Unable to allocate memory for point file header", 2);
     }
-    else
-    {
-        getAllAttribs = FALSE;
-    }
-
-
-    pfIndex = malloc(ncnt * sizeof(PointFileIndex));
- 
-    /* malloc an array for header names */
-    header = (char **) malloc(numFields * sizeof(char *));
-    /*printf("malloced for header\n");*/
-         
-    poly = getNewPoly(0);
 
-    if(!poly->attr_hdr)
-    {
-        poly->attr_hdr = getNewAttrHeader();
-    }
-    /*printf("got new attr header\n");*/
-
-
-    tBuf = trimBuffer;
-
-    insideQuote = 0;
-    i = 0;
-    count = 0;
-   
-    while(tBuf[0] != '\0')
+    numFields = 0;
+    more = 1;
+    csv.xcol = csv.ycol = -1;
+    while(nextField(csv.buf, &pos, end, d, field, &more))
     {
-        if(tBuf[0] == d && insideQuote == FALSE)
-        {
-             tempString[i] = '\0';
-             i = 0;
-             /*printf("PointFileReader tempString=%s count=%d\n", 
-                    tempString, count);*/
-
-             header[count] = (char *) strdup(tempString);
-             
-             if(!strcmp(header[count], xc))
-             {
-                 xcol = count;
-             }
-             else if(!strcmp(header[count], yc))
-             {
-                 ycol = count;
-             }
-
-             if(getAllAttribs)
-             {
-                 if (StringItems)
-                 {
-                      addNewAttrHeader(poly->attr_hdr, header[count], FTString);
-                 }
-                 else
-                 {
-                       addNewAttrHeader(poly->attr_hdr, header[count], FTDouble);
-                 }
-             }
-             count++;
-        }
-        else if(tBuf[0] == '"' && insideQuote == FALSE)
-        {
-             insideQuote = TRUE;
-
-        }
-        else if(tBuf[0] == '"' && insideQuote == TRUE)
+        header[numFields] = (char *) strdup(field);
+        if(!strcmp(header[numFields], xc))
         {
-             insideQuote = FALSE;
-
+            csv.xcol = numFields;
         }
-        else
+        else if(!strcmp(header[numFields], yc))
         {
-             tempString[i] = tBuf[0];
-             i++;
+            csv.ycol = numFields;
         }
-
-        tBuf++;
-    } /* end of while loop */
-
-    tempString[i] = '\0';
-    /*printf("PointFileReader tempString=%s count=%d\n", 
-               tempString, count); */
-
-    header[count] = (char *) strdup(tempString);
-    
-    if(!strcmp(header[count], xc))
-    {
-        xcol = count;
-    }
-    else if(!strcmp(header[count], yc))
-    {
-        ycol = count;
-    }
-
-    if(getAllAttribs)
-    {
-         if (StringItems)
-         {
-           addNewAttrHeader(poly->attr_hdr, header[count], FTString);
-         }
-         else
-         {
-            addNewAttrHeader(poly->attr_hdr, header[count], FTDouble);
-         }
+        numFields++;
     }
+    free(field);
+    /*printf("numFields=%d\n", numFields);*/
 
-    if(xcol == -1)
+    if(csv.xcol == -1)
     {
         /* error condition */
-        sprintf(mesg, "Could not locate %s in point file", xc);
+        sprintf(mesg, "Could not locate %.200s in point file", xc);
         ERROR(prog_name, mesg, 2);
     }
 
-    if(ycol == -1)
+    if(csv.ycol == -1)
     {
         /* error condition */
-        sprintf(mesg, "Could not locate %s in point file", yc);
+        sprintf(mesg, "Could not locate %.200s in point file", yc);
         ERROR(prog_name, mesg, 2);
     }
-    /*sprintf(mesg, "Columns with x,y coords in PointFile are %d and %d",
-                  xcol, ycol);
-    MESG(mesg);
-    */
 
-    /* the ALL condition was not selected */
-    if(!getAllAttribs)
+    poly = getNewPoly(0);
+
+    if(!poly->attr_hdr)
     {
+        poly->attr_hdr = getNewAttrHeader();
+    }
 
-        for(hc = 0; hc < ncnt; hc++)
+    /* the columns to keep, in the order of their attribute headers */
+    getAllAttribs = !strcmp(attribList[0], "ALL");
+    csv.attrCol = (int *) malloc(MAX(numFields, ncnt) * sizeof(int));
+    csv.nattr = 0;
+    for(hc = 0; hc < (getAllAttribs ? numFields : ncnt); hc++)
+    {
+        matched = 0;
+        for(count = 0; count < numFields && !matched; count++)
         {
-            matched = 0;
-            for(count = 0; count < numFields; count++)
-            {
-                if(!strcmp(header[count], attribList[hc]) )
-                {
-                     /* saves the name and where to find it in
-                        the header list so that when we go to get
-                        the data, we know which columns we need
-                        to save--pfIndex is internal only, it has
-                        nothing to do with the PolyObject or its 
-                        header structure
-                      */
-                     pfIndex[hc].name = (char *) strdup(header[count]);
-                     pfIndex[hc].index = count;     
-
-                     if (StringItems)
-                     {
-                        addNewAttrHeader(poly->attr_hdr, header[count], FTString); 
-                     }
-                     else
-                     {
-                        addNewAttrHeader(poly->attr_hdr, header[count], FTDouble);
-                     }
-                     matched = 1;
-                }
-
-            }
-            if(matched == 0)
+            if(getAllAttribs ? count == hc 
+                             : !strcmp(header[count], attribList[hc]))
             {
-                sprintf(mesg, "%s does not contain attribute %s",
-                        pointFileName, attribList[hc]);
-                WARN(mesg);
+                 csv.attrCol[csv.nattr++] = count;
+                 addNewAttrHeader(poly->attr_hdr, header[count],
+                                  StringItems ? FTString : FTDouble);
+                 matched = 1;
             }
-
+        }
+        if(matched == 0)
+        {
+            sprintf(mesg, "%.200s does not contain attribute %.40s",
+                    pointFileName, attribList[hc]);
+            WARN(mesg);
         }
     }
-
-    /* testing only */
-    /*for(count = 0; count < ncnt; count++)
-    {
-        printf("pfIndex[%d] name=%s index=%d\n", count, pfIndex[count].name,
-                       pfIndex[count].index);
-
-    }*/
+    csv.stringItems = StringItems;
 
     /* this is probably wrong */
     poly->map = file_mapproj;
@@ -395,337 +604,105 @@ PolyObject *PointFileReader(char *ename, MapProjInfo *file_mapproj,
 
     storeProjection(file_mapproj, output_mapproj); 
 
-     nObjects = 0;
-
-     data = (char **) malloc(numFields * sizeof(char *));
-
-     /* if using file chunking, move the file pointer to the correct line */
-     if(window > 0)
-     {
-        fsetpos(ifp, &filePosition); 
-     }
-          
-     /* read in each line of the PointFile and get the coordinates */
-     while((fgets(lineBuffer, sizeof(lineBuffer), ifp) != NULL) &&
-            (nObjects < maxShapes || maxShapes == 0) )   
-     {
-          /* ignore embedded comments, if any */
-          if(lineBuffer[0] == '#')
-          {
-               continue;
-          }
-
-          nObjects++;
-
-          /* go through each line and break out fields */
-          trim(lineBuffer, trimBuffer);
-
-          tBuf = trimBuffer;
-
-          insideQuote = 0;
-          i = 0;
-          count = 0;
-
-          while(tBuf[0] != '\0')
-          {
-               if(tBuf[0] == d && insideQuote == FALSE)
-               {
-                   /* new field */
-                   tempString[i] = '\0';
-                   i = 0;
-                   /*printf("PointFileReader2 tempString=%s\n", 
-                            tempString);*/
-
-                   data[count] = (char *) strdup(tempString);
-
-                   if(count == xcol)
-                   {
-                        strcpy(xc, tempString);
-                   }
-                   else if(count == ycol)
-                   {
-                        strcpy(yc, tempString);
-
-                   }
-                   count++;
-
-               }
-               else if(tBuf[0] == '"' && insideQuote == FALSE)
-               {
-                    insideQuote = TRUE;
-
-               }
-               else if(tBuf[0] == '"' && insideQuote == TRUE)
-               {
-                    insideQuote = FALSE;
-
-               }
-               else
-               {
-                    tempString[i] = tBuf[0];
-                    i++;
-               }
-
-               tBuf++;
-          } /* end of while tBuf */
-      
-          tempString[i] = '\0';
-          /*printf("PointFileReader2 tempString=%s\n", tempString);*/
-
-          data[count] = (char *) strdup(tempString);
-
-          if(count == xcol)
-          {
-               strcpy(xc, tempString);
-          }
-          else if(count == ycol)
-          {
-               strcpy(yc, tempString);
-          }
-          count++;
-
-          ps = getNewPolyShape(1);
-          ps->num_contours = 0;
-          shp = getNewShape(1);
-
-          if(digiCheck(xc))
-          {
-              sprintf(mesg, 
-                 "%s is non-numeric and cannot be used to define a coordinate",
-                  xc);
-              ERROR(prog_name, mesg, 2);
-
-          }
-
-          if(digiCheck(yc))
-          {
-              sprintf(mesg, 
-                 "%s is non-numeric and cannot be used to define a coordinate",
-                  yc);
-              ERROR(prog_name, mesg, 2);
-          }
-
-          /* get x and y for this shape from file */
-          projectPoint(atof(xc), atof(yc), &projx, &projy);
-          /*printf("xval=%f yval=%f projx=%f projy=%f\n", atof(xc), atof(yc),
-                 projx, projy);*/
-
-          /* output proj */
-          shp->vertex[0].x = projx;
-          shp->vertex[0].y = projy;
-         /* printf("x=%10s y=%10s projx=%12.0f projy=%12.0f\n", xc, yc, projx, projy);*/
-          gpc_add_contour(ps, shp, NOT_A_HOLE);
-          polyShapeIncl(&(poly->plist), ps, NULL);
-
-         
-     } /* end of while fgets loop */
-     
-     
-     
-     poly->nObjects = nObjects;
-
-     fclose(ifp);
-
-
-     poly->attr_val = (AttributeValue **) 
-                      malloc(nObjects * sizeof(AttributeValue *));
-
-     if(!poly->attr_val)
-     {
-          sprintf (mesg, "%s", 
-             "Unable to allocate memory for point file attributes");
-          ERROR (prog_name, mesg, 2);
-     }
-
-     for(count = 0; count < nObjects; count++)
-     {
-         poly->attr_val[count] =
-                   (AttributeValue *) malloc (ncnt *
-                                sizeof (AttributeValue));
-
-         
-         for(j = 0; j < ncnt; j++)
-         {
-              poly->attr_val[count][j].str = NULL;
-         }
-     }
-
-
-   
-     /* re-open file to read the attributes */
-     if((ifp = fopen(pointFileName, "r")) == NULL)
-     {
-          sprintf(mesg,"Unable to read %s\n", pointFileName);
-          ERROR(prog_name, mesg, 2);
-     }
-
-    do
+    /* find the rows of this chunk; if using file chunking, the chunk
+     * starts where the previous one ended */
+    pos = (window > 0) ? filePosition : headerEnd;
+    rowCap = 1024;
+    csv.rowStart = (long *) malloc(rowCap * sizeof(long));
+    csv.nrows = 0;
+    csv.maxLine = 0;
+    while(pos < csv.len && (csv.nrows < maxShapes || maxShapes == 0))
     {
-        fgets(lineBuffer, sizeof(lineBuffer), ifp);
+        end = lineEnd(csv.buf, csv.len, pos);
+        if(isPointRow(csv.buf, pos, end))
+        {
+            if(csv.nrows == rowCap)
+            {
+                rowCap *= 2;
+                csv.rowStart = (long *) realloc(csv.rowStart,
+                                                rowCap * sizeof(long));
+            }
+            if(csv.rowStart == NULL)
+            {
+                ERROR(prog_name, 
+                      "Unable to allocate memory for point file rows", 2);
+            }
+            csv.rowStart[csv.nrows++] = pos;
+            if(end - pos > csv.maxLine)
+            {
+                csv.maxLine = (int) (end - pos);
+            }
+        }
+        pos = end + 1;
     }
-    while(lineBuffer[0] == '#');
- 
-    
-    numRecords = 0;
+    filePosition = pos;
 
-    /* if using file chunking, move the file pointer to the correct line */
-    if(window > 0)
+    /* the whole file is done once no rows are left after this chunk */
+    while(pos < csv.len)
     {
-        fsetpos(ifp, &filePosition); 
+        end = lineEnd(csv.buf, csv.len, pos);
+        if(isPointRow(csv.buf, pos, end))
+        {
+            break;
+        }
+        pos = end + 1;
     }
-    
-    while((fgets(lineBuffer, sizeof(lineBuffer), ifp) != NULL) &&
-            (numRecords < maxShapes || maxShapes == 0) )   
+    if(pos >= csv.len)
     {
-          
-          /* ignore embedded comments, if any */
-          if(lineBuffer[0] == '#')
-          {
-               continue;
-          }
-          
-          trim(lineBuffer, trimBuffer);
+        fileCompleted = 1;
+    }
 
-          tBuf = trimBuffer;
+    csv.x = (double *) malloc(MAX(1, csv.nrows) * sizeof(double));
+    csv.y = (double *) malloc(MAX(1, csv.nrows) * sizeof(double));
+    csv.attr_val = (AttributeValue **) 
+                   malloc(MAX(1, csv.nrows) * sizeof(AttributeValue *));
+    if(!csv.x || !csv.y || !csv.attr_val)
+    {
+         sprintf (mesg, "%s", 
+             "Unable to allocate memory for point file attributes");
+         ERROR (prog_name, mesg, 2);
+    }
 
-          insideQuote = 0;
-          i = 0;
-          count = 0;
+    /* the coordinates and attributes of each row, in one pass */
+    parsePointFile(&csv);
+    unloadPointFile(csv.buf, csv.len, mapped);
 
-          while(tBuf[0] != '\0')
-          {
-               if(tBuf[0] == d && insideQuote == FALSE)
-               {
-                   /* new field */
-                   tempString[i] = '\0';
-                   i = 0;
-                   /*printf("PointFileReader3 tempString=%s\n", tempString);*/
-
-                   if(getAllAttribs)
-                    {
-                       if (StringItems)
-                       {
-                          poly->attr_val[numRecords][count].str = (char *) strdup(tempString);
-                       }
-                       else
-                       {
-                          // set double items for allocation
-                          if(digiCheck(tempString))
-                          {
-                            sprintf(mesg, "%s is non-numeric and cannot be used for ALLOCATE mode", tempString);
-                            ERROR(prog_name, mesg, 2);
-                          }
-                          poly->attr_val[numRecords][count].val = atof(tempString);
-                       }
-                    }
-                    else
-                    {
-                        for(hc = 0; hc < ncnt; hc++)
-                        {
-                            if(pfIndex[hc].index == count)
-                            {
-                               if (StringItems)
-                               {
-                                  poly->attr_val[numRecords][hc].str = (char *) strdup(tempString);
-                               }
-                               else
-                               {
-                                 // set double items for allocation
-                                 if(digiCheck(tempString))
-                                 {
-                                     sprintf(mesg, "%s is non-numeric and cannot be used for ALLOCATE mode", tempString);
-                                     ERROR(prog_name, mesg, 2);
-                                 }
-                                 poly->attr_val[numRecords][hc].val = atof(tempString);
-                               } // StringItems
-                            } //count
-                       } //hc
-                    } //getAllAtribs
-                    count++;
-               }
-               else if(tBuf[0] == '"' && insideQuote == FALSE)
-               {
-                    insideQuote = TRUE;
-               }
-               else if(tBuf[0] == '"' && insideQuote == TRUE)
-               {
-                    insideQuote = FALSE;
-               }
-               else
-               {
-                    tempString[i] = tBuf[0];
-                    i++;
-               }
-
-
-               tBuf++;
-          } /* end of while tBuf */
-          tempString[i] = '\0';
-          /*printf("PointFileReader3 tempString=%s\n", tempString);*/
-
-          if(getAllAttribs)
-           {
-              if (StringItems)
-              {
-                  poly->attr_val[numRecords][count].str = (char *) strdup(tempString);
-              }
-              else
-              {
-                 // set double items for allocation
-                 if(digiCheck(tempString))
-                 {
-                    sprintf(mesg, "%s is non-numeric and cannot be used for ALLOCATE mode", tempString);
-                    ERROR(prog_name, mesg, 2);
-                 }
-                 poly->attr_val[numRecords][count].val = atof(tempString);
-              }
-           }
-           else
-           {
-               for(hc = 0; hc < ncnt; hc++)
-               {
-                   if(pfIndex[hc].index == count)
-                   {
-                      if (StringItems)
-                      {
-                          poly->attr_val[numRecords][hc].str = (char *) strdup(tempString);
-                      }
-                      else
-                      {
-                          // set double items for allocation
-                          if(digiCheck(tempString))
-                          {
-                             sprintf(mesg, "%s is non-numeric and cannot be used for ALLOCATE mode", tempString);
-                             ERROR(prog_name, mesg, 2);
-                          }
-                          poly->attr_val[numRecords][hc].val = atof(tempString);
-                      } // StringItems
-                   } //hc
-              } //getAllAttribs
-           }
-           count++;
-
-          numRecords++;
-     }
+    /* get x and y for each shape in the output projection */
+    projectPoints(csv.nrows, csv.x, csv.y);
 
-     if(!feof(ifp))
-     {
-         fgetpos(ifp, &filePosition);     
-     }
-     else
-     {
-         fileCompleted = 1; /* the whole file is done */
-              
-     }      
+    shp = getNewShape(1);
+    for(i = 0; i < csv.nrows; i++)
+    {
+         ps = getNewPolyShape(1);
+         ps->num_contours = 0;
+
+         /* output proj */
+         shp->vertex[0].x = csv.x[i];
+         shp->vertex[0].y = csv.y[i];
+         gpc_add_contour(ps, shp, NOT_A_HOLE);
+         polyShapeIncl(&(poly->plist), ps, NULL);
+    }
+    freeShape(shp);
+
+    poly->nObjects = csv.nrows;
+    poly->attr_val = csv.attr_val;
 
-     window++;
+    window++;
 
-     fclose(ifp);
+    for(count = 0; count < numFields; count++)
+    {
+         free(header[count]);
+    }
+    free(header);
+    free(csv.attrCol);
+    free(csv.rowStart);
+    free(csv.x);
+    free(csv.y);
 
-     recomputeBoundingBox(poly);
+    recomputeBoundingBox(poly);
 
 
-     return poly;
+    return poly;
 
 }
 
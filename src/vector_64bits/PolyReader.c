@@ -172,6 +172,10 @@ PolyObject *PolyReader(char *ename, char *ecat, MapProjInfo *file_mapproj,
     ERROR("PolyReader", mesg, 2);
   }
 
+  if(poly != NULL)
+  {
+    statsCount(STAT_SHAPES_READ, poly->nObjects);
+  }
   return poly;
 }
 
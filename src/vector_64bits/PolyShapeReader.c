@@ -618,6 +618,7 @@ PolyObject *PolyShapeReader(char *name,
     sprintf(mesg, "Skipped %d polygons and %d vertices\n",
             skipped_polys, skipped_verts);
     MESG(mesg);
+    statsCount(STAT_SHAPES_CULLED, skipped_polys);
                                                                                     
     /*
      * check to see if bounding box of whole file overlaps the input bounding box
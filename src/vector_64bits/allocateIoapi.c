@@ -21,29 +21,14 @@ char mesg[256];
 extern char *prog_name;
 
 
+/* Number of distinct values of the first weight attribute.  The values
+ * are dictionary encoded once on the weight polygons (encodeAttrTypes),
+ * so typeAreaPercent can look up each shape's category by index. */
 int getNumTypes(PolyObject * poly, char ***list)
 {
-  char **list_array;
-  int ncnt, nmax;
-  int max_size = 2;   /*maximum types for this variable */
   int numTypes = 0;
-  PolyShape *ps;
-  PolyShapeList *plist;
-  int attrtype;
   int nObjects;  
-  char strVal[50];
-  int intVal;
-  double douVal;
-  int i, j, ret;
- 
-  list_array = (char **)malloc(max_size*sizeof(char *));
-  if(!list_array)
-  {
-     sprintf(mesg,"Memory allocation error in getNumTypes()");
-     *list = NULL;
-     sprintf(mesg, "Unable to allocate memory for unique attribute value string array");
-     ERROR(prog_name, mesg, 2);
-  }
+  int j;
 
   nObjects = poly->nObjects;
   if(nObjects == 0)
@@ -58,15 +43,12 @@ int getNumTypes(PolyObject * poly, char ***list)
     /*check the type of the attribute*/
     if (poly->attr_hdr->attr_desc[0]->type == FTInteger) {
       MESG("Base data poly attribute type is INT\n");
-      attrtype = FTInteger;
     }
     else if (poly->attr_hdr->attr_desc[0]->type == FTString) {
       MESG("Base data poly attribute type is STRING\n");
-      attrtype = FTString;
     }
     else if (poly->attr_hdr->attr_desc[0]->type == FTDouble) {
       MESG("Base data poly attribute type is DOUBLE\n");
-      attrtype = FTDouble;
     }
     else {
       ERROR(prog_name, "Weight polyon type is not integer, double or string type", 2);
@@ -76,58 +58,21 @@ int getNumTypes(PolyObject * poly, char ***list)
     ERROR(prog_name,"NO ATTRIBUTE HEADER was found for weight polygons\n",2);
   }
 
-  numTypes = 0;  
-  for(i = 0; i < nObjects; i++)
-  { 
-     if (attrtype == FTInteger)
-     {
-        intVal = poly->attr_val[i][0].ival; 
-        ret = sprintf(strVal, "%d", intVal);
-     }
-     else if (attrtype == FTDouble)
-     {
-        douVal = poly->attr_val[i][0].val; 
-        ret = sprintf(strVal, "%lf", douVal);
-     }
-     else if (attrtype == FTString)
-     {
-        sprintf(strVal,"%s",poly->attr_val[i][0].str); 
-     } 
-     else
-     {
-        sprintf(mesg, "NO ATTRIBUTE value for weight shape %d\n",i);
-        ERROR(prog_name,mesg,2);
-     }
-
-     for(j=0; j<numTypes;j++)
-     {
-        if(strcmp(strVal,list_array[j])==0)
-        {
-           break;
-        }
-     }
-     if (j == numTypes)
-     {
-        if (numTypes >= max_size)
-        {
-          max_size *= 2;
-          list_array = (char **)realloc(list_array,max_size*sizeof(char *));
-          if (!list_array)
-          {
-             sprintf(mesg,"Memory re-allocation error in getNumTypes");
-             ERROR(prog_name,mesg,2);
-          }
-        } 
-        list_array[numTypes] = (char *) strdup(strVal);
-        numTypes++;
-        sprintf(mesg, "numTypes=%d   strVal=%s\n",numTypes,strVal);
-        MESG(mesg);
-     }
-   
-  }  
+  numTypes = encodeAttrTypes(poly, 0);
+  if (numTypes < 0)
+  {
+     *list = NULL;
+     sprintf(mesg, "Unable to allocate memory for unique attribute value string array");
+     ERROR(prog_name, mesg, 2);
+  }
+  for(j = 0; j < numTypes; j++)
+  {
+     sprintf(mesg, "numTypes=%d   strVal=%s\n", j + 1, poly->type_list[j]);
+     MESG(mesg);
+  }
 
   /*attribute type array will be return to the calling program*/
-  *list = list_array;
+  *list = poly->type_list;
   return numTypes;
 }
 
@@ -167,7 +112,8 @@ int allocateIoapi(PolyObject *poly,   /* intersected weight and data polygons */
     int numTypes = 0;
     char typeNameHead[50],typeName[50];
     char **typeList;
-    double **areaP;   /*2d array to store area percent for each type of a attribute in a grid*/
+    TypeAreaMap *areaP = NULL;   /*area percent for each type of a attribute in a grid*/
+    double *typeCol;  /*area percent of one type in each grid*/
     double gridArea;  /*grid area*/
     
     int    *intAttData, *intAllData, *tmpIntData;
@@ -614,12 +560,12 @@ int allocateIoapi(PolyObject *poly,   /* intersected weight and data polygons */
     
     
     /*for area percent computation--such as surf zone*/
-    /*get multiple type area percentage for a grid in an array areaP[numTypes][d_poly->nObjects] */
+    /*get multiple type area percentage for a grid, kept per type for the grids that have it */
     if(!strcmp(modeFileName, "ALL_AREAPERCENT"))
     {
       /*compute area percent for each type of a attribute in a grid cell*/
       tmp_id = 0;
-      if(typeAreaPercent(poly, &areaP, &gridArea, tmp_id, numTypes, &typeList))
+      if(typeAreaPercent(poly, &areaP, &gridArea, tmp_id))
       {
          return 1;
       }
@@ -789,31 +735,25 @@ int allocateIoapi(PolyObject *poly,   /* intersected weight and data polygons */
                    {
                       if(strcmp(typeList[attr_id],"2")==0)
                       {
+                         typeCol = (double *) malloc(nrec_out * sizeof(double));
+                         typeAreaColumn(areaP, 0, sum);
+                         typeAreaColumn(areaP, 1, typeCol);
                          for (i=0;i<nrec_out;i++)
                          {
-                           sum[i] = 1.0 - areaP[0][i] - areaP[1][i];
+                           sum[i] = 1.0 - sum[i] - typeCol[i];
                            /*sprintf(mesg,"area percent type=%d  ID=%d   Area= %lf", attr_id,i,sum[i]);
                            MESG(mesg);*/
                          }
+                         free(typeCol);
                       }
                       else if (strcmp(typeList[attr_id],"3")==0)
                       {
-                         for (i=0;i<nrec_out;i++)
-                         {    
-                           sum[i]=areaP[attr_id][i];
-                           /*sprintf(mesg,"area percent type=%d  ID=%d   Area= %lf", attr_id,i,sum[i]);
-                           MESG(mesg);*/
-                         }
+                         typeAreaColumn(areaP, attr_id, sum);
                       }
                    }
                    else
                    {
-                       for (i=0;i<nrec_out;i++)
-                       {
-                         sum[i]=areaP[attr_id][i];  
-                         /*sprintf(mesg,"area percent type=%d  ID=%d   Area= %lf", attr_id,i,sum[i]);
-                         MESG(mesg);*/
-                       }
+                       typeAreaColumn(areaP, attr_id, sum);
                    }
 		}
                 else if(mode == DiscreteOverlap && !overlapsCalculated)
@@ -974,14 +914,7 @@ int allocateIoapi(PolyObject *poly,   /* intersected weight and data polygons */
     free(fltAllData);
 
     /*free memory used for area percent computation for a variable type*/
-    if(getEnvtValue(ENVT_ALLOC_ATTR_TYPE, attrType) && strcmp(attrType,"SURF_ZONE")==0)
-    { 
-      for(i=0;i<numTypes;i++)
-      {
-        free(areaP[i]);
-      }
-      free (areaP);
-    }
+    freeTypeAreaMap(areaP);
 
     return 0;
 }
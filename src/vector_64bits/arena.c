@@ -0,0 +1,230 @@
+/****************************************************************************
+ * arena.c
+ *
+ * Block allocator for the small geometry nodes (PolyShape headers, list
+ * nodes, bounding boxes and parents) that are created in large numbers
+ * while reading and intersecting shapes.  Nodes are carved out of large
+ * blocks, and everything allocated from an arena is released with a
+ * single call once the stage that owns it is done.  Each node carries a
+ * small header naming the arena it came from, so nodeFree can tell heap
+ * nodes from arena nodes without searching the arenas.
+ *
+ * File contains:
+ * newArena
+ * arenaAlloc
+ * resetArena
+ * freeArena
+ * setCurrentArena
+ * nodeAlloc
+ * nodeFree
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shapefil.h"
+#include "mims_spatl.h"
+
+/* default size of the first block of an arena */
+#define ARENA_BLOCK_SIZE (1 << 20)
+/* alignment of each allocation */
+#define ARENA_ALIGN 16
+
+typedef struct _ArenaBlock {
+    struct _ArenaBlock *next;
+    size_t size;                /* usable bytes in data */
+    size_t used;
+    char *data;
+} ArenaBlock;
+
+struct _Arena {
+    ArenaBlock *first;
+    ArenaBlock *current;
+    size_t block_size;          /* size of the next block to allocate */
+};
+
+/* the header in front of each node from nodeAlloc; padded so the node
+ * keeps the arena alignment */
+typedef union _NodeHeader {
+    Arena *arena;               /* owning arena, or NULL for the heap */
+    char pad[ARENA_ALIGN];
+} NodeHeader;
+
+/* the arena that nodeAlloc draws from; NULL means the heap */
+static Arena *current_arena = NULL;
+
+
+/* ============================================================= */
+static ArenaBlock *newArenaBlock(size_t size)
+{
+    ArenaBlock *b;
+
+    b = (ArenaBlock *) malloc(sizeof(ArenaBlock));
+    if(b == NULL)
+    {
+        return NULL;
+    }
+    b->data = (char *) malloc(size);
+    if(b->data == NULL)
+    {
+        free(b);
+        return NULL;
+    }
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+
+/* ============================================================= */
+/* create an arena whose first block holds block_size bytes
+ * (0 selects the default) */
+Arena *newArena(size_t block_size)
+{
+    Arena *a;
+
+    a = (Arena *) malloc(sizeof(Arena));
+    if(a == NULL)
+    {
+        return NULL;
+    }
+    a->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+    a->first = a->current = newArenaBlock(a->block_size);
+    if(a->first == NULL)
+    {
+        free(a);
+        return NULL;
+    }
+    return a;
+}
+
+
+/* ============================================================= */
+/* allocate size bytes from an arena.  Blocks left over from an earlier
+ * resetArena are reused before new ones are added, and each new block
+ * is twice the size of the last. */
+void *arenaAlloc(Arena * a, size_t size)
+{
+    ArenaBlock *b;
+    void *p;
+
+    size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+    b = a->current;
+    while(b->used + size > b->size)
+    {
+        if(b->next == NULL)
+        {
+            a->block_size *= 2;
+            if(a->block_size < size)
+            {
+                a->block_size = size;
+            }
+            b->next = newArenaBlock(a->block_size);
+            if(b->next == NULL)
+            {
+                return NULL;
+            }
+        }
+        b = b->next;
+        b->used = 0;
+    }
+    a->current = b;
+    p = b->data + b->used;
+    b->used += size;
+    return p;
+}
+
+
+/* ============================================================= */
+/* release everything allocated from an arena, keeping its blocks so the
+ * next stage can reuse them */
+void resetArena(Arena * a)
+{
+    if(a != NULL)
+    {
+        a->first->used = 0;
+        a->current = a->first;
+    }
+}
+
+
+/* ============================================================= */
+/* release an arena and its blocks */
+void freeArena(Arena * a)
+{
+    ArenaBlock *b, *next;
+
+    if(a == NULL)
+    {
+        return;
+    }
+    if(current_arena == a)
+    {
+        current_arena = NULL;
+    }
+    for(b = a->first; b != NULL; b = next)
+    {
+        next = b->next;
+        free(b->data);
+        free(b);
+    }
+    free(a);
+}
+
+
+/* ============================================================= */
+/* select the arena used by nodeAlloc (NULL for the heap) and return
+ * the one previously selected */
+Arena *setCurrentArena(Arena * a)
+{
+    Arena *prev = current_arena;
+
+    current_arena = a;
+    return prev;
+}
+
+
+/* ============================================================= */
+/* allocate a geometry node from the current arena, or from the heap if
+ * no arena is selected */
+void *nodeAlloc(size_t size)
+{
+    NodeHeader *h;
+
+    if(current_arena != NULL)
+    {
+        h = (NodeHeader *) arenaAlloc(current_arena,
+                                      sizeof(NodeHeader) + size);
+    }
+    else
+    {
+        h = (NodeHeader *) malloc(sizeof(NodeHeader) + size);
+    }
+    if(h == NULL)
+    {
+        return NULL;
+    }
+    h->arena = current_arena;
+    return h + 1;
+}
+
+
+/* ============================================================= */
+/* free a node from nodeAlloc.  Nodes that live in an arena are left
+ * alone; they go away when their arena is reset or freed. */
+void nodeFree(void *p)
+{
+    NodeHeader *h;
+
+    if(p == NULL)
+    {
+        return;
+    }
+    h = (NodeHeader *) p - 1;
+    if(h->arena == NULL)
+    {
+        free(h);
+    }
+}
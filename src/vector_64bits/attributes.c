@@ -5,6 +5,7 @@
  * attachAttribute
  * getNewAttrHeader
  * addNewAttrHeader
+ * encodeAttrTypes
  *
  * Updated 5/23/2005 -- added support for Regular Grids with no attribs
  *                      in attachAttribute  BDB
@@ -150,3 +151,87 @@ int addNewAttrHeader(
 }
 
 
+
+/* ============================================================= */
+/* string form of a category value, as used for output variable names */
+
+static char *attrTypeString(PolyObject *poly, int i, int attr_id, int type,
+                            char *buf)
+{
+  if (type == FTInteger) {
+    sprintf(buf, "%d", poly->attr_val[i][attr_id].ival);
+    return buf;
+  }
+  if (type == FTDouble) {
+    sprintf(buf, "%lf", poly->attr_val[i][attr_id].val);
+    return buf;
+  }
+  return poly->attr_val[i][attr_id].str ? poly->attr_val[i][attr_id].str : "";
+}
+
+static unsigned int attrTypeHash(char *s)
+{
+  unsigned int h = 2166136261u;
+
+  while (*s) {
+    h = (h ^ (unsigned char) *s++) * 16777619u;
+  }
+  return h;
+}
+
+/* ============================================================= */
+/* Give each distinct value of attribute attr_id a category code, in
+ * order of first appearance, and keep the code of every shape in
+ * poly->type_code so the values are compared only once.  The values
+ * are kept as strings in poly->type_list.  Returns the number of
+ * categories, or -1 on an allocation error. */
+
+int encodeAttrTypes(PolyObject *poly, int attr_id)
+{
+  char buf[64], *val;
+  int *slot, nslot, type, i, k;
+  unsigned int h;
+
+  if (poly->type_code != NULL && poly->type_attr == attr_id) {
+    return poly->ntypes;
+  }
+  if (poly->type_list != NULL) {
+    for (k = 0; k < poly->ntypes; k++) free(poly->type_list[k]);
+    free(poly->type_list);
+  }
+  free(poly->type_code);
+  poly->type_list = NULL;
+  poly->ntypes = 0;
+  poly->type_attr = -1;
+
+  type = poly->attr_hdr->attr_desc[attr_id]->type;
+  for (nslot = 16; nslot < 2 * poly->nObjects; nslot *= 2)
+    ;
+  slot = (int *) malloc(nslot * sizeof(int));
+  poly->type_code = (int *) malloc((poly->nObjects + 1) * sizeof(int));
+  poly->type_list = (char **) malloc((poly->nObjects + 1) * sizeof(char *));
+  if (!slot || !poly->type_code || !poly->type_list) {
+    free(slot);
+    WARN("Allocation error in encodeAttrTypes");
+    return -1;
+  }
+  for (k = 0; k < nslot; k++) slot[k] = -1;
+
+  for (i = 0; i < poly->nObjects; i++) {
+    val = attrTypeString(poly, i, attr_id, type, buf);
+    h = attrTypeHash(val) & (nslot - 1);
+    while ((k = slot[h]) >= 0 && strcmp(poly->type_list[k], val) != 0) {
+      h = (h + 1) & (nslot - 1);
+    }
+    if (k < 0) {
+      k = poly->ntypes++;
+      poly->type_list[k] = (char *) strdup(val);
+      slot[h] = k;
+    }
+    poly->type_code[i] = k;
+  }
+  free(slot);
+  poly->type_attr = attr_id;
+
+  return poly->ntypes;
+}
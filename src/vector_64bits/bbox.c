@@ -24,7 +24,7 @@ BoundingBox *newBBox(double xmin, double ymin, double xmax, double ymax)
 {
     BoundingBox *bb;
 
-    bb = (BoundingBox *) malloc(sizeof(BoundingBox));
+    bb = (BoundingBox *) nodeAlloc(sizeof(BoundingBox));
     if(bb)
     {
         bb->xmin = xmin;
@@ -112,7 +112,8 @@ BoundingBox *newBoundingBox(PolyShape * ps)
 
 
 /* ============================================================= */
-/* recompute a bounding box for a polygon */
+/* recompute a bounding box for a polygon, and the area and length of
+ * each of its shapes */
 int recomputeBoundingBox(PolyObject * p)
 {
     PolyShapeList *plist;
@@ -151,6 +152,10 @@ int recomputeBoundingBox(PolyObject * p)
         bb->xmax = xmax;
         bb->ymax = ymax;
 
+        /* the shape may have changed since it was measured */
+        plist->area = PolyArea(plist->ps);
+        plist->length = PolyLength(plist->ps);
+
         /* compute the overall bounding box for the whole polygon */
         if(i == 0)
         {
@@ -64,14 +64,14 @@ int reuseDW(
   plist = pw->plist;
   for (i=0; i<n1; i++) {
     pp = plist->pp;
-    p1[i] = newParent(pp, plist->ps, i);
+    p1[i] = newParent(pp, plist, i);
     plist = plist->next;
   }
 
   plist = pd->plist;
   for (i=0; i<n2; i++) {
     pp = plist->pp;
-    p2[i] = newParent(pp, plist->ps, i);
+    p2[i] = newParent(pp, plist, i);
     plist = plist->next;
   }
 
@@ -84,7 +84,7 @@ int reuseDW(
 
     pp = newPolyParent(p1[ii],p2[jj]);
     if(plist->pp != NULL) {
-      free(plist->pp);
+      nodeFree(plist->pp);
     }
     plist->pp = pp;
 
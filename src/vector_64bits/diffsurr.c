@@ -8,6 +8,8 @@
  * The surrogate entries for the categories are looked up in the respective
  * surrogate files, and if the absolute value of the difference between
  * corresponding values is larger than the tolerance, an warning is logged.
+ * Either file may be a text surrogate file or a binary one written by
+ * srgcreate through SURROGATE_BINARY_FILE.
  *
  * Developed by Atanas Trayanov of MCNC Environmental Modeling Center,
  * in support of the EPA Multimedia Integrated Modeling System, 2002.
@@ -17,6 +19,7 @@
 #include <string.h>
 #include <math.h>
 #include "io.h"
+#include "srgbin.h"
 
 typedef struct _Surrogate {
   float frac;
@@ -40,6 +43,7 @@ char *prog_version = "Spatial Allocator Diffsurr Version 3.6 03/10/2009";
 extern int debug_output;
 
 int ReadSrgtFile(char *fname, int scat, Surrogate **s, double eps);
+int ReadSrgtBinFile(char *fname, int scat, Surrogate **s);
 
 /* =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-= */
 
@@ -367,6 +371,10 @@ int ReadSrgtFile(char *fname, int scat, Surrogate **s, double eps)
 
   extern int comp_surr(const void *, const void *);
 
+  if (isSrgBinFile(fname)) {
+    return ReadSrgtBinFile(fname, scat, s);
+  }
+
   if ((fp = fopen(fname,"r")) == NULL) {
     WARN2("Cannot open file for reading: ", fname);
     n = -1;
@@ -460,6 +468,49 @@ int ReadSrgtFile(char *fname, int scat, Surrogate **s, double eps)
   return n;
 }
 
+/* =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-= */
+/*
+ * reads the entries for one category from a binary surrogate file;
+ * only that category's records are read from the file
+ */
+int ReadSrgtBinFile(char *fname, int scat, Surrogate **s)
+{
+  SrgBin *sb;
+  int n;
+  int i;
+  char buffer[MAXLINE];
+
+  extern int comp_surr(const void *, const void *);
+
+  if ((sb = readSrgBin(fname, scat)) == NULL) {
+    return -1;
+  }
+
+  n = sb->nrec;
+  sprintf(buffer,"Read %d entries for category %d from binary file %s",
+     n, scat, fname);
+  MESG(buffer);
+
+  if (n > 0) {
+    *s = (Surrogate *)malloc(n*sizeof(Surrogate));
+    if (*s == NULL) {
+      WARN("Malloc failure in ReadSrgtBinFile");
+      freeSrgBin(sb);
+      return -1;
+    }
+    for (i=0; i < n; i++) {
+      (*s)[i].id = atoi(srgBinCountyID(sb, sb->county[i]));
+      (*s)[i].col = sb->col[i];
+      (*s)[i].row = sb->row[i];
+      (*s)[i].frac = (float)sb->ratio[i];
+    }
+    qsort((*s), n, sizeof(Surrogate), comp_surr);
+  }
+
+  freeSrgBin(sb);
+  return n;
+}
+
 /* =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-= */
 int comp_surr(const void *v1, const void *v2)
 {
@@ -0,0 +1,141 @@
+/****************************************************************************
+ * geomstore.c
+ *
+ * An index-addressable view of the shapes in a PolyObject, kept as one
+ * array per field: bounding boxes, parent indices, contour counts and
+ * the area and length of each shape and of the weight shape it was cut
+ * from.  The store is built once from the shape list and the surrogate
+ * sums then read these arrays by index instead of chasing plist->next
+ * and the PolyShapes.  The measures are copied from the shape list,
+ * where they were taken when the shape was added (polyShapeIncl).
+ *
+ * The vertices are not copied.  Once the measures are kept no sum
+ * reads them, and gpc is given the PolyShapes themselves, so a second
+ * copy of every vertex would only double the memory of the largest
+ * inputs.  The store keeps a pointer to each PolyShape for that.
+ *
+ * File contains:
+ * getGeomStore
+ * freeGeomStore
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "shapefil.h"
+#include "mims_spatl.h"
+#include "io.h"
+
+
+/* ============================================================= */
+static GeomStore *buildGeomStore(PolyObject * poly)
+{
+    GeomStore *gs;
+    PolyShapeList *plist;
+    PolyParent *pp;
+    int i;
+
+    gs = (GeomStore *) malloc(sizeof(GeomStore));
+    if(gs == NULL)
+    {
+        return NULL;
+    }
+    gs->nshapes = poly->nObjects;
+
+    gs->bb = (BoundingBox *) malloc(MAX(1, gs->nshapes) * sizeof(BoundingBox));
+    gs->top_p1 = (int *) malloc(MAX(1, gs->nshapes) * sizeof(int));
+    gs->top_p1_p2 = (int *) malloc(MAX(1, gs->nshapes) * sizeof(int));
+    gs->top_p2 = (int *) malloc(MAX(1, gs->nshapes) * sizeof(int));
+    gs->ncontours = (int *) malloc(MAX(1, gs->nshapes) * sizeof(int));
+    gs->ps = (PolyShape **) malloc(MAX(1, gs->nshapes) * sizeof(PolyShape *));
+    gs->area = (double *) malloc(MAX(1, gs->nshapes) * sizeof(double));
+    gs->length = (double *) malloc(MAX(1, gs->nshapes) * sizeof(double));
+    gs->top_p1_area = (double *) malloc(MAX(1, gs->nshapes) * sizeof(double));
+    gs->top_p1_length =
+        (double *) malloc(MAX(1, gs->nshapes) * sizeof(double));
+    if(!gs->bb || !gs->top_p1 || !gs->top_p1_p2 || !gs->top_p2 ||
+       !gs->ncontours || !gs->ps || !gs->area || !gs->length ||
+       !gs->top_p1_area || !gs->top_p1_length)
+    {
+        freeGeomStore(gs);
+        return NULL;
+    }
+
+    plist = poly->plist;
+    for(i = 0; i < gs->nshapes; i++)
+    {
+        gs->ps[i] = plist->ps;
+        gs->ncontours[i] = plist->ps->num_contours;
+        gs->bb[i] = *(plist->bb);
+        gs->area[i] = plist->area;
+        gs->length[i] = plist->length;
+
+        /* the sums index shapes by their top-level parents: following
+         * the p1 links gives the weight shape and its data polygon,
+         * following the p2 links gives the grid cell */
+        gs->top_p1[i] = gs->top_p1_p2[i] = gs->top_p2[i] = -1;
+        gs->top_p1_area[i] = gs->top_p1_length[i] = 0.0;
+        pp = plist->pp;
+        if(pp)
+        {
+            while(pp->p1->pp)
+            {
+                pp = pp->p1->pp;
+            }
+            gs->top_p1[i] = pp->p1->index;
+            gs->top_p1_p2[i] = pp->p2->index;
+            gs->top_p1_area[i] = pp->p1->pl->area;
+            gs->top_p1_length[i] = pp->p1->pl->length;
+
+            pp = plist->pp;
+            while(pp->p2->pp)
+            {
+                pp = pp->p2->pp;
+            }
+            gs->top_p2[i] = pp->p2->index;
+        }
+        plist = plist->next;
+    }
+    return gs;
+}
+
+
+/* ============================================================= */
+/* Return the store for poly, building it on first use.  The store
+ * reflects the shape list at the time it is built, so it should only be
+ * requested once the object is complete. */
+GeomStore *getGeomStore(PolyObject * poly)
+{
+    if(poly->store == NULL)
+    {
+        poly->store = buildGeomStore(poly);
+        if(poly->store == NULL)
+        {
+            WARN("Allocation error in getGeomStore");
+        }
+    }
+    return poly->store;
+}
+
+
+/* ============================================================= */
+void freeGeomStore(GeomStore * gs)
+{
+    if(gs != NULL)
+    {
+        free(gs->bb);
+        free(gs->top_p1);
+        free(gs->top_p1_p2);
+        free(gs->top_p2);
+        free(gs->ncontours);
+        free(gs->ps);
+        free(gs->area);
+        free(gs->length);
+        free(gs->top_p1_area);
+        free(gs->top_p1_length);
+        free(gs);
+    }
+}
+
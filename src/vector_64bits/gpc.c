@@ -77,6 +77,13 @@ Copyright: (C) 1997-2004, Advanced Interfaces Group,
 #define PREV_INDEX(i, n)   ((i - 1 + n) % n)
 #define NEXT_INDEX(i, n)   ((i + 1    ) % n)
 
+#ifndef MIN
+#define MIN(a, b)          (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)          (((a) > (b)) ? (a) : (b))
+#endif
+
 #define OPTIMAL(v, i, n)   ((v[PREV_INDEX(i, n)].y != v[i].y) || \
                             (v[NEXT_INDEX(i, n)].y != v[i].y))
 
@@ -90,6 +97,8 @@ Copyright: (C) 1997-2004, Advanced Interfaces Group,
 
 #define NOT_RMAX(v, i, n)   (v[PREV_INDEX(i, n)].vertex.y > v[i].vertex.y)
 
+#define EDGE_POS(p, e)     (((e) & 3) ? (p)->y : (p)->x)
+
 #define VERTEX(e,p,s,x,y)  {add_vertex(&((e)->outp[(p)]->v[(s)]), x, y); \
                             (e)->outp[(p)]->active++;}
 
@@ -956,12 +965,14 @@ static bbox *create_contour_bboxes(gpc_polygon *p)
 }
 
 
-static void minimax_test(gpc_polygon *subj, gpc_polygon *clip, gpc_op op)
+static void minimax_test(gpc_polygon *subj, gpc_polygon *clip, gpc_op op,
+                         bbox *subj_bbox)
 {
   bbox *s_bbox, *c_bbox;
   int   s, c, *o_table, overlap;
 
-  s_bbox= create_contour_bboxes(subj);
+  /* The subject boxes may have been made when the subject was prepared */
+  s_bbox= subj_bbox ? subj_bbox : create_contour_bboxes(subj);
   c_bbox= create_contour_bboxes(clip);
 
   MALLOC(o_table, subj->num_contours * clip->num_contours * sizeof(int),
@@ -1003,7 +1014,8 @@ static void minimax_test(gpc_polygon *subj, gpc_polygon *clip, gpc_op op)
     }  
   }
 
-  FREE(s_bbox);
+  if (!subj_bbox)
+    FREE(s_bbox);
   FREE(c_bbox);
   FREE(o_table);
 }
@@ -1114,8 +1126,8 @@ void gpc_add_contour(gpc_polygon *p, gpc_vertex_list *new_contour, int hole)
 }
 
 
-void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
-                      gpc_polygon *result)
+static void polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
+                         gpc_polygon *result, bbox *subj_bbox)
 {
   sb_tree       *sbtree= NULL;
   it_node       *it= NULL, *intersect;
@@ -1144,7 +1156,7 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
   /* Identify potentialy contributing contours */
   if (((op == GPC_INT) || (op == GPC_DIFF))
    && (subj->num_contours > 0) && (clip->num_contours > 0))
-    minimax_test(subj, clip, op);
+    minimax_test(subj, clip, op, subj_bbox);
 
   /* Build LMT */
   if (subj->num_contours > 0)
@@ -1751,6 +1763,719 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
   FREE(sbt);
 }
 
+void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
+                      gpc_polygon *result)
+{
+  polygon_clip(op, subj, clip, result, NULL);
+}
+
+
+/*
+===========================================================================
+                        Prepared subject clipping
+===========================================================================
+
+A subject that is clipped against many clip polygons in turn (a county
+against the cells of a grid) is prepared once, which keeps its contour
+bounding boxes.  When the operation is an intersection, the clip
+polygon is a single convex contour, such as a grid cell, and the only
+subject contour whose box meets the clip box is a convex external
+contour, that contour is clipped directly against the clip edges
+(Sutherland-Hodgman) instead of being swept with the clip.  The
+intersection of two convex contours is a single convex contour, so the
+result is the same as the general algorithm gives.
+
+A concave contour is clipped directly only by an axis-aligned rectangle
+(a grid cell), and only if it neither crosses nor touches itself, which
+is tested once per prepared contour.  Intersections are then placed
+exactly on the rectangle edges.  Where the contour leaves and re-enters
+the rectangle the result runs along the rectangle edges, and where the
+intersection falls in several pieces those runs join the pieces with
+zero-width bridges.  Runs that go out and straight back along an edge
+are dropped; if any edge still has runs that overlap, or a vertex that
+lies on another run or repeats, the pieces are not separate contours and
+the general algorithm is used.  Subjects with holes and subjects with
+several contours near the clip are left to the general algorithm.
+Result contours are oriented as the
+general algorithm leaves them: clockwise for external contours and
+anticlockwise for holes.  gpc_copy_polygon copies a polygon the same way,
+for a subject or clip polygon that the caller knows lies inside the
+other.
+*/
+
+typedef struct                      /* Growable vertex list              */
+{
+  int                 n;            /* Number of vertices                */
+  int                 size;         /* Allocated vertices                */
+  gpc_vertex         *v;            /* Vertex array                      */
+} v_list;
+
+
+static void v_list_add(v_list *l, double x, double y)
+{
+  gpc_vertex *v;
+  int         i;
+
+  /* Drop repeated vertices */
+  if ((l->n > 0) && (l->v[l->n - 1].x == x) && (l->v[l->n - 1].y == y))
+    return;
+
+  if (l->n == l->size)
+  {
+    l->size= (l->size > 0) ? 2 * l->size : 16;
+    MALLOC(v, l->size * sizeof(gpc_vertex), "vertex list growth", gpc_vertex);
+    for (i= 0; i < l->n; i++)
+      v[i]= l->v[i];
+    FREE(l->v);
+    l->v= v;
+  }
+  l->v[l->n].x= x;
+  l->v[l->n].y= y;
+  l->n++;
+}
+
+
+static double signed_area(gpc_vertex *v, int n)
+{
+  double a= 0.0;
+  int    i;
+
+  for (i= 0; i < n; i++)
+    a+= v[i].x * v[NEXT_INDEX(i, n)].y - v[NEXT_INDEX(i, n)].x * v[i].y;
+  return 0.5 * a;
+}
+
+
+/* Return the orientation of the n vertices v (1 for anticlockwise, -1 for
+   clockwise) if they form a convex contour, or 0 if not */
+static int convex_vertices(gpc_vertex *v, int n)
+{
+  double      cross, dx, pdx;
+  int         i, turn= 0, xflips= 0;
+
+  if (n < 3)
+    return 0;
+
+  /* Every turn is to the same side, and the contour only goes round once */
+  pdx= v[0].x - v[n - 1].x;
+  for (i= 0; i < n; i++)
+  {
+    cross= (v[NEXT_INDEX(i, n)].x - v[i].x) * (v[PREV_INDEX(i, n)].y - v[i].y)
+         - (v[NEXT_INDEX(i, n)].y - v[i].y) * (v[PREV_INDEX(i, n)].x - v[i].x);
+    if (cross != 0.0)
+    {
+      if (turn == 0)
+        turn= (cross > 0.0) ? 1 : -1;
+      else if (turn != ((cross > 0.0) ? 1 : -1))
+        return 0;
+    }
+    dx= v[NEXT_INDEX(i, n)].x - v[i].x;
+    if (dx != 0.0)
+    {
+      if ((pdx != 0.0) && ((dx < 0.0) != (pdx < 0.0)))
+        xflips++;
+      pdx= dx;
+    }
+  }
+  if ((turn == 0) || (xflips > 2))
+    return 0;
+  return turn;
+}
+
+
+/* Copy a contour into out, without repeated vertices */
+static void copy_contour(gpc_vertex_list *contour, v_list *out)
+{
+  int v;
+
+  out->n= 0;
+  for (v= 0; v < contour->num_vertices; v++)
+    v_list_add(out, contour->vertex[v].x, contour->vertex[v].y);
+  while ((out->n > 1) && (out->v[out->n - 1].x == out->v[0].x)
+                      && (out->v[out->n - 1].y == out->v[0].y))
+    out->n--;
+}
+
+
+/* Copy the vertices of a single contour clip polygon into l, without
+   repeated vertices, and return its orientation if it is convex, or 0 if
+   not */
+static int convex_contour(gpc_polygon *clip, v_list *l)
+{
+  if ((clip->num_contours != 1) || clip->hole[0])
+    return 0;
+
+  copy_contour(&clip->contour[0], l);
+  return convex_vertices(l->v, l->n);
+}
+
+
+/* Clip the convex contour in out against a convex polygon c of nc
+   vertices turning in direction turn, leaving the result in out */
+static void convex_clip_contour(v_list *out, gpc_vertex *c, int nc, int turn,
+                                v_list *tmp)
+{
+  v_list     *in, *res, *swap, keep;
+  gpc_vertex *s, *e;
+  double      cs, ce, t;
+  int         i, k;
+
+  in= out;
+  res= tmp;
+  for (k= 0; (k < nc) && (in->n > 0); k++)
+  {
+    gpc_vertex *a= &c[k];
+    gpc_vertex *b= &c[NEXT_INDEX(k, nc)];
+
+    res->n= 0;
+    s= &in->v[in->n - 1];
+    cs= turn * ((b->x - a->x) * (s->y - a->y) - (b->y - a->y) * (s->x - a->x));
+    for (i= 0; i < in->n; i++)
+    {
+      e= &in->v[i];
+      ce= turn * ((b->x - a->x) * (e->y - a->y) - (b->y - a->y) * (e->x - a->x));
+      if (ce >= 0.0)
+      {
+        if (cs < 0.0)
+        {
+          t= cs / (cs - ce);
+          v_list_add(res, s->x + t * (e->x - s->x), s->y + t * (e->y - s->y));
+        }
+        v_list_add(res, e->x, e->y);
+      }
+      else if (cs >= 0.0)
+      {
+        if (cs > 0.0)
+        {
+          t= cs / (cs - ce);
+          v_list_add(res, s->x + t * (e->x - s->x), s->y + t * (e->y - s->y));
+        }
+      }
+      s= e;
+      cs= ce;
+    }
+    while ((res->n > 1) && (res->v[res->n - 1].x == res->v[0].x)
+                        && (res->v[res->n - 1].y == res->v[0].y))
+      res->n--;
+
+    swap= in;
+    in= res;
+    res= swap;
+  }
+
+  /* Leave the result in out */
+  if (in != out)
+  {
+    keep= *out;
+    *out= *in;
+    *in= keep;
+  }
+}
+
+
+/* Return TRUE if the n vertices v are the corners of an axis-aligned
+   rectangle */
+static int rect_vertices(gpc_vertex *v, int n)
+{
+  int i, vertical= 0;
+
+  if (n != 4)
+    return FALSE;
+  for (i= 0; i < n; i++)
+  {
+    if (v[NEXT_INDEX(i, n)].x == v[i].x)
+      vertical++;
+    else if (v[NEXT_INDEX(i, n)].y != v[i].y)
+      return FALSE;
+  }
+  return (vertical == 2) && (v[0].x != v[2].x) && (v[0].y != v[2].y);
+}
+
+
+/* Flags of the rectangle edges (1 xmin, 2 xmax, 4 ymin, 8 ymax) that the
+   vertex p lies on */
+static int rect_edges(gpc_vertex *p, bbox *r)
+{
+  return ((p->x == r->xmin) ? 1 : 0) | ((p->x == r->xmax) ? 2 : 0)
+       | ((p->y == r->ymin) ? 4 : 0) | ((p->y == r->ymax) ? 8 : 0);
+}
+
+
+/* Clip the contour in out against the rectangle r, leaving the result in
+   out.  Intersections lie exactly on the rectangle edges. */
+static void rect_clip_contour(v_list *out, bbox *r, v_list *tmp)
+{
+  v_list     *in, *res, *swap, keep;
+  gpc_vertex *s, *e;
+  double      cs, ce, t;
+  int         i, k;
+
+  in= out;
+  res= tmp;
+  for (k= 0; (k < 4) && (in->n > 0); k++)
+  {
+    res->n= 0;
+    s= &in->v[in->n - 1];
+    for (i= 0; i < in->n; i++)
+    {
+      e= &in->v[i];
+      switch (k)
+      {
+      case 0:  cs= s->x - r->xmin; ce= e->x - r->xmin; break;
+      case 1:  cs= r->xmax - s->x; ce= r->xmax - e->x; break;
+      case 2:  cs= s->y - r->ymin; ce= e->y - r->ymin; break;
+      default: cs= r->ymax - s->y; ce= r->ymax - e->y; break;
+      }
+      if (((cs < 0.0) && (ce > 0.0)) || ((cs > 0.0) && (ce < 0.0)))
+      {
+        t= cs / (cs - ce);
+        switch (k)
+        {
+        case 0:  v_list_add(res, r->xmin, s->y + t * (e->y - s->y)); break;
+        case 1:  v_list_add(res, r->xmax, s->y + t * (e->y - s->y)); break;
+        case 2:  v_list_add(res, s->x + t * (e->x - s->x), r->ymin); break;
+        default: v_list_add(res, s->x + t * (e->x - s->x), r->ymax); break;
+        }
+      }
+      if (ce >= 0.0)
+        v_list_add(res, e->x, e->y);
+      s= e;
+    }
+    while ((res->n > 1) && (res->v[res->n - 1].x == res->v[0].x)
+                        && (res->v[res->n - 1].y == res->v[0].y))
+      res->n--;
+
+    swap= in;
+    in= res;
+    res= swap;
+  }
+
+  /* Leave the result in out */
+  if (in != out)
+  {
+    keep= *out;
+    *out= *in;
+    *in= keep;
+  }
+}
+
+
+/* Drop the vertices of l where the contour runs along a rectangle edge and
+   turns straight back, with any repeated vertex that leaves */
+static void drop_edge_spikes(v_list *l, bbox *r)
+{
+  gpc_vertex *a, *b, *c;
+  int         i, k, e, changed;
+
+  do
+  {
+    changed= FALSE;
+    for (i= 0; (l->n >= 3) && (i < l->n); i++)
+    {
+      a= &l->v[PREV_INDEX(i, l->n)];
+      b= &l->v[i];
+      c= &l->v[NEXT_INDEX(i, l->n)];
+      e= rect_edges(a, r) & rect_edges(b, r) & rect_edges(c, r);
+      if (!e || ((EDGE_POS(b, e) - EDGE_POS(a, e))
+               * (EDGE_POS(c, e) - EDGE_POS(b, e)) > 0.0))
+        continue;
+
+      /* Remove b, and c as well if it repeats a */
+      for (k= i; k < l->n - 1; k++)
+        l->v[k]= l->v[k + 1];
+      l->n--;
+      if ((l->n > 1) && (l->v[PREV_INDEX(i, l->n)].x == l->v[i % l->n].x)
+                     && (l->v[PREV_INDEX(i, l->n)].y == l->v[i % l->n].y))
+      {
+        for (k= i % l->n; k < l->n - 1; k++)
+          l->v[k]= l->v[k + 1];
+        l->n--;
+      }
+      changed= TRUE;
+    }
+  } while (changed);
+}
+
+
+static int vertex_order(const void *p, const void *q)
+{
+  const gpc_vertex *a= (const gpc_vertex *) p;
+  const gpc_vertex *b= (const gpc_vertex *) q;
+
+  if (a->x != b->x)
+    return (a->x < b->x) ? -1 : 1;
+  if (a->y != b->y)
+    return (a->y < b->y) ? -1 : 1;
+  return 0;
+}
+
+
+static int run_order(const void *p, const void *q)
+{
+  const double *a= (const double *) p;
+  const double *b= (const double *) q;
+
+  if (a[0] != b[0])
+    return (a[0] < b[0]) ? -1 : 1;
+  return 0;
+}
+
+
+/* Return TRUE if the contour l, clipped by the rectangle r, is a single
+   contour: no vertex repeats, and along each rectangle edge its runs do
+   not overlap and no vertex lies inside a run */
+static int single_rect_contour(v_list *l, bbox *r)
+{
+  gpc_vertex *sorted;
+  double     *run, *pos;
+  int         i, j, k, e, nrun, npos, lo, hi, single= TRUE;
+
+  MALLOC(sorted, l->n * sizeof(gpc_vertex), "vertex sort", gpc_vertex);
+  for (i= 0; i < l->n; i++)
+    sorted[i]= l->v[i];
+  qsort(sorted, l->n, sizeof(gpc_vertex), vertex_order);
+  for (i= 1; single && (i < l->n); i++)
+    single= (vertex_order(&sorted[i - 1], &sorted[i]) != 0);
+  FREE(sorted);
+
+  MALLOC(run, 2 * l->n * sizeof(double), "edge run creation", double);
+  MALLOC(pos, l->n * sizeof(double), "edge position creation", double);
+  for (k= 0; single && (k < 4); k++)
+  {
+    e= 1 << k;
+    nrun= npos= 0;
+    for (i= 0; i < l->n; i++)
+    {
+      j= NEXT_INDEX(i, l->n);
+      if (!(rect_edges(&l->v[i], r) & e))
+        continue;
+      pos[npos++]= EDGE_POS(&l->v[i], e);
+      if (rect_edges(&l->v[j], r) & e)
+      {
+        run[2 * nrun]= MIN(EDGE_POS(&l->v[i], e), EDGE_POS(&l->v[j], e));
+        run[2 * nrun + 1]= MAX(EDGE_POS(&l->v[i], e), EDGE_POS(&l->v[j], e));
+        nrun++;
+      }
+    }
+    if (nrun == 0)
+      continue;
+
+    /* Runs sorted by their start may only meet end to start */
+    qsort(run, nrun, 2 * sizeof(double), run_order);
+    for (i= 1; single && (i < nrun); i++)
+      single= (run[2 * i] >= run[2 * i - 1]);
+
+    /* The run that may hold each vertex is the last one starting before it */
+    for (i= 0; single && (i < npos); i++)
+    {
+      lo= 0;
+      hi= nrun;
+      while (hi - lo > 1)
+      {
+        j= (lo + hi) / 2;
+        if (run[2 * j] < pos[i])
+          lo= j;
+        else
+          hi= j;
+      }
+      single= !((run[2 * lo] < pos[i]) && (pos[i] < run[2 * lo + 1]));
+    }
+  }
+  FREE(run);
+  FREE(pos);
+  return single;
+}
+
+
+static double orient(gpc_vertex *a, gpc_vertex *b, gpc_vertex *c)
+{
+  return (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+}
+
+
+/* Return TRUE if c, known to be on the line through a and b, lies on the
+   segment ab */
+static int on_segment(gpc_vertex *a, gpc_vertex *b, gpc_vertex *c)
+{
+  return (c->x >= MIN(a->x, b->x)) && (c->x <= MAX(a->x, b->x))
+      && (c->y >= MIN(a->y, b->y)) && (c->y <= MAX(a->y, b->y));
+}
+
+
+static int segments_meet(gpc_vertex *a, gpc_vertex *b,
+                         gpc_vertex *c, gpc_vertex *d)
+{
+  double d1= orient(c, d, a), d2= orient(c, d, b);
+  double d3= orient(a, b, c), d4= orient(a, b, d);
+
+  if ((((d1 > 0.0) && (d2 < 0.0)) || ((d1 < 0.0) && (d2 > 0.0)))
+   && (((d3 > 0.0) && (d4 < 0.0)) || ((d3 < 0.0) && (d4 > 0.0))))
+    return TRUE;
+  return ((d1 == 0.0) && on_segment(c, d, a)) || ((d2 == 0.0) && on_segment(c, d, b))
+      || ((d3 == 0.0) && on_segment(a, b, c)) || ((d4 == 0.0) && on_segment(a, b, d));
+}
+
+
+/* Return TRUE if no two edges of the contour l that do not follow each
+   other cross or touch.  Edges are swept in order of their left end. */
+static int simple_vertices(v_list *l)
+{
+  double     *left;
+  gpc_vertex *a, *b, *c, *d;
+  int         i, j, ei, ej, simple= TRUE;
+
+  if (l->n < 4)
+    return TRUE;
+
+  MALLOC(left, 2 * l->n * sizeof(double), "edge sort", double);
+  for (i= 0; i < l->n; i++)
+  {
+    left[2 * i]= MIN(l->v[i].x, l->v[NEXT_INDEX(i, l->n)].x);
+    left[2 * i + 1]= i;
+  }
+  qsort(left, l->n, 2 * sizeof(double), run_order);
+
+  for (i= 0; simple && (i < l->n); i++)
+  {
+    ei= (int) left[2 * i + 1];
+    a= &l->v[ei];
+    b= &l->v[NEXT_INDEX(ei, l->n)];
+    for (j= i + 1; simple && (j < l->n) && (left[2 * j] <= MAX(a->x, b->x)); j++)
+    {
+      ej= (int) left[2 * j + 1];
+      if ((ej == NEXT_INDEX(ei, l->n)) || (ei == NEXT_INDEX(ej, l->n)))
+        continue;
+      c= &l->v[ej];
+      d= &l->v[NEXT_INDEX(ej, l->n)];
+      if ((MAX(c->y, d->y) < MIN(a->y, b->y)) || (MIN(c->y, d->y) > MAX(a->y, b->y)))
+        continue;
+      simple= !segments_meet(a, b, c, d);
+    }
+  }
+  FREE(left);
+  return simple;
+}
+
+
+/* Append out to the n result contours unless it has no area, and return
+   the new number of contours */
+static int add_result_contour(v_list *out, int hole,
+                              gpc_vertex_list *contours, int *holes, int n)
+{
+  double a;
+  int    v;
+
+  if (out->n < 3)
+    return n;
+  a= signed_area(out->v, out->n);
+  if (a == 0.0)
+    return n;
+
+  holes[n]= hole;
+  contours[n].num_vertices= out->n;
+  MALLOC(contours[n].vertex, out->n * sizeof(gpc_vertex), "vertex creation",
+         gpc_vertex);
+  /* External contours run clockwise and holes anticlockwise */
+  if ((a > 0.0) != (hole != FALSE))
+    for (v= 0; v < out->n; v++)
+      contours[n].vertex[v]= out->v[out->n - 1 - v];
+  else
+    for (v= 0; v < out->n; v++)
+      contours[n].vertex[v]= out->v[v];
+  return n + 1;
+}
+
+
+static void set_result(gpc_polygon *result, gpc_vertex_list *contours,
+                       int *hole, int n)
+{
+  int s;
+
+  result->num_contours= n;
+  result->hole= NULL;
+  result->contour= NULL;
+  if (n > 0)
+  {
+    MALLOC(result->hole, n * sizeof(int), "hole flag table creation", int);
+    MALLOC(result->contour, n * sizeof(gpc_vertex_list), "contour creation",
+           gpc_vertex_list);
+    for (s= 0; s < n; s++)
+    {
+      result->hole[s]= hole[s];
+      result->contour[s]= contours[s];
+    }
+  }
+}
+
+
+void gpc_prepare_polygon(gpc_polygon *subj, gpc_prepared_polygon *prepared)
+{
+  int c;
+
+  prepared->polygon= subj;
+  prepared->box= (subj->num_contours > 0) ? create_contour_bboxes(subj) : NULL;
+
+  /* Self contact of a contour is tested when it is first needed */
+  MALLOC(prepared->simple, subj->num_contours * sizeof(int),
+         "contour flag creation", int);
+  for (c= 0; c < subj->num_contours; c++)
+    prepared->simple[c]= -1;
+}
+
+
+void gpc_free_prepared_polygon(gpc_prepared_polygon *prepared)
+{
+  FREE(prepared->box);
+  FREE(prepared->simple);
+  prepared->polygon= NULL;
+}
+
+
+#ifdef GPC_TEST
+static int direct_clips= 0;         /* Prepared clips done without a sweep */
+#endif
+
+void gpc_prepared_clip(gpc_op op, gpc_prepared_polygon *prepared,
+                       gpc_polygon *clip, gpc_polygon *result)
+{
+  gpc_polygon     *subj= prepared->polygon;
+  bbox            *s_bbox= (bbox *) prepared->box;
+  bbox             c_bbox;
+  v_list           c= {0, 0, NULL}, out= {0, 0, NULL}, tmp= {0, 0, NULL};
+  int              s, v, i, turn, inside, near, concave, hole= FALSE;
+  gpc_vertex_list  contour;
+  double           x, y;
+
+  /* Anything other than the intersection with a convex contour is left to
+     the general algorithm */
+  turn= (op == GPC_INT) ? convex_contour(clip, &c) : 0;
+  if (!turn || (subj->num_contours == 0))
+  {
+    FREE(c.v);
+    polygon_clip(op, subj, clip, result, s_bbox);
+    return;
+  }
+
+  c_bbox.xmin= c_bbox.xmax= c.v[0].x;
+  c_bbox.ymin= c_bbox.ymax= c.v[0].y;
+  for (v= 1; v < c.n; v++)
+  {
+    if (c.v[v].x < c_bbox.xmin) c_bbox.xmin= c.v[v].x;
+    if (c.v[v].x > c_bbox.xmax) c_bbox.xmax= c.v[v].x;
+    if (c.v[v].y < c_bbox.ymin) c_bbox.ymin= c.v[v].y;
+    if (c.v[v].y > c_bbox.ymax) c_bbox.ymax= c.v[v].y;
+  }
+
+  /* Find the subject contours that may meet the clip contour */
+  near= -1;
+  for (s= 0; s < subj->num_contours; s++)
+  {
+    if ((subj->contour[s].num_vertices < 3)
+     || (s_bbox[s].xmax < c_bbox.xmin) || (s_bbox[s].xmin > c_bbox.xmax)
+     || (s_bbox[s].ymax < c_bbox.ymin) || (s_bbox[s].ymin > c_bbox.ymax))
+      continue;
+    if ((near >= 0) || (subj->hole && subj->hole[s]))
+    {
+      /* Several contours or a hole: the general algorithm merges them */
+      near= -2;
+      break;
+    }
+    near= s;
+  }
+
+  concave= FALSE;
+  if (near >= 0)
+  {
+    copy_contour(&subj->contour[near], &out);
+    if (!convex_vertices(out.v, out.n))
+    {
+      /* A concave contour only by a rectangle, and only if it has no self
+         contact */
+      if (rect_vertices(c.v, c.n))
+      {
+        if (prepared->simple[near] < 0)
+          prepared->simple[near]= simple_vertices(&out);
+        concave= prepared->simple[near];
+      }
+      if (!concave)
+        near= -2;
+    }
+  }
+
+  if (near >= 0)
+  {
+    /* A contour whose box lies inside the clip contour is kept whole */
+    inside= TRUE;
+    for (v= 0; inside && (v < 4); v++)
+    {
+      x= (v & 1) ? s_bbox[near].xmax : s_bbox[near].xmin;
+      y= (v & 2) ? s_bbox[near].ymax : s_bbox[near].ymin;
+      for (i= 0; inside && (i < c.n); i++)
+        inside= turn * ((c.v[NEXT_INDEX(i, c.n)].x - c.v[i].x) * (y - c.v[i].y)
+                      - (c.v[NEXT_INDEX(i, c.n)].y - c.v[i].y) * (x - c.v[i].x))
+                >= 0.0;
+    }
+    if (!inside && concave)
+    {
+      rect_clip_contour(&out, &c_bbox, &tmp);
+      drop_edge_spikes(&out, &c_bbox);
+      if ((out.n >= 3) && !single_rect_contour(&out, &c_bbox))
+        near= -2;
+    }
+    else if (!inside)
+      convex_clip_contour(&out, c.v, c.n, turn, &tmp);
+  }
+  if (near == -2)
+  {
+    FREE(c.v);
+    FREE(out.v);
+    FREE(tmp.v);
+    polygon_clip(op, subj, clip, result, s_bbox);
+    return;
+  }
+
+#ifdef GPC_TEST
+  direct_clips++;
+#endif
+  if ((near >= 0) && add_result_contour(&out, FALSE, &contour, &hole, 0))
+    set_result(result, &contour, &hole, 1);
+  else
+    set_result(result, NULL, NULL, 0);
+
+  FREE(c.v);
+  FREE(out.v);
+  FREE(tmp.v);
+}
+
+
+void gpc_copy_polygon(gpc_polygon *subj, gpc_polygon *result)
+{
+  v_list           out= {0, 0, NULL};
+  int              s, *hole= NULL;
+  gpc_vertex_list *contours= NULL;
+  int              n= 0;
+
+  MALLOC(hole, subj->num_contours * sizeof(int), "hole flag table creation",
+         int);
+  MALLOC(contours, subj->num_contours * sizeof(gpc_vertex_list),
+         "contour creation", gpc_vertex_list);
+
+  for (s= 0; s < subj->num_contours; s++)
+  {
+    if (subj->contour[s].num_vertices < 3)
+      continue;
+    copy_contour(&subj->contour[s], &out);
+    n= add_result_contour(&out, subj->hole ? subj->hole[s] : FALSE,
+                          contours, hole, n);
+  }
+
+  set_result(result, contours, hole, n);
+
+  FREE(hole);
+  FREE(contours);
+  FREE(out.v);
+}
+
 
 void gpc_free_tristrip(gpc_tristrip *t)
 {
@@ -1804,7 +2529,7 @@ void gpc_tristrip_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
   /* Identify potentialy contributing contours */
   if (((op == GPC_INT) || (op == GPC_DIFF))
    && (subj->num_contours > 0) && (clip->num_contours > 0))
-    minimax_test(subj, clip, op);
+    minimax_test(subj, clip, op, NULL);
 
   /* Build LMT */
   if (subj->num_contours > 0)
@@ -2465,6 +3190,173 @@ void gpc_tristrip_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
   FREE(sbt);
 }
 
+#ifdef GPC_TEST
+/*
+===========================================================================
+                     Prepared clipping test (gpctest.exe)
+===========================================================================
+
+Clips a few subject polygons by a convex cell with gpc_prepared_clip and
+gpc_polygon_clip and checks that the results have the same area and the
+same number of contours, that their difference has no area, and that the
+prepared clip was done directly or by the general algorithm as expected.
+*/
+
+static double polygon_area(gpc_polygon *p)
+{
+  double a= 0.0, c;
+  int    s;
+
+  for (s= 0; s < p->num_contours; s++)
+  {
+    c= fabs(signed_area(p->contour[s].vertex, p->contour[s].num_vertices));
+    a+= (p->hole && p->hole[s]) ? -c : c;
+  }
+  return a;
+}
+
+
+static void set_contour(gpc_polygon *p, int s, double *xy, int n, int hole)
+{
+  int v;
+
+  p->hole[s]= hole;
+  p->contour[s].num_vertices= n;
+  MALLOC(p->contour[s].vertex, n * sizeof(gpc_vertex), "vertex creation",
+         gpc_vertex);
+  for (v= 0; v < n; v++)
+  {
+    p->contour[s].vertex[v].x= xy[2 * v];
+    p->contour[s].vertex[v].y= xy[2 * v + 1];
+  }
+}
+
+
+static void new_polygon(gpc_polygon *p, int n)
+{
+  p->num_contours= n;
+  MALLOC(p->hole, n * sizeof(int), "hole flag table creation", int);
+  MALLOC(p->contour, n * sizeof(gpc_vertex_list), "contour creation",
+         gpc_vertex_list);
+}
+
+
+static int check_clip(char *name, gpc_polygon *subj, gpc_polygon *clip,
+                      int direct)
+{
+  gpc_prepared_polygon prepared;
+  gpc_polygon          fast, general, diff;
+  double               af, ag, ad;
+  int                  ok, done;
+
+  done= direct_clips;
+  gpc_prepare_polygon(subj, &prepared);
+  gpc_prepared_clip(GPC_INT, &prepared, clip, &fast);
+  gpc_polygon_clip(GPC_INT, subj, clip, &general);
+  gpc_free_prepared_polygon(&prepared);
+  done= (direct_clips > done);
+  gpc_polygon_clip(GPC_XOR, &fast, &general, &diff);
+
+  af= polygon_area(&fast);
+  ag= polygon_area(&general);
+  ad= polygon_area(&diff);
+  ok= (fabs(af - ag) <= 1e-9 * (fabs(ag) + 1.0)) && (fabs(ad) <= 1e-9)
+   && (fast.num_contours == general.num_contours) && (done == direct);
+  printf("%-10s area %12.6f / %12.6f  contours %d / %d  %-7s  %s\n", name,
+         af, ag, fast.num_contours, general.num_contours,
+         done ? "direct" : "general", ok ? "ok" : "FAILED");
+
+  gpc_free_polygon(&fast);
+  gpc_free_polygon(&general);
+  gpc_free_polygon(&diff);
+  return ok;
+}
+
+
+static int check_contour(char *name, double *xy, int n, gpc_polygon *clip,
+                         int direct)
+{
+  gpc_polygon subj;
+  int         ok;
+
+  new_polygon(&subj, 1);
+  set_contour(&subj, 0, xy, n, FALSE);
+  ok= check_clip(name, &subj, clip, direct);
+  gpc_free_polygon(&subj);
+  return ok;
+}
+
+
+int main(int argc, char *argv[])
+{
+  double cell[]=    {1.0, 1.0,  3.0, 1.0,  3.0, 3.0,  1.0, 3.0};
+  double diamond[]= {2.0, 0.5,  3.5, 2.0,  2.0, 3.5,  0.5, 2.0};
+  double convex[]=  {0.0, 2.0,  2.0, 0.0,  4.0, 2.0,  2.0, 4.0};
+  double inner[]=   {1.5, 1.5,  2.5, 1.5,  2.0, 2.5};
+  double notch[]=   {0.0, 0.0,  4.0, 0.0,  4.0, 4.0,  2.5, 4.0,  2.5, 2.0,
+                     1.5, 2.0,  1.5, 4.0,  0.0, 4.0};
+  double corner[]=  {0.0, 0.0,  4.0, 0.0,  4.0, 2.5,  2.5, 2.5,  2.5, 4.0,
+                     0.0, 4.0};
+  double comb[]=    {1.2, 1.5,  2.8, 1.5,  2.8, 2.0,  2.7, 2.0,  2.7, 3.5,
+                     2.5, 3.5,  2.5, 2.0,  2.1, 2.0,  2.1, 3.5,  1.9, 3.5,
+                     1.9, 2.0,  1.5, 2.0,  1.5, 3.5,  1.3, 3.5,  1.3, 2.0,
+                     1.2, 2.0};
+  double hook[]=    {2.0, 2.0,  2.0, 3.8,  3.6, 3.8,  3.6, 2.5,  3.5, 2.5,
+                     3.5, 3.7,  2.5, 3.7,  2.5, 2.0};
+  double touch[]=   {2.0, 2.0,  3.5, 2.0,  3.5, 2.45, 3.0, 2.5,  3.3, 2.4,
+                     2.5, 2.3};
+  double bridge[]=  {0.0, 0.0,  4.0, 0.0,  4.0, 4.0,  2.5, 4.0,  2.5, 0.5,
+                     1.5, 0.5,  1.5, 4.0,  0.0, 4.0};
+  double spiral[]=  {2.0, 2.0,  2.0, 3.8,  3.6, 3.8,  3.6, 2.5,  2.8, 2.5,
+                     2.8, 3.7,  2.5, 3.7,  2.5, 2.0};
+  double pinch[]=   {1.5, 1.5,  2.0, 1.5,  2.0, 2.0,  2.5, 2.0,  2.5, 2.5,
+                     2.0, 2.5,  2.0, 2.0,  1.5, 2.0};
+  double outer[]=   {0.0, 0.0,  4.0, 0.0,  4.0, 4.0,  0.0, 4.0};
+  double hole[]=    {1.5, 1.5,  1.5, 2.5,  2.5, 2.5,  2.5, 1.5};
+  double other[]=   {2.0, 2.0,  5.0, 2.0,  5.0, 5.0,  2.0, 5.0};
+  gpc_polygon clip, subj;
+  int         ok= TRUE;
+
+  new_polygon(&clip, 1);
+  set_contour(&clip, 0, cell, 4, FALSE);
+
+  /* Clipped directly */
+  ok= check_contour("convex", convex, 4, &clip, TRUE) && ok;
+  ok= check_contour("inside", inner, 3, &clip, TRUE) && ok;
+  ok= check_contour("notch", notch, 8, &clip, TRUE) && ok;
+  ok= check_contour("corner", corner, 6, &clip, TRUE) && ok;
+  ok= check_contour("comb", comb, 16, &clip, TRUE) && ok;
+  ok= check_contour("hook", hook, 8, &clip, TRUE) && ok;
+  ok= check_contour("touch", touch, 6, &clip, TRUE) && ok;
+
+  /* Pieces joined along the cell edges, and self contact */
+  ok= check_contour("bridge", bridge, 8, &clip, FALSE) && ok;
+  ok= check_contour("spiral", spiral, 8, &clip, FALSE) && ok;
+  ok= check_contour("pinch", pinch, 8, &clip, FALSE) && ok;
+
+  new_polygon(&subj, 2);
+  set_contour(&subj, 0, outer, 4, FALSE);
+  set_contour(&subj, 1, hole, 4, TRUE);
+  ok= check_clip("holed", &subj, &clip, FALSE) && ok;
+  gpc_free_polygon(&subj);
+
+  new_polygon(&subj, 2);
+  set_contour(&subj, 0, convex, 4, FALSE);
+  set_contour(&subj, 1, other, 4, FALSE);
+  ok= check_clip("overlap", &subj, &clip, FALSE) && ok;
+  gpc_free_polygon(&subj);
+
+  /* A concave contour by a cell that is not a rectangle */
+  gpc_free_polygon(&clip);
+  new_polygon(&clip, 1);
+  set_contour(&clip, 0, diamond, 4, FALSE);
+  ok= check_contour("diamond", notch, 8, &clip, FALSE) && ok;
+
+  gpc_free_polygon(&clip);
+  return ok ? 0 : 1;
+}
+#endif
+
 /*
 ===========================================================================
                            End of file: gpc.c
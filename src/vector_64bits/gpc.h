@@ -82,6 +82,13 @@ typedef struct                      /* Polygon set structure             */
   gpc_vertex_list    *contour;      /* Contour array pointer             */
 } gpc_polygon;
 
+typedef struct                      /* Prepared subject polygon          */
+{
+  gpc_polygon        *polygon;      /* Subject polygon, not copied       */
+  void               *box;          /* Subject contour bounding boxes    */
+  int                *simple;       /* Contour has no self contact flags */
+} gpc_prepared_polygon;
+
 typedef struct                      /* Tristrip set structure            */
 {
   int                 num_strips;   /* Number of tristrips               */
@@ -112,6 +119,19 @@ void gpc_polygon_clip        (gpc_op           set_operation,
                               gpc_polygon     *clip_polygon,
                               gpc_polygon     *result_polygon);
 
+void gpc_prepare_polygon     (gpc_polygon     *subject_polygon,
+                              gpc_prepared_polygon *prepared_polygon);
+
+void gpc_prepared_clip       (gpc_op           set_operation,
+                              gpc_prepared_polygon *prepared_polygon,
+                              gpc_polygon     *clip_polygon,
+                              gpc_polygon     *result_polygon);
+
+void gpc_free_prepared_polygon (gpc_prepared_polygon *prepared_polygon);
+
+void gpc_copy_polygon        (gpc_polygon     *subject_polygon,
+                              gpc_polygon     *result_polygon);
+
 void gpc_tristrip_clip       (gpc_op           set_operation,
                               gpc_polygon     *subject_polygon,
                               gpc_polygon     *clip_polygon,
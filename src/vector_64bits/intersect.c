@@ -9,7 +9,9 @@
  * File contains:
  * polyIsect
  * point_clip
+ * bucketIsect
  * line_clip
+ * coverPair
  * comp_*_*_vertex
  */
 
@@ -27,6 +29,22 @@ int point_clip(PolyShape * p1,  /* the set of points */
                PolyShape * p2,  /* the input polygon */
                PolyShape * p /* the output set of points */ );
 int line_clip(PolyShape * p1, PolyShape * p2, PolyShape * p);
+static int bucketIsect(PolyObject * poly1, PolyObject * poly2, PolyObject * p,
+                      Parent ** p1, Parent ** p2);
+
+/* containment of polygon pairs, see coverPair */
+#define COVER_BOUNDARY 0        /* the boundaries meet: clip */
+#define COVER_INSIDE   1        /* poly1's shape is covered by poly2's */
+#define COVER_CONTAINS 2        /* poly2's shape is covered by poly1's */
+#define COVER_OUTSIDE  3        /* the shapes are apart */
+
+/* most edge pairs tested before a pair is left to gpc */
+#define COVER_MAX_EDGE_PAIRS 262144
+
+typedef struct _EdgeIndex EdgeIndex;
+static EdgeIndex *newEdgeIndex(PolyShape * ps);
+static void freeEdgeIndex(EdgeIndex * ei);
+static int coverPair(EdgeIndex * e1, EdgeIndex * e2, int *ca, int *cb);
 
 /* ============================================================= */
 /* Intersects a shape (point, line, or polygon), with a polygon and  
@@ -45,12 +63,18 @@ int polyIsect(PolyObject * poly1,       /* a point, line, or polygon */
     int n1, n2;
     int n;
     int at_least_one;
+    int cover;
     int itemp = 0;
+    long bboxTests = 0, clipCalls = 0, coveredPairs = 0;
     PolyShape *polyResult, *tmpPoly;
     PolyParent *pp;
     PolyShapeList *plist, *plist1, *plist2;
     Parent **p1;
     Parent **p2;
+    gpc_prepared_polygon *prep = NULL;
+    EdgeIndex **edges1 = NULL;  /* edge indexes of poly1's polygons */
+    EdgeIndex *edges2;          /* and of the current polygon of poly2 */
+    int *ca = NULL, *cb = NULL;
     double dummy = 0.0;
     char mesg[100];
 
@@ -94,7 +118,7 @@ int polyIsect(PolyObject * poly1,       /* a point, line, or polygon */
     for(i = 0; i < n1; i++)
     {
         pp = plist->pp;
-        p1[i] = newParent(pp, plist->ps, i);
+        p1[i] = newParent(pp, plist, i);
         plist = plist->next;
     }
 
@@ -102,15 +126,53 @@ int polyIsect(PolyObject * poly1,       /* a point, line, or polygon */
     for(i = 0; i < n2; i++)
     {
         pp = plist->pp;
-        p2[i] = newParent(pp, plist->ps, i);
+        p2[i] = newParent(pp, plist, i);
         plist = plist->next;
     }
     plist2 = poly2->plist;
 
+    /* points and lines are binned into buckets instead of being tested
+     * against every polygon in turn */
+    if(poly1->nSHPType == SHPT_POINT || poly1->nSHPType == SHPT_ARC)
+    {
+        at_least_one = bucketIsect(poly1, poly2, p, p1, p2);
+        if(at_least_one < 0)
+        {
+            return -1;
+        }
+        p->bb = newBBox(dummy, dummy, dummy, dummy);
+        recomputeBoundingBox(p);
+        statsCountPoly(p);
+        return at_least_one;
+    }
+
     at_least_one = 0;
 
     printBoundingBox(poly1->bb);
 
+    /* each polygon of poly1 is clipped against many polygons of poly2,
+     * so prepare it once; its edge index for the containment test is
+     * built on first use */
+    if(poly1->nSHPType == SHPT_POLYGON && !isShapeOverlay)
+    {
+        prep = (gpc_prepared_polygon *)
+            malloc(MAX(1, n1) * sizeof(gpc_prepared_polygon));
+        edges1 = (EdgeIndex **) calloc(MAX(1, n1), sizeof(EdgeIndex *));
+        ca = (int *) malloc(COVER_MAX_EDGE_PAIRS * sizeof(int));
+        cb = (int *) malloc(COVER_MAX_EDGE_PAIRS * sizeof(int));
+        if(!prep || !edges1 || !ca || !cb)
+        {
+            WARN("Allocation error in polyIsect");
+            return -1;
+        }
+        plist1 = poly1->plist;
+        for(i = 0; i < n1; i++)
+        {
+            gpc_prepare_polygon(plist1->ps, prep + i);
+            plist1 = plist1->next;
+        }
+    }
+
     for(j = 0; j < n2; j++)
     {
         /* check to see if bounding boxes for poly1 and the current contour of      
@@ -118,8 +180,11 @@ int polyIsect(PolyObject * poly1,       /* a point, line, or polygon */
 
 
 
+        bboxTests++;
+        edges2 = NULL;
         if(OVERLAP2(poly1->bb, plist2->bb))
         {
+            bboxTests += n1;
             plist1 = poly1->plist;
             for(i = 0; i < n1; i++)
             {
@@ -162,8 +227,46 @@ int polyIsect(PolyObject * poly1,       /* a point, line, or polygon */
                         }
                         else
                         {
-                            gpc_polygon_clip(GPC_INT, plist1->ps, plist2->ps,
-                                             polyResult);
+                            /* only pairs whose boundaries meet are
+                             * clipped; that includes pairs that only
+                             * touch, which still go to gpc.  A covered
+                             * shape is copied whole instead of being
+                             * rebuilt by gpc, so its piece has the
+                             * shape's own vertices and its area can
+                             * differ from the clipped one in the last
+                             * digits.  The same rows are written. */
+                            if(!edges1[i])
+                            {
+                                edges1[i] = newEdgeIndex(plist1->ps);
+                            }
+                            if(!edges2)
+                            {
+                                edges2 = newEdgeIndex(plist2->ps);
+                            }
+                            if(!edges1[i] || !edges2)
+                            {
+                                WARN("Allocation error in polyIsect");
+                                return -1;
+                            }
+                            cover = coverPair(edges1[i], edges2, ca, cb);
+                            if(cover == COVER_INSIDE)
+                            {
+                                gpc_copy_polygon(plist1->ps, polyResult);
+                            }
+                            else if(cover == COVER_CONTAINS)
+                            {
+                                gpc_copy_polygon(plist2->ps, polyResult);
+                            }
+                            else if(cover == COVER_BOUNDARY)
+                            {
+                                gpc_prepared_clip(GPC_INT, prep + i,
+                                                  plist2->ps, polyResult);
+                                clipCalls++;
+                            }
+                            if(cover != COVER_BOUNDARY)
+                            {
+                                coveredPairs++;
+                            }
                         }
 #ifdef DEBUG
                         gpc_write_polygon(stderr, 0, polyResult);
@@ -173,11 +276,13 @@ int polyIsect(PolyObject * poly1,       /* a point, line, or polygon */
                     {
                         /*fprintf(stderr,"point passed second overlap j=%d i=%d\n", j, i); */
                         point_clip(plist1->ps, plist2->ps, polyResult);
+                        clipCalls++;
                     }
                     else if(poly1->nSHPType == SHPT_ARC)
                     {
                         /*fprintf(stderr,"arc passed second overlap j=%d %d\n", j, i); */
                         line_clip(plist1->ps, plist2->ps, polyResult);
+                        clipCalls++;
                     }
                     else
                     {
@@ -211,10 +316,28 @@ int polyIsect(PolyObject * poly1,       /* a point, line, or polygon */
            }
            itemp++;  
            } */
+        freeEdgeIndex(edges2);
         plist2 = plist2->next;
     }   /* end for (j=0 ... */
+
+    if(prep)
+    {
+        for(i = 0; i < n1; i++)
+        {
+            gpc_free_prepared_polygon(prep + i);
+            freeEdgeIndex(edges1[i]);
+        }
+        free(prep);
+        free(edges1);
+        free(ca);
+        free(cb);
+    }
     p->bb = newBBox(dummy, dummy, dummy, dummy);
     recomputeBoundingBox(p);
+    statsCount(STAT_BBOX_TESTS, bboxTests);
+    statsCount(STAT_CLIP_CALLS, clipCalls);
+    statsCount(STAT_COVERED_PAIRS, coveredPairs);
+    statsCountPoly(p);
 
     /* return whether there was a non-empty intersection between p1 and p2 */
     return at_least_one;
@@ -263,13 +386,692 @@ int point_clip(PolyShape * p1,  /* the set of points */
     return 1;
 }
 
+/* ============================================================= */
+/* Bucket-based allocation used by polyIsect for point and line weight
+ * shapefiles.  The weight shapes are binned once into a uniform grid of
+ * buckets over poly1's bounding box, so each polygon only visits the
+ * shapes in the buckets covered by its own bounding box.  For points, each
+ * polygon contour the buckets touched by an edge are flagged; the other
+ * buckets lie wholly inside or outside the contour, so a single InPoly
+ * test per bucket classifies all of their points.  Points in flagged
+ * buckets still get the exact InPoly test, so points on a vertex or an
+ * edge are treated as in point_clip. */
+
+#define BKT_UNKNOWN  0
+#define BKT_BOUNDARY 1
+#define BKT_IN       2
+#define BKT_OUT      3
+
+/* target number of shapes per bucket */
+#define SHAPES_PER_BUCKET 2
+#define MAX_BUCKETS    4000000
+
+typedef struct _ShapeBuckets {
+    double xorig, yorig;
+    double dx, dy;
+    int nbx, nby;
+    int *start;                 /* nbx*nby+1 offsets into shp */
+    int *shp;                   /* shape indices, per bucket */
+} ShapeBuckets;
+
+/* a polygon contour prepared for point tests */
+typedef struct _PreparedContour {
+    Shape *shp;
+    int cx0, cy0;               /* first bucket covered by the contour */
+    int ncx, ncy;               /* number of buckets covered */
+    char *status;               /* BKT_* per bucket, NULL if not prepared */
+} PreparedContour;
+
+
+static int bucketCol(ShapeBuckets * pb, double x)
+{
+    int c = (int) floor((x - pb->xorig) / pb->dx);
+
+    return (c < 0) ? 0 : ((c >= pb->nbx) ? pb->nbx - 1 : c);
+}
+
+static int bucketRow(ShapeBuckets * pb, double y)
+{
+    int r = (int) floor((y - pb->yorig) / pb->dy);
+
+    return (r < 0) ? 0 : ((r >= pb->nby) ? pb->nby - 1 : r);
+}
+
+static int compInt(const void *a, const void *b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+
+/* bin the shapes of plists[0..n-1] into buckets over bb */
+static int buildShapeBuckets(ShapeBuckets * pb, PolyShapeList ** plists,
+                             int n, BoundingBox * bb)
+{
+    double w = bb->xmax - bb->xmin;
+    double h = bb->ymax - bb->ymin;
+    double nb, mw = 0.0, mh = 0.0;
+    int i, c, r, c0, c1, r0, r1, b;
+    int nbuckets;
+    int *fill;
+
+    nb = (double) n / SHAPES_PER_BUCKET;
+    if(nb > MAX_BUCKETS)
+    {
+        nb = MAX_BUCKETS;
+    }
+    if(w > 0.0 && h > 0.0)
+    {
+        pb->nbx = (int) sqrt(nb * w / h);
+        pb->nby = (int) sqrt(nb * h / w);
+    }
+    else if(w > 0.0)
+    {
+        pb->nbx = (int) nb;
+        pb->nby = 1;
+    }
+    else
+    {
+        pb->nbx = 1;
+        pb->nby = (h > 0.0) ? (int) nb : 1;
+    }
+    /* keep buckets at least as large as the average shape so that lines
+     * are not copied into many buckets */
+    for(i = 0; i < n; i++)
+    {
+        mw += plists[i]->bb->xmax - plists[i]->bb->xmin;
+        mh += plists[i]->bb->ymax - plists[i]->bb->ymin;
+    }
+    if(n > 0 && mw > 0.0)
+    {
+        pb->nbx = MIN(pb->nbx, (int) (w * n / mw));
+    }
+    if(n > 0 && mh > 0.0)
+    {
+        pb->nby = MIN(pb->nby, (int) (h * n / mh));
+    }
+    pb->nbx = MAX(1, MIN(pb->nbx, MAX_BUCKETS));
+    pb->nby = MAX(1, MIN(pb->nby, MAX_BUCKETS / pb->nbx));
+    pb->xorig = bb->xmin;
+    pb->yorig = bb->ymin;
+    pb->dx = (w > 0.0) ? w / pb->nbx : 1.0;
+    pb->dy = (h > 0.0) ? h / pb->nby : 1.0;
+
+    nbuckets = pb->nbx * pb->nby;
+    pb->start = (int *) calloc(nbuckets + 1, sizeof(int));
+    fill = (int *) calloc(nbuckets, sizeof(int));
+    if(!pb->start || !fill)
+    {
+        return 0;
+    }
+
+    /* count, then fill, the shapes in each bucket */
+    for(i = 0; i < n; i++)
+    {
+        c0 = bucketCol(pb, plists[i]->bb->xmin);
+        c1 = bucketCol(pb, plists[i]->bb->xmax);
+        r0 = bucketRow(pb, plists[i]->bb->ymin);
+        r1 = bucketRow(pb, plists[i]->bb->ymax);
+        for(r = r0; r <= r1; r++)
+        {
+            for(c = c0; c <= c1; c++)
+            {
+                pb->start[r * pb->nbx + c + 1]++;
+            }
+        }
+    }
+    for(b = 0; b < nbuckets; b++)
+    {
+        pb->start[b + 1] += pb->start[b];
+    }
+    pb->shp = (int *) malloc(MAX(1, pb->start[nbuckets]) * sizeof(int));
+    if(!pb->shp)
+    {
+        free(fill);
+        return 0;
+    }
+    for(i = 0; i < n; i++)
+    {
+        c0 = bucketCol(pb, plists[i]->bb->xmin);
+        c1 = bucketCol(pb, plists[i]->bb->xmax);
+        r0 = bucketRow(pb, plists[i]->bb->ymin);
+        r1 = bucketRow(pb, plists[i]->bb->ymax);
+        for(r = r0; r <= r1; r++)
+        {
+            for(c = c0; c <= c1; c++)
+            {
+                b = r * pb->nbx + c;
+                pb->shp[pb->start[b] + fill[b]++] = i;
+            }
+        }
+    }
+    free(fill);
+    return 1;
+}
+
+
+/* flag the buckets an edge from a to b passes through.  The column and
+ * row ranges are padded by one bucket, so a point on or within round-off
+ * of the edge, e.g. on a vertical edge along a bucket boundary, never
+ * falls in a bucket that is cached as all in or all out. */
+static void markEdgeBuckets(ShapeBuckets * pb, PreparedContour * pc,
+                            Vertex * a, Vertex * b)
+{
+    int c, c0, c1, r, r0, r1, rmin, rmax;
+    double x0, x1, y0, y1;
+    double xa, xb, ya, yb;
+
+    if(a->x > b->x)
+    {
+        Vertex *t = a;
+        a = b;
+        b = t;
+    }
+    c0 = MAX(0, bucketCol(pb, a->x) - 1);
+    c1 = MIN(pb->nbx - 1, bucketCol(pb, b->x) + 1);
+    rmin = MAX(0, bucketRow(pb, MIN(a->y, b->y)) - 1);
+    rmax = MIN(pb->nby - 1, bucketRow(pb, MAX(a->y, b->y)) + 1);
+
+    for(c = c0; c <= c1; c++)
+    {
+        if(a->x == b->x)
+        {
+            r0 = rmin;
+            r1 = rmax;
+        }
+        else
+        {
+            /* clip the edge to the x extent of this column; the padding
+             * columns get the nearer end point */
+            x0 = pb->xorig + c * pb->dx;
+            x1 = x0 + pb->dx;
+            xa = MIN(MAX(x0, a->x), b->x);
+            xb = MAX(MIN(x1, b->x), a->x);
+            ya = a->y + (b->y - a->y) * (xa - a->x) / (b->x - a->x);
+            yb = a->y + (b->y - a->y) * (xb - a->x) / (b->x - a->x);
+            y0 = MIN(ya, yb);
+            y1 = MAX(ya, yb);
+            r0 = MAX(rmin, bucketRow(pb, y0) - 1);
+            r1 = MIN(rmax, bucketRow(pb, y1) + 1);
+        }
+        for(r = r0; r <= r1; r++)
+        {
+            if(c >= pc->cx0 && c < pc->cx0 + pc->ncx &&
+               r >= pc->cy0 && r < pc->cy0 + pc->ncy)
+            {
+                pc->status[(r - pc->cy0) * pc->ncx + (c - pc->cx0)] =
+                    BKT_BOUNDARY;
+            }
+        }
+    }
+}
+
+
+/* set up bucket status for a contour.  Preparing is skipped when the
+ * contour is expected to see too few points to pay for it. */
+static int prepareContour(ShapeBuckets * pb, PreparedContour * pc,
+                          Shape * shp, int npoints)
+{
+    int i, n = shp->num_vertices;
+    double xmin, xmax, ymin, ymax;
+    Vertex *v = shp->vertex;
+
+    pc->shp = shp;
+    pc->status = NULL;
+    if(n < 3)
+    {
+        return 1;
+    }
+    xmin = xmax = v[0].x;
+    ymin = ymax = v[0].y;
+    for(i = 1; i < n; i++)
+    {
+        xmin = MIN(xmin, v[i].x);
+        xmax = MAX(xmax, v[i].x);
+        ymin = MIN(ymin, v[i].y);
+        ymax = MAX(ymax, v[i].y);
+    }
+
+    /* pad by one bucket so that anything outside the range is well
+     * clear of the contour */
+    pc->cx0 = MAX(0, bucketCol(pb, xmin) - 1);
+    pc->cy0 = MAX(0, bucketRow(pb, ymin) - 1);
+    pc->ncx = MIN(pb->nbx - 1, bucketCol(pb, xmax) + 1) - pc->cx0 + 1;
+    pc->ncy = MIN(pb->nby - 1, bucketRow(pb, ymax) + 1) - pc->cy0 + 1;
+
+    if((double) npoints * n <= (double) pc->ncx * pc->ncy + 2.0 * n)
+    {
+        return 1;
+    }
+    pc->status = (char *) calloc(pc->ncx * pc->ncy, sizeof(char));
+    if(!pc->status)
+    {
+        return 0;
+    }
+    for(i = 0; i < n; i++)
+    {
+        markEdgeBuckets(pb, pc, v + i, v + (i + n - 1) % n);
+    }
+    return 1;
+}
+
+
+/* InPoly for a prepared contour */
+static int inPreparedContour(ShapeBuckets * pb, PreparedContour * pc,
+                             Vertex * q)
+{
+    int c, r, k;
+    char *st;
+
+    if(!pc->status)
+    {
+        return InPoly(q, pc->shp);
+    }
+    c = bucketCol(pb, q->x) - pc->cx0;
+    r = bucketRow(pb, q->y) - pc->cy0;
+    if(c < 0 || r < 0 || c >= pc->ncx || r >= pc->ncy)
+    {
+        return OUT;
+    }
+    st = pc->status + r * pc->ncx + c;
+    if(*st == BKT_IN)
+    {
+        return IN;
+    }
+    if(*st == BKT_OUT)
+    {
+        return OUT;
+    }
+    k = InPoly(q, pc->shp);
+    if(*st == BKT_UNKNOWN)
+    {
+        if(k == IN)
+        {
+            *st = BKT_IN;
+        }
+        else if(k == OUT)
+        {
+            *st = BKT_OUT;
+        }
+    }
+    return k;
+}
+
+
+/* point_clip against a prepared polygon.  The loop order and the
+ * early return on a vertex match point_clip. */
+static int prepared_point_clip(ShapeBuckets * pb, PolyShape * p1,
+                               PreparedContour * pc, int n2, PolyShape * p)
+{
+    int n1 = p1->num_contours;
+    int i, j;
+    int k;
+    Shape *shp;
+
+    for(j = 0; j < n2; j++)
+    {
+        for(i = 0; i < n1; i++)
+        {
+            shp = p1->contour + i;
+            k = inPreparedContour(pb, pc + j, shp->vertex);
+            if(k == VTX)
+            {
+                WARN("Point coincides with Vertex. Special attention needed");
+                return 0;
+            }
+            if(k != OUT)
+            {
+                gpc_add_contour(p, shp, SOLID_POLYGON);
+            }
+        }
+    }
+    return 1;
+}
+
+
+/* Intersect the point or line shapes in poly1 with the polygons in
+ * poly2, appending the results to p in the same order as polyIsect.
+ * Returns 1 if any intersection was found, 0 if none was, and -1 on
+ * error. */
+static int bucketIsect(PolyObject * poly1, PolyObject * poly2, PolyObject * p,
+                      Parent ** p1, Parent ** p2)
+{
+    int n1 = poly1->nObjects;
+    int n2 = poly2->nObjects;
+    int i, j, k, b, c, r;
+    int c0, c1, r0, r1;
+    int ncand, npts;
+    int at_least_one = 0;
+    int *cand, *stamp;
+    int nprep = 0;
+    long bboxTests = 0, clipCalls = 0;
+    PreparedContour *pc = NULL;
+    ShapeBuckets pb;
+    PolyShapeList **plists;
+    PolyShapeList *plist, *plist2;
+    PolyShape *polyResult;
+    PolyParent *pp;
+
+    pb.start = NULL;
+    pb.shp = NULL;
+    plists = (PolyShapeList **) malloc(MAX(1, n1) * sizeof(PolyShapeList *));
+    cand = (int *) malloc(MAX(1, n1) * sizeof(int));
+    stamp = (int *) calloc(MAX(1, n1), sizeof(int));
+    if(!plists || !cand || !stamp)
+    {
+        WARN("Allocation error in bucketIsect");
+        return -1;
+    }
+    plist = poly1->plist;
+    for(i = 0; i < n1; i++)
+    {
+        plists[i] = plist;
+        plist = plist->next;
+    }
+    if(!buildShapeBuckets(&pb, plists, n1, poly1->bb))
+    {
+        WARN("Allocation error in bucketIsect");
+        return -1;
+    }
+
+    plist2 = poly2->plist;
+    for(j = 0; j < n2; j++, plist2 = plist2->next)
+    {
+        bboxTests++;
+        if(!OVERLAP2(poly1->bb, plist2->bb))
+        {
+            continue;
+        }
+
+        /* gather the shapes whose boxes overlap this polygon */
+        ncand = 0;
+        npts = 0;
+        c0 = bucketCol(&pb, plist2->bb->xmin);
+        c1 = bucketCol(&pb, plist2->bb->xmax);
+        r0 = bucketRow(&pb, plist2->bb->ymin);
+        r1 = bucketRow(&pb, plist2->bb->ymax);
+        for(r = r0; r <= r1; r++)
+        {
+            for(c = c0; c <= c1; c++)
+            {
+                b = r * pb.nbx + c;
+                for(k = pb.start[b]; k < pb.start[b + 1]; k++)
+                {
+                    i = pb.shp[k];
+                    if(stamp[i] != j + 1)
+                    {
+                        stamp[i] = j + 1;
+                        bboxTests++;
+                        if(OVERLAP2(plists[i]->bb, plist2->bb))
+                        {
+                            cand[ncand++] = i;
+                            npts += plists[i]->ps->num_contours;
+                        }
+                    }
+                }
+            }
+        }
+        if(ncand == 0)
+        {
+            continue;
+        }
+        clipCalls += ncand;
+        /* keep the output in poly1 order */
+        qsort(cand, ncand, sizeof(int), compInt);
+
+        if(poly1->nSHPType == SHPT_ARC)
+        {
+            for(k = 0; k < ncand; k++)
+            {
+                i = cand[k];
+                polyResult = getNewPolyShape(0);
+                if(polyResult == NULL)
+                {
+                    WARN("Malloc error for getNewPolyShape");
+                    return -1;
+                }
+                line_clip(plists[i]->ps, plist2->ps, polyResult);
+                if(polyResult->num_contours)
+                {
+                    at_least_one = 1;
+                    p->nObjects++;
+                    pp = newPolyParent(p1[i], p2[j]);
+                    polyShapeIncl(&(p->plist), polyResult, pp);
+                }
+                else
+                {
+                    freePolyShape(polyResult);
+                }
+            }
+            continue;
+        }
+
+        if(plist2->ps->num_contours > nprep)
+        {
+            free(pc);
+            nprep = plist2->ps->num_contours;
+            pc = (PreparedContour *) malloc(nprep * sizeof(PreparedContour));
+            if(!pc)
+            {
+                WARN("Allocation error in bucketIsect");
+                return -1;
+            }
+        }
+        for(k = 0; k < plist2->ps->num_contours; k++)
+        {
+            if(!prepareContour(&pb, pc + k, plist2->ps->contour + k, npts))
+            {
+                WARN("Allocation error in bucketIsect");
+                return -1;
+            }
+        }
+
+        for(k = 0; k < ncand; k++)
+        {
+            i = cand[k];
+            polyResult = getNewPolyShape(0);
+            if(polyResult == NULL)
+            {
+                WARN("Malloc error for getNewPolyShape");
+                return -1;
+            }
+            prepared_point_clip(&pb, plists[i]->ps, pc,
+                                plist2->ps->num_contours, polyResult);
+            if(polyResult->num_contours)
+            {
+                at_least_one = 1;
+                p->nObjects++;
+                pp = newPolyParent(p1[i], p2[j]);
+                polyShapeIncl(&(p->plist), polyResult, pp);
+            }
+            else
+            {
+                freePolyShape(polyResult);
+            }
+        }
+
+        for(k = 0; k < plist2->ps->num_contours; k++)
+        {
+            free(pc[k].status);
+        }
+    }
+
+    free(pc);
+    free(plists);
+    free(cand);
+    free(stamp);
+    free(pb.start);
+    free(pb.shp);
+    statsCount(STAT_BBOX_TESTS, bboxTests);
+    statsCount(STAT_CLIP_CALLS, clipCalls);
+    return at_least_one;
+}
+
+
+/* ============================================================= */
+/* Edge index used by line_clip for polygon contours with many vertices.
+ * The contour's edges are binned into horizontal strips so that each
+ * line segment is only tested against the edges in the strips it
+ * crosses.  Candidates are returned in increasing edge order, the same
+ * order in which line_clip would visit them. */
+
+#define EDGE_INDEX_MIN_VERTICES 64
+#define EDGES_PER_STRIP 4
+
+/* the strips of one contour; line_clip keeps its own, so that it can
+ * be called from several threads at once */
+typedef struct _EdgeStrips {
+    int *start;                 /* strip offsets into edge */
+    int *edge;                  /* edge numbers, per strip */
+    int *stamp;                 /* last query that saw each edge */
+    int nstrips;
+    int query;
+    double ymin, dy;
+    int size, edge_size, start_size;
+} EdgeStrips;
+
+static int edgeStrip(EdgeStrips * es, double y)
+{
+    int s = (int) floor((y - es->ymin) / es->dy);
+
+    return (s < 0) ? 0 : ((s >= es->nstrips) ? es->nstrips - 1 : s);
+}
+
+static int buildEdgeStrips(EdgeStrips * es, Shape * shp2, BoundingBox * cb)
+{
+    int n = shp2->num_vertices;
+    int i, nn, s, s0, s1, total;
+    Vertex *v = shp2->vertex;
+
+    es->nstrips = MAX(1, n / EDGES_PER_STRIP);
+    es->ymin = cb->ymin;
+    es->dy = (cb->ymax > cb->ymin) ?
+        (cb->ymax - cb->ymin) / es->nstrips : 1.0;
+
+    if(n > es->size)
+    {
+        es->size = n;
+        es->stamp = (int *) realloc(es->stamp, es->size * sizeof(int));
+        if(es->stamp == NULL)
+        {
+            return 0;
+        }
+    }
+    if(es->nstrips + 1 > es->start_size)
+    {
+        es->start_size = es->nstrips + 1;
+        es->start = (int *) realloc(es->start, es->start_size * sizeof(int));
+        if(es->start == NULL)
+        {
+            return 0;
+        }
+    }
+    memset(es->start, 0, (es->nstrips + 1) * sizeof(int));
+    memset(es->stamp, 0, n * sizeof(int));
+    es->query = 0;
+
+    for(i = 0; i < n; i++)
+    {
+        nn = (i + 1) % n;
+        s0 = edgeStrip(es, MIN(v[i].y, v[nn].y));
+        s1 = edgeStrip(es, MAX(v[i].y, v[nn].y));
+        for(s = s0; s <= s1; s++)
+        {
+            es->start[s + 1]++;
+        }
+    }
+    for(s = 0; s < es->nstrips; s++)
+    {
+        es->start[s + 1] += es->start[s];
+    }
+    total = es->start[es->nstrips];
+    if(total > es->edge_size)
+    {
+        es->edge_size = total;
+        es->edge = (int *) realloc(es->edge, es->edge_size * sizeof(int));
+        if(es->edge == NULL)
+        {
+            return 0;
+        }
+    }
+    /* fill in edge order; start[s] is advanced as strip s fills */
+    for(i = 0; i < n; i++)
+    {
+        nn = (i + 1) % n;
+        s0 = edgeStrip(es, MIN(v[i].y, v[nn].y));
+        s1 = edgeStrip(es, MAX(v[i].y, v[nn].y));
+        for(s = s0; s <= s1; s++)
+        {
+            es->edge[es->start[s]++] = i;
+        }
+    }
+    for(s = es->nstrips; s > 0; s--)
+    {
+        es->start[s] = es->start[s - 1];
+    }
+    es->start[0] = 0;
+    return 1;
+}
+
+/* the edges whose strips overlap the y range of segment a-b */
+static int edgeCandidates(EdgeStrips * es, Vertex * a, Vertex * b, int *cand)
+{
+    int s, k, e, nc = 0;
+    int s0 = edgeStrip(es, MIN(a->y, b->y));
+    int s1 = edgeStrip(es, MAX(a->y, b->y));
+
+    es->query++;
+    for(s = s0; s <= s1; s++)
+    {
+        for(k = es->start[s]; k < es->start[s + 1]; k++)
+        {
+            e = es->edge[k];
+            if(es->stamp[e] != es->query)
+            {
+                es->stamp[e] = es->query;
+                cand[nc++] = e;
+            }
+        }
+    }
+    if(s1 > s0)
+    {
+        qsort(cand, nc, sizeof(int), compInt);
+    }
+    return nc;
+}
+
+/* the bounding box of the vertices of a contour */
+static void contourBBox(Shape * shp, BoundingBox * bb)
+{
+    int i;
+
+    bb->xmin = bb->xmax = shp->vertex[0].x;
+    bb->ymin = bb->ymax = shp->vertex[0].y;
+    for(i = 1; i < shp->num_vertices; i++)
+    {
+        bb->xmin = MIN(bb->xmin, shp->vertex[i].x);
+        bb->xmax = MAX(bb->xmax, shp->vertex[i].x);
+        bb->ymin = MIN(bb->ymin, shp->vertex[i].y);
+        bb->ymax = MAX(bb->ymax, shp->vertex[i].y);
+    }
+}
+
+/* whether the boxes of segments a-b and c-d overlap */
+#define SEG_OVERLAP(a, b, c, d) \
+    (OVERLAP0(MIN((a)->x, (b)->x), MAX((a)->x, (b)->x), \
+              MIN((c)->x, (d)->x), MAX((c)->x, (d)->x)) && \
+     OVERLAP0(MIN((a)->y, (b)->y), MAX((a)->y, (b)->y), \
+              MIN((c)->y, (d)->y), MAX((c)->y, (d)->y)))
+
 
 /* ============================================================= */
 /* Intersect a set of lines (in p1) with a polygon (in p2) and return 
  * the intersection result in p (i.e. the portions of the lines that  
  * fall within the polygon.  The integer return value is 0 if an 
  * error occurred, and 1 if the computation was successful.  
- * Modified by dyang: 01/2014, : to pass isHole to addLineSegment. */
+ * Modified by dyang: 01/2014, : to pass isHole to addLineSegment. 
+ * Segments whose boxes miss a contour's box are skipped, and large
+ * contours only have their edges near each segment tested.  All of the
+ * scratch space is allocated per call, so line_clip is reentrant. */
 
 int line_clip(PolyShape * p1, PolyShape * p2, PolyShape * p)
 {
@@ -284,8 +1086,15 @@ int line_clip(PolyShape * p1, PolyShape * p2, PolyShape * p)
     Vertex v;
     Vertex *v0;
     Vertex vm;
-    static Isect *vis;
-    static int vi_size = 0;
+    Isect *vis = NULL;
+    int vi_size;
+    BoundingBox *cbb = NULL;
+    int *ecand = NULL;
+    int ecand_size = 0;
+    EdgeStrips es;
+    int status = 0;
+    BoundingBox lb;
+    int indexed, ne, e;
     int m;
     int nn, kk;
     intersection_type c;
@@ -296,29 +1105,77 @@ int line_clip(PolyShape * p1, PolyShape * p2, PolyShape * p)
     int comp_y_p_vertex(const void *, const void *);
     int comp_y_n_vertex(const void *, const void *);
 
-    if(vi_size == 0)
+    memset(&es, 0, sizeof(es));
+    vi_size = 64;
+    vis = (Isect *) malloc(vi_size * sizeof(Isect));
+    cbb = (BoundingBox *) malloc(MAX(1, n2) * sizeof(BoundingBox));
+    if(vis == NULL || cbb == NULL)
     {
-        vi_size = 1024;
-        vis = (Isect *) malloc(vi_size * sizeof(Isect));
-        if(vis == NULL)
-        {
-            WARN("Allocation error in line_clip");
-            return 0;
-        }
+        goto done;
+    }
+    for(j = 0; j < n2; j++)
+    {
+        contourBBox(p2->contour + j, cbb + j);
+        ecand_size = MAX(ecand_size, p2->contour[j].num_vertices);
+    }
+    ecand = (int *) malloc(MAX(1, ecand_size) * sizeof(int));
+    if(ecand == NULL)
+    {
+        goto done;
     }
+
     for(i = 0; i < n1; i++)
     {
         shp1 = p1->contour + i;
         isHole = p1-> hole[i];
+        if(shp1->num_vertices < 1)
+        {
+            continue;
+        }
+        contourBBox(shp1, &lb);
 
         for(j = 0; j < n2; j++)
         {
             shp2 = p2->contour + j;
+            if(shp2->num_vertices < 1 || !OVERLAP2((&lb), (cbb + j)))
+            {
+                continue;
+            }
+            indexed = 0;
             for(k = 0; k < shp1->num_vertices - 1; k++)
             {                   /* loop over line segs */
                 m = 0;
                 kk = k + 1;
 
+                /* a segment clear of the contour's box adds nothing */
+                if(!OVERLAP0(MIN(shp1->vertex[k].x, shp1->vertex[kk].x),
+                             MAX(shp1->vertex[k].x, shp1->vertex[kk].x),
+                             cbb[j].xmin, cbb[j].xmax) ||
+                   !OVERLAP0(MIN(shp1->vertex[k].y, shp1->vertex[kk].y),
+                             MAX(shp1->vertex[k].y, shp1->vertex[kk].y),
+                             cbb[j].ymin, cbb[j].ymax))
+                {
+                    continue;
+                }
+
+                if(!indexed && shp2->num_vertices >= EDGE_INDEX_MIN_VERTICES)
+                {
+                    if(!buildEdgeStrips(&es, shp2, cbb + j))
+                    {
+                        goto done;
+                    }
+                    indexed = 1;
+                }
+                if(indexed)
+                {
+                    ne = edgeCandidates(&es, shp1->vertex + k,
+                                        shp1->vertex + kk, ecand);
+                }
+                else
+                {
+                    ne = shp2->num_vertices;
+                }
+
                 l = InPoly(shp1->vertex + k, shp2);     /* left edge of segment? */
                 if(l == IN)
                 {
@@ -328,24 +1185,33 @@ int line_clip(PolyShape * p1, PolyShape * p2, PolyShape * p)
                     m++;
                 }
 
-                for(n = 0; n < shp2->num_vertices; n++)
+                for(e = 0; e < ne; e++)
                 {               /* loop over poly segs */
+                    n = indexed ? ecand[e] : e;
                     nn = (n + 1) % shp2->num_vertices;
+                    if(!SEG_OVERLAP(shp1->vertex + k, shp1->vertex + kk,
+                                    shp2->vertex + n, shp2->vertex + nn))
+                    {
+                        continue;
+                    }
                     /* compute the intersection of 2 line segments */
                     c = SegSegInt(shp1->vertex + k, shp1->vertex + kk,
                                   shp2->vertex + n, shp2->vertex + nn, &v);
                     if(c != NO_INT)
                     {
-                        if(m - 1 > vi_size)
+                        /* room for two points here and the right end */
+                        if(m + 2 >= vi_size)
                         {
+                            Isect *grown;
+
                             vi_size *= 2;
-                            vis =
+                            grown =
                                 (Isect *) realloc(vis, vi_size * sizeof(Isect));
-                            if(vis == NULL)
+                            if(grown == NULL)
                             {
-                                WARN("Allocation error in line_clip");
-                                return 0;
+                                goto done;
                             }
+                            vis = grown;
                         }
                         vis[m].v.x = v.x;
                         vis[m].v.y = v.y;
@@ -508,9 +1374,362 @@ int line_clip(PolyShape * p1, PolyShape * p2, PolyShape * p)
             }
         }
     }
-    return 1;
+    status = 1;
+
+  done:
+    if(!status)
+    {
+        WARN("Allocation error in line_clip");
+    }
+    free(vis);
+    free(cbb);
+    free(ecand);
+    free(es.start);
+    free(es.edge);
+    free(es.stamp);
+    return status;
+}
+
+
+
+/* ============================================================= */
+/* Containment pre-pass used by polyIsect for polygon pairs.  Before a
+ * pair is clipped, the edges of the two shapes inside the overlap of
+ * their boxes are tested for crossings.  If no edge of one touches an
+ * edge of the other, each contour lies wholly inside or outside the
+ * other shape, so one vertex per contour tells whether one shape
+ * covers the other (a tract inside a grid cell, or a grid cell inside
+ * a county) or the two are apart.  A covered shape is copied unchanged
+ * and a pair that is apart gives nothing; only pairs whose boundaries
+ * meet are clipped by gpc.  Shapes with many edges keep their edges in
+ * horizontal strips, as in line_clip, so that each test only visits
+ * the edges near the other shape. */
+
+/* the edges of a polygon, in horizontal strips */
+struct _EdgeIndex {
+    PolyShape *ps;
+    int nedges;
+    Vertex **ea, **eb;          /* edge end points */
+    BoundingBox bb;
+    double dy;
+    int nstrips;
+    int *start;                 /* nstrips+1 offsets into edge */
+    int *edge;                  /* edge numbers, per strip */
+    int *stamp;                 /* last query that saw each edge */
+    int query;
+};
+
+static int coverStrip(EdgeIndex * ei, double y)
+{
+    int s = (int) floor((y - ei->bb.ymin) / ei->dy);
+
+    return (s < 0) ? 0 : ((s >= ei->nstrips) ? ei->nstrips - 1 : s);
+}
+
+/* index the edges of the contours of ps that have an area */
+static EdgeIndex *newEdgeIndex(PolyShape * ps)
+{
+    int c, i, n, e, s, s0, s1, total;
+    Vertex *v, *a, *b;
+    EdgeIndex *ei;
+
+    ei = (EdgeIndex *) calloc(1, sizeof(EdgeIndex));
+    if(!ei)
+    {
+        return NULL;
+    }
+    ei->ps = ps;
+    for(c = 0; c < ps->num_contours; c++)
+    {
+        if(ps->contour[c].num_vertices >= 3)
+        {
+            ei->nedges += ps->contour[c].num_vertices;
+        }
+    }
+    if(ei->nedges == 0)
+    {
+        return ei;
+    }
+    ei->ea = (Vertex **) malloc(ei->nedges * sizeof(Vertex *));
+    ei->eb = (Vertex **) malloc(ei->nedges * sizeof(Vertex *));
+    ei->stamp = (int *) calloc(ei->nedges, sizeof(int));
+    if(!ei->ea || !ei->eb || !ei->stamp)
+    {
+        freeEdgeIndex(ei);
+        return NULL;
+    }
+    e = 0;
+    for(c = 0; c < ps->num_contours; c++)
+    {
+        n = ps->contour[c].num_vertices;
+        if(n < 3)
+        {
+            continue;
+        }
+        v = ps->contour[c].vertex;
+        for(i = 0; i < n; i++, e++)
+        {
+            ei->ea[e] = v + i;
+            ei->eb[e] = v + (i + 1) % n;
+            if(e == 0)
+            {
+                ei->bb.xmin = ei->bb.xmax = v[i].x;
+                ei->bb.ymin = ei->bb.ymax = v[i].y;
+            }
+            ei->bb.xmin = MIN(ei->bb.xmin, v[i].x);
+            ei->bb.xmax = MAX(ei->bb.xmax, v[i].x);
+            ei->bb.ymin = MIN(ei->bb.ymin, v[i].y);
+            ei->bb.ymax = MAX(ei->bb.ymax, v[i].y);
+        }
+    }
+
+    ei->nstrips = (ei->nedges >= EDGE_INDEX_MIN_VERTICES) ?
+        ei->nedges / EDGES_PER_STRIP : 1;
+    ei->dy = (ei->bb.ymax > ei->bb.ymin) ?
+        (ei->bb.ymax - ei->bb.ymin) / ei->nstrips : 1.0;
+    ei->start = (int *) calloc(ei->nstrips + 1, sizeof(int));
+    if(!ei->start)
+    {
+        freeEdgeIndex(ei);
+        return NULL;
+    }
+    for(e = 0; e < ei->nedges; e++)
+    {
+        a = ei->ea[e];
+        b = ei->eb[e];
+        s0 = coverStrip(ei, MIN(a->y, b->y));
+        s1 = coverStrip(ei, MAX(a->y, b->y));
+        for(s = s0; s <= s1; s++)
+        {
+            ei->start[s + 1]++;
+        }
+    }
+    for(s = 0; s < ei->nstrips; s++)
+    {
+        ei->start[s + 1] += ei->start[s];
+    }
+    total = ei->start[ei->nstrips];
+    ei->edge = (int *) malloc(MAX(1, total) * sizeof(int));
+    if(!ei->edge)
+    {
+        freeEdgeIndex(ei);
+        return NULL;
+    }
+    /* ei->start[s] is advanced as strip s fills */
+    for(e = 0; e < ei->nedges; e++)
+    {
+        a = ei->ea[e];
+        b = ei->eb[e];
+        s0 = coverStrip(ei, MIN(a->y, b->y));
+        s1 = coverStrip(ei, MAX(a->y, b->y));
+        for(s = s0; s <= s1; s++)
+        {
+            ei->edge[ei->start[s]++] = e;
+        }
+    }
+    for(s = ei->nstrips; s > 0; s--)
+    {
+        ei->start[s] = ei->start[s - 1];
+    }
+    ei->start[0] = 0;
+    return ei;
+}
+
+static void freeEdgeIndex(EdgeIndex * ei)
+{
+    if(ei)
+    {
+        free(ei->ea);
+        free(ei->eb);
+        free(ei->start);
+        free(ei->edge);
+        free(ei->stamp);
+        free(ei);
+    }
+}
+
+/* the edges whose boxes overlap bb; returns -1 if there are more than
+ * max of them */
+static int edgesInBox(EdgeIndex * ei, BoundingBox * bb, int *cand, int max)
+{
+    int s, k, e, nc = 0;
+    int s0 = coverStrip(ei, bb->ymin);
+    int s1 = coverStrip(ei, bb->ymax);
+    Vertex *a, *b;
+
+    ei->query++;
+    for(s = s0; s <= s1; s++)
+    {
+        for(k = ei->start[s]; k < ei->start[s + 1]; k++)
+        {
+            e = ei->edge[k];
+            if(ei->stamp[e] == ei->query)
+            {
+                continue;
+            }
+            ei->stamp[e] = ei->query;
+            a = ei->ea[e];
+            b = ei->eb[e];
+            if(OVERLAP0(MIN(a->x, b->x), MAX(a->x, b->x), bb->xmin, bb->xmax)
+               && OVERLAP0(MIN(a->y, b->y), MAX(a->y, b->y), bb->ymin,
+                           bb->ymax))
+            {
+                if(nc == max)
+                {
+                    return -1;
+                }
+                cand[nc++] = e;
+            }
+        }
+    }
+    return nc;
+}
+
+/* the side of line a-b that c is on: 1 left, -1 right, 0 on it */
+static int orientation(Vertex * a, Vertex * b, Vertex * c)
+{
+    double d = (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+
+    return (d > 0.0) ? 1 : ((d < 0.0) ? -1 : 0);
+}
+
+/* whether c, on the line through a-b, is on the segment a-b */
+#define ON_SEGMENT(a, b, c) \
+    ((c)->x >= MIN((a)->x, (b)->x) && (c)->x <= MAX((a)->x, (b)->x) && \
+     (c)->y >= MIN((a)->y, (b)->y) && (c)->y <= MAX((a)->y, (b)->y))
+
+/* whether segments a-b and c-d share a point, crossing or touching */
+static int segmentsMeet(Vertex * a, Vertex * b, Vertex * c, Vertex * d)
+{
+    int o1, o2, o3, o4;
+
+    if(!SEG_OVERLAP(a, b, c, d))
+    {
+        return 0;
+    }
+    o1 = orientation(a, b, c);
+    o2 = orientation(a, b, d);
+    o3 = orientation(c, d, a);
+    o4 = orientation(c, d, b);
+    if(o1 * o2 < 0 && o3 * o4 < 0)
+    {
+        return 1;
+    }
+    return (o1 == 0 && ON_SEGMENT(a, b, c)) ||
+        (o2 == 0 && ON_SEGMENT(a, b, d)) ||
+        (o3 == 0 && ON_SEGMENT(c, d, a)) || (o4 == 0 && ON_SEGMENT(c, d, b));
+}
+
+/* whether q is inside the polygon of ei, by the even-odd rule as gpc
+ * reads it.  q must not be on an edge. */
+static int insideEdgeIndex(EdgeIndex * ei, Vertex * q)
+{
+    int s, k, e, in = 0;
+    Vertex *a, *b;
+
+    if(ei->nedges == 0 || q->y < ei->bb.ymin || q->y > ei->bb.ymax ||
+       q->x < ei->bb.xmin || q->x > ei->bb.xmax)
+    {
+        return 0;
+    }
+    s = coverStrip(ei, q->y);
+    for(k = ei->start[s]; k < ei->start[s + 1]; k++)
+    {
+        e = ei->edge[k];
+        a = ei->ea[e];
+        b = ei->eb[e];
+        if((a->y > q->y) != (b->y > q->y) &&
+           q->x < a->x + (q->y - a->y) * (b->x - a->x) / (b->y - a->y))
+        {
+            in = !in;
+        }
+    }
+    return in;
+}
+
+/* which of the contours of ps with an area are inside the polygon of
+ * ei: sets *all if every one is and *any if one is */
+static void contoursInside(PolyShape * ps, EdgeIndex * ei, int *all, int *any)
+{
+    int c;
+
+    *all = 1;
+    *any = 0;
+    for(c = 0; c < ps->num_contours; c++)
+    {
+        if(ps->contour[c].num_vertices < 3)
+        {
+            continue;
+        }
+        if(insideEdgeIndex(ei, ps->contour[c].vertex))
+        {
+            *any = 1;
+        }
+        else
+        {
+            *all = 0;
+        }
+    }
 }
 
+/* classify a pair of polygons as COVER_*; ca and cb are scratch arrays
+ * of COVER_MAX_EDGE_PAIRS edges */
+static int coverPair(EdgeIndex * e1, EdgeIndex * e2, int *ca, int *cb)
+{
+    BoundingBox ob;
+    int n1, n2, i, j;
+    int all1, any1, all2, any2;
+
+    if(e1->nedges == 0 || e2->nedges == 0)
+    {
+        return COVER_BOUNDARY;
+    }
+    ob.xmin = MAX(e1->bb.xmin, e2->bb.xmin);
+    ob.xmax = MIN(e1->bb.xmax, e2->bb.xmax);
+    ob.ymin = MAX(e1->bb.ymin, e2->bb.ymin);
+    ob.ymax = MIN(e1->bb.ymax, e2->bb.ymax);
+    if(ob.xmin > ob.xmax || ob.ymin > ob.ymax)
+    {
+        return COVER_OUTSIDE;
+    }
+
+    n1 = edgesInBox(e1, &ob, ca, COVER_MAX_EDGE_PAIRS);
+    n2 = edgesInBox(e2, &ob, cb, COVER_MAX_EDGE_PAIRS);
+    if(n1 < 0 || n2 < 0 ||
+       (n1 > 0 && n2 > COVER_MAX_EDGE_PAIRS / n1))
+    {
+        return COVER_BOUNDARY;
+    }
+    for(i = 0; i < n1; i++)
+    {
+        for(j = 0; j < n2; j++)
+        {
+            if(segmentsMeet(e1->ea[ca[i]], e1->eb[ca[i]],
+                            e2->ea[cb[j]], e2->eb[cb[j]]))
+            {
+                return COVER_BOUNDARY;
+            }
+        }
+    }
+
+    /* no boundary meets the other, so each contour is wholly inside or
+     * outside the other polygon */
+    contoursInside(e1->ps, e2, &all1, &any1);
+    contoursInside(e2->ps, e1, &all2, &any2);
+    if(all1 && !any2)
+    {
+        return COVER_INSIDE;
+    }
+    if(all2 && !any1)
+    {
+        return COVER_CONTAINS;
+    }
+    if(!any1 && !any2)
+    {
+        return COVER_OUTSIDE;
+    }
+    return COVER_BOUNDARY;
+}
 
 
 /* ============================================================= */
@@ -10,6 +10,7 @@
 #define ENVT_SRG_OUTPUTNUM "WRITE_SRG_NUMERATOR"
 #define ENVT_SRG_OUTPUTDEN "WRITE_SRG_DENOMINATOR"
 #define ENVT_SURROGATE_FILE "SURROGATE_FILE"
+#define ENVT_SURROGATE_BINARY_FILE "SURROGATE_BINARY_FILE"
 #define ENVT_DATA_FILE_NAME_TYPE "DATA_FILE_NAME_TYPE"
 #define ENVT_DATA_FILE_NAME "DATA_FILE_NAME"
 #define ENVT_DATA_ID_ATTR "DATA_ID_ATTR"
@@ -62,6 +63,15 @@
 #define ENVT_WRITE_HEADER "WRITE_HEADER"
 #define ENVT_DEBUG_OUTPUT "DEBUG_OUTPUT"
 #define ENVT_MAX_INPUT_FILE_SHAPES "MAX_INPUT_FILE_SHAPES"
+#define ENVT_OVERLAY_CHUNK_JOBS "OVERLAY_CHUNK_JOBS"
+#define ENVT_SRGMERGE_THREADS "SRGMERGE_THREADS"
+#define ENVT_SRGBATCH_JOBS "SRGBATCH_JOBS"
+#define ENVT_POINT_FILE_THREADS "POINT_FILE_THREADS"
+#define ENVT_SURROGATE_THREADS "SURROGATE_THREADS"
+#define ENVT_UNION_THREADS "UNION_THREADS"
+#define ENVT_STAGE_STATS_FILE "STAGE_STATS_FILE"
+#define ENVT_STAGE_STATS_FORMAT "STAGE_STATS_FORMAT"
+#define ENVT_STAGE_STATS_LABEL "STAGE_STATS_LABEL"
 
 
 #define ENVT_X_GRID_PARTITIONS "X_GRID_PARTITIONS"
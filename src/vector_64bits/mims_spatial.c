@@ -40,9 +40,11 @@ int main(int argc, char *argv[])
     PolyObject *p_overlay;
     PolyObject *tmp_overlay;
     PolyObject *p_input;
-    PolyObject *p_result;
     PolyObject *p_wd = NULL;
     PolyObject *p_wdg = NULL;
+    Arena *chunkArena, *prevArena;
+    FILE *overlayOut;
+    int chunkJobs;
     int no_weight_attr = 0;
     int no_weight_poly = 0;
     int result;
@@ -131,6 +133,10 @@ int main(int argc, char *argv[])
     /* determine the type of processing to be performed */
     type = getSAJobType();
 
+    /* per-stage statistics, if STAGE_STATS_FILE is set; runs are
+     * labelled by processing mode */
+    statsStart(prog_name, getenv(ENVT_MIMS_PROCESSING));
+
 
     if(type == FILTER_SHAPE || type == CONVERT_SHAPE)
     {
@@ -206,7 +212,9 @@ int main(int argc, char *argv[])
 #endif
         sprintf(mesg, getenv(ENVT_INPUT_FILE_NAME));     /* use mesg as temp variable */
 
+        statsBegin("filter");
         filterDBF(mesg /*data_poly */ , filterFile, outfile);
+        statsEnd("filter");
     }
 
     else if(type == ALLOCATE)
@@ -235,6 +243,7 @@ int main(int argc, char *argv[])
 
         MESG("Using ALLOCATE mode");
 
+        statsBegin("read_output");
         getEnvtValue(ENVT_OUTPUT_FILE_TYPE, tempString);
 
         if(!strcmp(tempString, "RegularGrid") || !strcmp(tempString, "Regulargrid") ||
@@ -314,11 +323,13 @@ int main(int argc, char *argv[])
             ERROR(prog_name, mesg, 1);
         }
 
+        statsEnd("read_output");
         MESG("\nFinished reading the output file......\n");
         
 
         /* need a whole if-else block around input file types:
                 supported types are PointFile, ShapeFile, I/O API */
+        statsBegin("read_input");
         getEnvtValue(ENVT_INPUT_FILE_TYPE, tempString);
 
         if(!strcmp(tempString, "ShapeFile") || !strcmp(tempString, "Shapefile") ||
@@ -363,9 +374,11 @@ int main(int argc, char *argv[])
         }
 
 
+        statsEnd("read_input");
         MESG("\nFinished reading the input shape file......\n");
 
         /* associate the attributes of the weight file with their polygons */
+        statsBegin("attach_input");
 
         if(!strcmp(tempString, "ShapeFile") || !strcmp(tempString, "Shapefile"))
         {
@@ -387,6 +400,7 @@ int main(int argc, char *argv[])
 #endif
         }
 
+        statsEnd("attach_input");
         MESG("\nFinished reading the input attribute file......\n");
 
 
@@ -398,14 +412,17 @@ int main(int argc, char *argv[])
         }
 
         /* compute the intersection of the weight and data polygons */
+        statsBegin("intersect");
         if(!polyIsect(p_input, p_data, p_wd, FALSE))
         {
             WARN("Possible empty intersection in data polygons");
             return 1;
         }
+        statsEnd("intersect");
 
         MESG("\nFinished intersecting input and output files......\n");
 
+        statsBegin("allocate");
         if(outputIoapi)
         {
 #ifdef USE_IOAPI
@@ -420,6 +437,7 @@ int main(int argc, char *argv[])
         {
             allocate(p_wd, ENVT_OUTPUT_FILE_NAME, !no_weight_attr);
         }
+        statsEnd("allocate");
 
 
     } /* end of ALLOCATE mode */
@@ -442,16 +460,20 @@ int main(int argc, char *argv[])
             getFullMapProjection(ENVT_OUTPUT_ELLIPSOID, ENVT_OUTPUT_MAP_PROJ);
         /* this should handle the conversion from input to output map projection */
         MESG("read data\n");
+        statsBegin("read_input");
         p_data =
             PolyReader(ENVT_INPUT_FILE_NAME, ENVT_INPUT_FILE_TYPE,
                        dataMapProj, NULL, outputMapProj);
+        statsEnd("read_input");
 
         MESG("write shapefile\n");
         /* write out the geometry of the shapes */
+        statsBegin("write");
         if(polyShapeWrite(p_data, outfile) != 0)
         {
             ERROR(argv[0], "Error writing output shape file", 2);
         }
+        statsEnd("write");
         /* copy the .dbf file from the starting location/name to the output one */
 #ifndef _WIN32
         sprintf(mesg, "cp %s.dbf %s.dbf", getenv(ENVT_INPUT_FILE_NAME), outfile);
@@ -475,6 +497,7 @@ int main(int argc, char *argv[])
         /* read the thing to overlay & the data file */
 
         /* may want too integrate this into PolyReader fcn */
+        statsBegin("read_overlay");
         overlayMapProj =
             getFullMapProjection(ENVT_OVERLAY_ELLIPSOID, ENVT_OVERLAY_MAP_PRJN);
 
@@ -502,20 +525,36 @@ int main(int argc, char *argv[])
                   "Unable to process overlay shape, please check your script",
                   2);
         }
+        statsEnd("read_overlay");
 
         inputMapProj = getFullMapProjection(ENVT_INPUT_FILE_ELLIPSOID,
                                             ENVT_INPUT_FILE_MAP_PRJN);
         /* read in the input polygons and convert to map projection of the grid */
         window = 0;
 
+        /* the geometry of each chunk is built in one arena, which is
+         * reset once the chunk has been reported */
+        chunkArena = newArena(0);
+        if(chunkArena == NULL)
+        {
+            ERROR(argv[0], "Allocation error for the overlay arena", 2);
+        }
+
+        /* the output is opened once for all of the chunks, which are
+         * intersected OVERLAY_CHUNK_JOBS at a time */
+        overlayOut = openOverlayOutput();
+        chunkJobs = overlayChunkJobs();
+
         while(!fileCompleted)
         {
+            prevArena = setCurrentArena(chunkArena);
 
             if(maxShapes == 0)
             {
                 fileCompleted = 1;
             }
 
+            statsBegin("read_input");
             p_input = PolyReader(ENVT_INPUT_FILE_NAME, ENVT_INPUT_FILE_TYPE,
                                  inputMapProj, p_overlay->bb, p_overlay->map);
 
@@ -528,6 +567,9 @@ int main(int argc, char *argv[])
             }
 
 
+            statsEnd("read_input");
+
+            statsBegin("attach_input");
             getEnvtValue(ENVT_INPUT_FILE_TYPE, tempString);
             if((strcmp(tempString, "PointFile") != 0)
                && (strcmp(tempString, "Pointfile") != 0) && 
@@ -536,31 +578,37 @@ int main(int argc, char *argv[])
             {
                 attachAttribute(p_input, ENVT_OVERLAY_ATTRS, NULL);
             }
+            statsEnd("attach_input");
 
 
             /* at this point, input data has the attributes of interest attached to it */
 
-            p_result = getNewPoly(0);
-
-            /* input is parent #1, overlay is parent #2 */
-            if(!polyIsect(p_input, p_overlay, p_result, FALSE))
+            if(chunkJobs > 1)
             {
-                WARN("Possibly empty intersection in polyIsect");
+                statsBegin("chunk_jobs");
+                spawnOverlayChunk(p_input, p_overlay, overlayOut, chunkJobs);
+                statsEnd("chunk_jobs");
             }
-
-
-            if(p_result->parent_poly1 != NULL)
+            else
             {
-                reportOverlays(p_result);
+                overlayChunk(p_input, p_overlay, overlayOut);
             }
 
-            /* free the input shape & result shape */
-            /* these are not working correctly */
-            /* freePolyObject(p_input); */
+            /* free the input shape */
+            freePolyObject(p_input);
 
-            /* freePolyObject(p_result); */
+            setCurrentArena(prevArena);
+            resetArena(chunkArena);
 
         }                       /* end while */
+        if(chunkJobs > 1)
+        {
+            statsBegin("chunk_jobs");
+            waitOverlayChunks(overlayOut);
+            statsEnd("chunk_jobs");
+        }
+        closeOverlayOutput(overlayOut);
+        freeArena(chunkArena);
 
     }
     else
@@ -574,6 +622,7 @@ int main(int argc, char *argv[])
 
     }
 
+    statsWrite();
     MESG2("NORMAL COMPLETION of ", argv[0]);
     MESG("");
     return 0;
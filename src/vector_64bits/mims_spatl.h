@@ -122,6 +122,7 @@ typedef union _AttributeValue {
 typedef struct _Parent {
   struct _PolyParent *pp;
   PolyShape *ps;
+  struct _PolyShapeList *pl;    /* list item of ps, with its measures */
   int index;
 } Parent;
 
@@ -136,10 +137,38 @@ typedef struct _PolyShapeList {
   PolyShape *ps;
   PolyParent *pp;
   BoundingBox *bb;
+  double area;          /* area and length of ps, measured with bb */
+  double length;
   struct _PolyShapeList *next;
   struct _PolyShapeList *prev;
 } PolyShapeList;
 
+/* the shapes of a PolyObject addressed by shape index, as one array
+ * per field; built by getGeomStore (geomstore.c).  The vertices stay
+ * with the PolyShapes. */
+typedef struct _GeomStore {
+  int nshapes;
+  BoundingBox *bb;      /* bounding box per shape */
+  int *top_p1;          /* index of the top p1 parent (e.g. weight shape) */
+  int *top_p1_p2;       /* p2 index of that parent pair (e.g. data poly) */
+  int *top_p2;          /* index of the top p2 parent (e.g. grid cell) */
+  int *ncontours;       /* number of contours per shape */
+  PolyShape **ps;       /* the shapes, owned by the PolyObject */
+  double *area;         /* area and length per shape */
+  double *length;
+  double *top_p1_area;  /* area and length of the top p1 parent */
+  double *top_p1_length;
+} GeomStore;
+
+/* number of contours in shape i of a GeomStore */
+#define storeNumContours(gs, i) ((gs)->ncontours[i])
+
+/* measures of shape i of a GeomStore and of its top p1 parent */
+#define storeArea(gs, i) ((gs)->area[i])
+#define storeLength(gs, i) ((gs)->length[i])
+#define storeParentArea(gs, i) ((gs)->top_p1_area[i])
+#define storeParentLength(gs, i) ((gs)->top_p1_length[i])
+
 /* a set of shapes (point, line or polygon), such as those that might be 
  * specified in a shape file, with all associated info */
 typedef struct _PolyObject {
@@ -153,8 +182,24 @@ typedef struct _PolyObject {
   PolyShapeList *plist;
   struct _PolyObject *parent_poly1;
   struct _PolyObject *parent_poly2;
+  GeomStore *store;     /* built on demand by getGeomStore */
+  int type_attr;        /* attribute encoded by encodeAttrTypes, or -1 */
+  int ntypes;           /* number of distinct values of that attribute */
+  char **type_list;     /* the values as strings, by category code */
+  int *type_code;       /* category code of each shape */
 } PolyObject;
 
+/* area fraction of each category in each data polygon, kept only for the
+ * categories that occur in the polygon and grouped by category; built
+ * by typeAreaPercent */
+typedef struct _TypeAreaMap {
+  int ntypes;
+  int ncells;           /* number of data polygons */
+  int *type_start;      /* ntypes+1 offsets into cell and frac */
+  int *cell;            /* data polygon index, ascending per category */
+  double *frac;         /* area fraction of the category in the polygon */
+} TypeAreaMap;
+
 typedef struct _Isect {
   Vertex v;
   int type;
@@ -168,6 +213,19 @@ typedef struct _PolyIntStruct {
   double * intValues;  /* the values for each intersection */
 } PolyIntStruct;
 
+/* block allocator for geometry nodes, see arena.c */
+typedef struct _Arena Arena;
+
+/* counters of the stage statistics, see runStats.c */
+#define STAT_SHAPES_READ   0
+#define STAT_SHAPES_CULLED 1
+#define STAT_BBOX_TESTS    2
+#define STAT_CLIP_CALLS    3
+#define STAT_FRAGMENTS     4
+#define STAT_VERTICES      5
+#define STAT_COVERED_PAIRS 6
+#define NUM_STATS          7
+
 typedef struct _PointFileInfo {
   char *name;
   int index;
@@ -190,7 +248,7 @@ PolyShape *getNewPolyShape(int);
 Shape *getNewShape(int);
 void freeShape(Shape *s);
 PolyParent *newPolyParent(Parent *, Parent *);
-Parent *newParent(PolyParent *, PolyShape *, int);
+Parent *newParent(PolyParent *, PolyShapeList *, int);
 AttributeHeader *getNewAttrHeader(void);
 BoundingBox *newBBox(double, double, double, double);
 BoundingBox *newBoundingBox(PolyShape *);
@@ -214,6 +272,7 @@ JobType mimsJobType(char *);
 int printBoundingBox(BoundingBox *);
 int copyBBoxToFrom(BoundingBox *, BoundingBox *);
 int projectPoint ( double x, double y, double *newx, double *newy);
+int projectPoints ( int n, double *x, double *y);
 int storeProjection ( MapProjInfo *inproj, MapProjInfo *outproj );
 int compareLatLongDatum ( MapProjInfo *inMap1, MapProjInfo *inMap2 );
 int compareProjection ( MapProjInfo *inMap1, MapProjInfo *inMap2 );
@@ -234,13 +293,22 @@ int reportSurrogate(PolyObject *poly, char *ename, int use_weight_val,
 int createConvertOutput(PolyObject *poly, char *ename);
 int allocate(PolyObject *poly, char *ename, int use_weight_val);
 int avg1Poly(PolyObject * poly, double **pavg, int *pnum_data_polys, int attr_id, int use_weight_attr_value);
-int typeAreaPercent(PolyObject *poly, double ***psum, double *gridA, int attr_id, int numTypes, char ***list);
+int typeAreaPercent(PolyObject *poly, TypeAreaMap **pmap, double *gridA, int attr_id);
+void typeAreaColumn(TypeAreaMap *map, int type, double *col);
+void freeTypeAreaMap(TypeAreaMap *map);
+int encodeAttrTypes(PolyObject *poly, int attr_id);
 void trim(char *inString, char *outString);
 int getMapProjFromGriddesc(char *gname, MapProjInfo *map);
 PolyObject *BoundingBoxReader(MapProjInfo *file_mapproj, MapProjInfo *output_mapproj);
 PolyObject *PolygonFileReader(char *ename, MapProjInfo *file_mapproj, MapProjInfo *output_mapproj);
 PolyObject *PointFileReader(char *ename, MapProjInfo *file_mapproj, MapProjInfo *output_mapproj);
-int reportOverlays(PolyObject *poly);
+int reportOverlays(PolyObject *poly, FILE *ofp);
+FILE *openOverlayOutput(void);
+void closeOverlayOutput(FILE *ofp);
+int overlayChunkJobs(void);
+int overlayChunk(PolyObject *p_input, PolyObject *p_overlay, FILE *ofp);
+int spawnOverlayChunk(PolyObject *p_input, PolyObject *p_overlay, FILE *ofp, int njobs);
+void waitOverlayChunks(FILE *ofp);
 void freePolyObject(PolyObject *p);
 int discreteOverlap( PolyObject *poly, int **pmax, int *pn1, int attr_id);
 void addNewVertices(Shape *shp, int n);
@@ -248,5 +316,24 @@ PolyObject *calculateCentroid(PolyObject *p);
 gpc_vertex getCentroidVertex(PolyShape *ps);
 MapProjInfo *copyMapProj(MapProjInfo *inMap);
 PolyObject *getCentroidPoly(PolyObject *p);
+Arena *newArena(size_t block_size);
+void *arenaAlloc(Arena *a, size_t size);
+void resetArena(Arena *a);
+void freeArena(Arena *a);
+Arena *setCurrentArena(Arena *a);
+void *nodeAlloc(size_t size);
+void nodeFree(void *p);
+GeomStore *getGeomStore(PolyObject *poly);
+void freeGeomStore(GeomStore *gs);
+int envThreads(char *name);
+void runTasks(int ntask, int nthreads, void (*task)(void *, int, int),
+   void *arg);
+int flatSurfaceLengths(void);
+void statsStart(char *prog, char *defLabel);
+void statsBegin(char *name);
+void statsEnd(char *name);
+void statsCount(int which, long n);
+void statsCountPoly(PolyObject *poly);
+void statsWrite(void);
 
 #endif
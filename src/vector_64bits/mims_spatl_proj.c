@@ -8,6 +8,7 @@
  * mimsSetProjection
  * projectBBox
  * projectPoint
+ * projectPoints
  * storeProjection
  * copyMapProj
  * compareDatum
@@ -635,6 +636,65 @@ int projectPoint ( double x, double y, double *newx, double *newy)
   return 0;
 }
 
+/***************************************************************************/
+
+/* Project n points in place using the projections set in storeProjection.
+ * The points are handed to proj in one call, which gives the same
+ * results as calling projectPoint for each of them.  Return value is -1
+ * if an error is detected. */
+int projectPoints ( int n, double *x, double *y)
+{
+  extern char *prog_name;
+  double *z;
+  int i;
+
+  if (n <= 0) return 0;
+
+  z = (double *) calloc(n, sizeof(double));
+  if (z == NULL)
+  {
+     ERROR(prog_name, "Allocation error in projectPoints",2);
+     return -1;
+  }
+
+  if (pj_is_latlong(inprojection))
+  {
+     for (i = 0; i < n; i++)
+     {
+        x[i] *= DEG_TO_RAD;
+        y[i] *= DEG_TO_RAD;
+     }
+  }
+
+  i = pj_transform( inprojection, outprojection, n, 1, x, y, z );
+  free(z);
+  if( i != 0 )
+  {
+     ERROR(prog_name, "Error in projectPoints: pj_transform failed",2);
+     return -1;
+  }
+  for (i = 0; i < n; i++)
+  {
+     if (x[i] == HUGE_VAL)
+     {/* error output */
+        ERROR(prog_name, "Error in projectPoints: p.u=HUGE_VAL",2);
+        return -1;
+     }
+  }
+
+  /* x-y or decimal degree ascii output */
+  if ( pj_is_latlong(outprojection) )
+  {
+     for (i = 0; i < n; i++)
+     {
+         x[i] *= RAD_TO_DEG;
+         y[i] *= RAD_TO_DEG;
+     }
+  }
+
+  return 0;
+}
+
 /***************************************************************************/
 MapProjInfo *getFullMapProjection(
   char *ellipsoid_envt_var_name,
@@ -5,26 +5,296 @@
  *
  * Prints the results of an overlay operation to stdout or to a file
  * with a specified delimiter
+ *
+ * When the input is read in chunks (MAX_INPUT_FILE_SHAPES), each chunk
+ * can be intersected in a child process so that OVERLAY_CHUNK_JOBS
+ * chunks are worked on at once.  A child writes its lines to a scratch
+ * file that the parent copies to the output once the child is done, in
+ * the order the chunks were read.  The children share the overlay with
+ * the parent read-only, copy-on-write.  Processes are used rather than
+ * threads since the node arena and the line clipping scratch buffers
+ * are global.
  */
 
 #include <stdio.h>
 #include <stdlib.h> 
 #include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
 
 #include "mims_spatl.h"
 #include "mims_evs.h"
 #include "shapefil.h"
 #include "io.h"
 
+/* chunks being intersected by child processes, oldest first */
+#ifndef _WIN32
+static int maxJobs = 0;
+static int firstJob = 0;
+static int numJobs = 0;
+static pid_t *jobPid = NULL;
+static FILE **jobOut = NULL;
+#endif
+
+/* ============================================================= */
+/* Open the overlay output named by OVERLAY_OUT_TYPE and
+ * OVERLAY_OUT_NAME.  The output stays open while all of the chunks
+ * of the input are reported. */
+FILE *openOverlayOutput(void)
+{
+     int retVal;
+     char overlayOutType[30];
+     char overlayOutName[256];
+     char mesg[300];
+     extern char *prog_name;
+     FILE *ofp;
+
+     retVal = getEnvtValue(ENVT_OVERLAY_OUT_TYPE, overlayOutType);
+
+     if(!retVal)
+     {
+          ERROR(prog_name, 
+                   "Must specify an output type in OVERLAY_OUT_TYPE", 2);
+     }
+
+     /* overlay output type can be stdout or DelimitedFile */
+     sprintf(mesg, "Overlay output type: %s\n", overlayOutType);
+     MESG(mesg);
+
+     if(!strcmp(overlayOutType, "Stdout") || 
+                !strcmp(overlayOutType,"STDOUT") ||
+                !strcmp(overlayOutType, "stdout") ) 
+     {
+         ofp = stdout;
+     }
+     else if(!strcmp(overlayOutType, "DelimitedFile"))
+     {
+
+         retVal = getEnvtValue(ENVT_OVERLAY_OUT_NAME, overlayOutName);
+
+         if(!retVal || overlayOutName[0] == '\0')
+         {
+             ERROR(prog_name, "Must specify a file name in OVERLAY_OUT_NAME", 2);
+         }
+
+         if((ofp = fopen(overlayOutName, "w")) == NULL)
+         {
+               sprintf(mesg,"Unable to open %s for writing\n", 
+                        overlayOutName);
+               ERROR(prog_name, mesg, 2);
+         }
+
+         sprintf(mesg,"Writing overlay output to %s", overlayOutName);
+         MESG(mesg);
+
+     }
+     else
+     {
+          sprintf(mesg, "Unrecognized value for %s", ENVT_OVERLAY_OUT_TYPE);
+          ERROR(prog_name, mesg, 2);
+     }
+
+     return ofp;
+}
+
+
+/* ============================================================= */
+void closeOverlayOutput(FILE *ofp)
+{
+     if(ofp != stdout)
+     {
+          fclose(ofp);
+     }
+     else
+     {
+          fflush(ofp);
+     }
+}
+
+
+/* ============================================================= */
+/* Number of chunks to intersect at once, from OVERLAY_CHUNK_JOBS.
+ * The default of 1 works through the chunks in this process. */
+int overlayChunkJobs(void)
+{
+     char value[30];
+     char mesg[256];
+     extern char *prog_name;
+     int n = 1;
+
+     if(getEnvtValue(ENVT_OVERLAY_CHUNK_JOBS, value) && value[0] != '\0')
+     {
+          if(digiCheck(value) || (n = atoi(value)) < 1)
+          {
+               sprintf(mesg, "%s must be a positive integer", 
+                       ENVT_OVERLAY_CHUNK_JOBS);
+               ERROR(prog_name, mesg, 2);
+          }
+     }
+#ifdef _WIN32
+     n = 1;
+#endif
+     return n;
+}
+
+
+/* ============================================================= */
+/* Intersect one chunk of the input with the overlay and report the
+ * pieces to ofp */
+int overlayChunk(PolyObject *p_input, PolyObject *p_overlay, FILE *ofp)
+{
+     PolyObject *p_result;
+
+     p_result = getNewPoly(0);
+
+     /* input is parent #1, overlay is parent #2 */
+     statsBegin("intersect");
+     if(!polyIsect(p_input, p_overlay, p_result, FALSE))
+     {
+          WARN("Possibly empty intersection in polyIsect");
+     }
+     statsEnd("intersect");
+
+     statsBegin("report");
+     if(p_result->parent_poly1 != NULL)
+     {
+          reportOverlays(p_result, ofp);
+     }
+     statsEnd("report");
+
+     freePolyObject(p_result);
+     return 0;
+}
+
+
+#ifndef _WIN32
+/* ============================================================= */
+/* wait for the oldest chunk and copy its lines to ofp */
+static void collectOverlayChunk(FILE *ofp)
+{
+     int status;
+     size_t n;
+     char buf[65536];
+     char mesg[256];
+     extern char *prog_name;
+     FILE *tmp;
+
+     if(waitpid(jobPid[firstJob], &status, 0) < 0 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+     {
+          sprintf(mesg, "Overlay of an input chunk failed in process %d",
+                  (int) jobPid[firstJob]);
+          ERROR(prog_name, mesg, 2);
+     }
+
+     tmp = jobOut[firstJob];
+     rewind(tmp);
+     while((n = fread(buf, 1, sizeof(buf), tmp)) > 0)
+     {
+          if(fwrite(buf, 1, n, ofp) != n)
+          {
+               ERROR(prog_name, "Unable to write the overlay output", 2);
+          }
+     }
+     fclose(tmp);
+
+     firstJob = (firstJob + 1) % maxJobs;
+     numJobs--;
+}
+#endif
+
+
+/* ============================================================= */
+/* Intersect a chunk in a child process, keeping at most njobs children
+ * running.  The chunk can be released by the caller as soon as this
+ * returns. */
+int spawnOverlayChunk(PolyObject *p_input, PolyObject *p_overlay, 
+                      FILE *ofp, int njobs)
+{
+#ifndef _WIN32
+     int slot;
+     pid_t pid;
+     FILE *tmp;
+     extern char *prog_name;
+
+     if(jobPid == NULL)
+     {
+          maxJobs = njobs;
+          jobPid = (pid_t *) malloc(maxJobs * sizeof(pid_t));
+          jobOut = (FILE **) malloc(maxJobs * sizeof(FILE *));
+          if(jobPid == NULL || jobOut == NULL)
+          {
+               ERROR(prog_name, "Allocation error in spawnOverlayChunk", 2);
+          }
+     }
+
+     if(numJobs == maxJobs)
+     {
+          collectOverlayChunk(ofp);
+     }
+
+     if((tmp = tmpfile()) == NULL)
+     {
+          ERROR(prog_name, "Unable to open a scratch file for the overlay", 2);
+     }
+
+     /* nothing buffered may be written twice by the child */
+     fflush(NULL);
+
+     pid = fork();
+     if(pid < 0)
+     {
+          WARN("Unable to start a process, overlaying the chunk here");
+          fclose(tmp);
+          waitOverlayChunks(ofp);
+          return overlayChunk(p_input, p_overlay, ofp);
+     }
+     if(pid == 0)
+     {
+          overlayChunk(p_input, p_overlay, tmp);
+          if(fflush(tmp) != 0)
+          {
+               _exit(2);
+          }
+          fflush(stdout);
+          _exit(0);
+     }
+
+     slot = (firstJob + numJobs) % maxJobs;
+     jobPid[slot] = pid;
+     jobOut[slot] = tmp;
+     numJobs++;
+     return 0;
+#else
+     return overlayChunk(p_input, p_overlay, ofp);
+#endif
+}
+
+
+/* ============================================================= */
+/* copy out the chunks that are still running, in order */
+void waitOverlayChunks(FILE *ofp)
+{
+#ifndef _WIN32
+     while(numJobs > 0)
+     {
+          collectOverlayChunk(ofp);
+     }
+#endif
+}
+
+
+/* ============================================================= */
 /* Write results of OVERLAY operation to stdout or to a file */
                                                                                               
-int reportOverlays(PolyObject *poly)
+int reportOverlays(PolyObject *poly, FILE *ofp)
 {
      int count, retVal, id, dataValType,outIDYes;
      int index, numAttribs;
-     char overlayOutType[30];
      char overlayType[15];
-     char overlayOutName[256];
      char overlayOutDelim[30];
      char overlayOutCellID[5];
      char headerYesNo[10];
@@ -42,7 +312,6 @@ int reportOverlays(PolyObject *poly)
      extern char *prog_name;
      extern int window;
 
-     FILE *ofp;
      int outID,polyID,ncols,row,col; /*for output overlay ID (col and row)*/
 
      retVal = getEnvtValue(ENVT_WRITE_HEADER, headerYesNo);
@@ -75,14 +344,6 @@ int reportOverlays(PolyObject *poly)
                    "Must specify an output type in OVERLAY_TYPE", 2);
      } 
 
-     retVal = getEnvtValue(ENVT_OVERLAY_OUT_TYPE, overlayOutType);
-
-     if(!retVal)
-     {
-          ERROR(prog_name, 
-                   "Must specify an output type in OVERLAY_OUT_TYPE", 2);
-     }
-
      retVal = getEnvtValue(ENVT_OVERLAY_OUT_DELIM, overlayOutDelim);
 
      if(!retVal)
@@ -112,44 +373,6 @@ int reportOverlays(PolyObject *poly)
           delimiter = ' ';
      }
 
-     /* overlay output type can be stdout or DelimitedFile */
-     sprintf(mesg, "Overlay output type: %s\n", overlayOutType);
-     MESG(mesg);
-
-     if(!strcmp(overlayOutType, "Stdout") || 
-                !strcmp(overlayOutType,"STDOUT") ||
-                !strcmp(overlayOutType, "stdout") ) 
-     {
-         ofp = stdout;
-      
-     }
-     else if(!strcmp(overlayOutType, "DelimitedFile"))
-     {
-
-         retVal = getEnvtValue(ENVT_OVERLAY_OUT_NAME, overlayOutName);
-
-         if(!retVal || overlayOutName[0] == '\0')
-         {
-             ERROR(prog_name, "Must specify a file name in OVERLAY_OUT_NAME", 2);
-         }
-
-         if((ofp = fopen(overlayOutName, "w")) == NULL)
-         {
-               sprintf(mesg,"Unable to open %s for writing\n", 
-                        overlayOutName);
-               ERROR(prog_name, mesg, 2);
-         }
-
-         sprintf(mesg,"Writing overlay output to %s", overlayOutName);
-         MESG(mesg);
-
-     }
-     else
-     {
-          sprintf(mesg, "Unrecognized value for %s", ENVT_OVERLAY_OUT_TYPE);
-          ERROR(prog_name, mesg, 2);
-     }
-
      plist = poly->plist;                                                                                         
      i_poly = poly->parent_poly1;
      outIDYes = getEnvtValue(ENVT_OVERLAY_OUT_CELLID, overlayOutCellID);
@@ -285,9 +508,6 @@ int reportOverlays(PolyObject *poly)
          plist = plist->next;
      } /* end of for(count) */
 
-    if(!strcmp(overlayOutType, "DelimitedFile"))
-    {
-         fclose(ofp);
-    }
+    return 0;
 
 } /* end of function */
@@ -13,6 +13,7 @@
  * printPoly
  * Area
  * Length
+ * flatSurfaceLengths
  * PolyArea
  * PolyLength
  * newParent
@@ -131,7 +132,7 @@ int CopyPolySelf(PolyObject * pw, PolyObject * pd, PolyObject * pwd)
     {
         pp = plist->pp;
         ps = plist->ps;
-        p1[i] = newParent(pp, ps, i);
+        p1[i] = newParent(pp, plist, i);
 
         pp = newPolyParent(p1[i], p1[i]);
 
@@ -190,7 +191,7 @@ PolyShape *getNewPolyShape(int n)
 {
     PolyShape *p;
 
-    p = (PolyShape *) malloc(sizeof(PolyShape));
+    p = (PolyShape *) nodeAlloc(sizeof(PolyShape));
     if(p != NULL)
     {
         p->num_contours = n;
@@ -230,6 +231,11 @@ PolyObject *getNewPoly(int n)
         p->bb = NULL;
         p->map = NULL;
         p->name = NULL;
+        p->store = NULL;
+        p->type_attr = -1;
+        p->ntypes = 0;
+        p->type_list = NULL;
+        p->type_code = NULL;
     }
 
     return p;
@@ -256,10 +262,13 @@ void freePolyShape(PolyShape *p)
 
 /* release a polygon object and all its attributes from memory */
 /* added 5/10/2005 BDB */
+/* Only string attributes are freed, since AttributeValue is a union
+ * and the other members are not pointers.  Geometry nodes that came
+ * from an arena are left for resetArena/freeArena. */
 void freePolyObject(PolyObject *p)
 {
     int attribCount, numRecords, k, m;
-    PolyShapeList *pl;
+    PolyShapeList *pl, *next;
 
 
     if(p != NULL)
@@ -271,55 +280,61 @@ void freePolyObject(PolyObject *p)
 
         numRecords = p->nObjects;
 
-        if(p->bb != NULL)
-            free(p->bb);
+        freeGeomStore(p->store);
+        nodeFree(p->bb);
+
+        if(p->type_list != NULL)
+        {
+            for(k = 0; k < p->ntypes; k++)
+                free(p->type_list[k]);
+            free(p->type_list);
+        }
+        free(p->type_code);
 
         if(p->name != NULL)
             free(p->name);
 
-        /*
-        This code does not work for some reason, perhaps because
-        AttributeValue is a union?  */
-        for(k = 0; k < numRecords; k++)
+        if(p->attr_val != NULL)
         {
-            for(m = 0; m < attribCount; m++)
+            for(k = 0; k < numRecords; k++)
             {
-                if(p->attr_val[k][m].str != NULL)
+                if(p->attr_val[k] == NULL)
+                    continue;
+                for(m = 0; m < attribCount; m++)
                 {
-                    free(p->attr_val[k][m].str);
+                    if(p->attr_hdr->attr_desc[m]->type == FTString &&
+                       p->attr_val[k][m].str != NULL)
+                    {
+                        free(p->attr_val[k][m].str);
+                    }
                 }
+                free(p->attr_val[k]);
             }
-        }
-
-        if(p->attr_val != NULL)
             free(p->attr_val);
-
-
-        for(m = 0; m < attribCount; m++)
-        {
-            /*if(p->attr_hdr->attr_desc[m] != NULL)
-                free(p->attr_hdr->attr_desc[m]);*/
         }
 
         if(p->attr_hdr != NULL)
+        {
+            for(m = 0; m < attribCount; m++)
+            {
+                free(p->attr_hdr->attr_desc[m]->name);
+                free(p->attr_hdr->attr_desc[m]);
+            }
+            if(p->attr_hdr->attr_desc != NULL)
+                free(p->attr_hdr->attr_desc);
             free(p->attr_hdr);
+        }
 
-        if(p->plist != NULL)
+        for(pl = p->plist; pl != NULL; pl = next)
         {
-            pl = p->plist;
-            while(pl->next != NULL)
+            next = pl->next;
+            if(pl->ps != NULL)
             {
-                if(pl->ps != NULL)
-                    gpc_free_polygon(pl->ps);
-
-                if(pl->bb != NULL)
-                    free(pl->bb);
-
-                pl = pl->next;
+                gpc_free_polygon(pl->ps);
+                nodeFree(pl->ps);
             }
-
-
-            free(p->plist);
+            nodeFree(pl->bb);
+            nodeFree(pl);
         }
 
         free(p);
@@ -412,22 +427,10 @@ double Area(Shape * p)
 #endif
 #define PI180 (M_PI/180.0)
 
-/* This routine computes the length of a polyline. 
- * If the used defines env. variable MIMS_FLAT_SURFACE the length is computed 
- * using arcs on the surface of the Earth (the explicit Earth radius is not 
- * needed since it cancels out later in the fraction).  NOTE: there is no 
- * algorithm available in this program for calculating POLYGON area on a 
- * curved surface. */
-double Length(Shape * p)
+/* Whether line lengths are computed on a flat surface, i.e. unless
+ * the user has asked for curved lines */
+int flatSurfaceLengths(void)
 {
-    /* Note: The length of a polygon does not include it's last segment 
-     *       unless the polygon has the same first and last vertex */
-    int i, j, n;
-    double a = 0.0;
-
-    double xa, xb, ya, yb;
-    double cy, sy;
-    double x, y;
     static int firstime = 1;
     static int flat_surface;
     char tmpEnvVar[10];
@@ -446,10 +449,29 @@ double Length(Shape * p)
             }
         }
     }
+    return flat_surface;
+}
+
+/* This routine computes the length of a polyline. 
+ * If the used defines env. variable MIMS_FLAT_SURFACE the length is computed 
+ * using arcs on the surface of the Earth (the explicit Earth radius is not 
+ * needed since it cancels out later in the fraction).  NOTE: there is no 
+ * algorithm available in this program for calculating POLYGON area on a 
+ * curved surface. */
+double Length(Shape * p)
+{
+    /* Note: The length of a polygon does not include it's last segment 
+     *       unless the polygon has the same first and last vertex */
+    int i, j, n;
+    double a = 0.0;
+
+    double xa, xb, ya, yb;
+    double cy, sy;
+    double x, y;
 
     n = p->num_vertices;
 
-    if(flat_surface)
+    if(flatSurfaceLengths())
     {
         for(i = 0; i < n - 1; i++)
         {
@@ -465,6 +487,7 @@ double Length(Shape * p)
     {
         for(i = 0; i < n - 1; i++)
         {
+            j = i + 1;
             xa = PI180 * p->vertex[i].x;
             ya = PI180 * p->vertex[i].y;
             xb = PI180 * p->vertex[j].x;
@@ -524,14 +547,15 @@ double PolyLength(PolyShape * p)
 /* ===================================================== */
 /* A parent describes where a polygon came from and points to 
  * a shape that was used to create it. */
-Parent *newParent(PolyParent * pp, PolyShape * ps, int index)
+Parent *newParent(PolyParent * pp, PolyShapeList * pl, int index)
 {
     Parent *p;
-    p = (Parent *) malloc(sizeof(Parent));
+    p = (Parent *) nodeAlloc(sizeof(Parent));
     if(p)
     {
         p->pp = pp;
-        p->ps = ps;
+        p->ps = pl->ps;
+        p->pl = pl;
         p->index = index;
     }
     return p;
@@ -543,7 +567,7 @@ Parent *newParent(PolyParent * pp, PolyShape * ps, int index)
 PolyParent *newPolyParent(Parent * p1, Parent * p2)
 {
     PolyParent *p;
-    p = (PolyParent *) malloc(sizeof(PolyParent));
+    p = (PolyParent *) nodeAlloc(sizeof(PolyParent));
     if(p)
     {
         p->p1 = p1;
@@ -567,11 +591,13 @@ void polyShapeIncl(PolyShapeList **list, PolyShape *ps, PolyParent *pp)
     {
         ERROR(prog_name, "ps is NULL in polyShapeIncl", 1);
     }
-    p = (PolyShapeList *) malloc(sizeof(p[0]));
+    p = (PolyShapeList *) nodeAlloc(sizeof(p[0]));
     if(p)
     {
         p->ps = ps;
         p->bb = newBoundingBox(ps);
+        p->area = PolyArea(ps);
+        p->length = PolyLength(ps);
         p->pp = pp;
         
         p->next = NULL;
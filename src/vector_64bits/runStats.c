@@ -0,0 +1,476 @@
+/****************************************************************************
+ * runStats.c
+ *
+ * Per-stage timing and counters for srgcreate and allocator runs.  When
+ * STAGE_STATS_FILE is set, each run appends one record to that file with
+ * the wall and CPU seconds and the peak resident size of every stage,
+ * and counts of what the stage did:
+ *
+ *   shapes_read    shapes returned by the readers
+ *   shapes_culled  shape parts dropped by the readers' bounding box test
+ *   bbox_tests     bounding box tests made by polyIsect
+ *   clip_calls     polygon, line and point clips made by polyIsect
+ *   covered_pairs  polygon pairs polyIsect settled without clipping,
+ *                  as one inside the other or the two apart
+ *   fragments      intersected pieces produced by polyIsect
+ *   vertices       vertices in those pieces
+ *
+ * STAGE_STATS_FORMAT selects CSV (the default), one line per stage plus
+ * a "total" line, or JSON, one object per line for the whole run.
+ * STAGE_STATS_LABEL names the run in the record; each program supplies
+ * a default, e.g. the surrogate code for srgcreate.  Records are written
+ * with a single append, so concurrent runs can share one file.
+ *
+ * Stages may nest; the time and counts of an inner stage are not
+ * included in the outer one.  A stage that is entered several times
+ * accumulates.  Overlay chunks intersected in child processes
+ * (OVERLAY_CHUNK_JOBS) are not counted, but their CPU time is included
+ * in the total.  Everything here is a no-op unless statsStart found
+ * STAGE_STATS_FILE, and it is called from the main thread only.
+ *
+ * File contains:
+ * statsStart
+ * statsBegin
+ * statsEnd
+ * statsCount
+ * statsCountPoly
+ * statsWrite
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#include "shapefil.h"
+#include "mims_spatl.h"
+#include "mims_evs.h"
+#include "io.h"
+
+#define MAX_STAGES 32
+#define MAX_STAGE_DEPTH 8
+#define STAGE_NAME_LEN 32
+
+typedef struct _StageStats {
+    char name[STAGE_NAME_LEN];
+    int calls;
+    double wall, cpu;           /* accumulated seconds */
+    long maxrss;                /* peak resident size at the end, KB */
+    long count[NUM_STATS];
+} StageStats;
+
+static int enabled = 0;
+static int jsonFormat = 0;
+static char statsFile[256];
+static char program[256];
+static char label[256];
+static time_t startTime;
+static double runWall, runCPU;
+
+static StageStats stages[MAX_STAGES];
+static int numStages = 0;
+
+/* the open stages, innermost last, with the clocks and counters at the
+ * time each was last resumed */
+static int stack[MAX_STAGE_DEPTH];
+static double stackWall[MAX_STAGE_DEPTH], stackCPU[MAX_STAGE_DEPTH];
+static long stackCount[MAX_STAGE_DEPTH][NUM_STATS];
+static int depth = 0;
+
+/* run totals of the counters */
+static long counts[NUM_STATS];
+
+static char *countNames[NUM_STATS] = {
+    "shapes_read", "shapes_culled", "bbox_tests",
+    "clip_calls", "fragments", "vertices", "covered_pairs"
+};
+
+
+/* ============================================================= */
+static double wallClock(void)
+{
+#ifndef _WIN32
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+#else
+    return (double) time(NULL);
+#endif
+}
+
+
+/* ============================================================= */
+/* CPU seconds of this process, plus its waited-for children if
+ * children is set, and the peak resident size in KB */
+static double cpuClock(long *maxrss, int children)
+{
+#ifndef _WIN32
+    struct rusage ru;
+    double cpu;
+
+    getrusage(RUSAGE_SELF, &ru);
+    if(maxrss != NULL)
+    {
+        *maxrss = ru.ru_maxrss;
+    }
+    cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1.0e-6 +
+          ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1.0e-6;
+    if(children)
+    {
+        getrusage(RUSAGE_CHILDREN, &ru);
+        cpu += ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1.0e-6 +
+               ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1.0e-6;
+    }
+    return cpu;
+#else
+    if(maxrss != NULL)
+    {
+        *maxrss = 0;
+    }
+    return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+
+/* ============================================================= */
+/* charge the time and counts since the innermost open stage was last
+ * resumed to it, and restart its clocks */
+static void chargeStage(void)
+{
+    StageStats *s;
+    double wall, cpu;
+    long maxrss;
+    int k, d = depth - 1;
+
+    wall = wallClock();
+    cpu = cpuClock(&maxrss, 0);
+    s = stages + stack[d];
+    s->wall += wall - stackWall[d];
+    s->cpu += cpu - stackCPU[d];
+    if(maxrss > s->maxrss)
+    {
+        s->maxrss = maxrss;
+    }
+    for(k = 0; k < NUM_STATS; k++)
+    {
+        s->count[k] += counts[k] - stackCount[d][k];
+        stackCount[d][k] = counts[k];
+    }
+    stackWall[d] = wall;
+    stackCPU[d] = cpu;
+}
+
+
+/* ============================================================= */
+/* Turn the statistics on if STAGE_STATS_FILE is set.  prog is the
+ * program name and defLabel the run label used when STAGE_STATS_LABEL
+ * is not set. */
+void statsStart(char *prog, char *defLabel)
+{
+    char value[256];
+    char mesg[300];
+    extern char *prog_name;
+
+    if(getenv(ENVT_STAGE_STATS_FILE) == NULL ||
+       !getEnvtValue(ENVT_STAGE_STATS_FILE, statsFile) ||
+       statsFile[0] == '\0' || !strcmp(statsFile, "NONE"))
+    {
+        return;
+    }
+    jsonFormat = 0;
+    if(getenv(ENVT_STAGE_STATS_FORMAT) != NULL &&
+       getEnvtValue(ENVT_STAGE_STATS_FORMAT, value) && value[0] != '\0')
+    {
+        if(!strcmp(value, "JSON") || !strcmp(value, "json"))
+        {
+            jsonFormat = 1;
+        }
+        else if(strcmp(value, "CSV") && strcmp(value, "csv"))
+        {
+            sprintf(mesg, "%s must be CSV or JSON", ENVT_STAGE_STATS_FORMAT);
+            ERROR(prog_name, mesg, 2);
+        }
+    }
+    label[0] = '\0';
+    if(getenv(ENVT_STAGE_STATS_LABEL) != NULL)
+    {
+        getEnvtValue(ENVT_STAGE_STATS_LABEL, label);
+    }
+    if(label[0] == '\0' && defLabel != NULL)
+    {
+        strncpy(label, defLabel, sizeof(label) - 1);
+        label[sizeof(label) - 1] = '\0';
+    }
+    strncpy(program, (prog != NULL) ? prog : "", sizeof(program) - 1);
+    program[sizeof(program) - 1] = '\0';
+
+    enabled = 1;
+    numStages = 0;
+    depth = 0;
+    memset(counts, 0, sizeof(counts));
+    startTime = time(NULL);
+    runWall = wallClock();
+    runCPU = cpuClock(NULL, 1);
+}
+
+
+/* ============================================================= */
+/* Enter the named stage, pausing the stage that is open */
+void statsBegin(char *name)
+{
+    StageStats *s = NULL;
+    int i;
+
+    if(!enabled)
+    {
+        return;
+    }
+    if(depth == MAX_STAGE_DEPTH)
+    {
+        WARN("statsBegin: stages nested too deeply");
+        return;
+    }
+    if(depth > 0)
+    {
+        chargeStage();
+    }
+    for(i = 0; i < numStages; i++)
+    {
+        if(!strcmp(stages[i].name, name))
+        {
+            s = stages + i;
+            break;
+        }
+    }
+    if(s == NULL)
+    {
+        if(numStages == MAX_STAGES)
+        {
+            WARN("statsBegin: too many stages");
+            return;
+        }
+        s = stages + numStages++;
+        memset(s, 0, sizeof(StageStats));
+        strncpy(s->name, name, STAGE_NAME_LEN - 1);
+    }
+    s->calls++;
+    stack[depth] = s - stages;
+    stackWall[depth] = wallClock();
+    stackCPU[depth] = cpuClock(NULL, 0);
+    memcpy(stackCount[depth], counts, sizeof(counts));
+    depth++;
+}
+
+
+/* ============================================================= */
+/* Leave the named stage, which must be the innermost open one, and
+ * resume the stage it interrupted */
+void statsEnd(char *name)
+{
+    if(!enabled || depth == 0)
+    {
+        return;
+    }
+    if(strcmp(stages[stack[depth - 1]].name, name))
+    {
+        WARN2("statsEnd: stage is not the open one: ", name);
+        return;
+    }
+    chargeStage();
+    depth--;
+    if(depth > 0)
+    {
+        stackWall[depth - 1] = wallClock();
+        stackCPU[depth - 1] = cpuClock(NULL, 0);
+        memcpy(stackCount[depth - 1], counts, sizeof(counts));
+    }
+}
+
+
+/* ============================================================= */
+/* Add n to counter which (STAT_*) */
+void statsCount(int which, long n)
+{
+    if(enabled)
+    {
+        counts[which] += n;
+    }
+}
+
+
+/* ============================================================= */
+/* Count the pieces of poly and their vertices as polyIsect output */
+void statsCountPoly(PolyObject *poly)
+{
+    PolyShapeList *plist;
+    long nv = 0;
+    int c;
+
+    if(!enabled)
+    {
+        return;
+    }
+    for(plist = poly->plist; plist; plist = plist->next)
+    {
+        for(c = 0; c < plist->ps->num_contours; c++)
+        {
+            nv += plist->ps->contour[c].num_vertices;
+        }
+    }
+    counts[STAT_FRAGMENTS] += poly->nObjects;
+    counts[STAT_VERTICES] += nv;
+}
+
+
+/* ============================================================= */
+/* copy s to out, escaped for a JSON string or quoted for CSV as
+ * needed */
+static void quoteString(char *out, char *s, int json)
+{
+    int quote = json || strpbrk(s, ",\"\n") != NULL;
+
+    if(quote)
+    {
+        *out++ = '"';
+    }
+    for(; *s; s++)
+    {
+        if(*s == '"')
+        {
+            *out++ = json ? '\\' : '"';
+        }
+        else if(json && *s == '\\')
+        {
+            *out++ = '\\';
+        }
+        *out++ = (*s == '\n') ? ' ' : *s;
+    }
+    if(quote)
+    {
+        *out++ = '"';
+    }
+    *out = '\0';
+}
+
+
+/* ============================================================= */
+/* append the fields of one stage to buf */
+static char *formatStage(char *buf, char *prefix, StageStats *s)
+{
+    int k;
+
+    if(jsonFormat)
+    {
+        buf += sprintf(buf, "{\"stage\":\"%s\",\"calls\":%d,\"wall_s\":%.4f,"
+                       "\"cpu_s\":%.4f,\"maxrss_kb\":%ld", s->name, s->calls,
+                       s->wall, s->cpu, s->maxrss);
+        for(k = 0; k < NUM_STATS; k++)
+        {
+            buf += sprintf(buf, ",\"%s\":%ld", countNames[k], s->count[k]);
+        }
+        buf += sprintf(buf, "}");
+    }
+    else
+    {
+        buf += sprintf(buf, "%s,%s,%d,%.4f,%.4f,%ld", prefix, s->name,
+                       s->calls, s->wall, s->cpu, s->maxrss);
+        for(k = 0; k < NUM_STATS; k++)
+        {
+            buf += sprintf(buf, ",%ld", s->count[k]);
+        }
+        buf += sprintf(buf, "\n");
+    }
+    return buf;
+}
+
+
+/* ============================================================= */
+/* Close any open stages and append the record of this run to
+ * STAGE_STATS_FILE */
+void statsWrite(void)
+{
+    StageStats total;
+    FILE *fp;
+    char date[32], qprog[520], qlabel[520], prefix[1100];
+    char *buf, *p;
+    char mesg[300];
+    int i;
+
+    if(!enabled)
+    {
+        return;
+    }
+    while(depth > 0)
+    {
+        statsEnd(stages[stack[depth - 1]].name);
+    }
+
+    memset(&total, 0, sizeof(StageStats));
+    strcpy(total.name, "total");
+    total.calls = 1;
+    total.wall = wallClock() - runWall;
+    total.cpu = cpuClock(&total.maxrss, 1) - runCPU;
+    memcpy(total.count, counts, sizeof(counts));
+
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&startTime));
+    quoteString(qprog, program, jsonFormat);
+    quoteString(qlabel, label, jsonFormat);
+
+    buf = (char *) malloc(2048 + (numStages + 1) * (sizeof(prefix) + 512));
+    if(buf == NULL)
+    {
+        WARN("Allocation error in statsWrite");
+        return;
+    }
+    p = buf;
+    if(jsonFormat)
+    {
+        p += sprintf(p, "{\"program\":%s,\"label\":%s,\"start\":\"%s\","
+                     "\"stages\":[", qprog, qlabel, date);
+        for(i = 0; i < numStages; i++)
+        {
+            if(i > 0)
+            {
+                *p++ = ',';
+            }
+            p = formatStage(p, NULL, stages + i);
+        }
+        p += sprintf(p, "],\"total\":");
+        p = formatStage(p, NULL, &total);
+        p += sprintf(p, "}\n");
+    }
+    else
+    {
+        sprintf(prefix, "%s,%s,%s", qprog, qlabel, date);
+        for(i = 0; i < numStages; i++)
+        {
+            p = formatStage(p, prefix, stages + i);
+        }
+        p = formatStage(p, prefix, &total);
+    }
+
+    if((fp = fopen(statsFile, "a")) == NULL)
+    {
+        sprintf(mesg, "Unable to open %.200s for the stage statistics",
+                statsFile);
+        WARN(mesg);
+        free(buf);
+        return;
+    }
+    fseek(fp, 0, SEEK_END);
+    if(!jsonFormat && ftell(fp) == 0)
+    {
+        fprintf(fp, "program,label,start,stage,calls,wall_s,cpu_s,maxrss_kb,"
+                "shapes_read,shapes_culled,bbox_tests,clip_calls,fragments,"
+                "vertices\n");
+    }
+    fwrite(buf, 1, p - buf, fp);
+    fclose(fp);
+    free(buf);
+    enabled = 0;
+}
@@ -52,6 +52,7 @@ int main(int argc, char *argv[])
     char weightFile[256];
     char debugOutput[10];
     char tempString[100];
+    Arena *geomArena;
 
     extern int debug_output;
 
@@ -82,7 +83,26 @@ int main(int argc, char *argv[])
     }
 
     MESG(prog_version);
+
+    /* per-stage statistics, if STAGE_STATS_FILE is set; runs are
+     * labelled by surrogate code */
+    tempString[0] = '\0';
+    if(getenv(ENVT_SURROGATE_ID) != NULL)
+    {
+        getEnvtValue(ENVT_SURROGATE_ID, tempString);
+    }
+    statsStart(prog_name, tempString);
+
+    /* the grid, data, weight and intersected shapes all live until the
+     * surrogates are written, so their nodes come from one arena */
+    geomArena = newArena(0);
+    if(geomArena == NULL)
+    {
+        ERROR(prog_name, "Allocation error for the geometry arena", 2);
+    }
+    setCurrentArena(geomArena);
     
+    statsBegin("read_grid");
     if(getEnvtValue(ENVT_OUTPUT_FILE_TYPE, tempString))
     {
         if(strcmp(tempString, "RegularGrid")==0 || strcmp(tempString, "EGrid")==0)
@@ -109,6 +129,7 @@ int main(int argc, char *argv[])
     {
         ERROR(prog_name, "Error reading output grid/polygon data", 2);
     }
+    statsEnd("read_grid");
     outputBbox = p_grid->bb;
 
 #ifdef DEBUG
@@ -166,6 +187,7 @@ int main(int argc, char *argv[])
     MESG2("Filter File=",filterFile);
 
     MESG("Reading data polygons\n");
+    statsBegin("read_data");
     /* read in the data polygons and convert to grid's mapprojection */
     dataMapProj = getFullMapProjection(ENVT_DATA_ELLIPSOID, ENVT_DATA_MAP_PROJ);
     p_data = PolyReader(ENVT_DATA_FILE_NAME, ENVT_DATA_FILE_NAME_TYPE,
@@ -177,8 +199,10 @@ int main(int argc, char *argv[])
               "Error reading poly-data file, or no intersection with output grid exists",
               2);
     }
+    statsEnd("read_data");
 
     /* associate the data attributes with the data polygons */
+    statsBegin("attach_data");
     if (!attachAttribute(p_data, ENVT_DATA_ID_ATTR, NULL))
     {
 	ERROR(prog_name, "Attaching base data polygon attribute error", 2);
@@ -190,12 +214,14 @@ int main(int argc, char *argv[])
     {
 	ERROR(prog_name, "Processing multiple shapes with the same ID into one record failed", 2);
     }
+    statsEnd("attach_data");
     
 #ifdef DEBUG
     printPoly(p_data);
 #endif
     /* read in the weight polygons */
     MESG("Reading weight points/lines/polygons\n");
+    statsBegin("read_weight");
     weightMapProj =
         getFullMapProjection(ENVT_WEIGHT_FILE_ELLIPSOID, 
                              ENVT_WEIGHT_FILE_MAP_PROJ);
@@ -237,6 +263,7 @@ int main(int argc, char *argv[])
               "Error reading weight file, or no intersection with output grid exists",
               2);
     }
+    statsEnd("read_weight");
     /* if no weight polygons are available, area will be used */
     if(p_weight->nObjects == 0)
     {
@@ -248,10 +275,12 @@ int main(int argc, char *argv[])
     }
     /* associate the weight attributes with the weight polygons */
 /*     printf("3.25 p_grid->nSHPType=%d\n", p_grid->nSHPType); */
+    statsBegin("attach_weight");
     if(!attachAttribute(p_weight, ENVT_WEIGHT_ATTR_LIST, ENVT_SURROGATE_ID))
     {
         ERROR(prog_name, "Attaching weight polygon attribute error", 2);
     }
+    statsEnd("attach_weight");
     
 /*     printf("3.3 p_grid->nSHPType=%d\n", p_grid->nSHPType); */
 #ifdef DEBUG
@@ -267,6 +296,7 @@ int main(int argc, char *argv[])
         WARN("Allocation error in getNewPoly");
         return 1;
     }
+    statsBegin("intersect_wd");
     if(no_weight_poly)
     {
         if(!CopyPolySelf(p_weight, p_data, p_wd))
@@ -299,6 +329,7 @@ int main(int argc, char *argv[])
             try2saveDW(p_wd, ENVT_SAVE_DW_FILE);
         }
     }
+    statsEnd("intersect_wd");
 #ifdef DEBUG
     printPoly(p_wd);
 #endif
@@ -306,7 +337,9 @@ int main(int argc, char *argv[])
      * the grid cells */
     MESG("Intersecting weight-data objects with grid polygons\n");
 /*     printf("5. p_grid->nSHPType=%d\n", p_grid->nSHPType); */
+    statsBegin("intersect_grid");
     result = polyIsect(p_wd, p_grid, p_wdg, FALSE);
+    statsEnd("intersect_grid");
     if(result < 0)
     {
         WARN("Error intersecting weight+data and grid polygons");
@@ -332,10 +365,13 @@ int main(int argc, char *argv[])
         }
     }
 
+    statsBegin("report");
     if(!reportSurrogate(p_wdg, ENVT_SURROGATE_FILE, !no_weight_attr, outfile))
     {
         ERROR(prog_name, "Error generating surrogates", 2);
     }
+    statsEnd("report");
+    statsWrite();
 
     MESG2("NORMAL COMPLETION of ", prog_name);
     MESG("");
@@ -0,0 +1,1726 @@
+/****************************************************************************
+ * srgbatch.c
+ *
+ * Generates the regular-grid surrogates of a pg_srgtools run without a
+ * database server.  It reads the same control, generation, specification
+ * and shapefile catalog files as the PostgreSQL Surrogate Tool and writes
+ * the same <REGION>_<code>_NOFILL.txt files to its OUTPUT DIRECTORY, but
+ * computes each surrogate with the srgcreate intersection code instead of
+ * the SQL of the pgscripts templates.
+ *
+ * The semantics are those of the templates:
+ *   - weight shapes are cut by the data polygons and then by the grid
+ *     cells; pieces that only touch add nothing.  When the data and
+ *     weight shapefiles are the same, each weight shape keeps its own
+ *     data attribute instead of being cut.
+ *   - FILTER FUNCTION is an SQL WHERE clause on the weight attributes,
+ *     e.g. moves2014=2 or moves2014=4, gridcode IN (21,22) or
+ *     dev_stat='Producer'.  The srgtools forms ATTR=1,2,3 and
+ *     filters separated by semicolons are accepted as well.
+ *   - the numerator of a polygon piece is its area, or the weight
+ *     attribute times the fraction of the weight polygon's area; of a
+ *     line piece its length, or the weight attribute times its length;
+ *     of a point 1 or the weight attribute.
+ *   - the denominator of a county is the sum of its numerators in the
+ *     grid, rows with a zero numerator or denominator are dropped, and
+ *     the rows are sorted by county, column and row.
+ *
+ * Each surrogate is computed in its own process, and SRGBATCH_JOBS of
+ * them run at once.  Their messages go to temp_files/<REGION>_<code>.log
+ * under the OUTPUT DIRECTORY, next to the filtered weight shapefiles.
+ *
+ * Usage:
+ *   srgbatch.exe control_variables_pg.csv
+ *
+ * File contains:
+ * main
+ * runSurrogate
+ * filterWeights
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/utsname.h>
+#else
+#include <direct.h>
+#endif
+
+#include "shapefil.h"
+#include "mims_spatl.h"
+#include "mims_evs.h"
+#include "io.h"
+
+char *prog_name;
+char *prog_version = "Spatial Allocator Srgbatch Version 4.4 10/19/2026";
+int maxShapes = 0;
+int fileCompleted;
+
+/* library functions without prototypes in mims_spatl.h */
+int CopyPolySelf(PolyObject * pw, PolyObject * pd, PolyObject * pwd);
+int PolyMShapeInOne(PolyObject * poly);
+int attachAttribute(PolyObject * poly, char *attr_env_name,
+                    char *ctgr_name);
+int print_hdr(FILE * file, PolyObject * g_poly);
+
+/* a CSV file with a header line */
+typedef struct _CsvTable {
+    int ncol;
+    char **hdr;
+    int nrow;
+    char ***cell;
+} CsvTable;
+
+/* one surrogate to generate */
+typedef struct _SrgSpec {
+    char *region;
+    char *name;
+    int code;
+    char *dataShp;
+    char *dataAttr;
+    char *weightShp;
+    char *weightAttr;
+    char *weightFunc;
+    char *filter;
+} SrgSpec;
+
+/* settings shared by all surrogates */
+typedef struct _BatchInfo {
+    CsvTable *ctl;
+    CsvTable *catalog;
+    char *shpDir;
+    char *outDir;
+    char tmpDir[512];
+    char *outEllipsoid;
+} BatchInfo;
+
+/* filter expression nodes */
+#define F_OR 1
+#define F_AND 2
+#define F_NOT 3
+#define F_CMP 4
+
+#define C_EQ 1
+#define C_NE 2
+#define C_LT 3
+#define C_LE 4
+#define C_GT 5
+#define C_GE 6
+
+typedef struct _FilterNode {
+    int op;
+    struct _FilterNode *left;
+    struct _FilterNode *right;
+    int field;                  /* DBF field of an F_CMP */
+    int numeric;                /* the field is an integer or double */
+    int cmp;
+    int nval;                   /* values; more than one for IN (...) */
+    char **sval;
+    double *dval;
+    int *isnum;
+} FilterNode;
+
+/* filter tokens */
+#define T_END 0
+#define T_WORD 1
+#define T_NUMBER 2
+#define T_STRING 3
+#define T_OP 4
+#define T_LPAREN 5
+#define T_RPAREN 6
+#define T_COMMA 7
+#define T_SEMI 8
+
+typedef struct _FilterParser {
+    char *text;                 /* the whole filter, for messages */
+    char *p;
+    int tok;
+    char tokText[256];
+    DBFHandle hDBF;
+} FilterParser;
+
+/* a numerator piece: county rank, grid cell and value */
+typedef struct _SrgPiece {
+    int county;
+    int col;
+    int row;
+    int frag;
+    double value;
+} SrgPiece;
+
+static char **countyIDs;        /* for compareCountyIndex */
+
+
+/* ============================================================= */
+static void *batchAlloc(size_t size)
+{
+    void *p = malloc(size > 0 ? size : 1);
+
+    if(p == NULL)
+    {
+        ERROR(prog_name, "Allocation error", 2);
+    }
+    return p;
+}
+
+
+/* ============================================================= */
+static char *batchStrdup(const char *s)
+{
+    char *p = (char *) batchAlloc(strlen(s) + 1);
+
+    strcpy(p, s);
+    return p;
+}
+
+
+/* ============================================================= */
+/* trim white space from both ends of s in place */
+static char *trimField(char *s)
+{
+    char *e;
+
+    while(isspace((unsigned char) *s))
+    {
+        s++;
+    }
+    e = s + strlen(s);
+    while(e > s && isspace((unsigned char) e[-1]))
+    {
+        e--;
+    }
+    *e = '\0';
+    return s;
+}
+
+
+/* ============================================================= */
+/* split a CSV line into trimmed fields; quoted fields may contain
+ * commas and doubled quotes */
+static int splitCsv(char *line, char ***pfields)
+{
+    char **fields;
+    char *out, *start;
+    int n = 0, cap = 16, quoted;
+
+    fields = (char **) batchAlloc(cap * sizeof(char *));
+    out = line;
+    for(;;)
+    {
+        start = out;
+        quoted = 0;
+        while(*line != '\0' && (quoted || *line != ','))
+        {
+            if(*line == '"')
+            {
+                if(quoted && line[1] == '"')
+                {
+                    *out++ = '"';
+                    line += 2;
+                    continue;
+                }
+                quoted = !quoted;
+                line++;
+                continue;
+            }
+            *out++ = *line++;
+        }
+        if(n == cap)
+        {
+            cap *= 2;
+            fields = (char **) realloc(fields, cap * sizeof(char *));
+            if(fields == NULL)
+            {
+                ERROR(prog_name, "Allocation error", 2);
+            }
+        }
+        if(*line == ',')
+        {
+            line++;
+            *out++ = '\0';
+            fields[n++] = trimField(start);
+            continue;
+        }
+        *out = '\0';
+        fields[n++] = trimField(start);
+        break;
+    }
+    *pfields = fields;
+    return n;
+}
+
+
+/* ============================================================= */
+static CsvTable *readCsv(char *fname)
+{
+    CsvTable *t;
+    FILE *fp;
+    char line[4096];
+    char mesg[600];
+    char **fields, *copy;
+    int n, i, cap = 64;
+
+    if((fp = fopen(fname, "r")) == NULL)
+    {
+        sprintf(mesg, "Cannot open %s", fname);
+        ERROR(prog_name, mesg, 2);
+    }
+    t = (CsvTable *) batchAlloc(sizeof(CsvTable));
+    t->ncol = 0;
+    t->nrow = 0;
+    t->cell = (char ***) batchAlloc(cap * sizeof(char **));
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if(trimField(line)[0] == '\0')
+        {
+            continue;
+        }
+        copy = batchStrdup(line);
+        n = splitCsv(copy, &fields);
+        if(t->ncol == 0)
+        {
+            t->ncol = n;
+            t->hdr = fields;
+            continue;
+        }
+        /* short rows get empty trailing fields */
+        if(n < t->ncol)
+        {
+            fields = (char **) realloc(fields, t->ncol * sizeof(char *));
+            if(fields == NULL)
+            {
+                ERROR(prog_name, "Allocation error", 2);
+            }
+            for(i = n; i < t->ncol; i++)
+            {
+                fields[i] = "";
+            }
+        }
+        if(t->nrow == cap)
+        {
+            cap *= 2;
+            t->cell = (char ***) realloc(t->cell, cap * sizeof(char **));
+            if(t->cell == NULL)
+            {
+                ERROR(prog_name, "Allocation error", 2);
+            }
+        }
+        t->cell[t->nrow++] = fields;
+    }
+    fclose(fp);
+    if(t->ncol == 0)
+    {
+        sprintf(mesg, "%s has no header line", fname);
+        ERROR(prog_name, mesg, 2);
+    }
+    return t;
+}
+
+
+/* ============================================================= */
+/* column of a header name, ignoring case; -1 if not there */
+static int csvColumn(CsvTable * t, char *name)
+{
+    int i;
+
+    for(i = 0; i < t->ncol; i++)
+    {
+        if(strcasecmp(t->hdr[i], name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/* ============================================================= */
+static int needColumn(CsvTable * t, char *name, char *fname)
+{
+    char mesg[300];
+    int col = csvColumn(t, name);
+
+    if(col < 0)
+    {
+        sprintf(mesg, "Column %s is missing from %s", name, fname);
+        ERROR(prog_name, mesg, 2);
+    }
+    return col;
+}
+
+
+/* ============================================================= */
+/* value of a control variable, or NULL if it is not set */
+static char *controlValue(CsvTable * ctl, char *name)
+{
+    int i;
+
+    for(i = 0; i < ctl->nrow; i++)
+    {
+        if(strcasecmp(ctl->cell[i][0], name) == 0 && ctl->ncol > 1)
+        {
+            return ctl->cell[i][1];
+        }
+    }
+    return NULL;
+}
+
+
+/* ============================================================= */
+static char *needControl(CsvTable * ctl, char *name)
+{
+    char mesg[300];
+    char *v = controlValue(ctl, name);
+
+    if(v == NULL || v[0] == '\0')
+    {
+        sprintf(mesg, "Control variable %s is not set", name);
+        ERROR(prog_name, mesg, 2);
+    }
+    return v;
+}
+
+
+/* ============================================================= */
+static int fileExists(char *fname)
+{
+    struct stat st;
+
+    return stat(fname, &st) == 0;
+}
+
+
+/* ============================================================= */
+static void makeDir(char *dir)
+{
+    char mesg[600];
+
+    if(fileExists(dir))
+    {
+        return;
+    }
+#ifdef _WIN32
+    if(_mkdir(dir) != 0)
+#else
+    if(mkdir(dir, 0775) != 0)
+#endif
+    {
+        sprintf(mesg, "Cannot create directory %s", dir);
+        ERROR(prog_name, mesg, 2);
+    }
+}
+
+
+/* ============================================================= */
+/* fname = base + ext, in a buffer of size bytes */
+static void shapePartName(char *fname, size_t size, char *base, char *ext)
+{
+    char mesg[256];
+
+    if(snprintf(fname, size, "%s%s", base, ext) >= (int) size)
+    {
+        sprintf(mesg, "Shapefile name is longer than %d characters",
+                (int) size - 1);
+        ERROR(prog_name, mesg, 2);
+    }
+}
+
+
+/* ============================================================= */
+/* the real name of a DBF field, matched ignoring case as PostgreSQL
+ * does for unquoted names; returns 0 if there is no such field */
+static int dbfFieldName(char *shpBase, char *name, char *realName)
+{
+    DBFHandle hDBF;
+    char fname[600];
+    char title[20];
+    int i, nf, width, decimals, found = 0;
+
+    shapePartName(fname, sizeof(fname), shpBase, ".dbf");
+    if((hDBF = DBFOpen(fname, "rb")) == NULL)
+    {
+        return 0;
+    }
+    nf = DBFGetFieldCount(hDBF);
+    for(i = 0; i < nf && !found; i++)
+    {
+        DBFGetFieldInfo(hDBF, i, title, &width, &decimals);
+        if(strcasecmp(title, name) == 0)
+        {
+            strcpy(realName, title);
+            found = 1;
+        }
+    }
+    DBFClose(hDBF);
+    return found;
+}
+
+
+/* ============================================================= */
+/* look up a shapefile in the catalog; the catalog DIRECTORY is used if
+ * the shapefile is there, otherwise the SHAPEFILE DIRECTORY (in the pg
+ * catalog the DIRECTORY is a database schema) */
+static void catalogShapefile(BatchInfo * bi, char *name, char *base,
+                             char *ellipsoid, char *proj)
+{
+    CsvTable *cat = bi->catalog;
+    int cName, cDir, cEllip, cProj;
+    int i;
+    char shp[600];
+    char mesg[600];
+    char *e, *p;
+
+    cName = needColumn(cat, "SHAPEFILE NAME", "the shapefile catalog");
+    cDir = needColumn(cat, "DIRECTORY", "the shapefile catalog");
+    cEllip = needColumn(cat, "ELLIPSOID", "the shapefile catalog");
+    cProj = needColumn(cat, "PROJECTION", "the shapefile catalog");
+    for(i = 0; i < cat->nrow; i++)
+    {
+        if(strcasecmp(cat->cell[i][cName], name) == 0)
+        {
+            break;
+        }
+    }
+    if(i == cat->nrow)
+    {
+        sprintf(mesg, "Shapefile %s is not in the shapefile catalog", name);
+        ERROR(prog_name, mesg, 2);
+    }
+
+    sprintf(base, "%s/%s", cat->cell[i][cDir], cat->cell[i][cName]);
+    sprintf(shp, "%s.shp", base);
+    if(!fileExists(shp))
+    {
+        sprintf(base, "%s/%s", bi->shpDir, cat->cell[i][cName]);
+        sprintf(shp, "%s.shp", base);
+        if(!fileExists(shp))
+        {
+            sprintf(mesg, "Cannot find %s.shp in %s or %s", name,
+                    cat->cell[i][cDir], bi->shpDir);
+            ERROR(prog_name, mesg, 2);
+        }
+    }
+
+    /* spreadsheet programs turn +a=... into #NAME? */
+    e = cat->cell[i][cEllip];
+    if(e[0] != '+')
+    {
+        sprintf(mesg, "Ellipsoid \"%s\" of %s is not usable, using %s",
+                e, name, bi->outEllipsoid);
+        WARN(mesg);
+        e = bi->outEllipsoid;
+    }
+    strcpy(ellipsoid, e);
+
+    p = cat->cell[i][cProj];
+    sprintf(proj, "%s%s", p[0] == '+' ? "" : "+", p);
+}
+
+
+/* ============================================================= */
+static void setEnvt(char *name, char *value)
+{
+#ifdef _WIN32
+    char *s = (char *) batchAlloc(strlen(name) + strlen(value) + 2);
+
+    sprintf(s, "%s=%s", name, value);
+    putenv(s);
+#else
+    setenv(name, value, 1);
+#endif
+}
+
+
+/* ============================================================= */
+/* filter expressions */
+/* ============================================================= */
+
+static void filterError(FilterParser * fp, char *what)
+{
+    char mesg[600];
+
+    sprintf(mesg, "%s in filter function \"%s\"", what, fp->text);
+    ERROR(prog_name, mesg, 2);
+}
+
+
+/* ============================================================= */
+static void nextToken(FilterParser * fp)
+{
+    char *p = fp->p;
+    char q;
+    int n = 0;
+
+    while(isspace((unsigned char) *p))
+    {
+        p++;
+    }
+    fp->tokText[0] = '\0';
+    if(*p == '\0')
+    {
+        fp->tok = T_END;
+    }
+    else if(*p == '(' || *p == ')' || *p == ',' || *p == ';')
+    {
+        fp->tok = *p == '(' ? T_LPAREN : *p == ')' ? T_RPAREN :
+            *p == ',' ? T_COMMA : T_SEMI;
+        p++;
+    }
+    else if(*p == '=' || *p == '<' || *p == '>' || *p == '!')
+    {
+        fp->tok = T_OP;
+        fp->tokText[n++] = *p++;
+        if(*p == '=' || (fp->tokText[0] == '<' && *p == '>'))
+        {
+            fp->tokText[n++] = *p++;
+        }
+        fp->tokText[n] = '\0';
+        if(strcmp(fp->tokText, "!") == 0)
+        {
+            filterError(fp, "Unknown operator !");
+        }
+    }
+    else if(*p == '\'' || *p == '"')
+    {
+        fp->tok = T_STRING;
+        q = *p++;
+        for(;;)
+        {
+            if(*p == '\0')
+            {
+                filterError(fp, "Unterminated string");
+            }
+            if(*p == q)
+            {
+                if(p[1] != q)
+                {
+                    break;
+                }
+                p++;
+            }
+            if(n < (int) sizeof(fp->tokText) - 1)
+            {
+                fp->tokText[n++] = *p;
+            }
+            p++;
+        }
+        p++;
+        fp->tokText[n] = '\0';
+    }
+    else
+    {
+        /* a name or a number, up to the next operator or separator */
+        while(*p != '\0' && !isspace((unsigned char) *p) &&
+              strchr("()=<>!,;'\"", *p) == NULL)
+        {
+            if(n < (int) sizeof(fp->tokText) - 1)
+            {
+                fp->tokText[n++] = *p;
+            }
+            p++;
+        }
+        fp->tokText[n] = '\0';
+        fp->tok = digiCheck(fp->tokText) ? T_WORD : T_NUMBER;
+    }
+    fp->p = p;
+}
+
+
+/* ============================================================= */
+static int isKeyword(FilterParser * fp, char *word)
+{
+    return fp->tok == T_WORD && strcasecmp(fp->tokText, word) == 0;
+}
+
+
+/* ============================================================= */
+static FilterNode *newNode(int op, FilterNode * left, FilterNode * right)
+{
+    FilterNode *n = (FilterNode *) batchAlloc(sizeof(FilterNode));
+
+    memset(n, 0, sizeof(FilterNode));
+    n->op = op;
+    n->left = left;
+    n->right = right;
+    return n;
+}
+
+
+/* ============================================================= */
+static void addValue(FilterParser * fp, FilterNode * n)
+{
+    char *end;
+
+    if(fp->tok != T_NUMBER && fp->tok != T_STRING && fp->tok != T_WORD)
+    {
+        filterError(fp, "Missing value");
+    }
+    n->sval = (char **) realloc(n->sval, (n->nval + 1) * sizeof(char *));
+    n->dval = (double *) realloc(n->dval, (n->nval + 1) * sizeof(double));
+    n->isnum = (int *) realloc(n->isnum, (n->nval + 1) * sizeof(int));
+    if(n->sval == NULL || n->dval == NULL || n->isnum == NULL)
+    {
+        ERROR(prog_name, "Allocation error", 2);
+    }
+    n->sval[n->nval] = batchStrdup(fp->tokText);
+    n->dval[n->nval] = strtod(fp->tokText, &end);
+    n->isnum[n->nval] = fp->tok == T_NUMBER ||
+        (fp->tokText[0] != '\0' && *end == '\0');
+    n->nval++;
+    nextToken(fp);
+}
+
+
+/* ============================================================= */
+static FilterNode *parseOr(FilterParser * fp);
+
+/* field op value[,value...] | field [NOT] IN (values) */
+static FilterNode *parsePredicate(FilterParser * fp)
+{
+    FilterNode *n;
+    char title[20];
+    char mesg[256];
+    int i, nf, width, decimals, negate = 0;
+    DBFFieldType type;
+
+    if(fp->tok != T_WORD)
+    {
+        filterError(fp, "Missing attribute name");
+    }
+    n = newNode(F_CMP, NULL, NULL);
+    n->field = -1;
+    nf = DBFGetFieldCount(fp->hDBF);
+    for(i = 0; i < nf; i++)
+    {
+        type = DBFGetFieldInfo(fp->hDBF, i, title, &width, &decimals);
+        if(strcasecmp(title, fp->tokText) == 0)
+        {
+            n->field = i;
+            n->numeric = type == FTInteger || type == FTDouble;
+            break;
+        }
+    }
+    if(n->field < 0)
+    {
+        sprintf(mesg, "Unknown attribute %.200s", fp->tokText);
+        filterError(fp, mesg);
+    }
+    nextToken(fp);
+
+    if(isKeyword(fp, "NOT"))
+    {
+        negate = 1;
+        nextToken(fp);
+        if(!isKeyword(fp, "IN"))
+        {
+            filterError(fp, "Expected IN after NOT");
+        }
+    }
+    if(isKeyword(fp, "IN"))
+    {
+        n->cmp = negate ? C_NE : C_EQ;
+        nextToken(fp);
+        if(fp->tok != T_LPAREN)
+        {
+            filterError(fp, "Expected ( after IN");
+        }
+        nextToken(fp);
+        addValue(fp, n);
+        while(fp->tok == T_COMMA)
+        {
+            nextToken(fp);
+            addValue(fp, n);
+        }
+        if(fp->tok != T_RPAREN)
+        {
+            filterError(fp, "Expected ) to close IN");
+        }
+        nextToken(fp);
+        return n;
+    }
+
+    if(fp->tok != T_OP)
+    {
+        filterError(fp, "Missing comparison operator");
+    }
+    if(!strcmp(fp->tokText, "="))
+        n->cmp = C_EQ;
+    else if(!strcmp(fp->tokText, "!=") || !strcmp(fp->tokText, "<>"))
+        n->cmp = C_NE;
+    else if(!strcmp(fp->tokText, "<"))
+        n->cmp = C_LT;
+    else if(!strcmp(fp->tokText, "<="))
+        n->cmp = C_LE;
+    else if(!strcmp(fp->tokText, ">"))
+        n->cmp = C_GT;
+    else if(!strcmp(fp->tokText, ">="))
+        n->cmp = C_GE;
+    else
+        filterError(fp, "Unknown comparison operator");
+    nextToken(fp);
+    addValue(fp, n);
+
+    /* srgtools lists, ATTR=1,2,3 */
+    while(fp->tok == T_COMMA && (n->cmp == C_EQ || n->cmp == C_NE))
+    {
+        nextToken(fp);
+        addValue(fp, n);
+    }
+    return n;
+}
+
+
+/* ============================================================= */
+static FilterNode *parseNot(FilterParser * fp)
+{
+    FilterNode *n;
+
+    if(isKeyword(fp, "NOT"))
+    {
+        nextToken(fp);
+        return newNode(F_NOT, parseNot(fp), NULL);
+    }
+    if(fp->tok == T_LPAREN)
+    {
+        nextToken(fp);
+        n = parseOr(fp);
+        if(fp->tok != T_RPAREN)
+        {
+            filterError(fp, "Missing )");
+        }
+        nextToken(fp);
+        return n;
+    }
+    return parsePredicate(fp);
+}
+
+
+/* ============================================================= */
+static FilterNode *parseAnd(FilterParser * fp)
+{
+    FilterNode *n = parseNot(fp);
+
+    while(isKeyword(fp, "AND") || fp->tok == T_SEMI)
+    {
+        nextToken(fp);
+        n = newNode(F_AND, n, parseNot(fp));
+    }
+    return n;
+}
+
+
+/* ============================================================= */
+static FilterNode *parseOr(FilterParser * fp)
+{
+    FilterNode *n = parseAnd(fp);
+
+    while(isKeyword(fp, "OR"))
+    {
+        nextToken(fp);
+        n = newNode(F_OR, n, parseAnd(fp));
+    }
+    return n;
+}
+
+
+/* ============================================================= */
+static FilterNode *parseFilter(char *text, DBFHandle hDBF)
+{
+    FilterParser fp;
+    FilterNode *n;
+
+    fp.text = text;
+    fp.p = text;
+    fp.hDBF = hDBF;
+    nextToken(&fp);
+    n = parseOr(&fp);
+    if(fp.tok != T_END)
+    {
+        filterError(&fp, "Unexpected text");
+    }
+    return n;
+}
+
+
+/* ============================================================= */
+/* does record rec pass the filter; an empty numeric field is NULL and
+ * fails every comparison, as in SQL */
+static int evalFilter(FilterNode * n, DBFHandle hDBF, int rec)
+{
+    char buf[256];
+    double v = 0.0, d;
+    int i, c, match;
+
+    switch (n->op)
+    {
+    case F_OR:
+        return evalFilter(n->left, hDBF, rec) ||
+            evalFilter(n->right, hDBF, rec);
+    case F_AND:
+        return evalFilter(n->left, hDBF, rec) &&
+            evalFilter(n->right, hDBF, rec);
+    case F_NOT:
+        return !evalFilter(n->left, hDBF, rec);
+    }
+
+    strNullTerminate(buf, DBFReadStringAttribute(hDBF, rec, n->field),
+                     sizeof(buf) - 1);
+    strcpy(buf, trimField(buf));
+    if(n->numeric)
+    {
+        if(buf[0] == '\0')
+        {
+            return 0;
+        }
+        v = atof(buf);
+    }
+
+    match = 0;
+    for(i = 0; i < n->nval && !match; i++)
+    {
+        if(n->numeric && n->isnum[i])
+        {
+            d = v - n->dval[i];
+            c = d < 0.0 ? -1 : d > 0.0 ? 1 : 0;
+        }
+        else
+        {
+            c = strcmp(buf, n->sval[i]);
+        }
+        switch (n->cmp)
+        {
+        case C_EQ:
+        case C_NE:
+            match = c == 0;
+            break;
+        case C_LT:
+            match = c < 0;
+            break;
+        case C_LE:
+            match = c <= 0;
+            break;
+        case C_GT:
+            match = c > 0;
+            break;
+        case C_GE:
+            match = c >= 0;
+            break;
+        }
+    }
+    return n->cmp == C_NE ? !match : match;
+}
+
+
+/* ============================================================= */
+/* write the shapes of inBase that pass the filter to outBase; returns
+ * the number of shapes written */
+static int filterWeights(char *inBase, char *filter, char *outBase)
+{
+    SHPHandle hSHP, oSHP;
+    DBFHandle hDBF, oDBF;
+    SHPObject *obj;
+    FilterNode *root;
+    char fname[600];
+    char mesg[700];
+    int nObjects, shpType, i, kept = 0;
+    double minBound[4], maxBound[4];
+
+    shapePartName(fname, sizeof(fname), inBase, ".shp");
+    if((hSHP = SHPOpen(fname, "rb")) == NULL)
+    {
+        sprintf(mesg, "Cannot open %s", fname);
+        ERROR(prog_name, mesg, 2);
+    }
+    shapePartName(fname, sizeof(fname), inBase, ".dbf");
+    if((hDBF = DBFOpen(fname, "rb")) == NULL)
+    {
+        sprintf(mesg, "Cannot open %s", fname);
+        ERROR(prog_name, mesg, 2);
+    }
+    SHPGetInfo(hSHP, &nObjects, &shpType, minBound, maxBound);
+    root = parseFilter(filter, hDBF);
+
+    shapePartName(fname, sizeof(fname), outBase, ".shp");
+    if((oSHP = SHPCreate(fname, shpType)) == NULL)
+    {
+        sprintf(mesg, "Cannot create %s", fname);
+        ERROR(prog_name, mesg, 2);
+    }
+    shapePartName(fname, sizeof(fname), outBase, ".dbf");
+    if((oDBF = DBFCloneEmpty(hDBF, fname)) == NULL)
+    {
+        sprintf(mesg, "Cannot create %s", fname);
+        ERROR(prog_name, mesg, 2);
+    }
+
+    for(i = 0; i < nObjects; i++)
+    {
+        if(!evalFilter(root, hDBF, i))
+        {
+            continue;
+        }
+        if((obj = SHPReadObject(hSHP, i)) == NULL)
+        {
+            sprintf(mesg, "Cannot read shape %d of %s", i, inBase);
+            ERROR(prog_name, mesg, 2);
+        }
+        SHPWriteObject(oSHP, -1, obj);
+        SHPDestroyObject(obj);
+        DBFWriteTuple(oDBF, kept, (void *) DBFReadTuple(hDBF, i));
+        kept++;
+    }
+
+    SHPClose(oSHP);
+    DBFClose(oDBF);
+    SHPClose(hSHP);
+    DBFClose(hDBF);
+
+    sprintf(mesg, "Filter \"%s\" kept %d of %d shapes", filter, kept,
+            nObjects);
+    MESG(mesg);
+    return kept;
+}
+
+
+/* ============================================================= */
+/* surrogate computation */
+/* ============================================================= */
+
+/* ============================================================= */
+static int compareCountyIndex(const void *a, const void *b)
+{
+    int c = strcmp(countyIDs[*(const int *) a], countyIDs[*(const int *) b]);
+
+    return c != 0 ? c : *(const int *) a - *(const int *) b;
+}
+
+
+/* ============================================================= */
+static int comparePiece(const void *a, const void *b)
+{
+    const SrgPiece *p = (const SrgPiece *) a;
+    const SrgPiece *q = (const SrgPiece *) b;
+
+    if(p->county != q->county)
+        return p->county < q->county ? -1 : 1;
+    if(p->col != q->col)
+        return p->col < q->col ? -1 : 1;
+    if(p->row != q->row)
+        return p->row < q->row ? -1 : 1;
+    return p->frag < q->frag ? -1 : p->frag > q->frag;
+}
+
+
+/* ============================================================= */
+/* write the header written by the PostgreSQL Surrogate Tool */
+static void writeHeader(FILE * ofp, SrgSpec * s, PolyObject * p_grid)
+{
+    char date[100];
+    char system[100];
+    char *user;
+    time_t now;
+    int i;
+#ifndef _WIN32
+    struct utsname un;
+#endif
+
+    print_hdr(ofp, p_grid);
+    fprintf(ofp, "#SRGDESC=%d,%s\n", s->code, s->name);
+    fprintf(ofp, "#\n");
+    fprintf(ofp, "#SURROGATE REGION = %s\n", s->region);
+    fprintf(ofp, "#SURROGATE CODE = %d\n", s->code);
+    fprintf(ofp, "#SURROGATE NAME = %s\n", s->name);
+    fprintf(ofp, "#DATA SHAPEFILE = %s\n", s->dataShp);
+    fprintf(ofp, "#DATA ATTRIBUTE = %s\n", s->dataAttr);
+    fprintf(ofp, "#WEIGHT SHAPEFILE = %s\n", s->weightShp);
+    fprintf(ofp, "#WEIGHT ATTRIBUTE = %s\n", s->weightAttr);
+    fprintf(ofp, "#WEIGHT FUNCTION = %s\n", s->weightFunc);
+    fprintf(ofp, "#FILTER FUNCTION = %s\n", s->filter);
+    fprintf(ofp, "#\n");
+
+    user = getenv("USER");
+    strcpy(system, "windows");
+#ifndef _WIN32
+    if(uname(&un) == 0)
+    {
+        sprintf(system, "%.99s", un.sysname);
+    }
+#endif
+    for(i = 0; system[i] != '\0'; i++)
+    {
+        system[i] = tolower((unsigned char) system[i]);
+    }
+    now = time(NULL);
+    strftime(date, sizeof(date), "%a %b %d %H:%M:%S %Z %Y",
+             localtime(&now));
+    fprintf(ofp, "#USER = %s\n", user != NULL ? user : "");
+    fprintf(ofp, "#COMPUTER SYSTEM = %s\n", system);
+    fprintf(ofp, "#DATE = %s\n", date);
+}
+
+
+/* ============================================================= */
+/* sum the pieces of the weight-data-grid intersection by county and
+ * cell and write the surrogate rows */
+static void writeSurrogates(FILE * ofp, SrgSpec * s, PolyObject * p_wdg,
+                            int wattr, int use_weight_val)
+{
+    PolyObject *wd_poly, *d_poly, *w_poly, *g_poly;
+    GeomStore *gs;
+    SrgPiece *piece;
+    int *order, *rank;
+    char **ids;
+    int i, j, k, n, nd, ncols, npiece, w_idx, d_idx, cell;
+    int idtype, valtype, shptype;
+    double val, v, numer, denom;
+
+    wd_poly = p_wdg->parent_poly1;
+    w_poly = wd_poly->parent_poly1;
+    d_poly = wd_poly->parent_poly2;
+    g_poly = p_wdg->parent_poly2;
+    ncols = g_poly->map->ncols;
+
+    /* county IDs and their rank in sorted order */
+    nd = d_poly->nObjects;
+    idtype = d_poly->attr_hdr->attr_desc[0]->type;
+    ids = (char **) batchAlloc(nd * sizeof(char *));
+    order = (int *) batchAlloc(nd * sizeof(int));
+    rank = (int *) batchAlloc(nd * sizeof(int));
+    for(i = 0; i < nd; i++)
+    {
+        char id[80];
+
+        if(idtype == FTInteger)
+        {
+            sprintf(id, "%d", d_poly->attr_val[i][0].ival);
+        }
+        else if(idtype == FTString)
+        {
+            sprintf(id, "%.79s", d_poly->attr_val[i][0].str);
+        }
+        else
+        {
+            sprintf(id, "poly%d", i);
+        }
+        ids[i] = batchStrdup(id);
+        order[i] = i;
+    }
+    countyIDs = ids;
+    qsort(order, nd, sizeof(int), compareCountyIndex);
+    for(i = 0, k = -1; i < nd; i++)
+    {
+        if(i == 0 || strcmp(ids[order[i]], ids[order[i - 1]]) != 0)
+        {
+            k++;
+        }
+        rank[order[i]] = k;
+    }
+
+    valtype = use_weight_val ? w_poly->attr_hdr->attr_desc[wattr]->type :
+        FTInvalid;
+    shptype = w_poly->nSHPType;
+
+    gs = getGeomStore(p_wdg);
+    if(gs == NULL)
+    {
+        ERROR(prog_name, "Cannot build the intersected shapes", 2);
+    }
+    piece = (SrgPiece *) batchAlloc(gs->nshapes * sizeof(SrgPiece));
+    npiece = 0;
+    for(i = 0; i < gs->nshapes; i++)
+    {
+        cell = gs->top_p2[i];
+        d_idx = gs->top_p1_p2[i];
+        w_idx = gs->top_p1[i];
+        if(cell < 0 || d_idx < 0)
+        {
+            continue;
+        }
+
+        val = 1.0;
+        if(use_weight_val)
+        {
+            if(valtype == FTInteger)
+                val = (double) w_poly->attr_val[w_idx][wattr].ival;
+            else if(valtype == FTDouble)
+                val = w_poly->attr_val[w_idx][wattr].val;
+        }
+        if(shptype == SHPT_POINT)
+        {
+            v = storeNumContours(gs, i) > 1 ? 0.0 : val;
+        }
+        else if(shptype == SHPT_ARC)
+        {
+            /* attributes of lines are per unit length, e.g. AADT */
+            v = storeLength(gs, i);
+            if(use_weight_val)
+            {
+                v *= val;
+            }
+        }
+        else
+        {
+            v = storeArea(gs, i);
+            if(use_weight_val)
+            {
+                v = val * v / storeParentArea(gs, i);
+            }
+        }
+
+        piece[npiece].county = rank[d_idx];
+        piece[npiece].col = cell % ncols + 1;
+        piece[npiece].row = cell / ncols + 1;
+        piece[npiece].frag = i;
+        piece[npiece].value = v;
+        npiece++;
+    }
+    qsort(piece, npiece, sizeof(SrgPiece), comparePiece);
+
+    /* rank back to a county ID */
+    for(i = 0; i < nd; i++)
+    {
+        order[rank[i]] = i;
+    }
+
+    /* one county at a time: merge the pieces of a cell, then write */
+    for(i = 0; i < npiece; i = j)
+    {
+        denom = 0.0;
+        for(j = i; j < npiece && piece[j].county == piece[i].county; j++)
+        {
+            denom += piece[j].value;
+        }
+        for(k = i; k < j; k = n)
+        {
+            numer = 0.0;
+            for(n = k; n < j && piece[n].col == piece[k].col &&
+                piece[n].row == piece[k].row; n++)
+            {
+                numer += piece[n].value;
+            }
+            if(numer != 0.0 && denom != 0.0)
+            {
+                fprintf(ofp, "%d\t%s\t%d\t%d\t%.15g\t!\t%.15g\t%.15g\n",
+                        s->code, ids[order[piece[k].county]],
+                        piece[k].col, piece[k].row, numer / denom,
+                        numer, denom);
+            }
+        }
+    }
+
+    free(piece);
+    free(rank);
+    free(order);
+    for(i = 0; i < nd; i++)
+    {
+        free(ids[i]);
+    }
+    free(ids);
+}
+
+
+/* ============================================================= */
+/* compute one surrogate and write its NOFILL file */
+static int runSurrogate(BatchInfo * bi, SrgSpec * s, PolyObject * p_grid,
+                        char *outFile)
+{
+    PolyObject *p_data, *p_weight, *p_wd, *p_wdg;
+    MapProjInfo *dataMapProj, *weightMapProj;
+    FILE *ofp;
+    char dataBase[600], weightBase[600], filtered[600];
+    char ellipsoid[256], proj[512], field[20];
+    char label[100], mesg[700], code[20];
+    int sameFile, use_weight_val, wattr, result;
+
+    sprintf(label, "%s_%d", s->region, s->code);
+    statsStart(prog_name, label);
+
+    sameFile = strcasecmp(s->dataShp, s->weightShp) == 0;
+    use_weight_val = s->weightFunc[0] != '\0' ||
+        (s->weightAttr[0] != '\0' && strcasecmp(s->weightAttr, "NONE"));
+
+    /* data shapes */
+    catalogShapefile(bi, s->dataShp, dataBase, ellipsoid, proj);
+    setEnvt(ENVT_DATA_FILE_NAME_TYPE, "ShapeFile");
+    setEnvt(ENVT_DATA_ELLIPSOID, ellipsoid);
+    setEnvt(ENVT_DATA_MAP_PROJ, proj);
+    if(!dbfFieldName(dataBase, s->dataAttr, field))
+    {
+        sprintf(mesg, "Data attribute %s is not in %s.dbf", s->dataAttr,
+                dataBase);
+        ERROR(prog_name, mesg, 2);
+    }
+    setEnvt(ENVT_DATA_ID_ATTR, field);
+
+    /* weight shapes, filtered to a temporary shapefile */
+    catalogShapefile(bi, s->weightShp, weightBase, ellipsoid, proj);
+    setEnvt(ENVT_WEIGHT_FILE_TYPE, "ShapeFile");
+    setEnvt(ENVT_WEIGHT_FILE_ELLIPSOID, ellipsoid);
+    setEnvt(ENVT_WEIGHT_FILE_MAP_PROJ, proj);
+    sprintf(code, "%d", s->code);
+    setEnvt(ENVT_SURROGATE_ID, code);
+    if(s->weightFunc[0] != '\0')
+    {
+        setEnvt(ENVT_WEIGHT_ATTR_LIST, "USE_FUNCTION");
+        setEnvt(ENVT_WEIGHT_FUNCTION, s->weightFunc);
+    }
+    else if(use_weight_val)
+    {
+        if(!dbfFieldName(weightBase, s->weightAttr, field))
+        {
+            sprintf(mesg, "Weight attribute %s is not in %s.dbf",
+                    s->weightAttr, weightBase);
+            ERROR(prog_name, mesg, 2);
+        }
+        setEnvt(ENVT_WEIGHT_ATTR_LIST, field);
+    }
+    else
+    {
+        setEnvt(ENVT_WEIGHT_ATTR_LIST, "NONE");
+    }
+
+    if((ofp = fopen(outFile, "w")) == NULL)
+    {
+        sprintf(mesg, "Cannot open %s for writing", outFile);
+        ERROR(prog_name, mesg, 2);
+    }
+    writeHeader(ofp, s, p_grid);
+
+    statsBegin("read_weight");
+    if(s->filter[0] != '\0')
+    {
+        sprintf(filtered, "%s/%s_%d_weight", bi->tmpDir, s->region,
+                s->code);
+        if(filterWeights(weightBase, s->filter, filtered) == 0)
+        {
+            WARN("No weight shapes pass the filter");
+            fclose(ofp);
+            statsEnd("read_weight");
+            statsWrite();
+            return 0;
+        }
+        strcpy(weightBase, filtered);
+    }
+    statsEnd("read_weight");
+    setEnvt(ENVT_WEIGHT_FILE_NAME, weightBase);
+    setEnvt(ENVT_DATA_FILE_NAME, sameFile ? weightBase : dataBase);
+
+    MESG("Reading data polygons\n");
+    statsBegin("read_data");
+    dataMapProj = getFullMapProjection(ENVT_DATA_ELLIPSOID,
+                                       ENVT_DATA_MAP_PROJ);
+    p_data = PolyReader(ENVT_DATA_FILE_NAME, ENVT_DATA_FILE_NAME_TYPE,
+                        dataMapProj, p_grid->bb, p_grid->map);
+    if(!p_data)
+    {
+        ERROR(prog_name, "Error reading the data shapefile", 2);
+    }
+    if(!attachAttribute(p_data, ENVT_DATA_ID_ATTR, NULL))
+    {
+        ERROR(prog_name, "Attaching data polygon attribute error", 2);
+    }
+    statsEnd("read_data");
+
+    p_wd = getNewPoly(0);
+    p_wdg = getNewPoly(0);
+    if(!p_wd || !p_wdg)
+    {
+        ERROR(prog_name, "Allocation error in getNewPoly", 2);
+    }
+
+    if(sameFile)
+    {
+        /* the weight shapes carry their own data attribute */
+        p_weight = p_data;
+        if(use_weight_val &&
+           !attachAttribute(p_weight, ENVT_WEIGHT_ATTR_LIST,
+                            ENVT_SURROGATE_ID))
+        {
+            ERROR(prog_name, "Attaching weight attribute error", 2);
+        }
+        statsBegin("intersect_wd");
+        if(!CopyPolySelf(p_weight, p_data, p_wd))
+        {
+            ERROR(prog_name, "Error copying the weight shapes", 2);
+        }
+        statsEnd("intersect_wd");
+    }
+    else
+    {
+        if(PolyMShapeInOne(p_data) != 0)
+        {
+            ERROR(prog_name,
+                  "Processing multiple shapes with the same ID into one record failed",
+                  2);
+        }
+        MESG("Reading weight points/lines/polygons\n");
+        statsBegin("read_weight");
+        weightMapProj = getFullMapProjection(ENVT_WEIGHT_FILE_ELLIPSOID,
+                                             ENVT_WEIGHT_FILE_MAP_PROJ);
+        p_weight = PolyReader(ENVT_WEIGHT_FILE_NAME, ENVT_WEIGHT_FILE_TYPE,
+                              weightMapProj, p_data->bb, p_grid->map);
+        if(!p_weight)
+        {
+            ERROR(prog_name, "Error reading the weight shapefile", 2);
+        }
+        if(use_weight_val &&
+           !attachAttribute(p_weight, ENVT_WEIGHT_ATTR_LIST,
+                            ENVT_SURROGATE_ID))
+        {
+            ERROR(prog_name, "Attaching weight attribute error", 2);
+        }
+        statsEnd("read_weight");
+
+        MESG("Intersecting weight objects with data polygons\n");
+        statsBegin("intersect_wd");
+        result = p_weight->nObjects > 0 ?
+            polyIsect(p_weight, p_data, p_wd, FALSE) : 0;
+        statsEnd("intersect_wd");
+        if(result < 0)
+        {
+            ERROR(prog_name, "Error intersecting weight and data shapes", 2);
+        }
+        else if(result == 0)
+        {
+            WARN("Weight and data shapes do not intersect");
+            fclose(ofp);
+            statsWrite();
+            return 0;
+        }
+    }
+    wattr = use_weight_val ? p_weight->attr_hdr->num_attr - 1 : 0;
+
+    MESG("Intersecting weight-data objects with grid polygons\n");
+    statsBegin("intersect_grid");
+    result = polyIsect(p_wd, p_grid, p_wdg, FALSE);
+    statsEnd("intersect_grid");
+    if(result < 0)
+    {
+        ERROR(prog_name, "Error intersecting weight+data and grid shapes", 2);
+    }
+
+    statsBegin("report");
+    if(result > 0)
+    {
+        writeSurrogates(ofp, s, p_wdg, wattr, use_weight_val);
+    }
+    else
+    {
+        WARN("Weight+data shapes do not overlap the output grid");
+    }
+    if(fclose(ofp) != 0)
+    {
+        sprintf(mesg, "Error writing %s", outFile);
+        ERROR(prog_name, mesg, 2);
+    }
+    statsEnd("report");
+    statsWrite();
+    return 0;
+}
+
+
+/* ============================================================= */
+/* driver */
+/* ============================================================= */
+
+static int batchJobs(void)
+{
+    char value[30];
+    char mesg[256];
+    int n = 1;
+
+    if(getenv(ENVT_SRGBATCH_JOBS) != NULL &&
+       getEnvtValue(ENVT_SRGBATCH_JOBS, value) && value[0] != '\0')
+    {
+        if(digiCheck(value) || (n = atoi(value)) < 1)
+        {
+            sprintf(mesg, "%s must be a positive integer",
+                    ENVT_SRGBATCH_JOBS);
+            ERROR(prog_name, mesg, 2);
+        }
+    }
+#ifdef _WIN32
+    n = 1;
+#endif
+    return n;
+}
+
+
+/* ============================================================= */
+static int isYes(char *v)
+{
+    return v != NULL && (strcasecmp(v, "YES") == 0 || strcasecmp(v, "Y") == 0);
+}
+
+
+/* ============================================================= */
+/* the surrogates marked GENERATE=YES in the generation control file,
+ * with their settings from the specification file */
+static SrgSpec *readSurrogates(char *genFile, char *specFile, int *pn)
+{
+    CsvTable *gen, *spec;
+    SrgSpec *list;
+    int gRegion, gName, gCode, gGenerate;
+    int sRegion, sName, sCode, sData, sDataAttr, sWeight, sWeightAttr;
+    int sWeightFunc, sFilter, sMerge;
+    int i, j, n = 0;
+    char *region, *code, *name;
+    char mesg[600];
+
+    gen = readCsv(genFile);
+    spec = readCsv(specFile);
+    gRegion = needColumn(gen, "REGION", genFile);
+    gName = needColumn(gen, "SURROGATE", genFile);
+    gCode = needColumn(gen, "SURROGATE CODE", genFile);
+    gGenerate = needColumn(gen, "GENERATE", genFile);
+    sRegion = needColumn(spec, "REGION", specFile);
+    sName = needColumn(spec, "SURROGATE", specFile);
+    sCode = needColumn(spec, "SURROGATE CODE", specFile);
+    sData = needColumn(spec, "DATA SHAPEFILE", specFile);
+    sDataAttr = needColumn(spec, "DATA ATTRIBUTE", specFile);
+    sWeight = needColumn(spec, "WEIGHT SHAPEFILE", specFile);
+    sWeightAttr = needColumn(spec, "WEIGHT ATTRIBUTE", specFile);
+    sWeightFunc = needColumn(spec, "WEIGHT FUNCTION", specFile);
+    sFilter = needColumn(spec, "FILTER FUNCTION", specFile);
+    sMerge = csvColumn(spec, "MERGE FUNCTION");
+
+    list = (SrgSpec *) batchAlloc(gen->nrow * sizeof(SrgSpec));
+    for(i = 0; i < gen->nrow; i++)
+    {
+        if(!isYes(gen->cell[i][gGenerate]))
+        {
+            continue;
+        }
+        region = gen->cell[i][gRegion];
+        code = gen->cell[i][gCode];
+        name = gen->cell[i][gName];
+        for(j = 0; j < spec->nrow; j++)
+        {
+            if(strcasecmp(spec->cell[j][sRegion], region) == 0 &&
+               (code[0] != '\0' ? atoi(spec->cell[j][sCode]) == atoi(code) :
+                strcmp(spec->cell[j][sName], name) == 0))
+            {
+                break;
+            }
+        }
+        if(j == spec->nrow)
+        {
+            sprintf(mesg, "Surrogate %s %s %s is not in %s", region, code,
+                    name, specFile);
+            ERROR(prog_name, mesg, 2);
+        }
+        if(spec->cell[j][sData][0] == '\0' ||
+           spec->cell[j][sWeight][0] == '\0')
+        {
+            printf("Skipping %s %s %s: %s\n", region, code, name,
+                   sMerge >= 0 && spec->cell[j][sMerge][0] != '\0' ?
+                   "merged surrogates are made by srgmerge" :
+                   "no data or weight shapefile");
+            continue;
+        }
+        list[n].region = spec->cell[j][sRegion];
+        list[n].name = spec->cell[j][sName];
+        list[n].code = atoi(spec->cell[j][sCode]);
+        list[n].dataShp = spec->cell[j][sData];
+        list[n].dataAttr = spec->cell[j][sDataAttr];
+        list[n].weightShp = spec->cell[j][sWeight];
+        list[n].weightAttr = spec->cell[j][sWeightAttr];
+        list[n].weightFunc = spec->cell[j][sWeightFunc];
+        list[n].filter = spec->cell[j][sFilter];
+        n++;
+    }
+    *pn = n;
+    return list;
+}
+
+
+/* ============================================================= */
+int main(int argc, char *argv[])
+{
+    BatchInfo bi;
+    SrgSpec *srg;
+    PolyObject *p_grid;
+    Arena *geomArena;
+    char **outFile;
+    char logFile[700];
+    char mesg[700];
+    char *v;
+    int nsrg, njobs, i, failed = 0;
+#ifndef _WIN32
+    pid_t *pid;
+    int running = 0, next = 0, status, k;
+#endif
+    extern int debug_output;
+
+    prog_name = argv[0];
+    printf("%s\n", prog_version);
+    if(argc != 2)
+    {
+        fprintf(stderr, "Usage: %s control_variables_file\n", prog_name);
+        exit(1);
+    }
+
+    bi.ctl = readCsv(argv[1]);
+    v = controlValue(bi.ctl, "DEBUG_OUTPUT");
+    debug_output = isYes(v);
+    if(controlValue(bi.ctl, "COMPUTE SURROGATES") != NULL &&
+       !isYes(controlValue(bi.ctl, "COMPUTE SURROGATES")))
+    {
+        printf("COMPUTE SURROGATES is not YES, nothing to do\n");
+        return 0;
+    }
+    v = controlValue(bi.ctl, "OUTPUT_FILE_TYPE");
+    if(v != NULL && v[0] != '\0' && strcmp(v, "RegularGrid") != 0)
+    {
+        sprintf(mesg, "OUTPUT_FILE_TYPE %s is not supported, only RegularGrid",
+                v);
+        ERROR(prog_name, mesg, 2);
+    }
+
+    bi.catalog = readCsv(needControl(bi.ctl, "SHAPEFILE CATALOG"));
+    v = controlValue(bi.ctl, "SHAPEFILE DIRECTORY");
+    bi.shpDir = v != NULL ? v : ".";
+    bi.outDir = needControl(bi.ctl, "OUTPUT DIRECTORY");
+    bi.outEllipsoid = needControl(bi.ctl, "OUTPUT_FILE_ELLIPSOID");
+    makeDir(bi.outDir);
+    sprintf(bi.tmpDir, "%.500s/temp_files", bi.outDir);
+    makeDir(bi.tmpDir);
+
+    srg = readSurrogates(needControl(bi.ctl, "GENERATION CONTROL FILE"),
+                         needControl(bi.ctl, "SURROGATE SPECIFICATION FILE"),
+                         &nsrg);
+
+    /* the grid is read once and shared by all surrogates */
+    setEnvt(ENVT_OUTPUT_FILE_TYPE, "RegularGrid");
+    setEnvt(ENVT_OUTPUT_GRID_NAME, needControl(bi.ctl, "OUTPUT_GRID_NAME"));
+    setEnvt(ENVT_OUTPUT_ELLIPSOID, bi.outEllipsoid);
+    setEnvt("GRIDDESC", needControl(bi.ctl, "GRIDDESC"));
+    geomArena = newArena(0);
+    if(geomArena == NULL)
+    {
+        ERROR(prog_name, "Allocation error for the geometry arena", 2);
+    }
+    setCurrentArena(geomArena);
+    p_grid = PolyReader(ENVT_OUTPUT_GRID_NAME, ENVT_OUTPUT_FILE_TYPE,
+                        NULL, NULL, NULL);
+    if(!p_grid || getGeomStore(p_grid) == NULL)
+    {
+        ERROR(prog_name, "Error reading the output grid", 2);
+    }
+
+    outFile = (char **) batchAlloc((nsrg > 0 ? nsrg : 1) * sizeof(char *));
+    for(i = 0; i < nsrg; i++)
+    {
+        sprintf(mesg, "%.500s/%s_%d_NOFILL.txt", bi.outDir, srg[i].region,
+                srg[i].code);
+        outFile[i] = batchStrdup(mesg);
+    }
+    v = controlValue(bi.ctl, "OVERWRITE OUTPUT FILES");
+    if(v != NULL && !isYes(v))
+    {
+        for(i = 0; i < nsrg; i++)
+        {
+            if(fileExists(outFile[i]))
+            {
+                printf("Keeping existing %s\n", outFile[i]);
+                outFile[i] = NULL;
+            }
+        }
+    }
+
+    njobs = batchJobs();
+    printf("Generating %d surrogates on %s, %d at a time\n", nsrg,
+           p_grid->map->gridname, njobs);
+
+#ifndef _WIN32
+    pid = (pid_t *) batchAlloc((nsrg > 0 ? nsrg : 1) * sizeof(pid_t));
+    for(i = 0; i < nsrg; i++)
+    {
+        pid[i] = 0;
+    }
+    while(next < nsrg || running > 0)
+    {
+        if(next < nsrg && running < njobs)
+        {
+            i = next++;
+            if(outFile[i] == NULL)
+            {
+                continue;
+            }
+            sprintf(logFile, "%.500s/%s_%d.log", bi.tmpDir, srg[i].region,
+                    srg[i].code);
+            fflush(NULL);
+            pid[i] = fork();
+            if(pid[i] < 0)
+            {
+                ERROR(prog_name, "Unable to start a surrogate process", 2);
+            }
+            if(pid[i] == 0)
+            {
+                if(freopen(logFile, "w", stdout) == NULL ||
+                   dup2(fileno(stdout), fileno(stderr)) < 0)
+                {
+                    _exit(2);
+                }
+                runSurrogate(&bi, &srg[i], p_grid, outFile[i]);
+                fflush(NULL);
+                _exit(0);
+            }
+            running++;
+            continue;
+        }
+
+        k = (int) wait(&status);
+        if(k < 0)
+        {
+            break;
+        }
+        for(i = 0; i < nsrg && pid[i] != k; i++)
+            ;
+        if(i == nsrg)
+        {
+            continue;
+        }
+        running--;
+        pid[i] = 0;
+        if(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        {
+            printf("Finished %s %d %s\n", srg[i].region, srg[i].code,
+                   srg[i].name);
+        }
+        else
+        {
+            printf("ERROR in %s %d %s, see %s/%s_%d.log\n", srg[i].region,
+                   srg[i].code, srg[i].name, bi.tmpDir, srg[i].region,
+                   srg[i].code);
+            failed++;
+        }
+    }
+#else
+    for(i = 0; i < nsrg; i++)
+    {
+        if(outFile[i] != NULL)
+        {
+            runSurrogate(&bi, &srg[i], p_grid, outFile[i]);
+            printf("Finished %s %d %s\n", srg[i].region, srg[i].code,
+                   srg[i].name);
+        }
+    }
+#endif
+
+    if(failed > 0)
+    {
+        printf("ERROR -- %d of %d surrogates failed\n", failed, nsrg);
+        return 1;
+    }
+    printf("SUCCESS -- The Program Run Completed\n");
+    return 0;
+}
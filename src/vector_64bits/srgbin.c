@@ -0,0 +1,648 @@
+/****************************************************************************
+ * srgbin.c
+ *
+ * A binary container for surrogate ratios.  srgcreate collects the
+ * records it writes to the text surrogate file and, when
+ * SURROGATE_BINARY_FILE is set, writes them again here; diffsurr reads
+ * either form.  The file holds, in native byte order:
+ *
+ *   char  magic[8]                  "SRGBIN01"
+ *   int   byte_order                0x01020304, to reject foreign files
+ *   int   nrec, ncounty, idlen, nindex
+ *   char  ids[ncounty][idlen]       county IDs, in sorted order
+ *   int   index_code[nindex], index_county[nindex],
+ *         index_first[nindex], index_count[nindex]
+ *   int   code[nrec], county[nrec], col[nrec], row[nrec]
+ *   double ratio[nrec]
+ *
+ * Records are sorted by code, county, column and row, so the records of
+ * one surrogate code are a contiguous slice of every column and can be
+ * read without touching the rest of the file.  The slices are read into
+ * memory rather than mapped: the columns follow the variable-length ID
+ * block and so are not aligned, and the reader compacts the county
+ * index in place.
+ *
+ * File contains:
+ * newSrgBin
+ * addSrgBinRecord
+ * writeSrgBin
+ * isSrgBinFile
+ * readSrgBin
+ * srgBinCountyID
+ * freeSrgBin
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "srgbin.h"
+
+/* the records being sorted by writeSrgBin, for compSrgBinRecord */
+static SrgBin *sort_sb = NULL;
+
+
+/* ============================================================= */
+SrgBin *newSrgBin(void)
+{
+    SrgBin *sb;
+
+    sb = (SrgBin *) calloc(1, sizeof(SrgBin));
+    if(sb == NULL)
+    {
+        WARN("Allocation error in newSrgBin");
+    }
+    return sb;
+}
+
+
+/* ============================================================= */
+static unsigned int srgBinHash(char *s)
+{
+    unsigned int h = 2166136261u;
+
+    while(*s)
+    {
+        h = (h ^ (unsigned char) *s++) * 16777619u;
+    }
+    return h;
+}
+
+
+/* ============================================================= */
+/* size the county ID hash for n IDs, rehashing the ones kept so far;
+ * returns 0 on an allocation error */
+static int growSrgBinSlots(SrgBin * sb, int n)
+{
+    int *slot;
+    int nslot, i;
+    unsigned int h;
+
+    for(nslot = 256; nslot < 2 * n; nslot *= 2)
+        ;
+    slot = (int *) malloc(nslot * sizeof(int));
+    if(slot == NULL)
+    {
+        return 0;
+    }
+    for(i = 0; i < nslot; i++)
+    {
+        slot[i] = -1;
+    }
+    for(i = 0; i < sb->ncounty; i++)
+    {
+        h = srgBinHash(sb->ids[i]) & (nslot - 1);
+        while(slot[h] >= 0)
+        {
+            h = (h + 1) & (nslot - 1);
+        }
+        slot[h] = i;
+    }
+    free(sb->slot);
+    sb->slot = slot;
+    sb->nslot = nslot;
+    return 1;
+}
+
+
+/* ============================================================= */
+/* find or add a county ID */
+static int srgBinCounty(SrgBin * sb, char *county)
+{
+    char **ids;
+    int i, len;
+    unsigned int h;
+
+    if(2 * (sb->ncounty + 1) > sb->nslot &&
+       !growSrgBinSlots(sb, sb->ncounty + 1))
+    {
+        return -1;
+    }
+    h = srgBinHash(county) & (sb->nslot - 1);
+    while((i = sb->slot[h]) >= 0 && strcmp(sb->ids[i], county) != 0)
+    {
+        h = (h + 1) & (sb->nslot - 1);
+    }
+    if(i < 0)
+    {
+        if(sb->ncounty == sb->county_cap)
+        {
+            sb->county_cap = sb->county_cap ? 2 * sb->county_cap : 256;
+            ids = (char **) realloc(sb->ids, sb->county_cap * sizeof(char *));
+            if(ids == NULL)
+            {
+                return -1;
+            }
+            sb->ids = ids;
+        }
+        i = sb->ncounty;
+        sb->ids[i] = strdup(county);
+        if(sb->ids[i] == NULL)
+        {
+            return -1;
+        }
+        sb->ncounty++;
+        sb->slot[h] = i;
+        len = strlen(county) + 1;
+        if(len > sb->idlen)
+        {
+            sb->idlen = len;
+        }
+    }
+    return i;
+}
+
+
+/* ============================================================= */
+/* append one surrogate ratio; returns 0 on an allocation error */
+int addSrgBinRecord(SrgBin * sb, int code, char *county, int col, int row,
+                    double ratio)
+{
+    int c;
+
+    if(sb->nrec == sb->cap)
+    {
+        sb->cap = sb->cap ? 2 * sb->cap : 4096;
+        sb->code = (int *) realloc(sb->code, sb->cap * sizeof(int));
+        sb->county = (int *) realloc(sb->county, sb->cap * sizeof(int));
+        sb->col = (int *) realloc(sb->col, sb->cap * sizeof(int));
+        sb->row = (int *) realloc(sb->row, sb->cap * sizeof(int));
+        sb->ratio = (double *) realloc(sb->ratio, sb->cap * sizeof(double));
+        if(!sb->code || !sb->county || !sb->col || !sb->row || !sb->ratio)
+        {
+            WARN("Allocation error in addSrgBinRecord");
+            return 0;
+        }
+    }
+    c = srgBinCounty(sb, county);
+    if(c < 0)
+    {
+        WARN("Allocation error in addSrgBinRecord");
+        return 0;
+    }
+    sb->code[sb->nrec] = code;
+    sb->county[sb->nrec] = c;
+    sb->col[sb->nrec] = col;
+    sb->row[sb->nrec] = row;
+    sb->ratio[sb->nrec] = ratio;
+    sb->nrec++;
+    return 1;
+}
+
+
+/* ============================================================= */
+static int compSrgBinCounty(const void *v1, const void *v2)
+{
+    int c1 = *(const int *) v1;
+    int c2 = *(const int *) v2;
+
+    return strcmp(sort_sb->ids[c1], sort_sb->ids[c2]);
+}
+
+
+/* ============================================================= */
+/* order records by code, county, column and row; ties keep the order
+ * in which the records were added */
+static int compSrgBinRecord(const void *v1, const void *v2)
+{
+    int i = *(const int *) v1;
+    int j = *(const int *) v2;
+    SrgBin *sb = sort_sb;
+
+    if(sb->code[i] != sb->code[j])
+        return (sb->code[i] < sb->code[j]) ? -1 : 1;
+    if(sb->county[i] != sb->county[j])
+        return (sb->county[i] < sb->county[j]) ? -1 : 1;
+    if(sb->col[i] != sb->col[j])
+        return (sb->col[i] < sb->col[j]) ? -1 : 1;
+    if(sb->row[i] != sb->row[j])
+        return (sb->row[i] < sb->row[j]) ? -1 : 1;
+    return i - j;
+}
+
+
+/* ============================================================= */
+/* write the records of a column in the order given by perm */
+static int writeIntColumn(FILE * fp, int *v, int *perm, int n)
+{
+    int buf[1024];
+    int i, k;
+
+    for(i = 0; i < n; i += k)
+    {
+        for(k = 0; k < 1024 && i + k < n; k++)
+        {
+            buf[k] = v[perm[i + k]];
+        }
+        if(fwrite(buf, sizeof(int), k, fp) != (size_t) k)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/* ============================================================= */
+/* sort the records and write them to fname; returns 0 on error */
+int writeSrgBin(SrgBin * sb, char *fname)
+{
+    FILE *fp;
+    int *perm, *order, *rank;
+    int i, k, n, ok;
+    int hdr[5];
+    double buf[1024];
+    char *ids;
+
+    n = sb->nrec;
+    perm = (int *) malloc((n + 1) * sizeof(int));
+    order = (int *) malloc((sb->ncounty + 1) * sizeof(int));
+    rank = (int *) malloc((sb->ncounty + 1) * sizeof(int));
+    ids = (char *) calloc(sb->ncounty * sb->idlen + 1, sizeof(char));
+    if(!perm || !order || !rank || !ids)
+    {
+        WARN("Allocation error in writeSrgBin");
+        free(perm);
+        free(order);
+        free(rank);
+        free(ids);
+        return 0;
+    }
+
+    /* number the counties in sorted order of their IDs */
+    sort_sb = sb;
+    for(i = 0; i < sb->ncounty; i++)
+    {
+        order[i] = i;
+    }
+    qsort(order, sb->ncounty, sizeof(int), compSrgBinCounty);
+    for(i = 0; i < sb->ncounty; i++)
+    {
+        rank[order[i]] = i;
+        strcpy(ids + i * sb->idlen, sb->ids[order[i]]);
+    }
+    for(i = 0; i < n; i++)
+    {
+        sb->county[i] = rank[sb->county[i]];
+        perm[i] = i;
+    }
+    for(i = 0; i < sb->ncounty; i++)
+    {
+        free(sb->ids[i]);
+        sb->ids[i] = NULL;
+    }
+    free(sb->id_block);
+    sb->id_block = ids;
+    free(sb->slot);
+    sb->slot = NULL;
+    sb->nslot = 0;
+    qsort(perm, n, sizeof(int), compSrgBinRecord);
+
+    /* one index entry per run of records with the same code and county */
+    free(sb->index_code);
+    free(sb->index_county);
+    free(sb->index_first);
+    free(sb->index_count);
+    sb->index_code = (int *) malloc((n + 1) * sizeof(int));
+    sb->index_county = (int *) malloc((n + 1) * sizeof(int));
+    sb->index_first = (int *) malloc((n + 1) * sizeof(int));
+    sb->index_count = (int *) malloc((n + 1) * sizeof(int));
+    if(!sb->index_code || !sb->index_county || !sb->index_first ||
+       !sb->index_count)
+    {
+        WARN("Allocation error in writeSrgBin");
+        free(perm);
+        free(order);
+        free(rank);
+        return 0;
+    }
+    sb->nindex = 0;
+    for(i = 0; i < n; i++)
+    {
+        k = sb->nindex;
+        if(k == 0 || sb->code[perm[i]] != sb->index_code[k - 1] ||
+           sb->county[perm[i]] != sb->index_county[k - 1])
+        {
+            sb->index_code[k] = sb->code[perm[i]];
+            sb->index_county[k] = sb->county[perm[i]];
+            sb->index_first[k] = i;
+            sb->index_count[k] = 0;
+            sb->nindex++;
+        }
+        sb->index_count[sb->nindex - 1]++;
+    }
+
+    if((fp = fopen(fname, "wb")) == NULL)
+    {
+        WARN2("Cannot open binary surrogate file for writing: ", fname);
+        free(perm);
+        free(order);
+        free(rank);
+        return 0;
+    }
+    hdr[0] = SRGBIN_BYTE_ORDER;
+    hdr[1] = n;
+    hdr[2] = sb->ncounty;
+    hdr[3] = sb->idlen;
+    hdr[4] = sb->nindex;
+    ok = fwrite(SRGBIN_MAGIC, 1, SRGBIN_MAGIC_LEN, fp) == SRGBIN_MAGIC_LEN &&
+        fwrite(hdr, sizeof(int), 5, fp) == 5 &&
+        fwrite(sb->id_block, 1, sb->ncounty * sb->idlen, fp) ==
+        (size_t) (sb->ncounty * sb->idlen) &&
+        fwrite(sb->index_code, sizeof(int), sb->nindex, fp) ==
+        (size_t) sb->nindex &&
+        fwrite(sb->index_county, sizeof(int), sb->nindex, fp) ==
+        (size_t) sb->nindex &&
+        fwrite(sb->index_first, sizeof(int), sb->nindex, fp) ==
+        (size_t) sb->nindex &&
+        fwrite(sb->index_count, sizeof(int), sb->nindex, fp) ==
+        (size_t) sb->nindex && writeIntColumn(fp, sb->code, perm, n) &&
+        writeIntColumn(fp, sb->county, perm, n) &&
+        writeIntColumn(fp, sb->col, perm, n) &&
+        writeIntColumn(fp, sb->row, perm, n);
+    for(i = 0; ok && i < n; i += k)
+    {
+        for(k = 0; k < 1024 && i + k < n; k++)
+        {
+            buf[k] = sb->ratio[perm[i + k]];
+        }
+        ok = fwrite(buf, sizeof(double), k, fp) == (size_t) k;
+    }
+    if(fclose(fp) != 0)
+    {
+        ok = 0;
+    }
+    if(!ok)
+    {
+        WARN2("Error writing binary surrogate file ", fname);
+    }
+
+    free(perm);
+    free(order);
+    free(rank);
+    return ok;
+}
+
+
+/* ============================================================= */
+/* return 1 if fname starts with the binary surrogate magic */
+int isSrgBinFile(char *fname)
+{
+    FILE *fp;
+    char magic[SRGBIN_MAGIC_LEN];
+    int ok;
+
+    if((fp = fopen(fname, "rb")) == NULL)
+    {
+        return 0;
+    }
+    ok = fread(magic, 1, SRGBIN_MAGIC_LEN, fp) == SRGBIN_MAGIC_LEN &&
+        !memcmp(magic, SRGBIN_MAGIC, SRGBIN_MAGIC_LEN);
+    fclose(fp);
+    return ok;
+}
+
+
+/* ============================================================= */
+/* read the records [first, first+n) of an int column that starts at
+ * offset base */
+static int readIntSlice(FILE * fp, long base, int first, int n, int *v)
+{
+    if(fseek(fp, base + (long) first * sizeof(int), SEEK_SET) != 0)
+    {
+        return 0;
+    }
+    return fread(v, sizeof(int), n, fp) == (size_t) n;
+}
+
+
+/* ============================================================= */
+/* whether the index entries and ids read from a file refer to records
+ * and counties that exist */
+static int checkSrgBinIndex(SrgBin * sb, int nrec)
+{
+    int i;
+
+    for(i = 0; i < sb->nindex; i++)
+    {
+        if(sb->index_county[i] < 0 || sb->index_county[i] >= sb->ncounty ||
+           sb->index_first[i] < 0 || sb->index_count[i] < 0 ||
+           sb->index_count[i] > nrec - sb->index_first[i])
+        {
+            return 0;
+        }
+    }
+    for(i = 0; i < sb->ncounty; i++)
+    {
+        sb->id_block[(i + 1) * sb->idlen - 1] = '\0';
+    }
+    return 1;
+}
+
+
+/* ============================================================= */
+/* Read a binary surrogate file.  If code >= 0 only the records of that
+ * surrogate code are read, seeking past the others.  The counts in the
+ * header must agree with the size of the file, and every county number
+ * must name one of its IDs.  Returns NULL on error. */
+SrgBin *readSrgBin(char *fname, int code)
+{
+    FILE *fp;
+    SrgBin *sb;
+    char magic[SRGBIN_MAGIC_LEN];
+    int hdr[5];
+    int i, k, nrec, first, last, ok;
+    long base, size;
+    double expect;
+
+    if((fp = fopen(fname, "rb")) == NULL)
+    {
+        WARN2("Cannot open file for reading: ", fname);
+        return NULL;
+    }
+    if(fread(magic, 1, SRGBIN_MAGIC_LEN, fp) != SRGBIN_MAGIC_LEN ||
+       memcmp(magic, SRGBIN_MAGIC, SRGBIN_MAGIC_LEN) ||
+       fread(hdr, sizeof(int), 5, fp) != 5)
+    {
+        WARN2("Not a binary surrogate file: ", fname);
+        fclose(fp);
+        return NULL;
+    }
+    if(hdr[0] != SRGBIN_BYTE_ORDER)
+    {
+        WARN2("Binary surrogate file was written with another byte order: ",
+              fname);
+        fclose(fp);
+        return NULL;
+    }
+
+    /* the header counts must describe exactly the bytes in the file */
+    ok = fseek(fp, 0L, SEEK_END) == 0 && (size = ftell(fp)) >= 0 &&
+        fseek(fp, (long) (SRGBIN_MAGIC_LEN + 5 * sizeof(int)), SEEK_SET) == 0;
+    if(ok)
+    {
+        expect = SRGBIN_MAGIC_LEN + 5.0 * sizeof(int) +
+            (double) hdr[2] * hdr[3] + 4.0 * hdr[4] * sizeof(int) +
+            4.0 * hdr[1] * sizeof(int) + (double) hdr[1] * sizeof(double);
+        ok = hdr[1] >= 0 && hdr[2] >= 0 && hdr[3] >= 0 && hdr[4] >= 0 &&
+            (hdr[2] == 0 || hdr[3] > 0) && expect == (double) size;
+    }
+    if(!ok)
+    {
+        WARN2("Binary surrogate file header does not match its size: ",
+              fname);
+        fclose(fp);
+        return NULL;
+    }
+    if((sb = newSrgBin()) == NULL)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    nrec = hdr[1];
+    sb->ncounty = hdr[2];
+    sb->idlen = hdr[3];
+    sb->nindex = hdr[4];
+
+    sb->id_block = (char *) malloc(sb->ncounty * sb->idlen + 1);
+    sb->index_code = (int *) malloc((sb->nindex + 1) * sizeof(int));
+    sb->index_county = (int *) malloc((sb->nindex + 1) * sizeof(int));
+    sb->index_first = (int *) malloc((sb->nindex + 1) * sizeof(int));
+    sb->index_count = (int *) malloc((sb->nindex + 1) * sizeof(int));
+    ok = sb->id_block && sb->index_code && sb->index_county &&
+        sb->index_first && sb->index_count &&
+        fread(sb->id_block, 1, sb->ncounty * sb->idlen, fp) ==
+        (size_t) (sb->ncounty * sb->idlen) &&
+        fread(sb->index_code, sizeof(int), sb->nindex, fp) ==
+        (size_t) sb->nindex &&
+        fread(sb->index_county, sizeof(int), sb->nindex, fp) ==
+        (size_t) sb->nindex &&
+        fread(sb->index_first, sizeof(int), sb->nindex, fp) ==
+        (size_t) sb->nindex &&
+        fread(sb->index_count, sizeof(int), sb->nindex, fp) ==
+        (size_t) sb->nindex;
+    if(ok && !checkSrgBinIndex(sb, nrec))
+    {
+        WARN2("Binary surrogate file has a bad county index: ", fname);
+        fclose(fp);
+        freeSrgBin(sb);
+        return NULL;
+    }
+    if(!ok)
+    {
+        WARN2("Error reading binary surrogate file ", fname);
+        fclose(fp);
+        freeSrgBin(sb);
+        return NULL;
+    }
+    base = ftell(fp);
+
+    /* the index runs of one code are contiguous; keep only those */
+    first = 0;
+    last = nrec;
+    if(code >= 0)
+    {
+        k = 0;
+        first = last = 0;
+        for(i = 0; i < sb->nindex; i++)
+        {
+            if(sb->index_code[i] == code)
+            {
+                if(k == 0)
+                {
+                    first = sb->index_first[i];
+                }
+                last = sb->index_first[i] + sb->index_count[i];
+                sb->index_code[k] = sb->index_code[i];
+                sb->index_county[k] = sb->index_county[i];
+                sb->index_first[k] = sb->index_first[i] - first;
+                sb->index_count[k] = sb->index_count[i];
+                k++;
+            }
+        }
+        sb->nindex = k;
+        if(last < first)
+        {
+            WARN2("Binary surrogate file is not sorted by code: ", fname);
+            fclose(fp);
+            freeSrgBin(sb);
+            return NULL;
+        }
+    }
+
+    sb->nrec = sb->cap = last - first;
+    sb->code = (int *) malloc((sb->nrec + 1) * sizeof(int));
+    sb->county = (int *) malloc((sb->nrec + 1) * sizeof(int));
+    sb->col = (int *) malloc((sb->nrec + 1) * sizeof(int));
+    sb->row = (int *) malloc((sb->nrec + 1) * sizeof(int));
+    sb->ratio = (double *) malloc((sb->nrec + 1) * sizeof(double));
+    ok = sb->code && sb->county && sb->col && sb->row && sb->ratio &&
+        readIntSlice(fp, base, first, sb->nrec, sb->code) &&
+        readIntSlice(fp, base + (long) nrec * sizeof(int), first, sb->nrec,
+                     sb->county) &&
+        readIntSlice(fp, base + 2L * nrec * sizeof(int), first, sb->nrec,
+                     sb->col) &&
+        readIntSlice(fp, base + 3L * nrec * sizeof(int), first, sb->nrec,
+                     sb->row) &&
+        fseek(fp, base + 4L * nrec * sizeof(int) +
+              (long) first * sizeof(double), SEEK_SET) == 0 &&
+        fread(sb->ratio, sizeof(double), sb->nrec, fp) == (size_t) sb->nrec;
+    fclose(fp);
+    if(!ok)
+    {
+        WARN2("Error reading binary surrogate file ", fname);
+        freeSrgBin(sb);
+        return NULL;
+    }
+    for(i = 0; i < sb->nrec; i++)
+    {
+        if(sb->county[i] < 0 || sb->county[i] >= sb->ncounty)
+        {
+            WARN2("Binary surrogate file has a bad county number: ", fname);
+            freeSrgBin(sb);
+            return NULL;
+        }
+    }
+    return sb;
+}
+
+
+/* ============================================================= */
+/* the ID of county number county of a written or read container */
+char *srgBinCountyID(SrgBin * sb, int county)
+{
+    return sb->id_block + county * sb->idlen;
+}
+
+
+/* ============================================================= */
+void freeSrgBin(SrgBin * sb)
+{
+    int i;
+
+    if(sb == NULL)
+    {
+        return;
+    }
+    if(sb->ids != NULL)
+    {
+        for(i = 0; i < sb->ncounty; i++)
+        {
+            free(sb->ids[i]);
+        }
+        free(sb->ids);
+    }
+    free(sb->slot);
+    free(sb->id_block);
+    free(sb->code);
+    free(sb->county);
+    free(sb->col);
+    free(sb->row);
+    free(sb->ratio);
+    free(sb->index_code);
+    free(sb->index_county);
+    free(sb->index_first);
+    free(sb->index_count);
+    free(sb);
+}
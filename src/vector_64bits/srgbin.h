@@ -0,0 +1,52 @@
+/****************************************************************************
+ *  srgbin.h
+ *
+ *  Binary surrogate container written by srgcreate next to the text
+ *  surrogate file and read by diffsurr, see srgbin.c for the layout.
+ ***************************************************************************/
+
+#ifndef SRGBIN__H
+#define SRGBIN__H
+
+#define SRGBIN_MAGIC "SRGBIN01"
+#define SRGBIN_MAGIC_LEN 8
+#define SRGBIN_BYTE_ORDER 0x01020304
+
+/* surrogate ratios as columns, sorted by code, county, column and row.
+ * County IDs are kept once each in ids (idlen bytes apiece) and the
+ * records refer to them by number.  The county index has one entry per
+ * run of records with the same code and county. */
+typedef struct _SrgBin {
+  int nrec;             /* number of records */
+  int cap;              /* allocated records, while writing */
+  int *code;            /* surrogate code */
+  int *county;          /* index into ids */
+  int *col;
+  int *row;
+  double *ratio;
+
+  int ncounty;          /* number of distinct county IDs */
+  int county_cap;
+  int idlen;            /* bytes per ID, including the NUL */
+  char **ids;           /* the county IDs, while writing */
+  int *slot;            /* hash of ids, while writing */
+  int nslot;
+  char *id_block;       /* ncounty * idlen bytes, once written or read */
+
+  int nindex;           /* county index */
+  int *index_code;
+  int *index_county;
+  int *index_first;     /* first record of the run */
+  int *index_count;     /* number of records in the run */
+} SrgBin;
+
+SrgBin *newSrgBin(void);
+int addSrgBinRecord(SrgBin *sb, int code, char *county, int col, int row,
+                    double ratio);
+int writeSrgBin(SrgBin *sb, char *fname);
+int isSrgBinFile(char *fname);
+SrgBin *readSrgBin(char *fname, int code);
+char *srgBinCountyID(SrgBin *sb, int county);
+void freeSrgBin(SrgBin *sb);
+
+#endif
@@ -0,0 +1,2277 @@
+/****************************************************************************
+ * srgmerge.c
+ *
+ * Merges, gapfills, normalizes and summarizes surrogate files written by
+ * srgcreate.  It reads the same input files as the merging, gapfilling,
+ * normalization and QA tools in SurrogateTools.jar and writes the same
+ * outputs, but makes a single pass over each surrogate file.  Rows are
+ * read one county at a time, so only a bounded batch of counties is held
+ * in memory, and the counties of a batch can be processed by several
+ * threads (SRGMERGE_THREADS) while the output is still written in county
+ * order.
+ *
+ * Usage:
+ *   srgmerge.exe input_file
+ *      runs the OUTSRG commands of a merge or gapfill input file as
+ *      written by SurrogateTool:
+ *        OUTFILE=<output surrogate file>
+ *        XREFFILE=<surrogate code file with #SRGDESC=code,name lines>
+ *        OUTSRG=<name>; f1*({file|name})+f2*({file|name})
+ *        OUTSRG=<name>; GAPFILL=file|name;file|name...
+ *   srgmerge.exe -normalize SRGDESC_file [exclude_list [tolerance]]
+ *   srgmerge.exe -qa SRGDESC_file threshold
+ *
+ * Merging and gapfilling need each input to list its counties in
+ * ascending order, which is how srgcreate writes them.
+ *
+ * File contains:
+ * main
+ * mergeSurrogates
+ * normalizeSurrogates
+ * qaSurrogates
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "shapefil.h"
+#include "mims_spatl.h"
+#include "mims_evs.h"
+#include "io.h"
+
+/* most surrogate files read for one output surrogate */
+#define SRGMERGE_MAX_INPUTS 8
+/* a batch is processed once it holds this many rows or counties */
+#define SRGMERGE_BATCH_ROWS (1 << 18)
+#define SRGMERGE_BATCH_TASKS 8192
+/* Precision() and Threshold in SurrogateTools */
+#define SRGMERGE_PRECISION 1e-5
+
+#define MODE_MERGE 1
+#define MODE_GAPFILL 2
+#define MODE_NORMALIZE 3
+#define MODE_QA 4
+
+char *prog_name;
+char *prog_version = "Spatial Allocator Srgmerge Version 4.4 10/19/2026";
+
+/* growable text, one per task for the lines it writes */
+typedef struct _TextBuf {
+    char *s;
+    size_t len;
+    size_t cap;
+} TextBuf;
+
+/* surrogate codes and names from #SRGDESC lines or an SRGDESC file */
+typedef struct _SrgNames {
+    int n;
+    int cap;
+    int *code;
+    char **name;
+} SrgNames;
+
+/* one line of an SRGDESC file */
+typedef struct _SrgDesc {
+    char *region;
+    int code;
+    char *name;
+    char *file;
+} SrgDesc;
+
+typedef struct _SrgDescFile {
+    char *header;               /* first comment line */
+    int ntok;                   /* 5 for grids, 4 for polygons */
+    int ncomments;
+    char **comments;
+    int ndesc;
+    SrgDesc *desc;
+} SrgDescFile;
+
+/* the parsed fields of a data line */
+typedef struct _SrgRow {
+    int code;
+    long county;
+    long x;
+    long y;                     /* -1 for polygons */
+    double ratio;
+    int seq;
+} SrgRow;
+
+/* consecutive data lines of one county */
+typedef struct _CountyRun {
+    long county;
+    int n;
+    char **line;
+} CountyRun;
+
+/* reads the data lines of a surrogate file one county at a time */
+typedef struct _SrgReader {
+    FILE *fp;
+    char *fname;
+    char *buf;
+    size_t size;
+    int code;                   /* rows of other codes are skipped; -1 keeps all */
+    int sorted;                 /* counties must ascend */
+    FILE *hdr;                  /* comment lines before the data go here */
+    int ndata;
+    char *next;                 /* the next data line, trimmed, in buf */
+    long county;                /* its county */
+    int more;
+    char **lines;               /* lines of the run being read */
+    int cap;
+} SrgReader;
+
+/* the rows of one output county */
+typedef struct _SrgTask {
+    long county;
+    CountyRun *run[SRGMERGE_MAX_INPUTS];
+    TextBuf out;
+    int notOne;                 /* normalize: the county did not sum to 1 */
+    double sum;                 /* qa: sum of the ratios */
+    int gfcode;                 /* qa: gapfill code of the first row */
+    int nhold;                  /* qa: rows above the threshold */
+    int holdcap;
+    SrgRow *hold;
+} SrgTask;
+
+typedef struct _SrgJob SrgJob;
+
+struct _SrgJob {
+    int mode;
+    int ntok;
+    int ninput;
+    int outCode;
+    int inCode[SRGMERGE_MAX_INPUTS];
+    double f1, f2;              /* merge equation */
+    int nexclude;               /* counties not normalized */
+    long *exclude;
+    double precision;
+    double thresh;
+    int gapFilled;              /* qa: the file name has no NOFILL */
+    void (*process) (SrgJob *, SrgTask *);
+
+    int nthreads;
+    int ntask;
+    SrgTask *task;
+};
+
+/* qa totals for one county and surrogate */
+typedef struct _QACell {
+    long county;
+    int code;
+    double sum;
+    int gfcode;
+} QACell;
+
+typedef struct _QATable {
+    int ncell;
+    int cellcap;
+    QACell *cell;
+    int hsize;                  /* open addressing on (county, code) */
+    int *hash;
+    int nhold;
+    int holdcap;
+    SrgRow *hold;
+} QATable;
+
+
+/* ============================================================= */
+static void *srgAlloc(size_t size)
+{
+    void *p = malloc(size > 0 ? size : 1);
+
+    if(p == NULL)
+    {
+        ERROR(prog_name, "Allocation error", 2);
+    }
+    return p;
+}
+
+
+/* ============================================================= */
+static void *srgRealloc(void *p, size_t size)
+{
+    p = realloc(p, size > 0 ? size : 1);
+    if(p == NULL)
+    {
+        ERROR(prog_name, "Allocation error", 2);
+    }
+    return p;
+}
+
+
+/* ============================================================= */
+static char *srgStrdup(const char *s)
+{
+    char *p = (char *) srgAlloc(strlen(s) + 1);
+
+    strcpy(p, s);
+    return p;
+}
+
+
+/* ============================================================= */
+static void tbPutn(TextBuf * tb, const char *s, size_t n)
+{
+    if(tb->len + n + 1 > tb->cap)
+    {
+        tb->cap = 2 * (tb->len + n + 1) + 4096;
+        tb->s = (char *) srgRealloc(tb->s, tb->cap);
+    }
+    memcpy(tb->s + tb->len, s, n);
+    tb->len += n;
+    tb->s[tb->len] = '\0';
+}
+
+
+/* ============================================================= */
+static void tbPut(TextBuf * tb, const char *s)
+{
+    tbPutn(tb, s, strlen(s));
+}
+
+
+/* ============================================================= */
+/* trim white space from both ends of s in place */
+static char *trimLine(char *s)
+{
+    char *e;
+
+    while(isspace((unsigned char) *s))
+    {
+        s++;
+    }
+    e = s + strlen(s);
+    while(e > s && isspace((unsigned char) e[-1]))
+    {
+        e--;
+    }
+    *e = '\0';
+    return s;
+}
+
+
+/* ============================================================= */
+/* read a line of any length without its line terminator; returns NULL
+ * at the end of the file */
+static char *readLine(FILE * fp, char **buf, size_t * size)
+{
+    size_t len = 0;
+
+    if(*buf == NULL)
+    {
+        *size = 1024;
+        *buf = (char *) srgAlloc(*size);
+    }
+    for(;;)
+    {
+        if(fgets(*buf + len, (int) (*size - len), fp) == NULL)
+        {
+            if(len == 0)
+            {
+                return NULL;
+            }
+            break;
+        }
+        len += strlen(*buf + len);
+        if(len > 0 && (*buf)[len - 1] == '\n')
+        {
+            break;
+        }
+        if(len + 1 < *size)
+        {
+            continue;           /* last line without a newline */
+        }
+        *size *= 2;
+        *buf = (char *) srgRealloc(*buf, *size);
+    }
+    while(len > 0 && ((*buf)[len - 1] == '\n' || (*buf)[len - 1] == '\r'))
+    {
+        (*buf)[--len] = '\0';
+    }
+    return *buf;
+}
+
+
+/* ============================================================= */
+static int isCommentLine(const char *line)
+{
+    while(isspace((unsigned char) *line))
+    {
+        line++;
+    }
+    return *line == '\0' || *line == '#';
+}
+
+
+/* ============================================================= */
+/* format a double the way Java's Double.toString does, for the
+ * comments that the Java tools wrote */
+static void javaDouble(char *buf, double v)
+{
+    char tmp[64];
+    char *e;
+    int p, exp10, dec;
+
+    if(v == 0.0)
+    {
+        strcpy(buf, "0.0");
+        return;
+    }
+    for(p = 1; p < 17; p++)
+    {
+        sprintf(tmp, "%.*e", p - 1, v);
+        if(strtod(tmp, NULL) == v)
+        {
+            break;
+        }
+    }
+    sprintf(tmp, "%.*e", p - 1, v);
+    e = strchr(tmp, 'e');
+    exp10 = atoi(e + 1);
+    if(exp10 < -3 || exp10 >= 7)
+    {
+        *e = '\0';
+        sprintf(buf, "%s%sE%d", tmp, strchr(tmp, '.') ? "" : ".0", exp10);
+        return;
+    }
+    dec = p - 1 - exp10;
+    sprintf(buf, "%.*f", dec > 0 ? dec : 1, v);
+}
+
+
+/* ============================================================= */
+static int fileExists(const char *fname)
+{
+    FILE *fp = fopen(fname, "r");
+
+    if(fp == NULL)
+    {
+        return 0;
+    }
+    fclose(fp);
+    return 1;
+}
+
+
+/* ============================================================= */
+static FILE *openFile(const char *fname, const char *mode)
+{
+    FILE *fp;
+    char mesg[512];
+
+    if((fp = fopen(fname, mode)) == NULL)
+    {
+        sprintf(mesg, "Could not open the file '%.400s'", fname);
+        ERROR(prog_name, mesg, 1);
+    }
+    return fp;
+}
+
+
+/* ============================================================= */
+/* dir/name with its extension replaced by suffix */
+static char *siblingName(const char *fname, const char *suffix)
+{
+    char *out, *slash, *dot;
+
+    out = (char *) srgAlloc(strlen(fname) + strlen(suffix) + 1);
+    strcpy(out, fname);
+    slash = strrchr(out, '/');
+    dot = strrchr(out, '.');
+    if(dot != NULL && (slash == NULL || dot > slash))
+    {
+        *dot = '\0';
+    }
+    strcat(out, suffix);
+    return out;
+}
+
+
+/* ============================================================= */
+static void addSrgName(SrgNames * names, int code, const char *name)
+{
+    int i;
+
+    for(i = 0; i < names->n; i++)
+    {
+        if(names->code[i] == code)
+        {
+            return;
+        }
+    }
+    if(names->n == names->cap)
+    {
+        names->cap = names->cap ? 2 * names->cap : 64;
+        names->code = (int *) srgRealloc(names->code, names->cap * sizeof(int));
+        names->name =
+            (char **) srgRealloc(names->name, names->cap * sizeof(char *));
+    }
+    names->code[names->n] = code;
+    names->name[names->n] = srgStrdup(name);
+    names->n++;
+}
+
+
+/* ============================================================= */
+static int srgCode(SrgNames * names, const char *name)
+{
+    int i;
+    char mesg[512];
+
+    for(i = 0; i < names->n; i++)
+    {
+        if(strcmp(names->name[i], name) == 0)
+        {
+            return names->code[i];
+        }
+    }
+    sprintf(mesg, "Could not find an id for the surrogate named '%.400s'", name);
+    ERROR(prog_name, mesg, 1);
+    return -1;
+}
+
+
+/* ============================================================= */
+static char *srgName(SrgNames * names, int code)
+{
+    int i;
+    char mesg[256];
+
+    for(i = 0; i < names->n; i++)
+    {
+        if(names->code[i] == code)
+        {
+            return names->name[i];
+        }
+    }
+    sprintf(mesg, "Could not find a name for surrogate id '%d'", code);
+    ERROR(prog_name, mesg, 1);
+    return NULL;
+}
+
+
+/* ============================================================= */
+/* strip one pair of matching quotes */
+static char *stripQuotes(char *s)
+{
+    size_t n = strlen(s);
+
+    if(n >= 2 && (s[0] == '"' || s[0] == '\'') && s[n - 1] == s[0])
+    {
+        s[n - 1] = '\0';
+        return s + 1;
+    }
+    return s;
+}
+
+
+/* ============================================================= */
+/* #SRGDESC=code,name */
+static void parseSrgDescTag(char *line, SrgNames * names)
+{
+    char *p, *comma;
+    char mesg[512];
+    int code;
+
+    if(strncmp(line, "#SRGDESC", 8) != 0)
+    {
+        return;
+    }
+    p = trimLine(line + 8);
+    if(*p != '=')
+    {
+        ERROR(prog_name, "Expecting '=' after SRGDESC tag", 1);
+    }
+    p++;
+    if((comma = strchr(p, ',')) == NULL)
+    {
+        sprintf(mesg, "The line '%.300s' is not in the correct format. "
+                "Expected format #SRGDESC=<srg id>,<srg name>", line);
+        ERROR(prog_name, mesg, 1);
+    }
+    *comma = '\0';
+    p = trimLine(p);
+    if(*p == '\0' || digiCheck(p) || strchr(p, '.') != NULL)
+    {
+        sprintf(mesg, "Expected int for surrogate code but found '%.300s'", p);
+        ERROR(prog_name, mesg, 1);
+    }
+    code = atoi(p);
+    addSrgName(names, code, stripQuotes(trimLine(comma + 1)));
+}
+
+
+/* ============================================================= */
+/* split an SRGDESC line on commas, keeping quoted commas and dropping
+ * empty fields as the Java tokenizer does */
+static int splitDescLine(char *line, char **tok, int maxtok)
+{
+    int n = 0;
+    char *p = line, *start;
+    char q;
+
+    while(*p != '\0')
+    {
+        while(*p == ',')
+        {
+            p++;
+        }
+        if(*p == '\0')
+        {
+            break;
+        }
+        start = p;
+        while(isspace((unsigned char) *start))
+        {
+            start++;
+        }
+        if(*start == '"' || *start == '\'')
+        {
+            q = *start;
+            p = strchr(start + 1, q);
+            if(p == NULL)
+            {
+                p = start + strlen(start);
+            }
+            else
+            {
+                p++;
+            }
+        }
+        while(*p != '\0' && *p != ',')
+        {
+            p++;
+        }
+        if(*p == ',')
+        {
+            *p++ = '\0';
+        }
+        if(n < maxtok)
+        {
+            tok[n] = stripQuotes(trimLine(start));
+        }
+        n++;
+    }
+    return n;
+}
+
+
+/* ============================================================= */
+static SrgDescFile *readSrgDescFile(char *fname)
+{
+    SrgDescFile *df;
+    FILE *fp;
+    char *buf = NULL, *line, *tok[8];
+    size_t size;
+    char mesg[512];
+    int cap = 0, ccap = 0, i;
+
+    printf("Reading SRGDESC file '%s'\n", fname);
+    fp = openFile(fname, "r");
+    df = (SrgDescFile *) srgAlloc(sizeof(SrgDescFile));
+    memset(df, 0, sizeof(SrgDescFile));
+    while((line = readLine(fp, &buf, &size)) != NULL)
+    {
+        if(isCommentLine(line))
+        {
+            if(df->ncomments == ccap)
+            {
+                ccap = ccap ? 2 * ccap : 16;
+                df->comments = (char **)
+                    srgRealloc(df->comments, ccap * sizeof(char *));
+            }
+            df->comments[df->ncomments++] = srgStrdup(line);
+            if(df->header == NULL)
+            {
+                df->header = srgStrdup(line);
+                df->ntok = strstr(line, "GRID") ? 5 : 4;
+            }
+            continue;
+        }
+        if(df->header == NULL)
+        {
+            continue;           /* lines before the header are skipped */
+        }
+        if(splitDescLine(line, tok, 8) != 4)
+        {
+            sprintf(mesg, "Expected four tokens; line - '%.400s'", line);
+            ERROR(prog_name, mesg, 1);
+        }
+        if(df->ndesc == cap)
+        {
+            cap = cap ? 2 * cap : 32;
+            df->desc = (SrgDesc *) srgRealloc(df->desc, cap * sizeof(SrgDesc));
+        }
+        df->desc[df->ndesc].region = srgStrdup(tok[0]);
+        for(i = 0; df->desc[df->ndesc].region[i] != '\0'; i++)
+        {
+            df->desc[df->ndesc].region[i] =
+                tolower((unsigned char) df->desc[df->ndesc].region[i]);
+        }
+        df->desc[df->ndesc].code = atoi(tok[1]);
+        df->desc[df->ndesc].name = srgStrdup(tok[2]);
+        df->desc[df->ndesc].file = srgStrdup(tok[3]);
+        df->ndesc++;
+    }
+    fclose(fp);
+    free(buf);
+    if(df->header == NULL)
+    {
+        sprintf(mesg, "No header line in the SRGDESC file '%.400s'", fname);
+        ERROR(prog_name, mesg, 1);
+    }
+    printf("Mimimum surrogate items = %d\n", df->ntok);
+    printf("Finished reading the SRGDESC file\n");
+    return df;
+}
+
+
+/* ============================================================= */
+/* parse code, county, x, [y,] ratio from a data line */
+static void parseRow(char *line, int ntok, SrgRow * row)
+{
+    char *p = line, *e;
+    char mesg[512];
+
+    row->code = (int) strtol(p, &e, 10);
+    if(e == p)
+    {
+        goto bad;
+    }
+    p = e;
+    row->county = strtol(p, &e, 10);
+    if(e == p)
+    {
+        goto bad;
+    }
+    p = e;
+    row->x = strtol(p, &e, 10);
+    if(e == p)
+    {
+        goto bad;
+    }
+    p = e;
+    row->y = -1;
+    if(ntok == 5)
+    {
+        row->y = strtol(p, &e, 10);
+        if(e == p)
+        {
+            goto bad;
+        }
+        p = e;
+    }
+    row->ratio = strtod(p, &e);
+    if(e == p)
+    {
+        goto bad;
+    }
+    return;
+
+  bad:
+    sprintf(mesg, "The surrogate line '%.400s' is not in the correct format",
+            line);
+    ERROR(prog_name, mesg, 1);
+}
+
+
+/* ============================================================= */
+static void initReader(SrgReader * r, char *fname, int code, int sorted,
+                       FILE * hdr)
+{
+    memset(r, 0, sizeof(SrgReader));
+    r->fp = openFile(fname, "r");
+    r->fname = fname;
+    r->code = code;
+    r->sorted = sorted;
+    r->hdr = hdr;
+    r->more = 1;
+}
+
+
+/* ============================================================= */
+static void closeReader(SrgReader * r)
+{
+    if(r->fp != NULL)
+    {
+        fclose(r->fp);
+    }
+    free(r->buf);
+    free(r->lines);
+    memset(r, 0, sizeof(SrgReader));
+}
+
+
+/* ============================================================= */
+/* move to the next data line of the reader's surrogate */
+static int advanceReader(SrgReader * r)
+{
+    char *line, *p, *e;
+    long code;
+
+    while((line = readLine(r->fp, &r->buf, &r->size)) != NULL)
+    {
+        if(isCommentLine(line))
+        {
+            if(r->hdr != NULL && r->ndata == 0)
+            {
+                fprintf(r->hdr, "%s\n", line);
+            }
+            continue;
+        }
+        r->ndata++;
+        line = trimLine(line);
+        code = strtol(line, &p, 10);
+        if(r->code >= 0 && (p == line || code != r->code))
+        {
+            continue;
+        }
+        r->county = strtol(p, &e, 10);
+        r->next = line;
+        return 1;
+    }
+    r->more = 0;
+    r->next = NULL;
+    return 0;
+}
+
+
+/* ============================================================= */
+/* read the lines of the next county into the arena */
+static CountyRun *readCountyRun(SrgReader * r, Arena * a, int *nrows)
+{
+    CountyRun *run;
+    long county = r->county;
+    char mesg[512];
+    int n = 0;
+
+    do
+    {
+        if(n == r->cap)
+        {
+            r->cap = r->cap ? 2 * r->cap : 1024;
+            r->lines = (char **) srgRealloc(r->lines, r->cap * sizeof(char *));
+        }
+        r->lines[n] = (char *) arenaAlloc(a, strlen(r->next) + 1);
+        if(r->lines[n] == NULL)
+        {
+            ERROR(prog_name, "Allocation error", 2);
+        }
+        strcpy(r->lines[n], r->next);
+        n++;
+    }
+    while(advanceReader(r) && r->county == county);
+
+    if(r->sorted && r->more && r->county < county)
+    {
+        sprintf(mesg, "The counties in the surrogate file '%.300s' are not "
+                "in ascending order (%ld follows %ld)", r->fname, r->county,
+                county);
+        ERROR(prog_name, mesg, 1);
+    }
+
+    run = (CountyRun *) arenaAlloc(a, sizeof(CountyRun));
+    run->line = (char **) arenaAlloc(a, n * sizeof(char *));
+    if(run == NULL || run->line == NULL)
+    {
+        ERROR(prog_name, "Allocation error", 2);
+    }
+    run->county = county;
+    run->n = n;
+    memcpy(run->line, r->lines, n * sizeof(char *));
+    *nrows += n;
+    return run;
+}
+
+
+/* ============================================================= */
+/* process county task t of a batch; run by runTasks */
+static void processTask(void *arg, int t, int thread)
+{
+    SrgJob *job = (SrgJob *) arg;
+
+    job->process(job, &job->task[t]);
+}
+
+
+/* ============================================================= */
+static SrgTask *newTask(SrgJob * job, long county)
+{
+    SrgTask *t = &job->task[job->ntask++];
+
+    t->county = county;
+    memset(t->run, 0, sizeof(t->run));
+    t->out.len = 0;
+    t->notOne = 0;
+    t->sum = 0.0;
+    t->gfcode = -1;
+    t->nhold = 0;
+    return t;
+}
+
+
+/* ============================================================= */
+static void writeTasks(SrgJob * job, FILE * ofp)
+{
+    int i;
+
+    for(i = 0; i < job->ntask; i++)
+    {
+        if(job->task[i].out.len > 0)
+        {
+            fwrite(job->task[i].out.s, 1, job->task[i].out.len, ofp);
+        }
+    }
+}
+
+
+/* ============================================================= */
+static void initJob(SrgJob * job, int mode, int ntok)
+{
+    memset(job, 0, sizeof(SrgJob));
+    job->mode = mode;
+    job->ntok = ntok;
+    job->nthreads = envThreads(ENVT_SRGMERGE_THREADS);
+    job->task = (SrgTask *) srgAlloc(SRGMERGE_BATCH_TASKS * sizeof(SrgTask));
+    memset(job->task, 0, SRGMERGE_BATCH_TASKS * sizeof(SrgTask));
+}
+
+
+/* ============================================================= */
+static void freeJob(SrgJob * job)
+{
+    int i;
+
+    for(i = 0; i < SRGMERGE_BATCH_TASKS; i++)
+    {
+        free(job->task[i].out.s);
+        free(job->task[i].hold);
+    }
+    free(job->task);
+}
+
+
+/* ============================================================= */
+/* Stream the inputs of a job county by county.  With several inputs
+ * the counties are merged in ascending order, and each task holds the
+ * run of every input that has the county.  After each batch the tasks
+ * are processed and handed to done in county order. */
+static void streamCounties(SrgJob * job, SrgReader * in, int nin,
+                           void (*done) (SrgJob *, void *), void *arg)
+{
+    Arena *a;
+    SrgTask *t;
+    long county;
+    int i, any, nrows;
+
+    if((a = newArena(0)) == NULL)
+    {
+        ERROR(prog_name, "Allocation error", 2);
+    }
+    for(i = 0; i < nin; i++)
+    {
+        advanceReader(&in[i]);
+    }
+    for(;;)
+    {
+        job->ntask = 0;
+        nrows = 0;
+        while(job->ntask < SRGMERGE_BATCH_TASKS &&
+              nrows < SRGMERGE_BATCH_ROWS)
+        {
+            any = 0;
+            county = 0;
+            for(i = 0; i < nin; i++)
+            {
+                if(in[i].more && (!any || in[i].county < county))
+                {
+                    county = in[i].county;
+                    any = 1;
+                }
+            }
+            if(!any)
+            {
+                break;
+            }
+            t = newTask(job, county);
+            for(i = 0; i < nin; i++)
+            {
+                if(in[i].more && in[i].county == county)
+                {
+                    t->run[i] = readCountyRun(&in[i], a, &nrows);
+                }
+            }
+        }
+        if(job->ntask == 0)
+        {
+            break;
+        }
+        runTasks(job->ntask, job->nthreads, processTask, job);
+        done(job, arg);
+        resetArena(a);
+    }
+    freeArena(a);
+}
+
+
+/* ============================================================= */
+static void writeDone(SrgJob * job, void *arg)
+{
+    writeTasks(job, (FILE *) arg);
+}
+
+
+/* ============================================================= */
+/* code, county and cell columns of an output line */
+static void putRowKey(TextBuf * tb, int code, SrgRow * row, int ntok)
+{
+    char tmp[96];
+
+    if(ntok == 5)
+    {
+        sprintf(tmp, "%d\t%05ld\t%ld\t%ld\t", code, row->county, row->x,
+                row->y);
+    }
+    else
+    {
+        sprintf(tmp, "%d\t%05ld\t%011ld\t", code, row->county, row->x);
+    }
+    tbPut(tb, tmp);
+}
+
+
+/* ============================================================= */
+static int compareRowCell(const void *a, const void *b)
+{
+    const SrgRow *r1 = (const SrgRow *) a;
+    const SrgRow *r2 = (const SrgRow *) b;
+
+    if(r1->x != r2->x)
+    {
+        return r1->x < r2->x ? -1 : 1;
+    }
+    if(r1->y != r2->y)
+    {
+        return r1->y < r2->y ? -1 : 1;
+    }
+    return r1->seq - r2->seq;
+}
+
+
+/* ============================================================= */
+static SrgRow *parseRun(CountyRun * run, int ntok)
+{
+    SrgRow *rows = (SrgRow *) srgAlloc(run->n * sizeof(SrgRow));
+    int i;
+
+    for(i = 0; i < run->n; i++)
+    {
+        parseRow(run->line[i], ntok, &rows[i]);
+        rows[i].seq = i;
+    }
+    return rows;
+}
+
+
+/* ============================================================= */
+/* A county that only one input has keeps its ratios, as the Java merge
+ * tool does, and notes which surrogate they came from. */
+static void mergeOneCounty(SrgJob * job, SrgTask * t, CountyRun * run)
+{
+    SrgRow *rows = parseRun(run, job->ntok);
+    char tmp[256], num[40];
+    double sum = 0.0;
+    int i;
+
+    for(i = 0; i < run->n; i++)
+    {
+        sum += rows[i].ratio;
+        putRowKey(&t->out, job->outCode, &rows[i], job->ntok);
+        javaDouble(num, sum);
+        sprintf(tmp, "%.8f\t\t!\tNote: Only surrogate %d is available for "
+                "this county\t%s\n", rows[i].ratio, rows[i].code, num);
+        tbPut(&t->out, tmp);
+    }
+    free(rows);
+}
+
+
+/* ============================================================= */
+/* f1*s1+f2*s2 over the cells of either input, in cell order */
+static void mergeTwoCounties(SrgJob * job, SrgTask * t, CountyRun * r1,
+                             CountyRun * r2)
+{
+    SrgRow *a = parseRun(r1, job->ntok);
+    SrgRow *b = parseRun(r2, job->ntok);
+    SrgRow *row, *last = NULL;
+    char tmp[256], f1[40], f2[40], v1[40], v2[40], num[40];
+    double sum = 0.0, ratio;
+    int i = 0, j = 0, c;
+
+    qsort(a, r1->n, sizeof(SrgRow), compareRowCell);
+    qsort(b, r2->n, sizeof(SrgRow), compareRowCell);
+    javaDouble(f1, job->f1);
+    javaDouble(f2, job->f2);
+    while(i < r1->n || j < r2->n)
+    {
+        if(i == r1->n)
+        {
+            c = 1;
+        }
+        else if(j == r2->n)
+        {
+            c = -1;
+        }
+        else if(a[i].x != b[j].x)
+        {
+            c = a[i].x < b[j].x ? -1 : 1;
+        }
+        else if(a[i].y != b[j].y)
+        {
+            c = a[i].y < b[j].y ? -1 : 1;
+        }
+        else
+        {
+            c = 0;
+        }
+        row = (c <= 0) ? &a[i] : &b[j];
+
+        /* a cell repeated in an input is written once */
+        if(last != NULL && last->x == row->x && last->y == row->y)
+        {
+            if(c <= 0)
+            {
+                i++;
+            }
+            if(c >= 0)
+            {
+                j++;
+            }
+            continue;
+        }
+        last = row;
+
+        if(c == 0)
+        {
+            ratio = job->f1 * a[i].ratio + job->f2 * b[j].ratio;
+            javaDouble(v1, a[i].ratio);
+            javaDouble(v2, b[j].ratio);
+            sum += ratio;
+            javaDouble(num, sum);
+            sprintf(tmp, "%.8f\t\t!\t%s\t%s\t%s\t%s\t\t%s\n", ratio, f1, v1,
+                    f2, v2, num);
+        }
+        else if(c < 0)
+        {
+            ratio = job->f1 * a[i].ratio + job->f2 * 0.0;
+            javaDouble(v1, a[i].ratio);
+            sum += ratio;
+            javaDouble(num, sum);
+            sprintf(tmp, "%.8f\t\t!\t%s\t%s\t%s\t0.0\t\t%s\n", ratio, f1, v1,
+                    f2, num);
+        }
+        else
+        {
+            ratio = job->f1 * 0.0 + job->f2 * b[j].ratio;
+            javaDouble(v2, b[j].ratio);
+            sum += ratio;
+            javaDouble(num, sum);
+            sprintf(tmp, "%.8f\t\t!\t%s\t0.0\t%s\t%s\t%s\n", ratio, f1, f2,
+                    v2, num);
+        }
+        putRowKey(&t->out, job->outCode, row, job->ntok);
+        tbPut(&t->out, tmp);
+        if(c <= 0)
+        {
+            i++;
+        }
+        if(c >= 0)
+        {
+            j++;
+        }
+    }
+    free(a);
+    free(b);
+}
+
+
+/* ============================================================= */
+static void mergeTask(SrgJob * job, SrgTask * t)
+{
+    if(t->run[0] != NULL && t->run[1] != NULL)
+    {
+        mergeTwoCounties(job, t, t->run[0], t->run[1]);
+    }
+    else
+    {
+        mergeOneCounty(job, t, t->run[0] ? t->run[0] : t->run[1]);
+    }
+}
+
+
+/* ============================================================= */
+/* the county comes from the first input that has it; lines from the
+ * gapfilling surrogates are marked with their code */
+static void gapfillTask(SrgJob * job, SrgTask * t)
+{
+    CountyRun *run = NULL;
+    char code[32], out[32], gf[48];
+    char *line, *p;
+    int i, k;
+
+    for(k = 0; k < job->ninput; k++)
+    {
+        if((run = t->run[k]) != NULL)
+        {
+            break;
+        }
+    }
+    sprintf(code, "%d", job->inCode[k]);
+    sprintf(out, "%d", job->outCode);
+    sprintf(gf, " GF: %d\n", job->inCode[k]);
+    for(i = 0; i < run->n; i++)
+    {
+        line = run->line[i];
+        if((p = strstr(line, code)) != NULL)
+        {
+            tbPutn(&t->out, line, p - line);
+            tbPut(&t->out, out);
+            line = p + strlen(code);
+        }
+        tbPut(&t->out, line);
+        tbPut(&t->out, k > 0 ? gf : "\n");
+    }
+}
+
+
+/* ============================================================= */
+static int isExcluded(SrgJob * job, long county)
+{
+    int lo = 0, hi = job->nexclude - 1, mid;
+
+    while(lo <= hi)
+    {
+        mid = (lo + hi) / 2;
+        if(job->exclude[mid] == county)
+        {
+            return 1;
+        }
+        if(job->exclude[mid] < county)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return 0;
+}
+
+
+/* ============================================================= */
+/* scale the county to sum to 1.  For census tracts, rows whose tract
+ * is not in the county are dropped. */
+static void normalizeTask(SrgJob * job, SrgTask * t)
+{
+    CountyRun *run = t->run[0];
+    SrgRow *rows = parseRun(run, job->ntok);
+    char tmp[128], *comment;
+    double all = 0.0, sum = 0.0;
+    int i, *keep;
+
+    keep = (int *) srgAlloc(run->n * sizeof(int));
+    for(i = 0; i < run->n; i++)
+    {
+        all += rows[i].ratio;
+        keep[i] = (job->ntok == 5 || rows[i].x / 1000000 == rows[i].county);
+        if(keep[i])
+        {
+            sum += rows[i].ratio;
+        }
+    }
+    t->notOne = fabs(all - 1.0) > job->precision;
+    if(!isExcluded(job, t->county) && fabs(sum - 1.0) > job->precision)
+    {
+        for(i = 0; i < run->n; i++)
+        {
+            rows[i].ratio /= sum;
+        }
+    }
+    for(i = 0; i < run->n; i++)
+    {
+        if(!keep[i])
+        {
+            continue;
+        }
+        putRowKey(&t->out, rows[i].code, &rows[i], job->ntok);
+        comment = strchr(run->line[i], '!');
+        comment = comment ? trimLine(comment + 1) : "";
+        sprintf(tmp, "%.8f\t!\t", rows[i].ratio);
+        tbPut(&t->out, tmp);
+        tbPut(&t->out, comment);
+        tbPut(&t->out, "\n");
+    }
+    free(keep);
+    free(rows);
+}
+
+
+/* ============================================================= */
+/* county totals, gapfill code and the rows above the threshold */
+static void qaTask(SrgJob * job, SrgTask * t)
+{
+    CountyRun *run = t->run[0];
+    SrgRow row;
+    char *gf, *tab;
+    int i;
+
+    for(i = 0; i < run->n; i++)
+    {
+        parseRow(run->line[i], job->ntok, &row);
+        if(i == 0 && job->gapFilled)
+        {
+            tab = strrchr(run->line[i], '\t');
+            gf = strstr(tab ? tab : run->line[i], "GF:");
+            if(gf != NULL)
+            {
+                t->gfcode = atoi(gf + 3);
+            }
+        }
+        if(row.ratio - job->thresh >= SRGMERGE_PRECISION)
+        {
+            if(t->nhold == t->holdcap)
+            {
+                t->holdcap = t->holdcap ? 2 * t->holdcap : 64;
+                t->hold = (SrgRow *)
+                    srgRealloc(t->hold, t->holdcap * sizeof(SrgRow));
+            }
+            t->hold[t->nhold++] = row;
+        }
+        t->sum += row.ratio;
+    }
+}
+
+
+/* ============================================================= */
+/* the #GRID or #POLYGON line of a surrogate file */
+static char *gridHeader(char *fname)
+{
+    FILE *fp = openFile(fname, "r");
+    char *buf = NULL, *line, *grid = NULL;
+    size_t size;
+    char mesg[512];
+
+    while((line = readLine(fp, &buf, &size)) != NULL)
+    {
+        line = trimLine(line);
+        if(strncmp(line, "#GRID", 5) == 0 || strncmp(line, "#POLYGON", 8) == 0)
+        {
+            grid = srgStrdup(line);
+            break;
+        }
+    }
+    fclose(fp);
+    free(buf);
+    if(grid == NULL)
+    {
+        sprintf(mesg, "Could not find #GRID or #POLYGON tag in the file "
+                "'%.400s'", fname);
+        ERROR(prog_name, mesg, 1);
+    }
+    return grid;
+}
+
+
+/* ============================================================= */
+/* file|name */
+static void parseSrgInfo(char *info, char *line, char **file, char **name)
+{
+    char *bar = strchr(info, '|');
+    char mesg[600];
+
+    if(bar == NULL || strchr(bar + 1, '|') != NULL)
+    {
+        sprintf(mesg, "The line '%.500s' is not in the correct format", line);
+        ERROR(prog_name, mesg, 1);
+    }
+    *bar = '\0';
+    *file = srgStrdup(trimLine(info));
+    *name = srgStrdup(trimLine(bar + 1));
+    if(!fileExists(*file))
+    {
+        sprintf(mesg, "The file '%.500s' does not exist", *file);
+        ERROR(prog_name, mesg, 1);
+    }
+}
+
+
+/* ============================================================= */
+/* factor*({file|name}); the braces may also be given without the
+ * parentheses, as SurrogateTool writes region concatenations */
+static double parseMergeTerm(char *term, char *line, char **file,
+                             char **name)
+{
+    char *star = strchr(term, '*'), *info, *e;
+    char mesg[600];
+    size_t n;
+    double f;
+
+    if(star == NULL)
+    {
+        sprintf(mesg, "The line '%.500s' is not in the correct format", line);
+        ERROR(prog_name, mesg, 1);
+    }
+    *star = '\0';
+    f = strtod(trimLine(term), &e);
+    if(*e != '\0')
+    {
+        sprintf(mesg, "The merge factor '%.100s' is not a number", term);
+        ERROR(prog_name, mesg, 1);
+    }
+    info = trimLine(star + 1);
+    n = strlen(info);
+    if(n >= 4 && strncmp(info, "({", 2) == 0 && strcmp(info + n - 2, "})") == 0)
+    {
+        info[n - 2] = '\0';
+        info += 2;
+    }
+    else if(n >= 2 && info[0] == '{' && info[n - 1] == '}')
+    {
+        info[n - 1] = '\0';
+        info++;
+    }
+    else
+    {
+        sprintf(mesg, "Each part of the equation enclosed by '({' and '})'\n"
+                "%.500s", line);
+        ERROR(prog_name, mesg, 1);
+    }
+    parseSrgInfo(info, line, file, name);
+    return f;
+}
+
+
+/* one OUTSRG line of a merge or gapfill input file */
+typedef struct _SrgCommand {
+    int mode;
+    char *outName;
+    int ninput;
+    char *file[SRGMERGE_MAX_INPUTS];
+    char *name[SRGMERGE_MAX_INPUTS];
+    double f1, f2;
+} SrgCommand;
+
+
+/* ============================================================= */
+static void parseCommand(char *text, SrgCommand * cmd)
+{
+    char *line = srgStrdup(text), *eq, *semi, *body, *plus, *gap, *p, *q;
+    char mesg[600];
+
+    memset(cmd, 0, sizeof(SrgCommand));
+    eq = strchr(line, '=');
+    semi = strchr(line, ';');
+    if(eq == NULL || semi == NULL || semi < eq)
+    {
+        sprintf(mesg, "The line '%.500s' is not in the correct format", text);
+        ERROR(prog_name, mesg, 1);
+    }
+    *semi = '\0';
+    cmd->outName = srgStrdup(trimLine(eq + 1));
+    body = semi + 1;
+
+    if((gap = strstr(body, "GAPFILL")) != NULL)
+    {
+        cmd->mode = MODE_GAPFILL;
+        p = trimLine(gap + 7);
+        if(*p != '=')
+        {
+            sprintf(mesg, "Missing '=' after GAPFILL tag.\nThe line '%.500s' "
+                    "is not in the correct format", text);
+            ERROR(prog_name, mesg, 1);
+        }
+        p++;
+        while(p != NULL)
+        {
+            q = strchr(p, ';');
+            if(q != NULL)
+            {
+                *q++ = '\0';
+            }
+            if(cmd->ninput == SRGMERGE_MAX_INPUTS)
+            {
+                ERROR(prog_name, "Too many gapfilling surrogates", 1);
+            }
+            parseSrgInfo(p, text, &cmd->file[cmd->ninput],
+                         &cmd->name[cmd->ninput]);
+            cmd->ninput++;
+            p = q;
+        }
+        free(line);
+        return;
+    }
+
+    cmd->mode = MODE_MERGE;
+    if(strchr(body, ';') != NULL)
+    {
+        sprintf(mesg, "The line '%.500s' is not in the correct format", text);
+        ERROR(prog_name, mesg, 1);
+    }
+    body = trimLine(body);
+    if((plus = strchr(body, '+')) != NULL)
+    {
+        *plus = '\0';
+        if(strchr(plus + 1, '+') != NULL)
+        {
+            ERROR(prog_name, "Currently, merging is supported for a maximum "
+                  "of two surrogate files", 1);
+        }
+        cmd->f1 = parseMergeTerm(body, text, &cmd->file[0], &cmd->name[0]);
+        cmd->f2 = parseMergeTerm(plus + 1, text, &cmd->file[1], &cmd->name[1]);
+        cmd->ninput = 2;
+    }
+    else
+    {
+        cmd->f1 = parseMergeTerm(body, text, &cmd->file[0], &cmd->name[0]);
+        cmd->f2 = 0.0;
+        cmd->ninput = 1;
+    }
+    free(line);
+}
+
+
+/* ============================================================= */
+/* TAG=value, with the value as written after the '=' */
+static char *tagValue(char *line, char *tag)
+{
+    size_t n = strlen(tag);
+    char *p;
+    char mesg[600];
+
+    p = line + n;
+    while(isspace((unsigned char) *p))
+    {
+        p++;
+    }
+    if(*p != '=')
+    {
+        sprintf(mesg, "Expecting '=' after tag '%s'\nThe line '%.500s' is "
+                "not in the correct format", tag, line);
+        ERROR(prog_name, mesg, 1);
+    }
+    return srgStrdup(p + 1);
+}
+
+
+/* ============================================================= */
+static void addHeaderLine(char ***lines, int *n, char *line)
+{
+    int i;
+
+    for(i = 0; i < *n; i++)
+    {
+        if(strcmp((*lines)[i], line) == 0)
+        {
+            free(line);
+            return;
+        }
+    }
+    *lines = (char **) srgRealloc(*lines, (*n + 1) * sizeof(char *));
+    (*lines)[(*n)++] = line;
+}
+
+
+/* ============================================================= */
+/* run the merge or gapfill commands of an input file into OUTFILE */
+static void mergeSurrogates(char *inputFile)
+{
+    FILE *fp, *ofp;
+    char *buf = NULL, *line, *trimmed, *outFile = NULL, *xrefFile = NULL;
+    char *grid = NULL, *g, *lastFile = NULL;
+    char **inputLines = NULL, **srgdesc = NULL;
+    size_t size;
+    char mesg[1200], tmp[600];
+    int ninputLines = 0, nsrgdesc = 0, ncmd = 0, i, k;
+    SrgCommand *cmd = NULL;
+    SrgNames names;
+    SrgReader in[SRGMERGE_MAX_INPUTS];
+    SrgJob job;
+    size_t tlen;
+
+    printf("Reading merge input file...\n");
+    fp = openFile(inputFile, "r");
+    while((line = readLine(fp, &buf, &size)) != NULL)
+    {
+        inputLines = (char **)
+            srgRealloc(inputLines, (ninputLines + 1) * sizeof(char *));
+        inputLines[ninputLines++] = srgStrdup(line);
+        if(isCommentLine(line))
+        {
+            continue;
+        }
+        trimmed = trimLine(line);
+        if(strchr(trimmed, '=') == NULL)
+        {
+            continue;
+        }
+        tlen = strcspn(trimmed, "=");
+        while(tlen > 0 && isspace((unsigned char) trimmed[tlen - 1]))
+        {
+            tlen--;
+        }
+        if(tlen == 7 && strncmp(trimmed, "OUTFILE", 7) == 0)
+        {
+            outFile = tagValue(trimmed, "OUTFILE");
+        }
+        else if(tlen == 8 && strncmp(trimmed, "XREFFILE", 8) == 0)
+        {
+            xrefFile = tagValue(trimmed, "XREFFILE");
+            if(!fileExists(xrefFile))
+            {
+                sprintf(mesg, "The file '%.500s' does not exist", xrefFile);
+                ERROR(prog_name, mesg, 1);
+            }
+        }
+        else if(tlen == 6 && strncmp(trimmed, "OUTSRG", 6) == 0)
+        {
+            cmd = (SrgCommand *) srgRealloc(cmd, (ncmd + 1) * sizeof(SrgCommand));
+            parseCommand(trimmed, &cmd[ncmd++]);
+        }
+    }
+    fclose(fp);
+    if(outFile == NULL)
+    {
+        ERROR(prog_name, "The output surrogate file name is not specified", 1);
+    }
+    if(xrefFile == NULL)
+    {
+        ERROR(prog_name, "The cross reference file name is not specified", 1);
+    }
+    if(ncmd == 0)
+    {
+        ERROR(prog_name, "Atleast one merge or gapfill command should be "
+              "specified", 1);
+    }
+
+    /* every input must be on the same grid */
+    for(k = 0; k < ncmd; k++)
+    {
+        for(i = 0; i < cmd[k].ninput; i++)
+        {
+            g = gridHeader(cmd[k].file[i]);
+            if(grid != NULL && strcasecmp(grid, g) != 0)
+            {
+                sprintf(mesg, "The grids in the following file do not match: "
+                        "'%.500s', '%.500s'", lastFile, cmd[k].file[i]);
+                ERROR(prog_name, mesg, 1);
+            }
+            free(grid);
+            grid = g;
+            lastFile = cmd[k].file[i];
+        }
+    }
+
+    memset(&names, 0, sizeof(SrgNames));
+    fp = openFile(xrefFile, "r");
+    while((line = readLine(fp, &buf, &size)) != NULL)
+    {
+        parseSrgDescTag(trimLine(line), &names);
+    }
+    fclose(fp);
+    free(buf);
+
+    for(k = 0; k < ncmd; k++)
+    {
+        sprintf(tmp, "#SRGDESC=%d,", srgCode(&names, cmd[k].outName));
+        g = (char *) srgAlloc(strlen(tmp) + strlen(cmd[k].outName) + 1);
+        sprintf(g, "%s%s", tmp, cmd[k].outName);
+        addHeaderLine(&srgdesc, &nsrgdesc, g);
+        for(i = 0; i < cmd[k].ninput; i++)
+        {
+            sprintf(tmp, "#SRGDESC=%d,", srgCode(&names, cmd[k].name[i]));
+            g = (char *) srgAlloc(strlen(tmp) + strlen(cmd[k].name[i]) + 1);
+            sprintf(g, "%s%s", tmp, cmd[k].name[i]);
+            addHeaderLine(&srgdesc, &nsrgdesc, g);
+        }
+    }
+    printf("Finished reading merge input file and started merging...\n");
+
+    if(fileExists(outFile))
+    {
+        printf("Delete existing output surrogate file: %s\n", outFile);
+        remove(outFile);
+    }
+    ofp = openFile(outFile, "w");
+    fprintf(ofp, "%s\n", grid);
+    for(i = 0; i < nsrgdesc; i++)
+    {
+        fprintf(ofp, "%s\n", srgdesc[i]);
+    }
+    for(i = 0; i < ninputLines; i++)
+    {
+        fprintf(ofp, "#%s\n", inputLines[i]);
+    }
+
+    for(k = 0; k < ncmd; k++)
+    {
+        initJob(&job, cmd[k].mode, strncmp(grid, "#GRID", 5) == 0 ? 5 : 4);
+        job.process = cmd[k].mode == MODE_GAPFILL ? gapfillTask : mergeTask;
+        job.ninput = cmd[k].ninput;
+        job.outCode = srgCode(&names, cmd[k].outName);
+        job.f1 = cmd[k].f1;
+        job.f2 = cmd[k].f2;
+        for(i = 0; i < cmd[k].ninput; i++)
+        {
+            job.inCode[i] = srgCode(&names, cmd[k].name[i]);
+            initReader(&in[i], cmd[k].file[i], job.inCode[i], 1, NULL);
+        }
+        streamCounties(&job, in, cmd[k].ninput, writeDone, ofp);
+        for(i = 0; i < cmd[k].ninput; i++)
+        {
+            closeReader(&in[i]);
+        }
+        freeJob(&job);
+    }
+    if(fclose(ofp) != 0)
+    {
+        sprintf(mesg, "Error writing the output surrogate file '%.500s'",
+                outFile);
+        ERROR(prog_name, mesg, 1);
+    }
+    printf("Finished %s\n", cmd[0].mode == MODE_GAPFILL ? "gapfilling" :
+           "merging");
+}
+
+
+/* ============================================================= */
+static int compareLong(const void *a, const void *b)
+{
+    long x = *(const long *) a, y = *(const long *) b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+
+/* ============================================================= */
+static void readExcludeCounties(char *fname, SrgJob * job)
+{
+    FILE *fp = openFile(fname, "r");
+    char *buf = NULL, *line, *e;
+    size_t size;
+    char mesg[600];
+    int cap = 0;
+
+    while((line = readLine(fp, &buf, &size)) != NULL)
+    {
+        if(isCommentLine(line))
+        {
+            continue;
+        }
+        line = trimLine(line);
+        if(job->nexclude == cap)
+        {
+            cap = cap ? 2 * cap : 256;
+            job->exclude = (long *) srgRealloc(job->exclude, cap * sizeof(long));
+        }
+        job->exclude[job->nexclude] = strtol(line, &e, 10);
+        if(e == line || *e != '\0')
+        {
+            sprintf(mesg, "Error reading the file '%.300s'; %.100s is not a "
+                    "county id", fname, line);
+            ERROR(prog_name, mesg, 1);
+        }
+        job->nexclude++;
+    }
+    fclose(fp);
+    free(buf);
+    qsort(job->exclude, job->nexclude, sizeof(long), compareLong);
+}
+
+
+/* ============================================================= */
+static void normalizeDone(SrgJob * job, void *arg)
+{
+    int i;
+
+    writeTasks(job, ((FILE **) arg)[0]);
+    for(i = 0; i < job->ntask; i++)
+    {
+        if(job->task[i].notOne)
+        {
+            *((int *) ((FILE **) arg)[1]) = 1;
+        }
+    }
+}
+
+
+/* ============================================================= */
+/* write <file>_NORM.txt for each surrogate file of an SRGDESC file whose
+ * counties do not all sum to 1, and an SRGDESC file that lists them */
+static void normalizeSurrogates(int argc, char *argv[])
+{
+    SrgDescFile *df;
+    SrgDesc *d;
+    SrgReader in;
+    SrgJob job;
+    FILE *dfp, *ofp;
+    void *arg[2];
+    char *descOut, *normFile, *e;
+    char mesg[600];
+    int i, required;
+
+    if(argc < 3 || argc > 5)
+    {
+        fprintf(stderr, "Usage: %s -normalize SRGDESC.txt "
+                "[ExcludeCounties.txt] [1e-6]\n", prog_name);
+        exit(1);
+    }
+    initJob(&job, MODE_NORMALIZE, 0);
+    job.process = normalizeTask;
+    job.precision = SRGMERGE_PRECISION;
+    if(argc >= 4)
+    {
+        readExcludeCounties(argv[3], &job);
+    }
+    if(argc == 5)
+    {
+        job.precision = strtod(argv[4], &e);
+        if(e == argv[4] || *trimLine(e) != '\0')
+        {
+            sprintf(mesg, "%.100s is not a double (numeric) value", argv[4]);
+            ERROR(prog_name, mesg, 1);
+        }
+    }
+
+    df = readSrgDescFile(argv[2]);
+    job.ntok = df->ntok;
+    descOut = siblingName(argv[2], "_NORM.txt");
+    if(fileExists(descOut))
+    {
+        printf("Delete existing output surrogate file: %s\n", descOut);
+        remove(descOut);
+    }
+    dfp = openFile(descOut, "w");
+    for(i = 0; i < df->ncomments; i++)
+    {
+        fprintf(dfp, "%s\n", df->comments[i]);
+    }
+
+    for(i = 0; i < df->ndesc; i++)
+    {
+        d = &df->desc[i];
+        printf("Processing surrogate %s:%d:%s:%s\n", d->region, d->code,
+               d->name, d->file);
+        normFile = siblingName(d->file, "_NORM.txt");
+        if(fileExists(normFile))
+        {
+            printf("Delete existing normalized output surrogate file: %s\n",
+                   normFile);
+            remove(normFile);
+        }
+        ofp = openFile(normFile, "w");
+        initReader(&in, d->file, -1, 0, ofp);
+        required = 0;
+        arg[0] = ofp;
+        arg[1] = &required;
+        streamCounties(&job, &in, 1, normalizeDone, arg);
+        closeReader(&in);
+        fclose(ofp);
+
+        if(!required)
+        {
+            remove(normFile);
+            printf("Normalization is not required for the surrogate file "
+                   "'%s'\n", d->file);
+            fprintf(dfp, "%s,%d,\"%s\",%s\n", d->region, d->code, d->name,
+                    d->file);
+        }
+        else
+        {
+            fprintf(dfp, "%s,%d,\"%s\",%s\n", d->region, d->code, d->name,
+                    normFile);
+        }
+        free(normFile);
+    }
+    fclose(dfp);
+    freeJob(&job);
+}
+
+
+/* ============================================================= */
+static QACell *qaCell(QATable * qt, long county, int code, int *created)
+{
+    unsigned long h;
+    int i, j, *old, oldsize;
+
+    if(2 * (qt->ncell + 1) > qt->hsize)
+    {
+        old = qt->hash;
+        oldsize = qt->hsize;
+        qt->hsize = qt->hsize ? 2 * qt->hsize : 4096;
+        qt->hash = (int *) srgAlloc(qt->hsize * sizeof(int));
+        for(i = 0; i < qt->hsize; i++)
+        {
+            qt->hash[i] = -1;
+        }
+        for(i = 0; i < oldsize; i++)
+        {
+            if(old[i] >= 0)
+            {
+                h = ((unsigned long) qt->cell[old[i]].county * 31u +
+                     (unsigned long) qt->cell[old[i]].code) % qt->hsize;
+                while(qt->hash[h] >= 0)
+                {
+                    h = (h + 1) % qt->hsize;
+                }
+                qt->hash[h] = old[i];
+            }
+        }
+        free(old);
+    }
+    h = ((unsigned long) county * 31u + (unsigned long) code) % qt->hsize;
+    while((j = qt->hash[h]) >= 0)
+    {
+        if(qt->cell[j].county == county && qt->cell[j].code == code)
+        {
+            *created = 0;
+            return &qt->cell[j];
+        }
+        h = (h + 1) % qt->hsize;
+    }
+    if(qt->ncell == qt->cellcap)
+    {
+        qt->cellcap = qt->cellcap ? 2 * qt->cellcap : 1024;
+        qt->cell = (QACell *) srgRealloc(qt->cell, qt->cellcap * sizeof(QACell));
+    }
+    qt->hash[h] = qt->ncell;
+    qt->cell[qt->ncell].county = county;
+    qt->cell[qt->ncell].code = code;
+    qt->cell[qt->ncell].sum = 0.0;
+    qt->cell[qt->ncell].gfcode = -1;
+    *created = 1;
+    return &qt->cell[qt->ncell++];
+}
+
+
+/* ============================================================= */
+static void qaDone(SrgJob * job, void *arg)
+{
+    QATable *qt = (QATable *) arg;
+    SrgTask *t;
+    QACell *c;
+    int i, k, created;
+
+    for(i = 0; i < job->ntask; i++)
+    {
+        t = &job->task[i];
+        c = qaCell(qt, t->county, job->inCode[0], &created);
+        if(created)
+        {
+            c->gfcode = t->gfcode;
+        }
+        c->sum += t->sum;
+        for(k = 0; k < t->nhold; k++)
+        {
+            if(qt->nhold == qt->holdcap)
+            {
+                qt->holdcap = qt->holdcap ? 2 * qt->holdcap : 1024;
+                qt->hold = (SrgRow *)
+                    srgRealloc(qt->hold, qt->holdcap * sizeof(SrgRow));
+            }
+            qt->hold[qt->nhold] = t->hold[k];
+            qt->hold[qt->nhold].seq = qt->nhold;
+            qt->nhold++;
+        }
+    }
+}
+
+
+/* ============================================================= */
+static int compareInt(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+
+/* ============================================================= */
+static long holdGrid(SrgRow * r)
+{
+    return r->y == -1 ? r->x : r->x * 1000 + r->y;
+}
+
+
+/* ============================================================= */
+/* by county, then grid cell as the Java QA tool numbers them */
+static int compareHold(const void *a, const void *b)
+{
+    const SrgRow *r1 = (const SrgRow *) a;
+    const SrgRow *r2 = (const SrgRow *) b;
+    long g1 = holdGrid((SrgRow *) r1), g2 = holdGrid((SrgRow *) r2);
+
+    if(r1->county != r2->county)
+    {
+        return r1->county < r2->county ? -1 : 1;
+    }
+    if(g1 != g2)
+    {
+        return g1 < g2 ? -1 : 1;
+    }
+    return r1->seq - r2->seq;
+}
+
+
+/* ============================================================= */
+static FILE *openReport(char *fname, char *header, int ncode, int *codes,
+                        SrgNames * names, double thresh, int holdColumns)
+{
+    FILE *fp = openFile(fname, "w");
+    char num[40];
+    int j;
+
+    fprintf(fp, "%s\n", header);
+    if(thresh >= 0.0)
+    {
+        javaDouble(num, thresh);
+        fprintf(fp, "Threshold: %s\n", num);
+    }
+    fprintf(fp, "COUNTY,");
+    if(holdColumns == 5)
+    {
+        fprintf(fp, "COL,ROW,");
+    }
+    else if(holdColumns == 4)
+    {
+        fprintf(fp, "POLYID,");
+    }
+    for(j = 0; j < ncode; j++)
+    {
+        fprintf(fp, "%d%s", codes[j], j < ncode - 1 ? "," : "\n");
+    }
+    fprintf(fp, ",");
+    if(holdColumns)
+    {
+        fprintf(fp, holdColumns == 5 ? ",," : ",");
+    }
+    for(j = 0; j < ncode; j++)
+    {
+        fprintf(fp, "\"%s\"%s", srgName(names, codes[j]),
+                j < ncode - 1 ? "," : "\n");
+    }
+    return fp;
+}
+
+
+/* ============================================================= */
+/* the summary, gapfill, nodata, not1 and threshold reports of a region */
+static void writeQAReports(QATable * qt, char **fname, char *header,
+                           SrgNames * names, int ntok, double thresh)
+{
+    FILE *sum, *gap, *nod, *not1, *thr;
+    long *counties, col, row;
+    int *codes, *cell;
+    int ncounty = 0, ncode = 0, i, j, k, h, anyNot1, anyNoData, notOne;
+    char num[40];
+    QACell *c;
+    SrgRow *r;
+
+    counties = (long *) srgAlloc(qt->ncell * sizeof(long));
+    codes = (int *) srgAlloc(qt->ncell * sizeof(int));
+    for(i = 0; i < qt->ncell; i++)
+    {
+        counties[i] = qt->cell[i].county;
+        codes[i] = qt->cell[i].code;
+    }
+    qsort(counties, qt->ncell, sizeof(long), compareLong);
+    qsort(codes, qt->ncell, sizeof(int), compareInt);
+    for(i = 0; i < qt->ncell; i++)
+    {
+        if(i == 0 || counties[i] != counties[ncounty - 1])
+        {
+            counties[ncounty++] = counties[i];
+        }
+        if(i == 0 || codes[i] != codes[ncode - 1])
+        {
+            codes[ncode++] = codes[i];
+        }
+    }
+    cell = (int *) srgAlloc((size_t) ncounty * ncode * sizeof(int));
+    for(i = 0; i < ncounty * ncode; i++)
+    {
+        cell[i] = -1;
+    }
+    for(k = 0; k < qt->ncell; k++)
+    {
+        i = (int) ((long *) bsearch(&qt->cell[k].county, counties, ncounty,
+                                    sizeof(long), compareLong) - counties);
+        j = (int) ((int *) bsearch(&qt->cell[k].code, codes, ncode,
+                                   sizeof(int), compareInt) - codes);
+        cell[i * ncode + j] = k;
+    }
+
+    printf("The output surrogate summary file: %s\n", fname[0]);
+    printf("The gapfill report file: %s\n", fname[1]);
+    printf("The output surrogate NODATA file: %s\n", fname[2]);
+    printf("The output surrogate NOT1 file: %s\n", fname[3]);
+    printf("The output surrogate threshold file: %s\n", fname[4]);
+    sum = openReport(fname[0], header, ncode, codes, names, -1.0, 0);
+    gap = openReport(fname[1], header, ncode, codes, names, -1.0, 0);
+    nod = openReport(fname[2], header, ncode, codes, names, -1.0, 0);
+    not1 = openReport(fname[3], header, ncode, codes, names, -1.0, 0);
+    thr = openReport(fname[4], header, ncode, codes, names, thresh, ntok);
+
+    for(i = 0; i < ncounty; i++)
+    {
+        anyNot1 = anyNoData = 0;
+        for(j = 0; j < ncode; j++)
+        {
+            k = cell[i * ncode + j];
+            if(k < 0)
+            {
+                anyNoData = 1;
+            }
+            else if(fabs(qt->cell[k].sum - 1.0) > SRGMERGE_PRECISION)
+            {
+                anyNot1 = 1;
+            }
+        }
+        fprintf(sum, "%ld,", counties[i]);
+        fprintf(gap, "%ld,", counties[i]);
+        if(anyNoData)
+        {
+            fprintf(nod, "%ld,", counties[i]);
+        }
+        if(anyNot1)
+        {
+            fprintf(not1, "%ld,", counties[i]);
+        }
+        for(j = 0; j < ncode; j++)
+        {
+            k = cell[i * ncode + j];
+            c = k < 0 ? NULL : &qt->cell[k];
+            notOne = c != NULL && fabs(c->sum - 1.0) > SRGMERGE_PRECISION;
+            if(c == NULL)
+            {
+                fprintf(sum, "NODATA");
+            }
+            else
+            {
+                if(notOne)
+                {
+                    fprintf(sum, "NOT1:%.8f", c->sum);
+                }
+                if(c->gfcode != -1)
+                {
+                    fprintf(sum, "%sGF:%d", notOne ? ";" : "", c->gfcode);
+                }
+            }
+            if(c != NULL && c->gfcode != -1)
+            {
+                fprintf(gap, "%d", c->gfcode);
+            }
+            if(anyNoData && c == NULL)
+            {
+                fprintf(nod, "NODATA");
+            }
+            if(anyNot1 && notOne)
+            {
+                fprintf(not1, "%.8f", c->sum);
+            }
+            fprintf(sum, j < ncode - 1 ? "," : "\n");
+            fprintf(gap, j < ncode - 1 ? "," : "\n");
+            if(anyNoData)
+            {
+                fprintf(nod, j < ncode - 1 ? "," : "\n");
+            }
+            if(anyNot1)
+            {
+                fprintf(not1, j < ncode - 1 ? "," : "\n");
+            }
+        }
+    }
+
+    /* one line per county and grid cell that has a ratio above the
+     * threshold in any surrogate */
+    qsort(qt->hold, qt->nhold, sizeof(SrgRow), compareHold);
+    for(h = 0; h < qt->nhold; h = k)
+    {
+        for(k = h + 1; k < qt->nhold && qt->hold[k].county == qt->hold[h].county
+            && holdGrid(&qt->hold[k]) == holdGrid(&qt->hold[h]); k++)
+        {
+        }
+        i = (int) ((long *) bsearch(&qt->hold[h].county, counties, ncounty,
+                                    sizeof(long), compareLong) - counties);
+        fprintf(thr, "%ld,", qt->hold[h].county);
+        col = -1;
+        if(ntok == 5)
+        {
+            col = holdGrid(&qt->hold[h]) % 1000;
+            row = (holdGrid(&qt->hold[h]) - col) / 1000;
+            fprintf(thr, "%ld,", col);
+        }
+        else
+        {
+            row = holdGrid(&qt->hold[h]);
+        }
+        fprintf(thr, "%ld,", row);
+        for(j = 0; j < ncode; j++)
+        {
+            num[0] = '\0';
+            if(cell[i * ncode + j] >= 0)
+            {
+                for(r = &qt->hold[h]; r < &qt->hold[k]; r++)
+                {
+                    if(r->code == codes[j] && r->x == row && r->y == col)
+                    {
+                        sprintf(num, "%.8f", r->ratio);
+                        break;
+                    }
+                }
+            }
+            fprintf(thr, "%s%s", num, j < ncode - 1 ? "," : "\n");
+        }
+    }
+
+    fclose(sum);
+    fclose(gap);
+    fclose(nod);
+    fclose(not1);
+    fclose(thr);
+    free(cell);
+    free(codes);
+    free(counties);
+}
+
+
+/* ============================================================= */
+/* QA reports for every region of an SRGDESC file */
+static void qaSurrogates(int argc, char *argv[])
+{
+    static char *suffix[5] = { "_summary.csv", "_gapfill.csv",
+        "_nodata.csv", "_not1.csv", "_threshold.csv"
+    };
+    SrgDescFile *df;
+    SrgDesc *d;
+    SrgReader in;
+    SrgJob job;
+    SrgNames names;
+    QATable qt;
+    char *fname[5], *header, *e, *base;
+    char mesg[700];
+    int r, i, k, seen;
+
+    if(argc != 4)
+    {
+        fprintf(stderr, "Usage: %s -qa SRGDESC.txt threshold\n", prog_name);
+        exit(1);
+    }
+    df = readSrgDescFile(argv[2]);
+    initJob(&job, MODE_QA, df->ntok);
+    job.process = qaTask;
+    job.thresh = strtod(argv[3], &e);
+    if(e == argv[3] || *trimLine(e) != '\0')
+    {
+        sprintf(mesg, "%.100s is not a double (numeric) value", argv[3]);
+        ERROR(prog_name, mesg, 1);
+    }
+    header = (char *) srgAlloc(strlen(df->header) + strlen(argv[2]) + 2);
+    sprintf(header, "%s\n%s", df->header, argv[2]);
+
+    for(r = 0; r < df->ndesc; r++)
+    {
+        for(seen = 0, i = 0; i < r; i++)
+        {
+            if(strcmp(df->desc[i].region, df->desc[r].region) == 0)
+            {
+                seen = 1;
+            }
+        }
+        if(seen)
+        {
+            continue;
+        }
+
+        for(k = 0; k < 5; k++)
+        {
+            base = (char *) srgAlloc(strlen(df->desc[r].region) +
+                                     strlen(suffix[k]) + 2);
+            sprintf(base, "_%s%s", df->desc[r].region, suffix[k]);
+            fname[k] = siblingName(argv[2], base);
+            free(base);
+            if(fileExists(fname[k]))
+            {
+                sprintf(mesg, "The output file '%.500s' already exists",
+                        fname[k]);
+                ERROR(prog_name, mesg, 1);
+            }
+        }
+
+        printf("Reading surrogate files...\n");
+        memset(&qt, 0, sizeof(QATable));
+        memset(&names, 0, sizeof(SrgNames));
+        for(i = r; i < df->ndesc; i++)
+        {
+            d = &df->desc[i];
+            if(strcmp(d->region, df->desc[r].region) != 0)
+            {
+                continue;
+            }
+            addSrgName(&names, d->code, d->name);
+            printf("Reading %s\n", d->file);
+            job.inCode[0] = d->code;
+            job.gapFilled = strstr(d->file, "NOFILL") == NULL;
+            initReader(&in, d->file, d->code, 0, NULL);
+            streamCounties(&job, &in, 1, qaDone, &qt);
+            closeReader(&in);
+        }
+        printf("Finished reading the surrogate information.\n");
+        if(qt.ncell == 0)
+        {
+            ERROR(prog_name, "There is no data", 1);
+        }
+        writeQAReports(&qt, fname, header, &names, df->ntok, job.thresh);
+        for(k = 0; k < 5; k++)
+        {
+            free(fname[k]);
+        }
+        free(qt.cell);
+        free(qt.hash);
+        free(qt.hold);
+    }
+    freeJob(&job);
+}
+
+
+/* ============================================================= */
+int main(int argc, char *argv[])
+{
+    prog_name = argv[0];
+    printf("%s\n", prog_version);
+    if(argc >= 2 && strcmp(argv[1], "-normalize") == 0)
+    {
+        normalizeSurrogates(argc, argv);
+    }
+    else if(argc >= 2 && strcmp(argv[1], "-qa") == 0)
+    {
+        qaSurrogates(argc, argv);
+    }
+    else if(argc == 2)
+    {
+        mergeSurrogates(argv[1]);
+    }
+    else
+    {
+        fprintf(stderr, "Usage: %s merge_or_gapfill_input_file\n"
+                "       %s -normalize SRGDESC_file [exclude_list [tolerance]]\n"
+                "       %s -qa SRGDESC_file threshold\n",
+                prog_name, prog_name, prog_name);
+        exit(1);
+    }
+    return 0;
+}
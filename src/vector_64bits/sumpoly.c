@@ -11,6 +11,8 @@
  * sum2Poly
  * avg1Poly
  * typeAreaPercent
+ * typeAreaColumn
+ * freeTypeAreaMap
  * getPolyIntValue
  * setPolyIntValue
  * printOnePolyIntInfo
@@ -27,6 +29,7 @@
 
 #include "shapefil.h"
 #include "mims_spatl.h"
+#include "mims_evs.h"
 #include "parms3.h"
 
 //#define DEBUGCOUNTY 
@@ -55,9 +58,8 @@ int sum1Poly(PolyObject * poly, double **psum, int *pn1, int attr_id,
 {
     int i, n;
     int n1;
-    PolyShape *ps;
-    PolyShapeList *plist;
-    PolyParent *pp;
+    int w_idx;
+    GeomStore *gs;
     PolyObject *w_poly;
     PolyObject *d_poly;
     double val;
@@ -126,28 +128,22 @@ int sum1Poly(PolyObject * poly, double **psum, int *pn1, int attr_id,
     //MESG(mesg);
 
     /* loop over polygons in the weight-data intersection */
-    n = poly->nObjects;
+    gs = getGeomStore(poly);
+    if(gs == NULL)
+    {
+        return 1;
+    }
+    n = gs->nshapes;
     //sprintf(mesg, "num data polys = %d num weight-data ojects = %d\n", n1, n);
     //MESG(mesg);
 
-    plist = poly->plist;
-
     for(i = 0; i < n; i++)
     {
-        ps = plist->ps;         /* the intersected weight-data polygon */
-        id = -1;
-        pp = plist->pp;         /* the parent poly (= the county polygon) */
-
-        if(pp)
-        {
-            while(pp->p1->pp)
-            {
-                pp = pp->p1->pp;
-            }
-            /* p1 is the parent weight poly, p2 is the parent data poly */
-            /* AME: items are summed on ID the index of the data poly */
-            id = pp->p2->index; /* this id corresponds to the county */
-        }
+        /* the top parent pair of the intersected weight-data polygon:
+         * p1 is the parent weight poly, p2 is the parent data poly */
+        /* AME: items are summed on ID the index of the data poly */
+        id = gs->top_p1_p2[i];  /* this id corresponds to the county */
+        w_idx = gs->top_p1[i];
         /* determine the fraction of the weight that should be added 
            to the county's total for that attribute */
         if(id >= 0)
@@ -156,7 +152,7 @@ int sum1Poly(PolyObject * poly, double **psum, int *pn1, int attr_id,
             countyid = (d_poly->attr_val[id][0]).str;
             printf("sum1Poly: countyid=%s\n", countyid);
             printf("processing county %s, id=%d\n",countyid, id); 
-            printf("num_contours=%d\n", ps->num_contours);
+            printf("num_contours=%d\n", storeNumContours(gs, i));
             /* bug??? for some reason the countyid is not in the right numeric range */
 #endif
             /* get the value of the weight */
@@ -166,12 +162,11 @@ int sum1Poly(PolyObject * poly, double **psum, int *pn1, int attr_id,
                 if(weight_val_type == FTInteger)
                 {
                     val =
-                        (double) (w_poly->attr_val[pp->p1->index][attr_id].
-                                  ival);
+                        (double) (w_poly->attr_val[w_idx][attr_id].ival);
                 }
                 else if(weight_val_type == FTDouble)
                 {
-                    val = w_poly->attr_val[pp->p1->index][attr_id].val;
+                    val = w_poly->attr_val[w_idx][attr_id].val;
                 }
                 /* else it's a string - let val be 1 */
                 else
@@ -181,23 +176,22 @@ int sum1Poly(PolyObject * poly, double **psum, int *pn1, int attr_id,
                 if(weight_shp_type == SHPT_POINT)
                 {
                     /* frac = the weight value * number in w-d poly */
-                    if( ps->num_contours > 1 )
+                    if( storeNumContours(gs, i) > 1 )
                         frac = 0.0;
                     else
                         frac = val;
                 }
                 else if((weight_shp_type == SHPT_ARC) && (val != 0.0))
                 {
-                    /* TBD: we're computing the length and area over and over again... */
                     /* the weight value * length in w-d poly / total weight length */
-                    frac = val * PolyLength(ps) / PolyLength(pp->p1->ps);
+                    frac = val * storeLength(gs, i) / storeParentLength(gs, i);
 #ifdef DEBUGCOUNTY
                     printf("aa %s  %s  %.4lf", countyid, debugcty, frac );
                     if((frac > 0.0) && (countyid == debugcty))
                     {
                         fprintf(stderr,
                                 "sum1poly1: %s lenght = %lf, parent length = %lf, fract=%.4lf\n",
-                                debugcty, PolyLength(ps), PolyLength(pp->p1->ps),
+                                debugcty, storeLength(gs, i), storeParentLength(gs, i),
                                 frac);
                     }
 #endif
@@ -206,13 +200,13 @@ int sum1Poly(PolyObject * poly, double **psum, int *pn1, int attr_id,
                 else /* it's a poly */ if (val != 0.0)
                 {
                     /* frac = the weight value * area of w-d int / total weight area */
-                    frac = val * (PolyArea(ps) / PolyArea(pp->p1->ps));
+                    frac = val * (storeArea(gs, i) / storeParentArea(gs, i));
 #ifdef DEBUGCOUNTY
                     if((frac > 0.0) && (countyid == debugcty))
                     {
                         fprintf(stderr,
                                 "sum1poly1: %s shape area = %lf, parent area = %lf, fract=%.4lf\n",
-                                debugcty, PolyArea(ps), PolyArea(pp->p1->ps),
+                                debugcty, storeArea(gs, i), storeParentArea(gs, i),
                                 frac);
                     }
 #endif
@@ -228,20 +222,19 @@ int sum1Poly(PolyObject * poly, double **psum, int *pn1, int attr_id,
                 }
                 else if(weight_shp_type == SHPT_ARC)
                 {
-                    /* TBD: we're computing the length and area over and over again... */
                     /* frac = the weight value * length in w-d poly */
-                    frac = PolyLength(ps);
+                    frac = storeLength(gs, i);
                 }
                 else            /* polys */
                 {
                     /* frac = area of w-d int */
-                    frac = PolyArea(ps);
+                    frac = storeArea(gs, i);
 #ifdef DEBUGCOUNTY
                     if((frac > 0) && (countyid == debugcty))
                     {
                         fprintf(stderr,
                                 "sum1poly2: %s shape area = %lf, frac=%lf\n",
-                                debugcty, PolyArea(ps), frac);
+                                debugcty, storeArea(gs, i), frac);
                     }
 #endif
                 }
@@ -253,7 +246,6 @@ int sum1Poly(PolyObject * poly, double **psum, int *pn1, int attr_id,
             fprintf(stderr, "i = %d, id = %d, frac = %f\n", i, id, frac);
 #endif
         }
-        plist = plist->next;
     }
 
 #ifdef DEBUG
@@ -381,42 +373,53 @@ int printOnePolyIntInfo(PolyIntStruct * polyIntInfoPtr)
     return 0;
 }
 
+/* find the grid cells whose bounding boxes overlap d_bb, in index order;
+ * list has room for n2 indices */
+static void fillOnePolyIntInfo(PolyIntStruct * polyIntInfoPtr,
+                               BoundingBox * d_bb, GeomStore * g_gs, int n2,
+                               int *list)
+{
+    BoundingBox *g_bb;
+    int numIntersectsFound = 0;
+    int j;
+
+    for(j = 0; j < n2; j++)
+    {
+        g_bb = g_gs->bb + j;
+        /* the data poly bounding box overlaps the grid cell bounding box */
+        if(OVERLAP2(d_bb, g_bb))
+        {
+            list[numIntersectsFound] = j;
+            numIntersectsFound++;
+        }
+    }
+    allocateOnePolyIntInfo(polyIntInfoPtr, numIntersectsFound, list, 0.0);
+}
+
 /* populate polyInt Infowith values for data polygons and grid polygons */
 int fillPolyIntInfo(PolyIntStruct * polyIntInfo, PolyObject * d_poly,
                     PolyObject * g_poly, int n1, int n2)
 {
-    PolyShapeList *d_list, *g_list;
-    BoundingBox *d_bb, *g_bb;
+    GeomStore *d_gs, *g_gs;
     int *intersectionIndexList; /* the max # of grid cells that can be 
                                  * intersected with is n2 */
-    int numIntersectsFound;
-    int i, j;
+    int i;
 
-    intersectionIndexList = (int *) malloc(n2 * sizeof(int));
+    d_gs = getGeomStore(d_poly);
+    g_gs = getGeomStore(g_poly);
+    if(d_gs == NULL || g_gs == NULL)
+    {
+        return 1;
+    }
+    intersectionIndexList = (int *) malloc(MAX(1, n2) * sizeof(int));
 
     /* fill polyIntInfo with info about the intersections of the data polys with
      * the grid polys */
-    d_list = d_poly->plist;
     for(i = 0; i < n1; i++)
     {
-        d_bb = d_list->bb;
-        g_list = g_poly->plist;
-        numIntersectsFound = 0;
-        for(j = 0; j < n2; j++)
-        {
-            g_bb = g_list->bb;
-            /* the data poly bounding box overlaps the grid cell bounding box */
-            if(OVERLAP2(d_bb, g_bb))
-            {
-                intersectionIndexList[numIntersectsFound] = j;
-                numIntersectsFound++;
-            }
-            g_list = g_list->next;
-        }
-        allocateOnePolyIntInfo(&(polyIntInfo[i]), numIntersectsFound,
-                               intersectionIndexList, 0.0);
+        fillOnePolyIntInfo(&(polyIntInfo[i]), d_gs->bb + i, g_gs, n2,
+                           intersectionIndexList);
         /*printOnePolyIntInfo(&(polyIntInfo[i])); */
-        d_list = d_list->next;
     }
     free(intersectionIndexList);
     return 0;
@@ -495,11 +498,164 @@ int testPolyIntInfo(PolyIntStruct * polyIntInfo)
     return 0;
 }
 
+/* state shared by the per-county sums of sum2Poly */
+typedef struct _SumJob {
+    GeomStore *gs;              /* data-weight-grid pieces */
+    GeomStore *g_gs;            /* grid cells */
+    BoundingBox *d_bb;          /* data polygon boxes */
+    PolyObject *d_poly;
+    PolyObject *w_poly;
+    PolyIntStruct *polyIntInfo;
+#ifdef OLD_SUM
+    double **sum;
+#endif
+    int *start;                 /* pieces of data poly c are */
+    int *piece;                 /* piece[start[c]..start[c+1]-1] */
+    int **list;                 /* grid cell index list for each thread */
+    int num_data_polys;
+    int num_grid_polys;
+    int attr_id;
+    int weight_val_type;
+    int weight_shp_type;
+    int use_weight_attr_value;
+} SumJob;
+
+
+/* ============================================================= */
+/* numerator share of data-weight-grid piece i */
+static double pieceValue(SumJob * job, int i)
+{
+    GeomStore *gs = job->gs;
+    PolyObject *w_poly = job->w_poly;
+    int w_idx = gs->top_p1[i];
+    int attr_id = job->attr_id;
+    double val, frac;
+#ifdef DEBUGCOUNTY
+    PolyObject *d_poly = job->d_poly;
+    int data_poly_idx = gs->top_p1_p2[i];
+    int grid_cell_idx = gs->top_p2[i];
+    char *countyid;
+#endif
+
+    if(job->use_weight_attr_value)
+    {
+        if(job->weight_val_type == FTInteger)
+        {
+            val = (double) (w_poly->attr_val[w_idx][attr_id].ival);
+        }
+        else if(job->weight_val_type == FTDouble)
+        {
+            val = w_poly->attr_val[w_idx][attr_id].val;
+        }
+        else                    /*it's a string */
+        {
+            val = 1.0;
+        }
+        if(job->weight_shp_type == SHPT_POINT)
+        {
+            if( storeNumContours(gs, i) > 1 )
+                frac = 0.0;
+            else
+                frac = val;
+        }
+        else if(job->weight_shp_type == SHPT_ARC)
+        {
+            /* the weight value * length in w-d-g poly / total weight length */
+            frac = val * storeLength(gs, i) / storeParentLength(gs, i);
+        }
+        else
+        {
+            /* the weight value * area of w-d-g int / total weight area */
+            frac = val * (storeArea(gs, i) / storeParentArea(gs, i));
+#ifdef DEBUGCOUNTY
+            countyid = (d_poly->attr_val[data_poly_idx][0]).str;
+            //fprintf(stderr, "sum2poly ctyid = %s\n", countyid);
+
+            if(countyid == debugcty)
+            {
+                fprintf(stderr,
+                        "sum2poly1: %d shape area = %lf, parentarea = %lf, gc=%d, frac=%.4lf\n",
+                        debugcty, storeArea(gs, i), storeParentArea(gs, i),
+                        grid_cell_idx, frac);
+            }
+#endif
+        }
+    }
+    else
+    {
+        if(job->weight_shp_type == SHPT_POINT)
+        {
+
+            if( storeNumContours(gs, i) > 1 )
+                frac = 0.0;
+            else
+                frac = 1.0;
+        }
+        else if(job->weight_shp_type == SHPT_ARC)
+        {
+            /* frac = length in w-d-g poly */
+            frac = storeLength(gs, i); /* why not an actual fraction? */
+        }
+        else
+        {               /* polygons */
+            /* frac = area of w-d-g poly */
+            frac = storeArea(gs, i); /* why not an actual fraction? */
+#ifdef DEBUGCOUNTY
+            countyid = (d_poly->attr_val[data_poly_idx][0]).str;
+            fprintf(stderr, "sum2poly ctyid = %s\n", countyid);
+            /* AME: why isn't the county id in the right range?!? */
+            if(countyid == debugcty)
+            {
+                fprintf(stderr,
+                 "sum2poly2: %d shape area = %lf, data poly = %d, gridcell=%d, frac=%.4lf\n",
+                        debugcty, storeArea(gs, i), data_poly_idx,
+                        grid_cell_idx, frac);
+            }
+#endif
+        }
+    }
+    return frac;
+}
+
+
+/* ============================================================= */
+/* find the grid cells data poly c may intersect and add up the numerators
+ * of its pieces, in the order the pieces were made, so the sums do not
+ * depend on the number of threads */
+static void sumCounty(void *arg, int c, int thread)
+{
+    SumJob *job = (SumJob *) arg;
+    GeomStore *gs = job->gs;
+    int i, k, grid_cell_idx;
+    double frac, oldVal;
+
+    fillOnePolyIntInfo(&(job->polyIntInfo[c]), job->d_bb + c, job->g_gs,
+                       job->num_grid_polys, job->list[thread]);
+    for(k = job->start[c]; k < job->start[c + 1]; k++)
+    {
+        i = job->piece[k];
+        grid_cell_idx = gs->top_p2[i];
+        frac = pieceValue(job, i);
+
+        /* replace sum with 1D array + helpers */
+#ifdef OLD_SUM
+        job->sum[c][grid_cell_idx] += frac;
+#endif
+        oldVal = getPolyIntValue(job->polyIntInfo, c, grid_cell_idx,
+                                 job->num_data_polys);
+        setPolyIntValue(job->polyIntInfo, c, grid_cell_idx,
+                        oldVal + frac, job->num_data_polys);
+    }
+}
+
+
 /* ============================================================= */
 
 /* Computes the numerator for the surrogate computation.  Sums an 
  * attribute based on data polygons with specified weights 
- * Modified by dyang: 01/2014, : to deduct point value in polygon hole */
+ * Modified by dyang: 01/2014, : to deduct point value in polygon hole
+ * The pieces are grouped by data polygon and each data polygon is summed
+ * as one task, on SURROGATE_THREADS threads. */
 
 int sum2Poly(PolyObject * dwg_poly, double ***psum, int *pnum_data_polys,
              int *pnum_grid_polys, int attr_id, PolyIntStruct ** polyIntInfoPtr,
@@ -507,24 +663,20 @@ int sum2Poly(PolyObject * dwg_poly, double ***psum, int *pnum_data_polys,
 {
     int i, j, num_dwg_polys;
     int num_data_polys, num_grid_polys;
-    PolyShape *ps;
-    PolyShapeList *plist;
-    PolyParent *pp;
+    int nthreads;
+    GeomStore *gs, *d_gs, *g_gs;
     PolyObject *d_poly;
     PolyObject *w_poly;
     PolyObject *wd_poly;
     PolyObject *g_poly;
-    double val;
-    int ival;
     int data_poly_idx;
     int grid_cell_idx;
     double **sum;
-    double oldVal;
-    double frac;
     PolyIntStruct *polyIntInfo; /* will be malloc'd for # of d_polys */
     int weight_val_type;
     int weight_shp_type;
-    char* countyid;
+    int *start, *piece, *fill;
+    SumJob job;
 
     inSum2Poly = 1;
     wd_poly = dwg_poly->parent_poly1;
@@ -540,15 +692,23 @@ int sum2Poly(PolyObject * dwg_poly, double ***psum, int *pnum_data_polys,
     if(num_data_polys < 0 || num_grid_polys < 0)
         return -1;
 
-    /* initialize the polyIntInfo structure with info about the intersection
-     * of the grid and data polygons */
+    /* the polyIntInfo structure gets info about the intersection of the
+     * grid and data polygons as each data polygon is summed */
     polyIntInfo =
-        (PolyIntStruct *) malloc(num_data_polys * sizeof(PolyIntStruct));
-    fillPolyIntInfo(polyIntInfo, d_poly, g_poly, num_data_polys,
-                    num_grid_polys);
+        (PolyIntStruct *) malloc(MAX(1, num_data_polys) * sizeof(PolyIntStruct));
     /* set the value of polyIntInfoPtr to polyIntInfo to pass back to caller */
     *polyIntInfoPtr = polyIntInfo;
 
+    d_gs = getGeomStore(d_poly);
+    g_gs = getGeomStore(g_poly);
+    gs = getGeomStore(dwg_poly);
+    if(polyIntInfo == NULL || d_gs == NULL || g_gs == NULL || gs == NULL)
+    {
+        WARN("Allocation error in Sum2Poly");
+        return 1;
+    }
+    num_dwg_polys = gs->nshapes;
+
 #ifdef OLD_SUM
     printf("num_data_polys malloc in sum2poly = %d %d\n", num_data_polys,
            num_data_polys * sizeof(double *));
@@ -603,140 +763,96 @@ int sum2Poly(PolyObject * dwg_poly, double ***psum, int *pnum_data_polys,
     //sprintf(mesg, "use weight attribute value = %d\n", use_weight_attr_value);
     //MESG(mesg);
 
-    num_dwg_polys = dwg_poly->nObjects;
-    //sprintf(mesg, "num data-weight-grid polys = %d\n", dwg_poly->nObjects);
-    //MESG(mesg);
-    /* TBD: cache the area / length of polys to prevent recomputing */
-    plist = dwg_poly->plist;
+    /* group the pieces by data polygon, keeping their order */
+    start = (int *) calloc(num_data_polys + 2, sizeof(int));
+    piece = (int *) malloc(MAX(1, num_dwg_polys) * sizeof(int));
+    if(start == NULL || piece == NULL)
+    {
+        WARN("Allocation error in Sum2Poly");
+        return 1;
+    }
     for(i = 0; i < num_dwg_polys; i++)
     {
-        ps = plist->ps;
-
-        /* find grid cell index */
-        grid_cell_idx = -1;
-        pp = plist->pp;
-        if(pp)
-        {
-            while(pp->p2->pp)
-            {
-                pp = pp->p2->pp;
-            }
-            grid_cell_idx = pp->p2->index;
-        }
-
-        /* find data poly index */
-        data_poly_idx = -1;
-        pp = plist->pp;
-        if(pp)
-        {
-            while(pp->p1->pp)
-            {
-                pp = pp->p1->pp;
-            }
-            data_poly_idx = pp->p2->index;
-        }
-
+        /* grid cell and data poly indices */
+        grid_cell_idx = gs->top_p2[i];
+        data_poly_idx = gs->top_p1_p2[i];
         if(data_poly_idx >= 0 && grid_cell_idx >= 0)
         {
-            if(use_weight_attr_value)
+            if(data_poly_idx >= num_data_polys)
             {
-                if(weight_val_type == FTInteger)
-                {
-                    val =
-                        (double) (w_poly->attr_val[pp->p1->index][attr_id].
-                                  ival);
-                }
-                else if(weight_val_type == FTDouble)
-                {
-                    val = w_poly->attr_val[pp->p1->index][attr_id].val;
-                }
-                else            /*it's a string */
-                {
-                    val = 1.0;
-                }
-                if(weight_shp_type == SHPT_POINT)
-                {
-                    if( ps->num_contours > 1 )
-                        frac = 0.0;
-                    else
-                        frac = val;
-                }
-                else if(weight_shp_type == SHPT_ARC)
-                {
-                    /* the weight value * length in w-d-g poly / total weight length */
-                    frac = val * PolyLength(ps) / PolyLength(pp->p1->ps);
-                }
-                else
-                {
-                    /* the weight value * area of w-d-g int / total weight area */
-                    frac = val * (PolyArea(ps) / PolyArea(pp->p1->ps));
-#ifdef DEBUGCOUNTY
-                    countyid = (d_poly->attr_val[data_poly_idx][0]).str;
-                    //fprintf(stderr, "sum2poly ctyid = %s\n", countyid);
-
-                    if(countyid == debugcty)
-                    {
-                        fprintf(stderr,
-                                "sum2poly1: %d shape area = %lf, parentarea = %lf, gc=%d, frac=%.4lf\n",
-                                debugcty, PolyArea(ps), PolyArea(pp->p1->ps),
-                                grid_cell_idx, frac);
-                    }
-#endif
-                }
+                WARN("couldn't find index in polyIntInfo");
             }
             else
             {
-                if(weight_shp_type == SHPT_POINT)
-                {
-
-                    if( ps->num_contours > 1 )
-                        frac = 0.0;
-                    else
-                        frac = 1.0;
-                }
-                else if(weight_shp_type == SHPT_ARC)
-                {
-                    /* frac = length in w-d-g poly */
-                    frac = PolyLength(ps); /* why not an actual fraction? */
-                }
-                else
-                {               /* polygons */
-                    /* frac = area of w-d-g poly */
-                    frac = PolyArea(ps); /* why not an actual fraction? */
-#ifdef DEBUGCOUNTY
-                    countyid = (d_poly->attr_val[data_poly_idx][0]).str;
-                    fprintf(stderr, "sum2poly ctyid = %s\n", countyid);
-                    /* AME: why isn't the county id in the right range?!? */
-                    if(countyid == debugcty)
-                    {
-                        fprintf(stderr,
-                         "sum2poly2: %d shape area = %lf, data poly = %d, gridcell=%d, frac=%.4lf\n",
-                                debugcty, PolyArea(ps), data_poly_idx,
-                                grid_cell_idx, frac);
-                    }
-#endif
-                }
+                start[data_poly_idx + 2]++;
             }
+        }
+    }
+    for(i = 2; i <= num_data_polys + 1; i++)
+    {
+        start[i] += start[i - 1];
+    }
+    /* start[c + 1] is where the pieces of c go while they are placed, and
+     * is the end of c's pieces afterwards */
+    fill = start + 1;
+    for(i = 0; i < num_dwg_polys; i++)
+    {
+        data_poly_idx = gs->top_p1_p2[i];
+        if(data_poly_idx >= 0 && data_poly_idx < num_data_polys &&
+           gs->top_p2[i] >= 0)
+        {
+            piece[fill[data_poly_idx]++] = i;
+        }
+    }
 
-            /* replace sum with 1D array + helpers */
+    nthreads = envThreads(ENVT_SURROGATE_THREADS);
+    if(nthreads > num_data_polys)
+    {
+        nthreads = MAX(1, num_data_polys);
+    }
+    job.gs = gs;
+    job.g_gs = g_gs;
+    job.d_bb = d_gs->bb;
+    job.d_poly = d_poly;
+    job.w_poly = w_poly;
+    job.polyIntInfo = polyIntInfo;
 #ifdef OLD_SUM
-            sum[data_poly_idx][grid_cell_idx] += frac;
+    job.sum = sum;
 #endif
-            oldVal = getPolyIntValue(polyIntInfo, data_poly_idx, grid_cell_idx,
-                                     num_data_polys);
-            if(oldVal == MISSING)
-            {
-                WARN("couldn't find index in polyIntInfo");
-            }
-            else
-            {
-                setPolyIntValue(polyIntInfo, data_poly_idx, grid_cell_idx,
-                                oldVal + frac, num_data_polys);
-            }
-
+    job.start = start;
+    job.piece = piece;
+    job.num_data_polys = num_data_polys;
+    job.num_grid_polys = num_grid_polys;
+    job.attr_id = attr_id;
+    job.weight_val_type = weight_val_type;
+    job.weight_shp_type = weight_shp_type;
+    job.use_weight_attr_value = use_weight_attr_value;
+    job.list = (int **) malloc(nthreads * sizeof(int *));
+    if(job.list == NULL)
+    {
+        WARN("Allocation error in Sum2Poly");
+        return 1;
+    }
+    for(j = 0; j < nthreads; j++)
+    {
+        job.list[j] = (int *) malloc(MAX(1, num_grid_polys) * sizeof(int));
+        if(job.list[j] == NULL)
+        {
+            WARN("Allocation error in Sum2Poly");
+            return 1;
         }
-        plist = plist->next;
     }
+    //sprintf(mesg, "num data-weight-grid polys = %d\n", dwg_poly->nObjects);
+    //MESG(mesg);
+    runTasks(num_data_polys, nthreads, sumCounty, &job);
+
+    for(j = 0; j < nthreads; j++)
+    {
+        free(job.list[j]);
+    }
+    free(job.list);
+    free(start);
+    free(piece);
 
 #ifdef DEBUG
     for(i = 0; i < num_data_polys; i++)
@@ -764,9 +880,8 @@ int avg1Poly(PolyObject * poly, double **pavg, int *pnum_data_polys,
 {
     int i, n;
     int num_data_polys;
-    PolyShape *ps;
-    PolyShapeList *plist;
-    PolyParent *pp;
+    int w_idx;
+    GeomStore *gs, *dgs;
     PolyObject *w_poly;
     PolyObject *d_poly;
     double val;
@@ -797,27 +912,21 @@ int avg1Poly(PolyObject * poly, double **pavg, int *pnum_data_polys,
         avg[i] = 0.0;
     }
 
-    n = poly->nObjects;  /* number of intersected objects */
-    plist = poly->plist;
+    gs = getGeomStore(poly);
+    dgs = getGeomStore(d_poly);
+    if(gs == NULL || dgs == NULL)
+    {
+        return 1;
+    }
+    n = gs->nshapes;  /* number of intersected objects */
 
     weight_val_type = w_poly->attr_hdr->attr_desc[attr_id]->type;
 
     /* loop over each intersected object */
     for(i = 0; i < n; i++)
     {
-        ps = plist->ps;
-
-        id = -1;
-        pp = plist->pp;
-
-        if(pp)
-        {
-            while(pp->p1->pp)
-            {
-                pp = pp->p1->pp;
-            }
-            id = pp->p2->index;
-        }
+        id = gs->top_p1_p2[i];
+        w_idx = gs->top_p1[i];
 
         if(id >= 0)
         {
@@ -828,12 +937,11 @@ int avg1Poly(PolyObject * poly, double **pavg, int *pnum_data_polys,
                 if(weight_val_type == FTInteger)
                 {
                     val =
-                        (double) (w_poly->attr_val[pp->p1->index][attr_id].
-                                  ival);
+                        (double) (w_poly->attr_val[w_idx][attr_id].ival);
                 }
                 else if(weight_val_type == FTDouble)
                 {
-                    val = w_poly->attr_val[pp->p1->index][attr_id].val;
+                    val = w_poly->attr_val[w_idx][attr_id].val;
                 }
                 /* else it's a string - let val be 1 */
                 else
@@ -842,7 +950,7 @@ int avg1Poly(PolyObject * poly, double **pavg, int *pnum_data_polys,
                 }
                 if(w_poly->nSHPType == SHPT_POINT)
                 {
-                    if( ps->num_contours > 1 )
+                    if( storeNumContours(gs, i) > 1 )
                         frac = 0.0;
                     else
                         frac = val;  /* frac is the weight value */
@@ -850,11 +958,11 @@ int avg1Poly(PolyObject * poly, double **pavg, int *pnum_data_polys,
                 /* AME -  don't bother to calc length or area if val is 0 */
                 else if((w_poly->nSHPType == SHPT_ARC) && (val != 0))
                 {
-                    frac = val * PolyLength(ps) / PolyLength(pp->p1->ps); 
+                    frac = val * storeLength(gs, i) / storeParentLength(gs, i); 
                 }
                 else /* is's a poly */ if (val != 0)
                 {
-                    frac = val * PolyArea(ps);
+                    frac = val * storeArea(gs, i);
                 }
             } 
             else /* don't use_weight_attr_value */
@@ -866,32 +974,29 @@ int avg1Poly(PolyObject * poly, double **pavg, int *pnum_data_polys,
                 }
                 else if(weight_shp_type == SHPT_ARC)
                 {
-                    frac = PolyLength(ps);
+                    frac = storeLength(gs, i);
                 }
                 else            /* polys */
                 {
-                    frac = PolyArea(ps);
+                    frac = storeArea(gs, i);
                 }
             }
             avg[id] += frac;
         }
-        plist = plist->next;
     }
-    plist = d_poly->plist;
     for(i = 0; i < num_data_polys; i++)
     {
-        ps = plist->ps;
         if(d_poly->nSHPType == SHPT_POINT)
         {
             frac = 1.0;
         }
         else if(d_poly->nSHPType == SHPT_ARC)
         {
-            frac = PolyLength(ps);
+            frac = storeLength(dgs, i);
         }
         else
         {
-            frac = PolyArea(ps);
+            frac = storeArea(dgs, i);
         }
         if(frac != 0.0)
         {
@@ -902,7 +1007,6 @@ int avg1Poly(PolyObject * poly, double **pavg, int *pnum_data_polys,
         {
             WARN("Division by zero attempt in Avg1Poly. Normalization ignored.");
         }
-        plist = plist->next;
     }
 
     return 0;
@@ -1175,25 +1279,27 @@ int discreteCentroid(PolyObject *poly, int **cent, int *pn1, int attr_id)
 
 
 
-/*This subroutine will return area percent for each type in the attribute*/
-int typeAreaPercent(PolyObject * poly, double ***psum, double *gridA, int attr_id, int numTypes, char ***list)
+/* This subroutine will return area percent for each type in the attribute.
+ * The weight shapes' values are dictionary encoded (encodeAttrTypes), so
+ * each fragment finds its type by index.  Only the (type, grid) pairs
+ * that occur are kept: the fragments are sorted by grid and then by type,
+ * keeping their list order within a pair so the sums are added in the
+ * same order as a dense [type][grid] accumulation. */
+int typeAreaPercent(PolyObject * poly, TypeAreaMap **pmap, double *gridA, int attr_id)
 {
-    int i, j,n;
+    int i, j, k, n, nfrag, numTypes;
     int n1, id_w, id_d;
     PolyShape *ps;
     PolyShapeList *plist;
     PolyParent *pp;
     PolyObject *w_poly;
     PolyObject *d_poly;
-    double douVal;
-    int intVal;
-    char strVal[50];  
-    double **sum;  /*sum for all grid and all types [type][grid]*/
     double gridArea,typeArea;
     int weight_val_type;
-    int data_val_type;
     int weight_shp_type;
-    char ** list_array;  /*types of a variable list*/
+    int *fcell, *ftype, *count, *order, *sorted;
+    double *ffrac;
+    TypeAreaMap *map;
     extern char *prog_name;
 
 
@@ -1201,35 +1307,18 @@ int typeAreaPercent(PolyObject * poly, double ***psum, double *gridA, int attr_i
     d_poly = poly->parent_poly2;        /* e.g. polygon shapes such as grids -- output shapes*/
    
     n1 = d_poly->nObjects;      /* e.g. # of grids */
-  
-    list_array = *list;     /*get attribute type list array*/
+    *pmap = NULL;
 
     if(n1 < 0)
         return -1;
-    
-    /*allocate memory for each type*/
-    *psum = sum = (double **) malloc(numTypes * sizeof(double *));
-    if(!sum)
+
+    numTypes = encodeAttrTypes(w_poly, attr_id);
+    if(numTypes < 0)
     {
         WARN("Allocation error 1 in typeAreaPercent");
         return 1;
     }
     
-    /*allocate memory for all grids in each type*/
-    for(i = 0; i < numTypes; i++)
-    {        
-        sum[i] = (double *) malloc(n1 * sizeof(double));
-        if(!sum[i])
-        {
-            WARN("Allocation error 2 in typeAreaPercent");
-            return 2;
-        }
-        for(j = 0; j < n1; j++)
-        {
-            sum[i][j] = 0.0;
-        }
-    }
-    
     /* weight value type is int, double or string */
     weight_val_type = w_poly->attr_hdr->attr_desc[attr_id]->type;
     if(weight_val_type == FTInteger)
@@ -1252,12 +1341,25 @@ int typeAreaPercent(PolyObject * poly, double ***psum, double *gridA, int attr_i
     sprintf(mesg, "num data polys = %d num weight-data ojects = %d\n", n1, n);
     MESG(mesg);
 
+    fcell = (int *) malloc(MAX(1, n) * sizeof(int));
+    ftype = (int *) malloc(MAX(1, n) * sizeof(int));
+    ffrac = (double *) malloc(MAX(1, n) * sizeof(double));
+    order = (int *) malloc(MAX(1, n) * sizeof(int));
+    sorted = (int *) malloc(MAX(1, n) * sizeof(int));
+    count = (int *) malloc((MAX(n1, numTypes) + 1) * sizeof(int));
+    map = (TypeAreaMap *) malloc(sizeof(TypeAreaMap));
+    if(!fcell || !ftype || !ffrac || !order || !sorted || !count || !map)
+    {
+        WARN("Allocation error 2 in typeAreaPercent");
+        return 2;
+    }
+
    /*go through each poly in the intersected polygons*/
+    nfrag = 0;
     plist = poly->plist;
     for(i = 0; i < n; i++)
     {
         ps = plist->ps;         /* the intersected weight-data polygon */
-	typeArea = PolyArea(ps);
         id_w = -1;        
 	id_d = -1;
         pp = plist->pp;         /* the parent poly */
@@ -1277,47 +1379,112 @@ int typeAreaPercent(PolyObject * poly, double ***psum, double *gridA, int attr_i
         /* determine the area of the attribute type*/ 
         if(id_d >= 0 && id_w >=0)
         {
+	    typeArea = PolyArea(ps);
             *gridA = gridArea = PolyArea(pp->p2->ps);
-            /*printf("typeAreaPercent: gridArea=%lf.5\n", gridArea);*/
-           
-            /* get the attribute of the weight */
-	    if (weight_val_type == FTInteger)
+            fcell[nfrag] = id_d;
+            ftype[nfrag] = w_poly->type_code[id_w];
+            ffrac[nfrag] = typeArea/gridArea;
+            nfrag++;
+        }
+        plist = plist->next;
+    }
+
+    /* stable counting sort by grid, then by type */
+    for(j = 0; j <= n1; j++)
+        count[j] = 0;
+    for(k = 0; k < nfrag; k++)
+        count[fcell[k] + 1]++;
+    for(j = 0; j < n1; j++)
+        count[j + 1] += count[j];
+    for(k = 0; k < nfrag; k++)
+        order[count[fcell[k]]++] = k;
+
+    for(j = 0; j <= numTypes; j++)
+        count[j] = 0;
+    for(k = 0; k < nfrag; k++)
+        count[ftype[k] + 1]++;
+    for(j = 0; j < numTypes; j++)
+        count[j + 1] += count[j];
+    for(k = 0; k < nfrag; k++)
+        sorted[count[ftype[order[k]]]++] = order[k];
+
+    /* add up the fragments of each (type, grid) pair */
+    map->ntypes = numTypes;
+    map->ncells = n1;
+    map->type_start = (int *) malloc((numTypes + 1) * sizeof(int));
+    map->cell = (int *) malloc(MAX(1, nfrag) * sizeof(int));
+    map->frac = (double *) malloc(MAX(1, nfrag) * sizeof(double));
+    if(!map->type_start || !map->cell || !map->frac)
+    {
+        WARN("Allocation error 3 in typeAreaPercent");
+        return 3;
+    }
+    j = 0;
+    k = 0;
+    for(i = 0; i < numTypes; i++)
+    {
+        map->type_start[i] = j;
+        for(; k < nfrag && ftype[sorted[k]] == i; k++)
+        {
+            if(j > map->type_start[i] && map->cell[j - 1] == fcell[sorted[k]])
             {
-              intVal = w_poly->attr_val[id_w][attr_id].ival; 
-              sprintf(strVal, "%d", intVal);
+                map->frac[j - 1] += ffrac[sorted[k]];
             }
-            else if (weight_val_type == FTDouble)
+            else
             {
-              douVal = w_poly->attr_val[id_w][attr_id].val; 
-              sprintf(strVal, "%lf", douVal);
+                map->cell[j] = fcell[sorted[k]];
+                map->frac[j] = 0.0 + ffrac[sorted[k]];
+                j++;
             }
-            else if (weight_val_type == FTString)
-            {
-              sprintf(strVal,"%s",w_poly->attr_val[id_w][attr_id].str); 
-            } 
-		    
-            /*get index to the type in type list*/
-	    for(j=0; j<numTypes;j++)
-            {
-              if(strcmp(strVal,list_array[j])==0)
-              {
-                break;
-              }
-            }	    
-	    sum[j][id_d] += typeArea/gridArea;
         }
-        plist = plist->next;
     }
-
-
-    /*print out the area for each type*/
-    /*for (i=0;i<numTypes;i++)
-    {	   
-      for(j = 0; j < n1; j++)
-      {
-        printf(" typeAreaPercent type=%d  poly=%d  typePercent=%f\n", i,j, sum[i][j]);
-      }
-    }*/
+    map->type_start[numTypes] = j;
+
+    free(fcell);
+    free(ftype);
+    free(ffrac);
+    free(order);
+    free(sorted);
+    free(count);
+
+    *pmap = map;
+    sprintf(mesg, "type area fractions kept = %d of %d types x %d data polys\n",
+            j, numTypes, n1);
+    MESG(mesg);
       
 return 0;
 }
+
+
+/* ============================================================= */
+/* area fraction of one type in every data polygon */
+void typeAreaColumn(TypeAreaMap *map, int type, double *col)
+{
+    int i;
+
+    for(i = 0; i < map->ncells; i++)
+    {
+        col[i] = 0.0;
+    }
+    if(type < 0 || type >= map->ntypes)
+    {
+        return;
+    }
+    for(i = map->type_start[type]; i < map->type_start[type + 1]; i++)
+    {
+        col[map->cell[i]] = map->frac[i];
+    }
+}
+
+
+/* ============================================================= */
+void freeTypeAreaMap(TypeAreaMap *map)
+{
+    if(map != NULL)
+    {
+        free(map->type_start);
+        free(map->cell);
+        free(map->frac);
+        free(map);
+    }
+}
@@ -10,6 +10,7 @@
 
 #include <stdio.h>
 #include <stdlib.h> 
+#include <stdarg.h>
 #include <string.h>
 #include <math.h>
 
@@ -18,6 +19,369 @@
 #include "mims_evs.h"
 #include "parms3.h"
 #include "io.h"
+#include "srgbin.h"
+
+/* counties whose surrogate lines are made together before they are written */
+#define SRG_REPORT_BATCH 512
+
+/* growable text */
+typedef struct _SrgText {
+  char *s;
+  size_t len;
+  size_t cap;
+} SrgText;
+
+/* a surrogate of a run of counties, for the binary file and grid sums */
+typedef struct _SrgRec {
+  int j;          /* grid cell or output polygon */
+  double a;       /* numerator */
+  int col, row;
+  double frac;
+  int bin;        /* written to the binary file */
+} SrgRec;
+
+/* consecutive data polygons with the same id and a denominator: the
+ * lines, messages and records reportSurrogate writes for them */
+typedef struct _SrgGroup {
+  int first, last;   /* data polygons first..last-1 */
+  char id[80];
+  int remainder;     /* a #REMAINDER line follows the group */
+  SrgText out;       /* lines for the surrogate file */
+  SrgText log;       /* messages, each a type (M, W or V), text and '\0' */
+  SrgRec *rec;
+  int nrec, maxrec;
+} SrgGroup;
+
+/* what the groups of one attribute share */
+typedef struct _ReportJob {
+  PolyObject *d_poly, *g_poly;
+  PolyIntStruct *polyIntInfo;
+  double *denom;
+  SrgGroup *group;
+  int attr_num;
+  int ncols;
+  int outIDType;
+  int isGrid, isEGrid, isPolygon;
+  int output_qa;     /* qa sum, numerator or denominator comments */
+  double denomThreshold;
+} ReportJob;
+
+
+/* ============================================================= */
+/* make room for n more characters and the '\0' */
+static void textGrow(SrgText *t, size_t n)
+{
+  if (t->len + n + 1 > t->cap)
+  {
+    t->cap = 2 * (t->len + n + 1) + 4096;
+    t->s = (char *) realloc(t->s, t->cap);
+    if (t->s == NULL)
+    {
+      ERROR("reportSurrogate", "Cannot allocate space for the surrogates",2);
+    }
+  }
+}
+
+
+/* ============================================================= */
+static void textPut(SrgText *t, const char *s, size_t n)
+{
+  textGrow(t, n);
+  memcpy(t->s + t->len, s, n);
+  t->len += n;
+  t->s[t->len] = '\0';
+}
+
+
+/* ============================================================= */
+static void textPrintf(SrgText *t, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  textGrow(t, 255);
+  for (;;)
+  {
+    va_start(ap, fmt);
+    n = vsnprintf(t->s + t->len, t->cap - t->len, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+    {
+      ERROR("reportSurrogate", "Cannot format a surrogate line",2);
+    }
+    if ((size_t) n < t->cap - t->len)
+    {
+      t->len += n;
+      return;
+    }
+    textGrow(t, n);
+  }
+}
+
+
+/* ============================================================= */
+/* keep a message of type M (MESG), W (WARN) or V (surrogate out of range)
+ * to be issued when the group is written */
+static void logText(SrgGroup *g, char type, const char *s, size_t n)
+{
+  textPut(&g->log, &type, 1);
+  textPut(&g->log, s, n);
+  textPut(&g->log, "", 1);
+}
+
+
+/* ============================================================= */
+static void addRec(SrgGroup *g, int j, double a, int col, int row,
+   double frac, int bin)
+{
+  SrgRec *r;
+
+  if (g->nrec == g->maxrec)
+  {
+    g->maxrec = 2 * g->maxrec + 64;
+    g->rec = (SrgRec *) realloc(g->rec, g->maxrec * sizeof(SrgRec));
+    if (g->rec == NULL)
+    {
+      ERROR("reportSurrogate", "Cannot allocate space for the surrogates",2);
+    }
+  }
+  r = &g->rec[g->nrec++];
+  r->j = j;
+  r->a = a;
+  r->col = col;
+  r->row = row;
+  r->frac = frac;
+  r->bin = bin;
+}
+
+
+/* ============================================================= */
+static void dataPolyId(PolyObject *d_poly, int attrtype, int i, char *id)
+{
+  id[0] = '\0';
+  if (attrtype == FTInteger) {
+    sprintf(id,"%d",d_poly->attr_val[i][0].ival);
+  }
+  else if (attrtype == FTString) {
+    sprintf(id,"%s",d_poly->attr_val[i][0].str);
+  }
+  else {
+    sprintf(id,"poly%d",i);
+  }
+}
+
+
+/* ============================================================= */
+/* Make the surrogate lines of group t: the fraction of each grid cell or
+ * output polygon with a nonzero numerator, in cell order, with the running
+ * qa sum over the group, and the #REMAINDER line for the part of the group
+ * outside the output.  Nothing here is shared with other groups, so the
+ * groups can be made on any number of threads; the lines are written in
+ * county order by reportSurrogate. */
+static void reportGroup(void *arg, int t, int thread)
+{
+  ReportJob *job = (ReportJob *) arg;
+  SrgGroup *g = job->group + t;
+  char *data_poly_id = g->id;
+  int attr_num = job->attr_num;
+  int ncols = job->ncols;
+  PolyIntStruct *pi;
+  double frac, a, b, last_b, sum_a = 0.0, qasum = 0.0;
+  int i, j, k, polyID, written, warned = 0;
+  int lastcol = 0, lastrow = 0;
+  size_t at;
+  char out_poly_id[80];
+  char qasum_str[400];
+  char numerator_str[400];
+  char denominator_str[400];
+  char mesg[256];
+
+  g->out.len = 0;
+  g->log.len = 0;
+  g->nrec = 0;
+  last_b = job->denom[g->first];
+
+  for (i = g->first; i < g->last; i++)
+  {
+    if ((b = job->denom[i]) == 0.0) continue;
+
+    /* only the cells the data polygon may intersect have a numerator */
+    pi = job->polyIntInfo + i;
+    for (k = 0; k < pi->numIntersections; k++)
+    {
+      a = pi->intValues[k];
+      if (a == 0.0) continue;
+      j = pi->intIndices[k];
+
+      /*get polygon id*/
+      if (job->isPolygon)
+      {
+        out_poly_id[0] = '\0';
+        if (job->outIDType == FTInteger) {
+          sprintf(out_poly_id,"%d",job->g_poly->attr_val[j][0].ival);
+        }
+        else if (job->outIDType == FTString) {
+          sprintf(out_poly_id,"%s",job->g_poly->attr_val[j][0].str);
+        }
+        else {
+          sprintf(out_poly_id,"poly%d",j);
+        }
+      }
+
+      frac = a/b; /* a = val(k), b is known above */
+      if (!warned && ((frac <=0.0) || (frac > 1.0)))
+      {
+        logText(g, 'V', "", 0);
+        warned = 1;
+      }
+
+      qasum += frac;
+      sprintf(qasum_str,"\t%lf",qasum);
+      sprintf(numerator_str,"\t%lf",a);
+      sum_a += a;
+      sprintf(denominator_str,"\t%lf",b);
+
+      if (job->isGrid)
+      {
+        if (!job->isEGrid)
+        {
+          lastcol = j%ncols + 1;
+          lastrow = j/ncols + 1;
+        }
+        else
+        {
+          polyID = job->g_poly->attr_val[j][0].ival;
+          lastcol = (polyID-1)%ncols + 1;
+          lastrow = (polyID-1)/ncols + 1;
+        }
+      }
+      written = (b >= job->denomThreshold && strlen(data_poly_id) >= 1);
+
+      at = g->out.len;
+      if (job->output_qa)
+      {
+        if (job->isGrid)
+        {
+          if (written)
+          {
+            textPrintf(&g->out,"%5d\t%s\t%5d\t%5d\t%10.8lf\t!%s%s%s\n",
+               attr_num, data_poly_id, lastcol, lastrow,frac,
+               numerator_str, denominator_str, qasum_str);
+          }
+          else
+          {
+            textPrintf(&g->out,
+               "#SKIPPED %5d\t%s\t%5d\t%5d\t%10.8lf\t!%s%s%s\n",attr_num,
+               data_poly_id, lastcol, lastrow,frac,
+               numerator_str, denominator_str, qasum_str);
+            logText(g, 'M', g->out.s + at, g->out.len - at);
+          }
+        }
+        else if (job->isPolygon)
+        {
+          if (written)
+          {
+            textPrintf(&g->out,"%5d\t%s\t%s\t%10.8lf\t!%s%s%s\n",
+               attr_num, data_poly_id, out_poly_id, frac,
+               numerator_str, denominator_str, qasum_str);
+          }
+          else
+          {
+            textPrintf(&g->out,"#SKIPPED %5d\t%s\t%s\t%10.8lf\t!%s%s%s\n",
+               attr_num, data_poly_id, out_poly_id, frac,
+               numerator_str, denominator_str, qasum_str);
+            logText(g, 'M', g->out.s + at, g->out.len - at);
+          }
+        }
+      }  /*output with QA*/
+      else /* just output the basic surrogate*/
+      {
+        if (job->isGrid)
+        {
+          if (written)
+          {
+            textPrintf(&g->out,"%5d\t%s\t%5d\t%5d\t%10.8lf\n",
+               attr_num, data_poly_id, lastcol, lastrow, frac);
+          }
+          else
+          {
+            textPrintf(&g->out,"#SKIPPED %5d\t%s\t%5d\t%5d\t%10.8lf\n",
+               attr_num, data_poly_id, lastcol, lastrow, frac);
+            logText(g, 'M', g->out.s + at, g->out.len - at);
+          }
+        }
+        else if (job->isPolygon)
+        {
+          if (written)
+          {
+            textPrintf(&g->out,"%5d\t%s\t%s\t%10.8lf\n",
+               attr_num, data_poly_id, out_poly_id, frac);
+          }
+          else
+          {
+            textPrintf(&g->out,"#SKIPPED %5d\t%s\t%s\t%10.8lf\n",
+               attr_num, data_poly_id, out_poly_id, frac);
+            logText(g, 'M', g->out.s + at, g->out.len - at);
+          }
+        }
+      } /*end no QA output*/
+
+      addRec(g, j, a, lastcol, lastrow, frac, job->isGrid && written);
+    }  /* for (k = 0; k < pi->numIntersections; k++) */
+  }  /* for (i = g->first; i < g->last; i++) */
+
+  /* the part of the data polygon that is missing from the output, written
+   * when the next county starts */
+  frac = 1.0 - qasum;
+  if (!g->remainder || fabs(frac) <= 0.00001 || qasum <= 0.00001 ||
+      strlen(data_poly_id) < 1)
+  {
+    return;
+  }
+  at = g->out.len;
+  if (job->output_qa)
+  {
+    sprintf(mesg,"QA sum for attr %d, county %s was %.4lf not 1; last c,r=%d,%d",
+       attr_num, data_poly_id, qasum, lastcol, lastrow);
+    logText(g, 'W', mesg, strlen(mesg));
+
+    sprintf(qasum_str,"\t%lf",1-qasum);
+    /* AME: changed str to 1-qasum to show remainder */
+    sprintf(numerator_str,"\t%lf",last_b-sum_a);
+    sprintf(denominator_str,"\t%lf",last_b);
+
+    if (job->isGrid)
+    {
+      textPrintf(&g->out,"#REMAINDER %5d\t%s\t%5d\t%5d\t%10.8lf\t!%s%s%s\n",
+         attr_num, data_poly_id, 0, 0,frac,
+         numerator_str, denominator_str, qasum_str);
+    }
+    else if (job->isPolygon)
+    {
+      textPrintf(&g->out,"#REMAINDER %5d\t%s\t%s\t%10.8lf\t!%s%s%s\n",
+         attr_num, data_poly_id, "0", frac,
+         numerator_str, denominator_str, qasum_str);
+    }
+  }
+  else
+  {
+    if (job->isGrid)
+    {
+      textPrintf(&g->out,"#REMAINDER %5d\t%s\t%5d\t%5d\t%10.8lf\n",
+         attr_num, data_poly_id, 0, 0,frac);
+    }
+    else if (job->isPolygon)
+    {
+      textPrintf(&g->out,"#REMAINDER %5d\t%s\t%s\t%10.8lf\n",
+         attr_num, data_poly_id, "0", frac);
+    }
+  }
+  if (g->out.len > at)
+  {
+    logText(g, 'M', g->out.s + at, g->out.len - at);
+  }
+}
+
 
 /* ============================================================= */
 /* main routine for computing emission surrogates.  Weight polygons 
@@ -32,17 +396,14 @@ int reportSurrogate(PolyObject *wdg_poly, char *ename, int use_weight_val,
 {
   double **num;
   double *denom;
-  double frac, a, b, last_b, sum_a=0.0;
   int n1, n2, d1;
-  int i, j;
+  int i, j, k;
   /* weight, data, and grid polygons, plus intersected weight & data polys */  
   PolyObject *wd_poly, *d_poly, *g_poly, *w_poly;
   int attrtype;
   int outIDType;
-  int ncols,polyID;
+  int ncols;
   char data_poly_id[80];
-  char out_poly_id[80];
-  char msg[100];
   int attr_id;   /* loop index */
   int attr_num;  /* written to output file */
 
@@ -54,22 +415,24 @@ int reportSurrogate(PolyObject *wdg_poly, char *ename, int use_weight_val,
   int output_numerator;
   int output_denominator;
   int valuesOK = 1;
-  int lastrow = 0;
-  int lastcol = 0;
-  double qasum = 0.0;
   double *num_gridsum = NULL;
 
   extern char *prog_name;
-  char qasum_str[20];  
-  char numerator_str[20];  
-  char denominator_str[20];  
   char fname[100];
-  char last_data_poly_id[80];
   PolyIntStruct *polyIntInfo;
-  char mesg[256];
+  char mesg[512];
   char outputType[100];
   char denomThreshold_s[100];
   double  denomThreshold = 0.00001;  /*default denominator threshold for surrogate ratio computation*/
+  char binFname[256];
+  SrgBin *sbin = NULL;   /* binary copy of the surrogates, if requested */
+
+  /* runs of data polygons, made on nthreads threads */
+  ReportJob job;
+  SrgGroup *group, *g;
+  SrgRec *r;
+  int ngroup, first, nbatch, nthreads;
+  char *p;
 
   /* retrieve name of and open output file for surrogates */  
   if (ename == NULL) {
@@ -96,6 +459,25 @@ int reportSurrogate(PolyObject *wdg_poly, char *ename, int use_weight_val,
     goto error;
   }
 
+  /* the surrogates are also collected for a binary file if requested */
+  if(getEnvtValue(ENVT_SURROGATE_BINARY_FILE, binFname) &&
+     strcmp(binFname, "") && strcmp(binFname, "NONE"))
+  {
+    if(strcmp(outputType, "RegularGrid")==0 || strcmp(outputType, "EGrid")==0)
+    {
+      sbin = newSrgBin();
+      if (sbin == NULL)
+      {
+        ERROR("reportSurrogate",
+           "Cannot allocate space for the binary surrogates",2);
+      }
+    }
+    else
+    {
+      WARN("SURROGATE_BINARY_FILE is only written for RegularGrid and EGrid output");
+    }
+  }
+
   /*set denominator threshold for surrogate ratio computation*/
   if(!getEnvtValue(ENVT_DENOMINATOR_THRESHOLD,denomThreshold_s))
   {
@@ -164,19 +546,6 @@ int reportSurrogate(PolyObject *wdg_poly, char *ename, int use_weight_val,
   }
 
   
-  /* initialize strings if they won't be updated */  
-  if (!output_qasum) 
-  {
-     strcpy(qasum_str,"");
-  }
-  if (!output_numerator) 
-  {
-     strcpy(numerator_str,"");
-  }
-  if (!output_denominator) 
-  {
-     strcpy(denominator_str,"");
-  }
   if (strcmp(outputGridFileName,"") != 0)
   {
      num_gridsum = (double *)malloc(g_poly->nObjects*sizeof(double));
@@ -187,7 +556,7 @@ int reportSurrogate(PolyObject *wdg_poly, char *ename, int use_weight_val,
      }
   }
   
-  for (j = 0; j < g_poly->nObjects; j++)
+  for (j = 0; num_gridsum != NULL && j < g_poly->nObjects; j++)
   { 
      num_gridsum[j] = 0.0;
   }
@@ -241,12 +610,32 @@ int reportSurrogate(PolyObject *wdg_poly, char *ename, int use_weight_val,
       outIDType = FTInvalid;
     }
   }
+
+  /* what the runs of data polygons share for every attribute */
+  nthreads = envThreads(ENVT_SURROGATE_THREADS);
+  group = (SrgGroup *) calloc(MAX(1, d_poly->nObjects), sizeof(SrgGroup));
+  if (group == NULL)
+  {
+    ERROR("reportSurrogate",
+       "Cannot allocate space for the surrogates",2);
+  }
+  memset(&job, 0, sizeof(ReportJob));
+  job.d_poly = d_poly;
+  job.g_poly = g_poly;
+  job.outIDType = outIDType;
+  job.isGrid = (strcmp(outputType, "RegularGrid")==0 || strcmp(outputType, "EGrid")==0);
+  job.isEGrid = (strcmp(outputType, "EGrid")==0);
+  job.isPolygon = (strcmp(outputType, "Polygon")==0);
+  job.output_qa = (output_qasum || output_numerator || output_denominator);
+  job.denomThreshold = denomThreshold;
+  ncols = 0;
  
   /* loop over all requested attributes for weight polygons */    
   for (attr_id=0; attr_id < w_poly->attr_hdr->num_attr ;attr_id++) 
   {    
     /* compute the numerator for the surrogate fraction */    
     MESG("Compute numerator\n");
+    statsBegin("sum");
 #ifdef OLD_SUM  
     if (sum2Poly(wdg_poly, &num, &n1, &n2, attr_id) !=0 ) return 1;
 #else    
@@ -255,6 +644,7 @@ int reportSurrogate(PolyObject *wdg_poly, char *ename, int use_weight_val,
     /* compute the denominator for the surrogate fraction */    
     MESG("Compute denominator\n");
     if (sum1Poly(wd_poly, &denom, &d1, attr_id, use_weight_val) !=0 ) return 2;
+    statsEnd("sum");
     
     attr_num = w_poly->attr_hdr->attr_desc[attr_id]->category;
     
@@ -267,278 +657,86 @@ int reportSurrogate(PolyObject *wdg_poly, char *ename, int use_weight_val,
       ncols = g_poly->map->ncols;
     }
          
-    last_data_poly_id[0] = '\0';
-
+    /* group the data polygons with a denominator into runs with the same
+     * id; a run shares one qa sum and #REMAINDER line */
+    ngroup = 0;
     for (i=0; i<n1; i++) 
     {
-      if ((b=denom[i]) != 0.0) {
-        data_poly_id[0] = '\0';
-        if (attrtype == FTInteger) {
-          sprintf(data_poly_id,"%d",d_poly->attr_val[i][0].ival);
-        }
-        /*else if (d_poly->attr_hdr->attr_desc[0]->type == FTString) {*/
-        else if (attrtype == FTString) {
-          sprintf(data_poly_id,"%s",d_poly->attr_val[i][0].str);
-        }
-        else {
-          sprintf(data_poly_id,"poly%d",i);
+      if (denom[i] == 0.0) continue;
+      dataPolyId(d_poly, attrtype, i, data_poly_id);
+      if (ngroup == 0 || strcmp(data_poly_id, group[ngroup-1].id))
+      {
+        group[ngroup].first = i;
+        strcpy(group[ngroup].id, data_poly_id);
+        group[ngroup].remainder = 1;
+        ngroup++;
+      }
+      group[ngroup-1].last = i + 1;
+    }
+    /* the remainder of a run is written when the next run starts */
+    if (ngroup > 0)
+    {
+      group[ngroup-1].remainder = 0;
+    }
+
+    job.polyIntInfo = polyIntInfo;
+    job.denom = denom;
+    job.attr_num = attr_num;
+    job.ncols = ncols;
+
+    /* make the lines of a batch of runs, one run per task, and write them
+     * in county order */
+    for (first = 0; first < ngroup; first += SRG_REPORT_BATCH)
+    {
+      nbatch = ngroup - first < SRG_REPORT_BATCH ? ngroup - first : SRG_REPORT_BATCH;
+      job.group = group + first;
+      runTasks(nbatch, nthreads, reportGroup, &job);
+
+      for (k = first; k < first + nbatch; k++)
+      {
+        g = &group[k];
+        if (g->out.len > 0)
+        {
+          fwrite(g->out.s, 1, g->out.len, sfile);
         }
-        
-        /* check to see if the current data poly id (for denominator is 
-         * the same as the previous one.  If not, reset the qa sum */
-        if (strcmp(data_poly_id, last_data_poly_id)) 
+        for (p = g->log.s; p != NULL && p < g->log.s + g->log.len; p += strlen(p) + 1)
         {
-          frac = 1.0 - qasum;   /*missing percentage in a data polygon*/
-          //fprintf(sfile,"QA sum for attr %d, county %s was %.4lf not 1; last c,r=%d,%d,%d\n",
-          //       attr_num, last_data_poly_id, qasum, lastcol, lastrow, n1);
-
-
-          if ( fabs(frac) > 0.00001 && qasum > 0.00001 )
-          {   
-            if (strlen(last_data_poly_id) >= 1)
-            {            
-              if (output_qasum || output_numerator || output_denominator)
-              {         
-                /*change****************************************************/
-                sprintf(mesg,"QA sum for attr %d, county %s was %.4lf not 1; last c,r=%d,%d",
-                   attr_num, last_data_poly_id, qasum, lastcol, lastrow);             
-                WARN(mesg);
-      
-                sprintf(qasum_str,"\t%lf",1-qasum);
-                /* AME: changed str to 1-qasum to show remainder */
-                qasum = 1.0;
-                sprintf(numerator_str,"\t%lf",last_b-sum_a);
-                sprintf(denominator_str,"\t%lf",last_b);
-
-                if(strcmp(outputType, "RegularGrid")==0 || strcmp(outputType, "EGrid")==0)
-                {
-                   lastcol = 0;
-                   lastrow = 0;         
-                   fprintf(sfile,"#REMAINDER %5d\t%s\t%5d\t%5d\t%10.8lf\t!%s%s%s\n",
-                       attr_num, last_data_poly_id, lastcol, lastrow,frac,
-                       numerator_str, denominator_str, qasum_str);
-                   sprintf(mesg,"#REMAINDER %5d\t%s\t%5d\t%5d\t%10.8lf\t!%s%s%s\n",
-                       attr_num, last_data_poly_id, lastcol, lastrow,frac,
-                       numerator_str, denominator_str, qasum_str);
-                   MESG(mesg);
-                }
-                else if (strcmp(outputType, "Polygon")==0)
-                {
-                   sprintf(out_poly_id,"0");    
-                   fprintf(sfile,"#REMAINDER %5d\t%s\t%s\t%10.8lf\t!%s%s%s\n",
-                      attr_num, last_data_poly_id, out_poly_id, frac,
-                      numerator_str, denominator_str, qasum_str);
-                   sprintf(mesg,"#REMAINDER %5d\t%s\t%s\t%10.8lf\t!%s%s%s\n",
-                      attr_num, last_data_poly_id, out_poly_id, frac,
-                      numerator_str, denominator_str, qasum_str);
-                   MESG(mesg);
-                }
-              }
-              else
-              {
-                 if(strcmp(outputType, "RegularGrid")==0 || strcmp(outputType, "EGrid")==0)
-                 {
-                   lastcol = 0;
-                   lastrow = 0;         
-                   fprintf(sfile,"#REMAINDER %5d\t%s\t%5d\t%5d\t%10.8lf\n",
-                           attr_num, last_data_poly_id, lastcol, lastrow,frac);
-                   sprintf(mesg,"#REMAINDER %5d\t%s\t%5d\t%5d\t%10.8lf\n",
-                           attr_num, last_data_poly_id, lastcol, lastrow,frac);
-                   MESG(mesg);
-                 }
-                 else if (strcmp(outputType, "Polygon")==0)
-                 {
-                   sprintf(out_poly_id,"0");    
-                   fprintf(sfile,"#REMAINDER %5d\t%s\t%s\t%10.8lf\n",
-                      attr_num, last_data_poly_id, out_poly_id, frac);
-                   sprintf(mesg,"#REMAINDER %5d\t%s\t%s\t%10.8lf\n",
-                      attr_num, last_data_poly_id, out_poly_id, frac);
-                   MESG(mesg);
-                 }                  
-              }         
-            }
+          if (*p == 'M')
+          {
+            MESG(p + 1);
+          }
+          else if (*p == 'W')
+          {
+            WARN(p + 1);
+          }
+          else if (valuesOK)
+          {
+            sprintf(mesg,
+               "At least one surrogate for attribute %d, data polygon %s is not between 0 and 1\n",
+               attr_num, g->id);
+            WARN(mesg);
+            valuesOK = 0;                  
           }
-          qasum=0.0;
-          strcpy(last_data_poly_id,data_poly_id);
-          sum_a = 0.0;
-          last_b = b;
         }
-       
-        
-        /* loop over grid cells */
-        for (j=0; j<n2; j++) 
+        for (j = 0; j < g->nrec; j++)
         {
-       
-           /*get polygon id*/
-           if (strcmp(outputType, "Polygon")==0)
-           {
-              out_poly_id[0] = '\0';
-              if (outIDType == FTInteger) {
-              sprintf(out_poly_id,"%d",g_poly->attr_val[j][0].ival);
-              }
-              /*else if (g_poly->attr_hdr->attr_desc[0]->type == FTString) {*/
-              else if (outIDType == FTString) {
-                sprintf(out_poly_id,"%s",g_poly->attr_val[j][0].str);
-              }
-              else {
-                sprintf(out_poly_id,"poly%d",j);
-              }
-           }
-          
-           /*get egrid id*/
-           if (strcmp(outputType, "EGrid")==0)
-           {
-             polyID = g_poly->attr_val[j][0].ival;
-           }
-        
-#ifdef OLD_SUM
-           a = num[i][j];
-#else
-           a = getPolyIntValue(polyIntInfo, i, j, n1);
-#endif         
-           /* won't need = 0, because only non-zero stored.  If denom is really small-- it is not stored */          
-           if (a != 0.0) 
-           {
-               frac = a/b; /* a = val(k), b is known above */
-               if (valuesOK && ((frac <=0.0) || (frac > 1.0)))
-               {
-                  sprintf(msg,
-                     "At least one surrogate for attribute %d, data polygon %d is not between 0 and 1\n",
-                      attr_num, data_poly_id);
-                  WARN(msg);
-                  valuesOK = 0;                  
-               }
-            
-                        
-               qasum += frac;
-               sprintf(qasum_str,"\t%lf",qasum);
-               sprintf(numerator_str,"\t%lf",a);
-               sum_a += a;
-               sprintf(denominator_str,"\t%lf",b);
-               
-               if (output_qasum || output_numerator || output_denominator)
-               {
-                 if(strcmp(outputType, "RegularGrid")==0 || strcmp(outputType, "EGrid")==0)
-                 {
-                   if(strcmp(outputType, "RegularGrid")==0) 
-                   {
-                     lastcol = j%ncols + 1;
-                     lastrow = j/ncols + 1;
-                   }
-                   else
-                   {
-                     lastcol = (polyID-1)%ncols + 1;
-                     lastrow = (polyID-1)/ncols + 1;
-                   }
-                     
-                   if (b >= denomThreshold && strlen(data_poly_id) >= 1) 
-                   {
-                        fprintf(sfile,"%5d\t%s\t%5d\t%5d\t%10.8lf\t!%s%s%s\n",
-                           attr_num, data_poly_id, lastcol, lastrow,frac,
-                           numerator_str, denominator_str, qasum_str);
-                   }
-                   else
-                   {
-                      fprintf(sfile,
-                        "#SKIPPED %5d\t%s\t%5d\t%5d\t%10.8lf\t!%s%s%s\n",attr_num, 
-                        data_poly_id, lastcol, lastrow,frac,
-                        numerator_str, denominator_str, qasum_str);
-
-                      sprintf(mesg,
-                        "#SKIPPED %5d\t%s\t%5d\t%5d\t%10.8lf\t!%s%s%s\n",attr_num, 
-                        data_poly_id, lastcol, lastrow,frac,
-                        numerator_str, denominator_str, qasum_str);
-                      MESG(mesg);
-                   }
-                 }
-                 else if (strcmp(outputType, "Polygon")==0)
-                 {
-                   if (b >= denomThreshold && strlen(data_poly_id) >= 1) 
-                   {
-                       fprintf(sfile,"%5d\t%s\t%s\t%10.8lf\t!%s%s%s\n",
-                          attr_num, data_poly_id, out_poly_id, frac,
-                          numerator_str, denominator_str, qasum_str);
-                   }
-                   else
-                   {
-                      fprintf(sfile,"#SKIPPED %5d\t%s\t%s\t%10.8lf\t!%s%s%s\n",
-                          attr_num, data_poly_id, out_poly_id, frac,
-                          numerator_str, denominator_str, qasum_str);
-
-                      sprintf(mesg,"#SKIPPED %5d\t%s\t%s\t%10.8lf\t!%s%s%s\n",
-                          attr_num, data_poly_id, out_poly_id, frac,
-                          numerator_str, denominator_str, qasum_str);
-                      MESG(mesg);
-                   }
-                 }
-               }  /*output with QA*/
-               else /* just output the basic surrogate*/
-               {
-                  /* just output the basic surrogate info */
-                  if(strcmp(outputType, "RegularGrid")==0 || strcmp(outputType, "EGrid")==0 )
-                  {
-                    if(strcmp(outputType, "RegularGrid")==0)
-                    {
-                       lastcol = j%ncols + 1;
-                       lastrow = j/ncols + 1;
-                    }
-                    else
-                    {
-                       lastcol = (polyID-1)%ncols + 1;
-                       lastrow = (polyID-1)/ncols + 1;
-                    }
-                    if (b >= denomThreshold && strlen(data_poly_id) >= 1)
-                    {
-                       fprintf(sfile,"%5d\t%s\t%5d\t%5d\t%10.8lf\n",
-                         attr_num, data_poly_id, lastcol, lastrow, frac);
-                    }
-                    else 
-                    {
-                       fprintf(sfile,"#SKIPPED %5d\t%s\t%5d\t%5d\t%10.8lf\n",
-                         attr_num, data_poly_id, lastcol, lastrow, frac);
-                       sprintf(mesg,"#SKIPPED %5d\t%s\t%5d\t%5d\t%10.8lf\n",
-                         attr_num, data_poly_id, lastcol, lastrow, frac);
-                       MESG(mesg);
-                    }
-                  }
-                  else if (strcmp(outputType, "Polygon")==0)
-                  {
-                    if (b >= denomThreshold && strlen(data_poly_id) >= 1)
-                    {
-                      fprintf(sfile,"%5d\t%s\t%s\t%10.8lf\n",
-                         attr_num, data_poly_id, out_poly_id, frac);   
-                    }
-                    else
-                    {
-                      fprintf(sfile,"#SKIPPED %5d\t%s\t%s\t%10.8lf\n",
-                         attr_num, data_poly_id, out_poly_id, frac); 
-                      sprintf(mesg,"#SKIPPED %5d\t%s\t%s\t%10.8lf\n",
-                         attr_num, data_poly_id, out_poly_id, frac); 
-                      MESG(mesg);
-                    }
-                 }              
-               } /*end no QA output*/                     
-
-               num_gridsum[j] += a;                             
-             }  /* if a != 0 */
-          }  /* for (j= 0; j < n2; j++) */   
-      }  /* if (denom[i] != 0) */
-      else  /* denom[i] == 0 */
-      {
-        data_poly_id[0] = '\0';
-        if (attrtype == FTInteger) {
-          sprintf(data_poly_id,"%d",d_poly->attr_val[i][0].ival);
-        }
-        else if (attrtype == FTString) {
-          sprintf(data_poly_id,"%s",d_poly->attr_val[i][0].str);
-        }
-        else {
-          sprintf(data_poly_id,"poly%d",i);
+          r = &g->rec[j];
+          if (r->bin && sbin != NULL && !addSrgBinRecord(sbin, attr_num,
+                 g->id, r->col, r->row, r->frac))
+          {
+             ERROR("reportSurrogate",
+                "Cannot allocate space for the binary surrogates",2);
+          }
+          if (num_gridsum != NULL)
+          {
+             num_gridsum[r->j] += r->a;
+          }
         }
-#ifdef DEBUG
-        fprintf(stderr,"zero for %s\n", data_poly_id);
-#endif
-      } /* denom[i] == 0 */ 
+        free(g->out.s);
+        free(g->log.s);
+        free(g->rec);
+        memset(g, 0, sizeof(SrgGroup));
+      }
     }
     free(denom);
 #ifdef OLD_SUM
@@ -549,6 +747,18 @@ int reportSurrogate(PolyObject *wdg_poly, char *ename, int use_weight_val,
 #endif    
   }
   fclose(sfile);
+  free(group);
+
+  if (sbin != NULL)
+  {
+     sprintf(mesg,"Writing %d surrogates to binary file %s", sbin->nrec, binFname);
+     MESG(mesg);
+     if (!writeSrgBin(sbin, binFname))
+     {
+        ERROR("reportSurrogate", "Cannot write the binary surrogate file",2);
+     }
+     freeSrgBin(sbin);
+  }
 
   if (num_gridsum != NULL)
   { 
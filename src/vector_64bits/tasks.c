@@ -0,0 +1,165 @@
+/****************************************************************************
+ * tasks.c
+ *
+ * The thread pool shared by the tools that split their work into
+ * independent tasks (surrogate sums and output, the overlay union, point
+ * file parsing and srgmerge), and the reader for the environment
+ * variables that set their number of threads.  Threads are not available
+ * on Windows, where every task is run on the calling thread.
+ *
+ * File contains:
+ * envThreads
+ * runTasks
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "shapefil.h"
+#include "mims_spatl.h"
+
+
+/* ============================================================= */
+/* Number of threads from the environment variable name: 1 when it is not
+ * set, and always 1 on Windows */
+int envThreads(char *name)
+{
+    char value[30];
+    char mesg[256];
+    extern char *prog_name;
+    int n = 1;
+
+    if(getenv(name) == NULL)
+    {
+        return n;
+    }
+    if(getEnvtValue(name, value) && value[0] != '\0')
+    {
+        if(digiCheck(value) || (n = atoi(value)) < 1)
+        {
+            sprintf(mesg, "%s must be a positive integer", name);
+            ERROR(prog_name, mesg, 2);
+        }
+    }
+#ifdef _WIN32
+    n = 1;
+#endif
+    return n;
+}
+
+
+/* tasks shared by the threads of runTasks */
+typedef struct _TaskPool {
+    int ntask;
+    int nextTask;
+    void (*task) (void *, int, int);
+    void *arg;
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+} TaskPool;
+
+typedef struct _TaskWorker {
+    TaskPool *pool;
+    int thread;
+} TaskWorker;
+
+
+/* ============================================================= */
+static void taskWork(TaskPool * pool, int thread)
+{
+    int t;
+
+    for(;;)
+    {
+#ifndef _WIN32
+        pthread_mutex_lock(&pool->lock);
+#endif
+        t = pool->nextTask++;
+#ifndef _WIN32
+        pthread_mutex_unlock(&pool->lock);
+#endif
+        if(t >= pool->ntask)
+        {
+            break;
+        }
+        pool->task(pool->arg, t, thread);
+    }
+}
+
+
+#ifndef _WIN32
+static void *taskThread(void *arg)
+{
+    TaskWorker *w = (TaskWorker *) arg;
+
+    taskWork(w->pool, w->thread);
+    return NULL;
+}
+#endif
+
+
+/* ============================================================= */
+/* Run task(arg, t, thread) for t = 0..ntask-1 on up to nthreads threads.
+ * Tasks are handed out in order as threads become free, so tasks of very
+ * different sizes, e.g. counties, still keep all of the threads busy.
+ * thread (0..nthreads-1) lets a task use scratch space of its own thread;
+ * tasks must not write anything another task reads. */
+void runTasks(int ntask, int nthreads, void (*task) (void *, int, int),
+              void *arg)
+{
+    TaskPool pool;
+    int i;
+
+    pool.ntask = ntask;
+    pool.nextTask = 0;
+    pool.task = task;
+    pool.arg = arg;
+    if(nthreads > ntask)
+    {
+        nthreads = ntask;
+    }
+#ifndef _WIN32
+    if(nthreads > 1)
+    {
+        pthread_t *tid = (pthread_t *) malloc(nthreads * sizeof(pthread_t));
+        TaskWorker *w = (TaskWorker *) malloc(nthreads * sizeof(TaskWorker));
+        int started = 1;
+
+        pthread_mutex_init(&pool.lock, NULL);
+        if(tid != NULL && w != NULL)
+        {
+            for(; started < nthreads; started++)
+            {
+                w[started].pool = &pool;
+                w[started].thread = started;
+                if(pthread_create(&tid[started], NULL, taskThread,
+                                  &w[started]) != 0)
+                {
+                    break;
+                }
+            }
+        }
+        /* this thread takes tasks too, and finishes them alone if no
+         * thread could be started */
+        taskWork(&pool, 0);
+        for(i = 1; i < started; i++)
+        {
+            pthread_join(tid[i], NULL);
+        }
+        pthread_mutex_destroy(&pool.lock);
+        free(tid);
+        free(w);
+        return;
+    }
+#endif
+    for(i = 0; i < ntask; i++)
+    {
+        task(arg, i, 0);
+    }
+}
@@ -12,8 +12,181 @@
 
 #include "shapefil.h"
 #include "mims_spatl.h"
+#include "mims_evs.h"
 #include "parms3.h"
 
+/* a shape to be unioned, ordered by the Z-order key of its bounding
+ * box center so that neighbouring shapes end up next to each other */
+typedef struct _UnionItem {
+    unsigned long key;
+    int index;
+    PolyShape *ps;
+} UnionItem;
+
+
+/* ============================================================= */
+/* interleave the low 16 bits of x and y */
+static unsigned long mortonKey(unsigned long x, unsigned long y)
+{
+    unsigned long key = 0;
+    int b;
+
+    for(b = 0; b < 16; b++)
+    {
+        key |= ((x >> b) & 1UL) << (2 * b);
+        key |= ((y >> b) & 1UL) << (2 * b + 1);
+    }
+    return key;
+}
+
+
+/* ============================================================= */
+static int compUnionItem(const void *a, const void *b)
+{
+    const UnionItem *u1 = (const UnionItem *) a;
+    const UnionItem *u2 = (const UnionItem *) b;
+
+    if(u1->key != u2->key)
+    {
+        return (u1->key < u2->key) ? -1 : 1;
+    }
+    return u1->index - u2->index;
+}
+
+
+/* one level of cascadedUnion, shared by the threads of runTasks */
+typedef struct _UnionLevel {
+    gpc_polygon **level;        /* the polygons of this level */
+    char *owned;                /* level[i] is an intermediate result */
+    gpc_polygon **next;         /* the unions of its pairs */
+} UnionLevel;
+
+
+/* ============================================================= */
+/* Union pair t of a level into next[t].  The pairs share no polygons,
+ * and gpc keeps no state between calls, so the pairs of a level can be
+ * unioned on different threads. */
+static void unionPair(void *arg, int t, int thread)
+{
+    UnionLevel *u = (UnionLevel *) arg;
+    gpc_polygon *result;
+    int i = 2 * t;
+
+    result = (gpc_polygon *) malloc(sizeof(gpc_polygon));
+    if(result != NULL)
+    {
+        gpc_polygon_clip(GPC_UNION, u->level[i + 1], u->level[i], result);
+    }
+    if(u->owned[i])
+    {
+        gpc_free_polygon(u->level[i]);
+        free(u->level[i]);
+    }
+    if(u->owned[i + 1])
+    {
+        gpc_free_polygon(u->level[i + 1]);
+        free(u->level[i + 1]);
+    }
+    u->next[t] = result;
+}
+
+
+/* ============================================================= */
+/* Union the n shapes in items as a balanced tree: neighbours in the
+ * Z-order are unioned pairwise, then the pairs of those results, and so
+ * on, so each shape takes part in about log2(n) clips of polygons that
+ * only cover its own part of the overlay.  Folding the shapes one at a
+ * time into a single result instead clips the whole accumulated polygon
+ * for every shape.  The pairs of each level are unioned on up to
+ * UNION_THREADS threads; the pairs are the same for any number of
+ * threads, so the result is too.  Intermediate results are freed as
+ * soon as they have been used; the input shapes are left alone.
+ * Returns a newly allocated polygon, or NULL on an allocation error. */
+static gpc_polygon *cascadedUnion(UnionItem * items, int n)
+{
+    UnionLevel u;
+    gpc_polygon **swap;
+    gpc_polygon *result;
+    gpc_polygon empty = { 0, NULL, NULL };
+    int i, m, failed, carried, nthreads;
+
+    /* a lone shape is still put through one union, as before */
+    if(n < 2)
+    {
+        result = (gpc_polygon *) malloc(sizeof(gpc_polygon));
+        if(result != NULL)
+        {
+            gpc_polygon_clip(GPC_UNION, n ? items[0].ps : &empty, &empty,
+                             result);
+        }
+        return result;
+    }
+
+    u.level = (gpc_polygon **) malloc(n * sizeof(gpc_polygon *));
+    u.next = (gpc_polygon **) malloc(n * sizeof(gpc_polygon *));
+    u.owned = (char *) malloc(n * sizeof(char));
+    if(!u.level || !u.next || !u.owned)
+    {
+        free(u.level);
+        free(u.next);
+        free(u.owned);
+        return NULL;
+    }
+    for(i = 0; i < n; i++)
+    {
+        u.level[i] = items[i].ps;
+        u.owned[i] = 0;
+    }
+
+    nthreads = envThreads(ENVT_UNION_THREADS);
+    failed = 0;
+    while(n > 1 && !failed)
+    {
+        m = n / 2;
+        runTasks(m, nthreads, unionPair, &u);
+
+        /* an odd shape is carried up to the next level */
+        carried = u.owned[n - 1];
+        if(n % 2)
+        {
+            u.next[m] = u.level[n - 1];
+            u.owned[m] = carried;
+        }
+        for(i = 0; i < m; i++)
+        {
+            u.owned[i] = 1;
+            if(u.next[i] == NULL)
+            {
+                u.owned[i] = 0;
+                failed = 1;
+            }
+        }
+        n = m + n % 2;
+        swap = u.level;
+        u.level = u.next;
+        u.next = swap;
+    }
+
+    result = u.level[0];
+    if(failed)
+    {
+        for(i = 0; i < n; i++)
+        {
+            if(u.owned[i])
+            {
+                gpc_free_polygon(u.level[i]);
+                free(u.level[i]);
+            }
+        }
+        result = NULL;
+    }
+    free(u.level);
+    free(u.next);
+    free(u.owned);
+    return result;
+}
+
+
 /* ============================================================= */
 /* Performs a union on a polygon, and  
  * returns the result as a set of contours (which could be points) in p 
@@ -30,6 +203,8 @@ int polyUnion(
   int at_least_one;
   int itemp = 0;
   PolyShape *polyResult, *tmpPoly;
+  UnionItem *items;
+  double xmin, ymin, xmax, ymax, xscale, yscale;
   PolyParent *pp;
   PolyShapeList *plist, *plist2;
   Parent **p1;
@@ -71,41 +246,74 @@ int polyUnion(
   for (i=0; i < n2; i++) 
   {
       pp = plist->pp;
-      p2[i] = newParent(pp, plist->ps, i);
+      p2[i] = newParent(pp, plist, i);
       plist = plist->next;
   }
-  plist2 = inpoly->plist;
-
 
   at_least_one = 0;
 
   polyResult = getNewPolyShape(0);
+  items = (UnionItem *)malloc(MAX(1, n2)*sizeof(UnionItem));
+
+  if (polyResult == NULL || items == NULL) 
+  {
+    WARN("Malloc error for getNewPolyShape");
+    return -1;
+  }
 
+  /* order the shapes along a Z-order curve over the overlay's extent
+   * so that the pairs unioned first are close together */
+  xmin = ymin = xmax = ymax = 0.0;
+  plist2 = inpoly->plist;
   for (j = 0; j < n2; j++) 
   {
+      if (j == 0 || plist2->bb->xmin < xmin) xmin = plist2->bb->xmin;
+      if (j == 0 || plist2->bb->ymin < ymin) ymin = plist2->bb->ymin;
+      if (j == 0 || plist2->bb->xmax > xmax) xmax = plist2->bb->xmax;
+      if (j == 0 || plist2->bb->ymax > ymax) ymax = plist2->bb->ymax;
+      plist2 = plist2->next;
+  }
+  xscale = (xmax > xmin) ? 65535.0 / (xmax - xmin) : 0.0;
+  yscale = (ymax > ymin) ? 65535.0 / (ymax - ymin) : 0.0;
 
-      if (polyResult == NULL) 
-      {
-        WARN("Malloc error for getNewPolyShape");
-        return -1;
-      }
-          
-      gpc_polygon_clip(GPC_UNION, plist2->ps, polyResult,  polyResult);     
-      /*gpc_polygon_clip(GPC_UNION, polyResult, plist2->ps, polyResult);*/
+  plist2 = inpoly->plist;
+  for (j = 0; j < n2; j++) 
+  {
+      items[j].index = j;
+      items[j].ps = plist2->ps;
+      items[j].key = mortonKey(
+          (unsigned long)((0.5*(plist2->bb->xmin + plist2->bb->xmax) - xmin)*xscale),
+          (unsigned long)((0.5*(plist2->bb->ymin + plist2->bb->ymax) - ymin)*yscale));
 #ifdef DEBUG
       gpc_write_polygon(stderr, 0, plist2->ps);
-      gpc_write_polygon(stderr, 0, polyResult);
 #endif
       plist2 = plist2->next;
-    } /* for (j=0; j<n2; j++) */
+  }
+  qsort(items, n2, sizeof(UnionItem), compUnionItem);
+
+  tmpPoly = cascadedUnion(items, n2);
+  free(items);
+  if (tmpPoly == NULL) 
+  {
+    WARN("Allocation error in polyUnion");
+    return -1;
+  }
+
+  /* move the union into the shape allocated for the result */
+  *polyResult = *tmpPoly;
+  free(tmpPoly);
+#ifdef DEBUG
+  gpc_write_polygon(stderr, 0, polyResult);
+#endif
     
       n = polyResult->num_contours;
-      /* if n > 0, there was a non-empty union of p1 and p2 */
-      if(n) 
+      /* if n > 0, there was a non-empty union of the shapes; it is
+       * given the first shape as its parent */
+      if(n && n2 > 0) 
       {
          at_least_one = 1;
          p->nObjects++;
-         pp = newPolyParent(p2[j], p2[j]);
+         pp = newPolyParent(p2[0], p2[0]);
          polyShapeIncl(&(p->plist), polyResult, pp);
       }
       else 
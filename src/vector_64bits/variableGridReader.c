@@ -4,7 +4,8 @@
  * file that corresponds to the outermost edge of the modeled domain /
  * coarsest resolution.
  *
- * THIS READER READS AN ASCII DUMP OF THE NETCDF GRID_DOT or GRID_CRO FILE
+ * THIS READER READS THE NETCDF GRID_DOT or GRID_CRO FILE, either directly
+ * through the I/O API or from an ASCII dump of it made with ncdump.
  * It looks for the variables LAT and LON
  * 
  * Moved into a separate variableGridReader.c file 4/8/2005 BDB
@@ -23,6 +24,9 @@
 #include "mims_spatl.h"
 #include "mims_evs.h"
 #include "parms3.h"
+#ifdef USE_IOAPI
+#include "iodecl3.h"
+#endif
 
 static char strTokString[512];
 static char *strTokPtr;
@@ -79,6 +83,100 @@ int nextVal(char * string, const char *delim, double *valuePtr)
    return 0;   
 }
 
+/* true if the file starts with a netCDF (classic, 64-bit offset or
+ * netCDF-4/HDF5) signature rather than ncdump text */
+static int isNetCDFFile(char *fname)
+{
+   FILE *fp;
+   unsigned char sig[4];
+   int n;
+
+   if ((fp = fopen(fname, "rb")) == NULL)
+   {
+      return 0;
+   }
+   n = fread(sig, 1, 4, fp);
+   fclose(fp);
+   if (n < 4)
+   {
+      return 0;
+   }
+   if (sig[0] == 'C' && sig[1] == 'D' && sig[2] == 'F' &&
+       (sig[3] == 1 || sig[3] == 2 || sig[3] == 5))
+   {
+      return 1;
+   }
+   return (sig[0] == 0x89 && sig[1] == 'H' && sig[2] == 'D' && sig[3] == 'F');
+}
+
+#ifdef USE_IOAPI
+/* Read the dot point Y (LAT or YDOT) and X (LON or XDOT) values of the
+ * file named by GRID_DOT_FILE through the I/O API, without going through
+ * an ncdump text file.  Returns 0 on success. */
+static int readDotPointsIoapi(char *yvar, char *xvar, int *ndotcols,
+                              int *ndotrows, double **yvals, double **xvals,
+                              char *mesg)
+{
+   extern char *prog_name;
+   IOAPI_Bdesc3 bdesc;
+   IOAPI_Cdesc3 cdesc;
+   float *buf;
+   int i, n;
+
+   if (!open3c(ENVT_GRID_DOT_FILE, &bdesc, &cdesc, FSREAD3, prog_name))
+   {
+      sprintf(mesg, "Unable to open grid dot file %s", ENVT_GRID_DOT_FILE);
+      return 1;
+   }
+   if (!desc3c(ENVT_GRID_DOT_FILE, &bdesc, &cdesc))
+   {
+      sprintf(mesg, "Unable to get description of grid dot file %s",
+              ENVT_GRID_DOT_FILE);
+      return 1;
+   }
+   *ndotcols = bdesc.ncols;
+   *ndotrows = bdesc.nrows;
+   n = bdesc.ncols * bdesc.nrows;
+
+   buf = (float *) malloc(n * sizeof(float));
+   *yvals = (double *) malloc(n * sizeof(double));
+   *xvals = (double *) malloc(n * sizeof(double));
+   if (buf == NULL || *yvals == NULL || *xvals == NULL)
+   {
+      sprintf(mesg, "Could not allocate space for variable grid dot lat and lon points");
+      goto fail;
+   }
+
+   if (!read3c(ENVT_GRID_DOT_FILE, yvar, 1, bdesc.sdate, bdesc.stime, buf))
+   {
+      sprintf(mesg, "Could not read variable %s from grid dot file", yvar);
+      goto fail;
+   }
+   for (i = 0; i < n; i++)
+   {
+      (*yvals)[i] = buf[i];
+   }
+   if (!read3c(ENVT_GRID_DOT_FILE, xvar, 1, bdesc.sdate, bdesc.stime, buf))
+   {
+      sprintf(mesg, "Could not read variable %s from grid dot file", xvar);
+      goto fail;
+   }
+   for (i = 0; i < n; i++)
+   {
+      (*xvals)[i] = buf[i];
+   }
+   free(buf);
+   return 0;
+
+fail:
+   free(buf);
+   free(*yvals);
+   free(*xvals);
+   *yvals = *xvals = NULL;
+   return 1;
+}
+#endif
+
 PolyObject *VariableGridReader( 
    char *name, /* file name to read */
    BoundingBox *bbox,  /* bounding box of interest - ignore if NULL */
@@ -93,7 +191,7 @@ PolyObject *VariableGridReader(
   int nObjects;
   int nv, np;
   int c, r;
-  char mesg[256];
+  char mesg[512];
   /*char *earth_ellipsoid;*/
 
   char YVARSTR[10];
@@ -122,10 +220,10 @@ PolyObject *VariableGridReader(
   double lastYVal;*/
   double latVal;
   double lonVal;
-  double *latVals; /* sorted array of all lat values */
-  double *lonVals; /* sorted array of all lon values */
-  double *xVals; /* sorted array of all X values */
-  double *yVals; /* sorted array of all Y values */
+  double *latVals = NULL; /* sorted array of all lat values */
+  double *lonVals = NULL; /* sorted array of all lon values */
+  double *xVals = NULL; /* sorted array of all X values */
+  double *yVals = NULL; /* sorted array of all Y values */
   double cellXCent;
   double cellYCent;
   double totalX; /* total width of grid */
@@ -158,11 +256,11 @@ PolyObject *VariableGridReader(
   int    readingXY = 0;  /* 0 if reading lat/lon, 1 for x/y */
   int    foundX = 0;
   int    foundY = 0;
-  FILE   *outGridFile;
+  FILE   *outGridFile = NULL;
   MapProjInfo *latlonMapProj;
 
 
-  MESG("Reading Variable Grid output from NCDUMP\n");
+  MESG("Reading Variable Grid\n");
   map = getNewMap();
   if (map == NULL) {
     sprintf(mesg,"getNewMap error for %s", name);
@@ -225,6 +323,38 @@ PolyObject *VariableGridReader(
        ENVT_GRID_DOT_FILE);
        goto error;
   }    
+  if (getenv("READ_XYDOT") != NULL)
+  {
+    if (strcmp(getenv("READ_XYDOT"),"1") == 0)
+    {
+       readingXY = 1;
+    }
+  }
+
+  /* a netCDF file is read directly; anything else is taken to be the
+   * output of ncdump */
+  if (isNetCDFFile(gridDotFileName))
+  {
+#ifdef USE_IOAPI
+    sprintf(mesg,"Reading grid dot file %s through the I/O API\n",gridDotFileName);
+    MESG(mesg);
+    if (readDotPointsIoapi(readingXY ? "YDOT" : "LAT", readingXY ? "XDOT" : "LON",
+                           &numVarDotCols, &numVarDotRows, &latVals, &lonVals, mesg))
+    {
+       goto error;
+    }
+    sprintf(mesg,"Variable grid: number of dot cols = %d, number of dot rows = %d\n",
+       numVarDotCols, numVarDotRows);
+    MESG(mesg);
+    totDotPoints = numVarDotCols*numVarDotRows;
+    goto got_dot_points;
+#else
+    sprintf(mesg,"Grid dot file %s is a netCDF file; without the I/O API it must first be converted with ncdump",
+       gridDotFileName);
+    goto error;
+#endif
+  }
+
   sprintf(mesg,"Opening grid dot file %s\n",gridDotFileName);
   MESG(mesg);
   if ((gridDotFile = fopen(gridDotFileName,"r")) == NULL) {
@@ -284,14 +414,10 @@ PolyObject *VariableGridReader(
   
   strcpy(YVARSTR,"LAT =");
   strcpy(XVARSTR,"LON =");
-  if (getenv("READ_XYDOT") != NULL)
+  if (readingXY)
   {
-    if (strcmp(getenv("READ_XYDOT"),"1") == 0)
-    {
-       strcpy(YVARSTR,"YDOT =");
-       strcpy(XVARSTR,"XDOT =");
-       readingXY = 1;
-    }
+     strcpy(YVARSTR,"YDOT =");
+     strcpy(XVARSTR,"XDOT =");
   }      
 
   do
@@ -410,6 +536,10 @@ PolyObject *VariableGridReader(
   } while ((readResult != NULL) && 
            ((currLon < totDotPoints) || ( currLat < totDotPoints)));
   fclose(gridDotFile);
+
+#ifdef USE_IOAPI
+ got_dot_points:
+#endif
   map->ncols = numVarDotCols-1;  /* subtract 1 because we want # cells, not lines */
   map->nrows = numVarDotRows-1;
    
@@ -422,30 +552,51 @@ PolyObject *VariableGridReader(
   yVals = (double *)malloc(totDotPoints*sizeof(double));
   
 
-  latlonMapProj = getFullMapProjection(ioapi_sphere, "+proj=latlong");
+  /* the dot points are on the I/O API sphere; getFullMapProjection
+   * takes the names of environment variables, so build the map here */
+  latlonMapProj = getNewMap();
+  if (latlonMapProj == NULL) {
+    sprintf(mesg,"getNewMap error for the grid dot lat-lon points");
+    goto error;
+  }
+  latlonMapProj->earth_ellipsoid = (char *) strdup(ioapi_sphere);
+  latlonMapProj->ctype = CUSTOM3;
+  latlonMapProj->custom_proj_str = (char *) strdup("+proj=latlong");
   storeProjection(latlonMapProj, map);
   
+  if ((xVals == NULL) || (yVals == NULL))
+  {
+     sprintf(mesg,"Could not allocate space for variable grid dot x and y points");
+     goto error;
+  }
+
+  if (!readingXY)
+  {
+    /* convert lat lon to projected coordinates, all points at once */
+    memcpy(xVals, lonVals, totDotPoints*sizeof(double));
+    memcpy(yVals, latVals, totDotPoints*sizeof(double));
+    projectPoints(totDotPoints, xVals, yVals);
+  }
+  else  /* we just want to adjust the origin, we don't need to project */
+  {
+    for (r = 0; r < totDotPoints; r++)
+    {
+       xVals[r] = lonVals[r]+xorig;
+       yVals[r] = latVals[r]+yorig;
+    }
+  }
+
   cminX = 1E20;
   cminY = 1E20;
   cmaxX = -1E20;
   cmaxY = -1E20;
-  fprintf(outGridFile,"X and Y\n");
+  if (outGridFile) fprintf(outGridFile,"X and Y\n");
   for (r = 0; r < totDotPoints; r++)
   {
-    if (!readingXY)
-    {
-       /* convert lat lon to projected coordinates */
-       projectPoint ( lonVals[r], latVals[r], &projx, &projy);    
+    projx = xVals[r];
+    projy = yVals[r];
+    if (outGridFile)
        fprintf(outGridFile,"%lf %lf %lf %lf\n",lonVals[r], projx, projy, latVals[r]);
-    }
-    else  /* we just want to adjust the origin, we don't need to project */
-    {
-       projx = lonVals[r]+xorig;
-       projy = latVals[r]+yorig;
-       fprintf(outGridFile,"%lf %lf %lf %lf\n",lonVals[r], projx, projy, latVals[r]);
-    }   
-    xVals[r] = projx;
-    yVals[r] = projy;  
     cminX = MIN(cminX, projx);
     cminY = MIN(cminY, projy);
     cmaxX = MAX(cmaxX, projx);
@@ -453,8 +604,9 @@ PolyObject *VariableGridReader(
   }
   fprintf(stderr,"check of BBox (minx, miny, maxx, maxy) = %lf, %lf, %lf, %lf\n",
      cminX, cminY, cmaxX, cmaxY);
-  fprintf(outGridFile,"BBOX (minx, maxx, miny, maxy) = %lf, %lf, %lf, %lf\n",
-     cminX, cmaxX, cminY, cmaxY);
+  if (outGridFile)
+     fprintf(outGridFile,"BBOX (minx, maxx, miny, maxy) = %lf, %lf, %lf, %lf\n",
+        cminX, cmaxX, cminY, cmaxY);
   
   nObjects = (numVarDotCols - 1) * (numVarDotRows - 1);
   sprintf(mesg,"num grid cells = %d\n",nObjects);
@@ -474,7 +626,7 @@ PolyObject *VariableGridReader(
   np = 1;  /* num parts of shape */
 
   MESG("computing cell coordinates \n");
-  fprintf(outGridFile,"GRID CELLS\n");
+  if (outGridFile) fprintf(outGridFile,"GRID CELLS\n");
   
   /* r and c are for grid cells (one less than dot rows/cols), 
    * plus indexing on low size, so go to num dot rows and cols - 2 */
@@ -493,7 +645,8 @@ PolyObject *VariableGridReader(
       shp->vertex[2].y = yVals[ul+1];
       shp->vertex[3].x = xVals[ll+1]; /* lower right corner */
       shp->vertex[3].y = yVals[ll+1];
-      fprintf(outGridFile,"%d %d %.2f %.2f %.2f %.2f %.2f %.2f %.2f %.2f\n",
+      if (outGridFile)
+        fprintf(outGridFile,"%d %d %.2f %.2f %.2f %.2f %.2f %.2f %.2f %.2f\n",
          r+1, c+1, shp->vertex[0].x, shp->vertex[0].y,
          shp->vertex[1].x, shp->vertex[1].y, shp->vertex[2].x, shp->vertex[2].y,
          shp->vertex[3].x, shp->vertex[3].y);
@@ -503,7 +656,7 @@ PolyObject *VariableGridReader(
       polyShapeIncl(&(poly->plist), ps, NULL);
     }
   }  
-  fclose(outGridFile);
+  if (outGridFile) fclose(outGridFile);
   if (xVals) free(xVals);
   if (yVals) free(yVals);
   if (latVals) free(latVals);